@@ -0,0 +1,104 @@
+#include "tau.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+Compile pass microbenchmark.
+
+Parses one generated module with many arithmetic-heavy functions, runs the
+TypeChecker pass over it once and then times ModuleNode::compile repeatedly.
+The figure of merit is time per compile, which is dominated by per-node
+dispatch now that types are resolved once up front.
+
+usage: compile_pass [functions] [statements] [iterations] [threads]
+
+threads is handed to TypeCheckModule, 0 uses every core.
+*/
+
+static std::string generate_module(u64 functions, u64 statements) {
+	std::stringstream src;
+	src << "mod bench;\n\n";
+
+	for (u64 f = 0; f < functions; f++) {
+		src << "pub fn f" << f << "(i64 a, i64 b) i64 {\n";
+		src << "\ti64 c = a + b;\n";
+		for (u64 s = 0; s < statements; s++) {
+			src << "\ti64 v" << s << " = (a + b * " << s << ") - (c - a) * (b + " << s << ") + -c;\n";
+		}
+		src << "\tif (a < b) { return a * b + c; } else { return c - a; }\n";
+		src << "}\n\n";
+	}
+
+	return src.str();
+}
+
+int main(int argc, char** argv) {
+	u64 functions = argc > 1 ? atoll(argv[1]) : 64;
+	u64 statements = argc > 2 ? atoll(argv[2]) : 32;
+	u64 iterations = argc > 3 ? atoll(argv[3]) : 20;
+	u64 threads = argc > 4 ? atoll(argv[4]) : 1;
+
+	std::string source = generate_module(functions, statements);
+
+	tau::TokenStream tokens;
+	tau::result<bool> result = tau::Tokenize(source, "bench.tau", tokens);
+	if (result.error_bit) {
+		std::cout << result.error << "\n";
+		return 1;
+	}
+
+	tau::Parser parser;
+	tau::InitializeTauParser(parser);
+	tau::AstNode* node = parser.parse_eval(tokens, "Module");
+
+	if (node == nullptr) {
+		std::cout << "Failed to parse generated module\n";
+		return 1;
+	}
+
+	tau::ParserContext ctx = parser.get_context();
+
+	auto check_start = std::chrono::steady_clock::now();
+	bool checked = tau::TypeCheckModule(tau::node_cast<tau::ModuleNode>(node), ctx, threads);
+	auto check_end = std::chrono::steady_clock::now();
+
+	if (!checked) {
+		for (auto& err : ctx.errors) {
+			std::cout << "Error: " << err << "\n";
+		}
+		return 1;
+	}
+
+	double best = 1e30;
+	double total = 0;
+	size_t output_size = 0;
+
+	for (u64 i = 0; i < iterations; i++) {
+		std::stringstream output;
+
+		auto start = std::chrono::steady_clock::now();
+		bool ok = node->compile(output, ctx);
+		auto end = std::chrono::steady_clock::now();
+
+		if (!ok) {
+			std::cout << "Compile pass failed\n";
+			return 1;
+		}
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		best = std::min(best, seconds);
+		total += seconds;
+		output_size = output.str().size();
+	}
+
+	std::cout << functions << " functions x " << statements << " statements, " << output_size << " bytes of C\n";
+	std::cout << "type check (" << threads << " threads): " << std::chrono::duration<double>(check_end - check_start).count() * 1000.0 << "ms\n";
+	std::cout << "best: " << best * 1000.0 << "ms, mean: " << (total / iterations) * 1000.0 << "ms\n";
+
+	delete node;
+	return 0;
+}
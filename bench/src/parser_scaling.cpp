@@ -0,0 +1,205 @@
+#include "tau.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+Parser scaling benchmark.
+
+Every shape generates a module whose size grows with N and runs it through
+Tokenize + Parser::parse_eval(tokens, "Module"). The timings are fitted to
+t = c * N^k on a log-log scale and the run fails if any k is worse than linear.
+
+usage: parser_scaling [max_exponent]
+*/
+
+struct Shape {
+	std::string name;
+	std::vector<u64> sizes;
+	std::function<std::string(u64)> generate;
+};
+
+struct Sample {
+	u64 n;
+	double seconds;
+};
+
+static u64 s_StructCounter = 0;
+
+static std::string gen_statements(u64 n) {
+	std::stringstream src;
+	src << "mod bench;\n\npub fn run() void {\n";
+	for (u64 i = 0; i < n; i++) {
+		src << "\ti64 v" << i << " = " << i << ";\n";
+	}
+	src << "}\n";
+	return src.str();
+}
+
+static std::string gen_call_args(u64 n) {
+	std::stringstream src;
+	src << "mod bench;\n\npub fn run() void {\n\tsink(";
+	for (u64 i = 0; i < n; i++) {
+		src << i;
+		if (i + 1 < n) {
+			src << ", ";
+		}
+	}
+	src << ");\n}\n";
+	return src.str();
+}
+
+static std::string gen_nested_parens(u64 n) {
+	std::stringstream src;
+	src << "mod bench;\n\npub fn run() void {\n\ti64 v = ";
+	for (u64 i = 0; i < n; i++) {
+		src << "(";
+	}
+	src << "1";
+	for (u64 i = 0; i < n; i++) {
+		src << ")";
+	}
+	src << ";\n}\n";
+	return src.str();
+}
+
+static std::string gen_nested_calls(u64 n) {
+	std::stringstream src;
+	src << "mod bench;\n\npub fn run() void {\n\ti64 v = ";
+	for (u64 i = 0; i < n; i++) {
+		src << "f(";
+	}
+	src << "1";
+	for (u64 i = 0; i < n; i++) {
+		src << ")";
+	}
+	src << ";\n}\n";
+	return src.str();
+}
+
+static std::string gen_struct_members(u64 n) {
+	// struct definitions register themselves in the global TypeRegistry, so every run needs a fresh name
+	std::stringstream src;
+	src << "mod bench;\n\nstruct s" << s_StructCounter++ << " {\n";
+	for (u64 i = 0; i < n; i++) {
+		src << "\tpub i64 m" << i << ";\n";
+	}
+	src << "}\n";
+	return src.str();
+}
+
+static std::string gen_else_if_chain(u64 n) {
+	std::stringstream src;
+	src << "mod bench;\n\npub fn run(i64 v) void {\n\t";
+	for (u64 i = 0; i < n; i++) {
+		src << "if (v < " << i << ") { v = " << i << "; }\n\telse ";
+	}
+	src << "{ v = 0; }\n}\n";
+	return src.str();
+}
+
+static double time_parse(const Shape& shape, u64 n, u64 repetitions) {
+	double best = 1e30;
+
+	for (u64 r = 0; r < repetitions; r++) {
+		std::string source = shape.generate(n);
+
+		auto start = std::chrono::steady_clock::now();
+
+		tau::TokenStream tokens;
+		tau::result<bool> result = tau::Tokenize(source, "bench.tau", tokens);
+		if (result.error_bit) {
+			std::cout << result.error << "\n";
+			return -1;
+		}
+
+		tau::Parser parser;
+		tau::InitializeTauParser(parser);
+		tau::AstNode* node = parser.parse_eval(tokens, "Module");
+
+		auto end = std::chrono::steady_clock::now();
+
+		if (node == nullptr) {
+			return -1;
+		}
+		delete node;
+
+		best = std::min(best, std::chrono::duration<double>(end - start).count());
+	}
+
+	return best;
+}
+
+// least squares slope of log(t) over log(n)
+static double fit_exponent(const std::vector<Sample>& samples) {
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	double count = (double)samples.size();
+
+	for (auto& s : samples) {
+		double x = std::log((double)s.n);
+		double y = std::log(s.seconds);
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+
+	return (count * sxy - sx * sy) / (count * sxx - sx * sx);
+}
+
+int main(int argc, char** argv) {
+	double max_exponent = 1.25;
+	if (argc > 1) {
+		max_exponent = atof(argv[1]);
+	}
+
+	std::vector<Shape> shapes = {
+		{ "statements per function", { 64, 128, 256, 512, 1024 }, gen_statements },
+		{ "call arguments", { 64, 128, 256, 512, 1024 }, gen_call_args },
+		{ "nested parentheses", { 64, 128, 256, 512, 1024 }, gen_nested_parens },
+		{ "nested calls", { 64, 128, 256, 512, 1024 }, gen_nested_calls },
+		{ "struct members", { 64, 128, 256, 512, 1024 }, gen_struct_members },
+		{ "else-if chain", { 16, 32, 64, 128, 256 }, gen_else_if_chain },
+	};
+
+	bool failed = false;
+
+	for (auto& shape : shapes) {
+		std::vector<Sample> samples;
+
+		std::cout << shape.name << "\n";
+		for (u64 n : shape.sizes) {
+			double seconds = time_parse(shape, n, 3);
+
+			if (seconds < 0) {
+				std::cout << "\tN = " << n << ": failed to parse\n";
+				failed = true;
+				samples.clear();
+				break;
+			}
+
+			std::cout << "\tN = " << n << ": " << seconds * 1000.0 << "ms\n";
+			samples.push_back({ n, std::max(seconds, 1e-9) });
+		}
+
+		if (samples.size() < 2) {
+			continue;
+		}
+
+		double k = fit_exponent(samples);
+		bool ok = k <= max_exponent;
+		std::cout << "\tgrowth: N^" << k << (ok ? "" : "  <-- worse than linear") << "\n\n";
+
+		if (!ok) {
+			failed = true;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
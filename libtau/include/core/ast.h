@@ -10,31 +10,57 @@ namespace tau {
 
 	class AstNode {
 	public:
+		inline AstNode(NodeType kind = NodeType::Undefined) : m_Kind{ kind } {}
 		virtual ~AstNode() = default;
 
 		virtual bool compile(std::ostream& outputStream, ParserContext& ctx);
 
 		virtual void debug_print() {};
-	protected:
 
+		inline NodeType kind() const {
+			return m_Kind;
+		}
+
+	protected:
+		NodeType m_Kind;
 	};
 
+	// checked downcast on the node tag, returns nullptr on mismatch like dynamic_cast
+	template<typename _ty>
+	inline _ty* node_cast(AstNode* node) {
+		if (node == nullptr || node->kind() != _ty::Kind) {
+			return nullptr;
+		}
+		return static_cast<_ty*>(node);
+	}
+
 	class OrphanTokens : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::TempToken;
+		inline OrphanTokens() : AstNode(Kind) {}
+
 		std::vector<token> tokens;
 	};
 
 	class Typed {
 	public:
 		virtual _type_id get_type(ParserContext& registry) = 0;
+
+		// written by the TypeChecker pass (or the first get_type call), 0 while unresolved
+		_type_id resolved_type = 0;
 	};
 
+	Typed* as_typed(AstNode* node);
+
 	class StructDefNode;
 	class FunctionDefinitionNode;
 	class IncludeNode;
 
 	class ModuleBodyNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::ModuleBody;
+		inline ModuleBodyNode() : AstNode(Kind) {}
+
 		std::vector<StructDefNode*> structs;
 		std::vector<FunctionDefinitionNode*> functions;
 		std::vector<IncludeNode*> includes;
@@ -46,6 +72,9 @@ namespace tau {
 
 	class InlineCBlock : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::CBlock;
+		inline InlineCBlock() : AstNode(Kind) {}
+
 		std::vector<token> tokens;
 
 		virtual bool compile(std::ostream& outputStream, ParserContext& ctx) override;
@@ -53,7 +82,8 @@ namespace tau {
 
 	class StaticIntegerNode : public AstNode, public Typed {
 	public:
-		inline StaticIntegerNode(i64 value, std::string_view type_name) : m_Value{ value }, m_TypeName{ type_name } {
+		static constexpr NodeType Kind = NodeType::ImmediateInt;
+		inline StaticIntegerNode(i64 value, std::string_view type_name) : AstNode(Kind), m_Value{ value }, m_TypeName{ type_name } {
 
 		}
 
@@ -67,11 +97,12 @@ namespace tau {
 			std::cout << m_Value;
 		}
 
-		inline bool compile(std::ostream& output, ParserContext& ctx) {
-			output << m_Value;
-			return true;
+		inline std::string_view type_name() const {
+			return m_TypeName;
 		}
 
+		bool compile(std::ostream& output, ParserContext& ctx) override;
+
 	private:
 		i64 m_Value;
 		std::string_view m_TypeName;
@@ -79,7 +110,8 @@ namespace tau {
 
 	class StaticStringNode : public AstNode, public Typed {
 	public:
-		inline StaticStringNode(const std::string& value, std::string_view type_name) : m_Value{ value }, m_TypeName{ type_name } {
+		static constexpr NodeType Kind = NodeType::ImmediateString;
+		inline StaticStringNode(const std::string& value, std::string_view type_name) : AstNode(Kind), m_Value{ value }, m_TypeName{ type_name } {
 
 		}
 
@@ -93,7 +125,11 @@ namespace tau {
 			std::cout << m_Value;
 		}
 
-		inline bool compile(std::ostream& output, ParserContext& ctx) {
+		inline std::string_view type_name() const {
+			return m_TypeName;
+		}
+
+		bool compile(std::ostream& output, ParserContext& ctx) {
 			output << "\"" << m_Value << "\"";
 			return true;
 		}
@@ -105,7 +141,8 @@ namespace tau {
 
 	class StaticCharNode : public AstNode, public Typed {
 	public:
-		inline StaticCharNode(char value, std::string_view type_name) : m_Value{ value }, m_TypeName{ type_name } {
+		static constexpr NodeType Kind = NodeType::ImmediateChar;
+		inline StaticCharNode(char value, std::string_view type_name) : AstNode(Kind), m_Value{ value }, m_TypeName{ type_name } {
 
 		}
 
@@ -119,7 +156,11 @@ namespace tau {
 			std::cout << m_Value;
 		}
 
-		inline bool compile(std::ostream& output, ParserContext& ctx) {
+		inline std::string_view type_name() const {
+			return m_TypeName;
+		}
+
+		bool compile(std::ostream& output, ParserContext& ctx) {
 			output << "'" << m_Value << "'";
 			return true;
 		}
@@ -131,7 +172,8 @@ namespace tau {
 
 	class StaticBoolNode : public AstNode, public Typed {
 	public:
-		inline StaticBoolNode(bool value, std::string_view type_name) : m_Value{ value }, m_TypeName{ type_name } {
+		static constexpr NodeType Kind = NodeType::ImmediateBool;
+		inline StaticBoolNode(bool value, std::string_view type_name) : AstNode(Kind), m_Value{ value }, m_TypeName{ type_name } {
 
 		}
 
@@ -145,7 +187,11 @@ namespace tau {
 			std::cout << m_Value;
 		}
 
-		inline bool compile(std::ostream& output, ParserContext& ctx) {
+		inline std::string_view type_name() const {
+			return m_TypeName;
+		}
+
+		bool compile(std::ostream& output, ParserContext& ctx) {
 			output << (m_Value ? "true" : "false");
 			return true;
 		}
@@ -159,7 +205,8 @@ namespace tau {
 
 	class VariableNode : public AstNode, public Typed {
 	public:
-		inline VariableNode(PathNode* variableName) : m_VariableName{ variableName } {
+		static constexpr NodeType Kind = NodeType::Variable;
+		inline VariableNode(PathNode* variableName) : AstNode(Kind), m_VariableName{ variableName } {
 
 		}
 		~VariableNode();
@@ -168,13 +215,20 @@ namespace tau {
 
 		bool compile(std::ostream& output, ParserContext& ctx) override;
 
+		inline PathNode* path() const {
+			return m_VariableName;
+		}
+
 	private:
+		_type_id lookup_type(ParserContext& ctx);
+
 		PathNode* m_VariableName = nullptr;
 	};
 
 	class StaticFloatNode : public AstNode, public Typed {
 	public:
-		inline StaticFloatNode(double value, std::string_view type_name) : m_Value{ value }, m_TypeName{ type_name } {
+		static constexpr NodeType Kind = NodeType::ImmediateFloat;
+		inline StaticFloatNode(double value, std::string_view type_name) : AstNode(Kind), m_Value{ value }, m_TypeName{ type_name } {
 
 		}
 
@@ -184,11 +238,12 @@ namespace tau {
 			return m_Value;
 		}
 
-		inline bool compile(std::ostream& output, ParserContext& ctx) {
-			output << m_Value;
-			return true;
+		inline std::string_view type_name() const {
+			return m_TypeName;
 		}
 
+		bool compile(std::ostream& output, ParserContext& ctx) override;
+
 	private:
 		double m_Value;
 		std::string_view m_TypeName;
@@ -196,6 +251,9 @@ namespace tau {
 
 	class ArgumentsNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::Arguments;
+		inline ArgumentsNode() : AstNode(Kind) {}
+
 		~ArgumentsNode();
 
 		std::vector<AstNode*> args;
@@ -203,8 +261,9 @@ namespace tau {
 
 	class FunctionCallNode : public AstNode, public Typed {
 	public:
+		static constexpr NodeType Kind = NodeType::FunctionCall;
 		inline FunctionCallNode(PathNode* functionName, ArgumentsNode *Arguments)
-			: function_name{ functionName }, arguments{Arguments } { }
+			: AstNode(Kind), function_name{ functionName }, arguments{Arguments } { }
 		~FunctionCallNode();
 
 		_type_id get_type(ParserContext& registry) override;
@@ -213,10 +272,46 @@ namespace tau {
 
 		PathNode* function_name = nullptr;
 		ArgumentsNode* arguments = nullptr;
+
+		// set by ElideNullChecks when every @null_check'ed argument is known not to be null
+		bool nonnull_proven = false;
+		// set by EliminateBoundsChecks when the callee's preconditions hold for the arguments
+		bool in_bounds_proven = false;
+		// the callee's entry checks are all proven, calls its __unchecked entry
+		bool unchecked = false;
+		// arguments CheckMoves found going to @moves parameters, passed by address
+		std::vector<bool> moves;
+
+		// set by InstantiateTemplates when the call builds a case of an enum, shape.Small(1) or result<i64, u8>.Ok(x)
+		_type_id variant = 0;
+		size_t variant_case = 0;
 	};
 
+	/*
+	value? on an enum whose first case is the success and every other one a failure. When
+	value holds a failure the enclosing function returns it right away, otherwise the
+	expression is the payload of the first case. The function has to return an enum with
+	the same failure cases, payloads included, which is taken as is when it is the same enum.
+	*/
+	class PropagateNode : public AstNode, public Typed {
+	public:
+		static constexpr NodeType Kind = NodeType::Propagate;
+		inline PropagateNode(AstNode* value) : AstNode(Kind), value{ value } {}
+		~PropagateNode();
+
+		_type_id get_type(ParserContext& ctx) override;
+
+		bool compile(std::ostream& output, ParserContext& ctx) override;
+
+		AstNode* value = nullptr;
+	};
+
+	struct AllowedBinaryOperator;
+	struct AllowedUnaryOperator;
+
 	class BinaryOperator : public AstNode, public Typed {
 	public:
+		static constexpr NodeType Kind = NodeType::BinaryOperator;
 		BinaryOperator(OperatorID _operator, AstNode* lhs, AstNode* rhs);
 		~BinaryOperator();
 		_type_id get_type(ParserContext& registry) override;
@@ -233,10 +328,16 @@ namespace tau {
 
 		OperatorID m_Operator;
 		AstNode *m_Lhs, *m_Rhs;
+
+		// written in parentheses, the parser must not regroup it with the operators around it
+		bool parenthesized = false;
+
+		const AllowedBinaryOperator* resolved_operator = nullptr;
 	};
 
 	class UnaryOperator : public AstNode, public Typed {
 	public:
+		static constexpr NodeType Kind = NodeType::UnaryOperator;
 		UnaryOperator(OperatorID _operator, AstNode* child);
 		~UnaryOperator();
 
@@ -252,34 +353,79 @@ namespace tau {
 
 		OperatorID m_Operator;
 		AstNode* m_Child;
+
+		const AllowedUnaryOperator* resolved_operator = nullptr;
 	};
 
 	class TemplateParamsNode;
 
 	struct PathSpecBit {
-		std::string current;
+		Name current;
 		TemplateParamsNode *template_parameters = nullptr;
 	};
 
 	class PathSpecNode :  public AstNode {
 	public:
-		inline PathSpecNode() {}
+		static constexpr NodeType Kind = NodeType::PathSpec;
+		inline PathSpecNode() : AstNode(Kind) {}
 
-		std::string get_full_name();
+		// joined with '_', computed once and cached
+		Name get_full_name();
 
 		std::vector<PathSpecBit> bits;
+
+	private:
+		Name m_FullName;
 	};
 
 	class TemplateParamsNode : public AstNode {
 	public:
-		inline TemplateParamsNode() {}
+		static constexpr NodeType Kind = NodeType::TemplateParams;
+		inline TemplateParamsNode() : AstNode(Kind) {}
 
-		std::vector<std::string> params;
+		std::vector<Name> params;
 	};
 
 	class AnnotationNode : public AstNode, public Typed {
 	public:
+		static constexpr NodeType Kind = NodeType::Annotation;
 		AnnotationNode(const std::string& annotation_type, std::vector<AstNode*> params, AstNode* body);
+		~AnnotationNode();
+
+		_type_id get_type(ParserContext& ctx) override;
+
+		bool compile(std::ostream& output, ParserContext& ctx) override;
+
+		inline const std::string& annotation_type() const {
+			return m_AnnotationType;
+		}
+
+		inline const std::vector<AstNode*>& params() const {
+			return m_Params;
+		}
+
+		inline std::vector<AstNode*>& params() {
+			return m_Params;
+		}
+
+		inline AstNode* body() const {
+			return m_Body;
+		}
+
+		inline AstNode*& body() {
+			return m_Body;
+		}
+
+		// @alloc(count): the pointer type it yields, taken from the declaration it initializes
+		_type_id value_type = 0;
+
+		/*
+		Set by PromoteAllocations on an @alloc it moved to the stack and on the @free
+		statements of that allocation: the local array backing it and how many elements
+		the array holds. Counts that do not fit still go to malloc, and free skips the array.
+		*/
+		Name stack_buffer;
+		size_t stack_capacity = 0;
 		
 	private:
 		std::string m_AnnotationType;
@@ -287,13 +433,29 @@ namespace tau {
 		AstNode* m_Body;
 	};
 
+	// the node has no counter in __tau_profile
+	constexpr size_t NO_PROFILE_COUNTER = (size_t)-1;
+
+	// a function or if InstrumentModule counts, written to the profile when the program exits
+	struct ProfileSite {
+		std::string function;
+		// position among the ifs of the function, NO_PROFILE_COUNTER for the function itself
+		size_t ordinal;
+		// ifs have a second counter after it for the times they were not taken
+		size_t counter;
+	};
+
 	class ModuleNode : public AstNode {
 	public:
-		inline ModuleNode(PathSpecNode* name) : moduleName{ name } {}
+		static constexpr NodeType Kind = NodeType::Module;
+		inline ModuleNode(PathSpecNode* name) : AstNode(Kind), moduleName{ name } {}
 
 		PathSpecNode* moduleName;
 		ModuleBodyNode* body = nullptr;
 
+		// set by InstrumentModule, the counters the module's C keeps
+		std::vector<ProfileSite> profile_sites;
+
 		bool compile_header(std::ostream& output, ParserContext& ctx);
 		virtual bool compile(std::ostream& output, ParserContext& ctx) override;
 	};
@@ -309,6 +471,9 @@ namespace tau {
 
 	class IncludeNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::Include;
+		inline IncludeNode() : AstNode(Kind) {}
+
 		
 		PathSpecNode* includeName = nullptr;
 		PathSpecNode* alias = nullptr;
@@ -321,6 +486,7 @@ namespace tau {
 
 	class UseNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::Use;
 		UseNode(PathNode* pathNode, PathNode* alias);
 
 	private:
@@ -330,6 +496,7 @@ namespace tau {
 
 	class ListNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::List;
 		ListNode();
 		~ListNode();
 
@@ -338,61 +505,158 @@ namespace tau {
 
 	class ReturnNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::Return;
+		inline ReturnNode() : AstNode(Kind) {}
+
 		AstNode* returnValue = nullptr;
 
+		/*
+		Set by EliminateTailCalls when returnValue is a call of the enclosing function, or
+		the function's accumulator operator applied to such a call and another operand. The
+		call's arguments become the new parameters, the operand goes into the accumulator,
+		and the function starts over. Both point into returnValue.
+		*/
+		FunctionCallNode* tail_call = nullptr;
+		AstNode* accumulated = nullptr;
+
 		bool compile(std::ostream& output, ParserContext& ctx) override;
 	};
 
 	struct Param {
 		_type_id type;
-		std::string name;
+		Name name;
+		// @moves(name), the callee takes over the caller's struct value and receives it by address
+		bool moves = false;
+		// set by InferAttributes when no other pointer the callee sees reaches the same memory, emitted restrict
+		bool noalias = false;
 	};
 
 	class ParameterListNode : public AstNode {
 	public:
-		inline ParameterListNode() {}
+		static constexpr NodeType Kind = NodeType::Parameters;
+		inline ParameterListNode() : AstNode(Kind) {}
 
 		std::vector<Param> params;
 	};
 
 	class StatementBlockNode;
+	class IrFunction;
+
+	// what a function does besides returning a value, Pure only reads memory, Const not even that
+	enum class Purity {
+		Impure,
+		Pure,
+		Const,
+	};
+
+	// how often a profiled run called a function
+	enum class FunctionHeat {
+		Unknown,
+		Hot,
+		Cold,
+	};
 
 	class FunctionDefinitionNode : public AstNode {
 	public:
-		inline FunctionDefinitionNode() {}
+		static constexpr NodeType Kind = NodeType::FunctionDefinition;
+		inline FunctionDefinitionNode() : AstNode(Kind) {}
 
 
 		virtual bool compile(std::ostream& output, ParserContext& ctx) override;
 
-		std::string functionName;
+		// makes the function visible to calls compiled after this point
+		void declare(ParserContext& ctx);
+
+		Name functionName;
 		ParameterListNode* params = nullptr;
 		TemplateParamsNode* templateParams = nullptr;
 		_type_id returnType;
 		StatementBlockNode* body = nullptr;
 		Visibility visibility = Visibility::Private;
+
+		// @const_eval, every call has to be evaluated at compile time
+		bool const_eval = false;
+
+		// inline fn, emitted as a static inline definition (in the module header when public)
+		bool is_inline = false;
+
+		// @stack_limit(bytes), the stack PromoteAllocations may give one allocation whose count is only known at run time
+		size_t stack_limit = 0;
+
+		// EliminateTailCalls made the body a loop, Add or Mul when its returns also accumulate into a local
+		bool tail_loop = false;
+		OperatorID accumulator = OperatorID::Undefined;
+
+		// set by LowerToIr when the body fits the IR, codegen then emits the body from it
+		IrFunction* ir = nullptr;
+
+		// set by InferAttributes, emitted as __attribute__((pure/const/noreturn)) on the prototypes
+		Purity purity = Purity::Impure;
+		bool noreturn = false;
+
+		// set by ApplyProfile, emitted as __attribute__((hot/cold)), hot callees get the inline budget and cold ones stay calls
+		FunctionHeat heat = FunctionHeat::Unknown;
+		// set by InstrumentModule, counts the calls
+		size_t profile_counter = NO_PROFILE_COUNTER;
+
+		/*
+		Parameters asserted non-null on entry by @null_check, and the conditions of leading
+		@pre_assert statements that only read parameters. With either, the body is emitted
+		as <name>__unchecked and <name> runs the checks before calling it, so calls that
+		ElideNullChecks and EliminateBoundsChecks proved safe can skip them.
+		*/
+		std::vector<size_t> null_checks;
+		std::vector<AstNode*> preconditions;
+
+		inline bool has_entry_checks() const {
+			return !null_checks.empty() || !preconditions.empty();
+		}
+
+		inline bool passes_entry_checks(const FunctionCallNode* call) const {
+			return (null_checks.empty() || call->nonnull_proven) && (preconditions.empty() || call->in_bounds_proven);
+		}
 	};
 
 	class TemplateArgsNode;
 
 	// std.vector<std.map<std.string, int>>
 	struct PathArg {
-		std::string bit;
+		Name bit;
 		TemplateArgsNode* args = nullptr;
 	};
 
 	class PathNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::Path;
+		inline PathNode() : AstNode(Kind) {}
+
 		~PathNode();
 
 		std::vector<PathArg> nodes;
 
-		std::string get_full_name(ParserContext&);
+		// number of * following the path when it names a type
+		u32 indirection = 0;
+
+		// mangled name, cached after the first successful resolution
+		Name get_full_name(ParserContext&);
 		std::string get_local_name();
+
+		// must be called after nodes is modified
+		inline void invalidate_name() {
+			m_FullName = Name{};
+		}
+
+	private:
+		Name resolve_full_name(ParserContext&);
+
+	private:
+		Name m_FullName;
 	};
 
 	class TemplateArgsNode : public AstNode {
 	public:
-		inline TemplateArgsNode() {
+		static constexpr NodeType Kind = NodeType::TemplateArgs;
+		inline TemplateArgsNode() : AstNode(Kind) {
 
 		}
 		~TemplateArgsNode();
@@ -402,9 +666,10 @@ namespace tau {
 
 	class VariableDeclNode : public AstNode {
 	public:
-		VariableDeclNode(const std::string& var_name, _type_id type);
+		static constexpr NodeType Kind = NodeType::VariableDeclaration;
+		VariableDeclNode(Name var_name, _type_id type);
 
-		std::string var_name;
+		Name var_name;
 		_type_id type;
 		Visibility visibility;
 		
@@ -415,6 +680,9 @@ namespace tau {
 
 	class StructMembersNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::StructMembers;
+		inline StructMembersNode() : AstNode(Kind) {}
+
 		~StructMembersNode();
 
 		std::vector<VariableDeclNode*> members;
@@ -423,7 +691,9 @@ namespace tau {
 	// separate struct and struct template
 	class StructDefNode : public AstNode {
 	public:
-		StructDefNode(const std::string& name, StructMembersNode *members, TypeRegistry& registry);
+		static constexpr NodeType Kind = NodeType::Struct;
+		// generic structs (templateParams set) are not registered, their instances are
+		StructDefNode(Name name, StructMembersNode *members, TypeRegistry& registry, const StructLayout& layout = {}, TemplateParamsNode* templateParams = nullptr);
 		~StructDefNode();
 
 		virtual bool compile(std::ostream& output, ParserContext& ctx) override;
@@ -431,11 +701,16 @@ namespace tau {
 		Visibility visibility;
 		PathArg struct_name;
 		StructMembersNode* members = nullptr;
-		_type_id struct_id;
+		TemplateParamsNode* templateParams = nullptr;
+		StructLayout layout;
+		_type_id struct_id = 0;
 	};
 
 	class StatementBlockNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::StatementBlock;
+		inline StatementBlockNode() : AstNode(Kind) {}
+
 		std::vector<AstNode*> statements;
 
 		virtual bool compile(std::ostream& output, ParserContext& ctx) override;
@@ -443,8 +718,18 @@ namespace tau {
 
 	class IfNode;
 
+	// the way a branch is expected to go, passed to the C compiler through __builtin_expect
+	enum class BranchHint {
+		None,
+		Unlikely,
+		Likely,
+	};
+
 	class ElseNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::Else;
+		inline ElseNode() : AstNode(Kind) {}
+
 		IfNode* ifBranch = nullptr;
 		StatementBlockNode* body = nullptr;
 
@@ -453,10 +738,33 @@ namespace tau {
 
 	class IfNode : public AstNode {
 	public:
+		static constexpr NodeType Kind = NodeType::If;
+		inline IfNode() : AstNode(Kind) {}
+
 		AstNode* condition = nullptr;
 		StatementBlockNode* body = nullptr;
 		ElseNode* elseBranch = nullptr;
 
+		// set by ApplyProfile when the counts lean far to one side, or InferAttributes when one side ends in a call that does not return
+		BranchHint hint = BranchHint::None;
+		// set by InstrumentModule, counts taken and then not taken
+		size_t profile_counter = NO_PROFILE_COUNTER;
+
+		bool compile(std::ostream& output, ParserContext& ctx) override;
+	};
+
+	// for (init; condition; step) body, each of the header parts may be missing
+	class ForNode : public AstNode {
+	public:
+		static constexpr NodeType Kind = NodeType::For;
+		inline ForNode() : AstNode(Kind) {}
+
+		// a VariableDeclNode scoped to the loop, or an expression
+		AstNode* init = nullptr;
+		AstNode* condition = nullptr;
+		AstNode* step = nullptr;
+		StatementBlockNode* body = nullptr;
+
 		bool compile(std::ostream& output, ParserContext& ctx) override;
 	};
 
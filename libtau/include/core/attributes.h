@@ -0,0 +1,93 @@
+#pragma once
+
+#include "escape.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tau {
+
+	/*
+	Infers facts about functions the C compiler cannot see across translation units or
+	would have to prove itself, run last among the AST passes so it sees the final bodies.
+
+	Purity: a function is Const when it only computes its result from its arguments,
+	Pure when it also reads memory through pointers, indexing or fields. Writing anything
+	but a local, taking an address, inline C, annotations that allocate, free or abort,
+	entry checks, loops without a condition, tail loops without a return, @moves parameters
+	and calls to functions that are not at least as pure, or not in the module, make it
+	Impure. Void functions, main and instrumented functions stay Impure. Recursion is fine,
+	purities only go down from Const until they agree.
+
+	Noreturn: a function without any return whose body cannot finish, because it ends in a
+	loop without a condition, a self tail call EliminateTailCalls made a jump, or a call to
+	another such function.
+
+	Noalias: a pointer parameter of a private function is restrict when, at every call in
+	the module, each pointer argument is either an @alloc local of the caller that does not
+	escape or a restrict parameter of the caller, and no two of them are the same. The
+	callee must not write the parameter or name any of its own in inline C, and functions
+	named in inline C or used as operators have calls that cannot be checked.
+
+	Branch hints: an if whose one side always ends in a call that does not return expects
+	the other side.
+	*/
+	class AttributeInference : public AstVisitor<AttributeInference> {
+	public:
+		inline AttributeInference(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_function(FunctionDefinitionNode* func);
+		// collects what each added function does, before any of the infer_* calls
+		void collect();
+
+		size_t infer_purity();
+		size_t infer_noreturn();
+		size_t infer_noalias(EscapeAnalysis& escape);
+		size_t hint_branches();
+
+		void visit_if(IfNode* node);
+		void visit_for(ForNode* node);
+		void visit_return(ReturnNode* node);
+		void visit_propagate(PropagateNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_binary(BinaryOperator* node);
+		void visit_unary(UnaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_annotation(AnnotationNode* node);
+		void visit_variable(VariableNode* node);
+		void visit_cblock(InlineCBlock* node);
+
+	private:
+		struct Facts {
+			Purity purity = Purity::Const;
+			bool returns = false;
+			bool inline_c = false;
+			std::vector<FunctionCallNode*> calls;
+			std::vector<IfNode*> branches;
+			std::unordered_set<Name> written;
+			// @alloc locals, then only those that do not escape
+			std::unordered_set<Name> allocations;
+		};
+
+		FunctionDefinitionNode* callee_of(FunctionCallNode* call) const;
+		void lower(Purity purity);
+		// the allocation or restrict parameter of the caller an argument points into
+		bool root_of(FunctionDefinitionNode* caller, AstNode* arg, Name& root);
+		// whether control cannot leave the statement, counting loops without a condition when loops is set
+		bool never_completes(AstNode* statement, bool loops) const;
+
+	private:
+		ParserContext& m_Context;
+
+		std::vector<FunctionDefinitionNode*> m_Order;
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+		std::unordered_map<FunctionDefinitionNode*, Facts> m_Facts;
+		// functions called where the arguments are not visible
+		std::unordered_set<Name> m_Unseen;
+
+		Facts* m_Current = nullptr;
+	};
+
+	// returns the number of attributes and branch hints found
+	size_t InferAttributes(ModuleNode* module, ParserContext& ctx);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "null_check.h"
+
+#include <unordered_map>
+
+namespace tau {
+
+	/*
+	Removal of @pre_assert checks that are known to hold, run after ElideNullChecks and
+	before EliminateDeadCode.
+
+	Each function is walked with a list of facts a < b or a <= b between terms, a term
+	being a local or parameter, or a non-negative integer literal. Facts come from
+	  - the function's own preconditions and @pre_assert statements already passed,
+	  - the comparison guarding an if, for its branches,
+	  - the condition of a for loop, for its body, and for the canonical induction loop
+	    for (T i = a; i < n; i++) also a <= i, since i can not wrap before reaching n.
+	A fact is only taken when no name in it is written in the region it covers and none
+	has its address taken or appears in inline C. Conditions are proven from a single fact,
+	a chain of two, literal arithmetic, or unsigned values being at least 0.
+
+	A proven @pre_assert statement disappears. A call whose callee's preconditions hold for
+	its arguments is marked in_bounds_proven, and calls the __unchecked entry once its null
+	checks are proven as well. Leading @pre_assert statements of a loop body that do not
+	depend on the loop are hoisted in front of it, guarded by the loop's entry condition,
+	so the body only runs the checks that do.
+	*/
+	class BoundsCheckEliminator : public AstVisitor<BoundsCheckEliminator> {
+	public:
+		inline BoundsCheckEliminator(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_function(FunctionDefinitionNode* func);
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_block(StatementBlockNode* node);
+		void visit_if(IfNode* node);
+		void visit_for(ForNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_call(FunctionCallNode* node);
+
+		inline size_t eliminated_count() const {
+			return m_Eliminated;
+		}
+
+	private:
+		// lhs < rhs when strict, otherwise lhs <= rhs
+		struct Fact {
+			AstNode* lhs;
+			AstNode* rhs;
+			bool strict;
+		};
+
+		// parameters of a callee and the arguments of the call being proven
+		struct Binding {
+			FunctionDefinitionNode* callee;
+			const std::vector<AstNode*>* args;
+		};
+
+		AstNode* term(AstNode* node, const Binding* binding) const;
+		bool prove(AstNode* condition, const Binding* binding = nullptr) const;
+		bool prove_less(AstNode* a, AstNode* b, bool strict) const;
+		bool known_less(AstNode* a, AstNode* b, bool strict) const;
+
+		// adds the facts of a condition that holds, when its names are not written in region
+		void assume(AstNode* condition, bool holds, const WriteCollector& region);
+		bool stable(AstNode* condition, const WriteCollector& region) const;
+		void forget(Name name);
+
+		// moves the loop independent leading checks of the body in front of the loop, returns how many statements were inserted
+		size_t hoist(ForNode* loop, std::vector<AstNode*>& statements, size_t index);
+
+	private:
+		ParserContext& m_Context;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+
+		std::vector<Fact> m_Facts;
+		// the facts to restore when the open blocks end
+		std::vector<std::vector<Fact>> m_Saved;
+		WriteCollector m_FunctionWrites;
+
+		size_t m_Eliminated = 0;
+	};
+
+	// returns the number of checks removed, hoisted out of a loop or skipped at a call
+	size_t EliminateBoundsChecks(ModuleNode* module, ParserContext& ctx);
+}
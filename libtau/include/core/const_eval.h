@@ -0,0 +1,84 @@
+#pragma once
+
+#include "const_fold.h"
+
+#include <map>
+#include <unordered_map>
+
+namespace tau {
+
+	/*
+	Compile-time evaluator for the pure subset of Tau: integer, float and bool arithmetic,
+	locals, if/else, return and calls to other functions of the module.
+
+	Evaluation walks the AST of the callee with the given arguments and gives up on anything
+	outside that subset (inline C, globals, fields, pointers, strings) as soon as it is
+	reached, so only the path actually taken for these arguments has to be pure. Arithmetic
+	goes through the same C rules as the folder and any undefined behaviour aborts the
+	evaluation rather than picking a result.
+
+	Results are memoised per (function, arguments) so recursive definitions like factorial or
+	fibonacci stay linear. Step and depth budgets keep non-terminating or very deep calls from
+	stalling the compiler, those calls are simply left to run at runtime.
+	*/
+	class ConstEvaluator {
+	public:
+		ConstEvaluator() = default;
+
+		void add_function(FunctionDefinitionNode* func);
+
+		// module function a call resolves to, nullptr for anything else
+		FunctionDefinitionNode* find_function(FunctionCallNode* call) const;
+
+		// evaluates func(args), args as the caller would pass them before parameter conversion
+		bool evaluate(FunctionDefinitionNode* func, const std::vector<Constant>& args, Constant& out);
+
+	private:
+		enum class Flow {
+			Next,
+			Return,
+			Abort,
+		};
+
+		struct Local {
+			Name name;
+			_type_id type;
+			bool initialized;
+			Constant value;
+		};
+
+		typedef std::pair<FunctionDefinitionNode*, std::vector<u64>> CallKey;
+
+		bool invoke(FunctionDefinitionNode* func, const std::vector<Constant>& args, Constant& out);
+
+		Flow exec(AstNode* statement);
+		Flow exec_block(StatementBlockNode* block);
+
+		bool eval(AstNode* expr, Constant& out);
+		bool eval_binary(BinaryOperator* op, Constant& out);
+		bool eval_unary(UnaryOperator* op, Constant& out);
+		bool eval_call(FunctionCallNode* call, Constant& out);
+
+		Local* find_local(AstNode* variable);
+		bool store(Local* local, const Constant& value, Constant& out);
+
+		inline bool step() {
+			return ++m_Steps <= s_MaxSteps;
+		}
+
+	private:
+		static constexpr size_t s_MaxSteps = 1 << 20;
+		static constexpr size_t s_MaxDepth = 256;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+		std::map<CallKey, std::pair<bool, Constant>> m_Cache;
+
+		std::vector<Local> m_Locals;
+		size_t m_Frame = 0;
+		FunctionDefinitionNode* m_Current = nullptr;
+		Constant m_Result;
+
+		size_t m_Steps = 0;
+		size_t m_Depth = 0;
+	};
+}
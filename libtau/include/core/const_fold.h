@@ -0,0 +1,110 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+#include <unordered_set>
+
+namespace tau {
+
+	class ConstEvaluator;
+
+	/*
+	A constant as C sees it after integer promotion: type is one of TYPE_I32, TYPE_U32,
+	TYPE_I64, TYPE_U64, TYPE_F32 or TYPE_F64. Integers live in bits (sign extended for
+	the signed types), floats in real. is_bool marks a 0/1 int that came from a bool or
+	a comparison and is emitted as true/false.
+	*/
+	struct Constant {
+		_type_id type = TYPE_UNDEFINED;
+		u64 bits = 0;
+		double real = 0.0;
+		bool is_bool = false;
+	};
+
+	/*
+	C evaluation of constants, shared by the folder and the compile-time evaluator. Each
+	returns false when the operation is one the C compiler may treat as undefined.
+	*/
+	bool constant_of(AstNode* node, Constant& out);
+	bool constant_truthy(const Constant& value);
+	// value after being stored into a variable of Tau type `type`, promoted again
+	bool convert_constant(const Constant& value, _type_id type, Constant& out);
+	bool fold_binary(OperatorID op, const Constant& lhs, const Constant& rhs, Constant& out);
+	bool fold_unary(OperatorID op, const Constant& value, Constant& out);
+
+	// literal node that compiles to exactly value, typed so the C compiler agrees
+	AstNode* constant_node(const Constant& value);
+
+	/*
+	Constant folding and propagation, run after TypeCheckModule.
+
+	Constant subexpressions are evaluated the way the C we emit would evaluate them:
+	integer promotion, the usual arithmetic conversions, unsigned wraparound and float
+	rounding. Anything the C compiler is free to treat as undefined or implementation
+	defined (signed overflow, division by zero, oversized shifts, shifting negative
+	values, non-finite floats) is left in place.
+
+	Locals initialised with a constant and never assigned, incremented or address-taken
+	in their function are propagated into their uses. Functions containing inline C are
+	not propagated into, since the C may write to any local.
+
+	With an evaluator, calls to module functions whose arguments all folded to constants
+	are run at compile time and replaced by their result. Calls to @const_eval functions
+	that cannot be evaluated are reported as errors.
+	*/
+	class ConstantFolder : public AstVisitor<ConstantFolder> {
+	public:
+		ConstantFolder(ParserContext& ctx, ConstEvaluator* evaluator = nullptr);
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_block(StatementBlockNode* node);
+		void visit_if(IfNode* node);
+		void visit_for(ForNode* node);
+		void visit_return(ReturnNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_call(FunctionCallNode* node);
+
+		// folds the expression held in slot, replacing it when it reduces to a constant
+		void fold(AstNode*& slot);
+
+		inline size_t folded_count() const {
+			return m_Folded;
+		}
+
+		inline size_t propagated_count() const {
+			return m_Propagated;
+		}
+
+		inline size_t evaluated_count() const {
+			return m_Evaluated;
+		}
+
+	private:
+		struct Binding {
+			Name name;
+			bool is_constant;
+			Constant value;
+		};
+
+		void replace(AstNode*& slot, const Constant& value);
+		const Binding* find_binding(Name name) const;
+
+	private:
+		ParserContext& m_Context;
+		ConstEvaluator* m_Evaluator;
+		Name m_Function;
+
+		std::vector<Binding> m_Bindings;
+		std::vector<size_t> m_Frames;
+		std::unordered_set<Name> m_Assigned;
+		bool m_Propagate = false;
+
+		size_t m_Folded = 0;
+		size_t m_Propagated = 0;
+		size_t m_Evaluated = 0;
+	};
+
+	// returns the number of nodes replaced by constants, errors go to ctx.errors
+	size_t FoldConstants(ModuleNode* module, ParserContext& ctx);
+}
@@ -81,19 +81,60 @@ namespace tau {
 		Dot,
 	};
 
+	enum class NodeType : u16 {
+		Undefined = 0,
+		Annotation,
+		Arguments,
+		BinaryOperator,
+		CBlock,
+		Else,
+		For,
+		FunctionCall,
+		FunctionDefinition,
+		Identifier,
+		If,
+		ImmediateBool,
+		ImmediateChar,
+		ImmediateFloat,
+		ImmediateInt,
+		ImmediateString,
+		Include,
+		List,
+		Module,
+		ModuleBody,
+		Parameter,
+		Parameters,
+		Path,
+		PathSpec,
+		Propagate,
+		Return,
+		StatementBlock,
+		Struct,
+		StructMembers,
+		TempToken,
+		TemplateArgs,
+		TemplateParams,
+		UnaryOperator,
+		Use,
+		Variable,
+		VariableDeclaration,
+	};
+
+	// C precedence levels, lower binds tighter
 	inline int get_operator_prec(OperatorID op) {
 		switch (op) {
 		default:
 			return -1;
 		case OperatorID::Dot:
+		case OperatorID::ArrayAccess:
 			return 1;
-		case OperatorID::Add:
-		case OperatorID::Sub:
-			return 4;
 		case OperatorID::Mul:
 		case OperatorID::Div:
 		case OperatorID::Mod:
-			return 5;
+			return 3;
+		case OperatorID::Add:
+		case OperatorID::Sub:
+			return 4;
 		case OperatorID::Negative:
 		case OperatorID::PostInc:
 		case OperatorID::PostDec:
@@ -143,6 +184,15 @@ namespace tau {
 		}
 	}
 
+	inline bool is_assignment(OperatorID op) {
+		return get_operator_prec(op) == get_operator_prec(OperatorID::Assign);
+	}
+
+	// assignments group right to left, every other binary operator left to right
+	inline bool is_right_associative(OperatorID op) {
+		return is_assignment(op);
+	}
+
 	inline OperatorID get_unary_operator(std::string_view lit, bool prefix = true) {
 		if (lit == "-") {
 			return OperatorID::Negative;
@@ -178,6 +228,7 @@ namespace tau {
 			return "[?]";
 		case OperatorID::Undefined: return "[0]";
 		case OperatorID::Dot: return ".";
+		case OperatorID::ArrayAccess: return "[]";
 		case OperatorID::Add: return "+";
 		case OperatorID::Negative:
 		case OperatorID::Sub: return "-";
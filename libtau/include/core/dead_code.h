@@ -0,0 +1,61 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+#include <unordered_set>
+
+namespace tau {
+
+	/*
+	Reachability over the call graph and type-use graph of a module, run last, after
+	FoldConstants, so calls that were inlined or evaluated away no longer count.
+
+	Roots are what other modules can see: public functions and public structs, plus main.
+	From there every called function, every type named by a declaration, parameter or
+	return type, and every field type of a reachable struct is reachable. Identifiers in
+	inline C blocks are taken as references to the function or struct of that name, since
+	the C is opaque to the compiler. Private functions and structs that are not reached are
+	removed from the module, which also keeps the generic instances only they used out of
+	the header.
+	*/
+	class Reachability : public AstVisitor<Reachability> {
+	public:
+		inline Reachability(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_struct(StructDefNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_binary(BinaryOperator* node);
+		void visit_unary(UnaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_cblock(InlineCBlock* node);
+
+		// marks the module's roots and everything they reach
+		void run(ModuleNode* module);
+
+		inline bool is_reachable(FunctionDefinitionNode* node) const {
+			return m_Functions.find(node->functionName) != m_Functions.end();
+		}
+
+		bool is_reachable(StructDefNode* node);
+
+	private:
+		void use_function(Name name);
+		void use_type(_type_id type);
+
+	private:
+		ParserContext& m_Context;
+		std::string m_ModuleName;
+
+		std::unordered_set<Name> m_Functions;
+		std::unordered_set<_type_id> m_Types;
+		// identifiers seen in inline C
+		std::unordered_set<Name> m_Names;
+
+		std::vector<Name> m_Worklist;
+	};
+
+	// removes unreachable private functions and structs, returns how many were removed
+	size_t EliminateDeadCode(ModuleNode* module, ParserContext& ctx);
+}
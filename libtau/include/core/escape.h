@@ -0,0 +1,78 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tau {
+
+	/*
+	Escape analysis of pointer locals, run after FoldConstants and before ElideNullChecks,
+	so counts are folded and a promoted allocation is already known not to be null.
+
+	A local or parameter escapes unless every use of it is one of
+	  - indexing p[i] or dereferencing *p,
+	  - comparing it with == or !=,
+	  - @null_check(p), and for locals @free(p),
+	  - passing it to a parameter of a module function that does not escape itself.
+	Writing it, taking its address, storing or returning it, naming it in inline C or
+	declaring the name twice in one function all make it escape. Parameter summaries are
+	found together for the whole module, starting from nothing escaping and repeating until
+	no summary changes, so recursive functions do not make their arguments escape.
+
+	A declaration T* p = @alloc(n) whose p does not escape is given a local array. When n
+	is a literal and the n elements fit in @stack_limit bytes (256 by default) the array
+	holds all of them and the @free statements of p go away. Otherwise, in a function with
+	@stack_limit, the array holds as many elements as fit, larger counts still go to malloc
+	and @free only frees what did not come from the array.
+	*/
+	class EscapeAnalysis : public AstVisitor<EscapeAnalysis> {
+	public:
+		inline EscapeAnalysis(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_function(FunctionDefinitionNode* func);
+
+		// collects what escapes in the function, returns whether a parameter summary changed
+		bool analyze(FunctionDefinitionNode* func);
+		// moves the function's non-escaping allocations to the stack, returns how many
+		size_t promote(FunctionDefinitionNode* func);
+		// whether a local or parameter of the function last analyzed escapes
+		bool escapes(Name name) const;
+
+		void visit_block(StatementBlockNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_binary(BinaryOperator* node);
+		void visit_unary(UnaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_annotation(AnnotationNode* node);
+		void visit_variable(VariableNode* node);
+		void visit_cblock(InlineCBlock* node);
+
+	private:
+		struct Free {
+			StatementBlockNode* block;
+			AnnotationNode* statement;
+		};
+
+		// true for parameters that escape from the function
+		std::vector<bool>& summary(FunctionDefinitionNode* func);
+
+	private:
+		ParserContext& m_Context;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+		std::unordered_map<FunctionDefinitionNode*, std::vector<bool>> m_Summaries;
+
+		// state of the function being analyzed
+		std::unordered_set<Name> m_Escaped;
+		std::unordered_map<Name, size_t> m_Declared;
+		std::vector<VariableDeclNode*> m_Allocations;
+		std::vector<Free> m_Frees;
+		StatementBlockNode* m_Block = nullptr;
+	};
+
+	// returns the number of allocations moved to the stack
+	size_t PromoteAllocations(ModuleNode* module, ParserContext& ctx);
+}
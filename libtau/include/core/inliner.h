@@ -0,0 +1,87 @@
+#pragma once
+
+#include "const_fold.h"
+
+#include <unordered_map>
+
+namespace tau {
+
+	/*
+	Inlines calls to small leaf functions of the module, run after TypeCheckModule and
+	before FoldConstants so the folder sees through the expanded calls.
+
+	A function qualifies when its body is a single return of a pure expression over its
+	parameters: literals and builtin, non-mutating operators, no calls, no locals, no inline
+	C. Functions declared inline or found hot by ApplyProfile get a larger size budget than
+	the rest, ones it found cold are not inlined unless declared inline and instrumented
+	ones are not inlined at all so their calls are counted. @const_eval ones are left for
+	the evaluator so its errors still fire and ones with entry checks (@null_check,
+	@pre_assert) keep them. Callees are expanded first, so a function that
+	only calls leaves becomes a leaf itself.
+
+	A call is replaced by the callee's expression with every parameter substituted by the
+	argument. Arguments must be pure and of the parameter's exact type (constants are
+	converted to it), and a parameter used more than once only takes literals or plain
+	variables so nothing is computed twice. The result is only inlined when the expression
+	already has the return type as C sees it, so no conversion of the call is lost.
+	*/
+	class Inliner : public AstVisitor<Inliner> {
+	public:
+		inline Inliner(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_function(FunctionDefinitionNode* func);
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_block(StatementBlockNode* node);
+		void visit_if(IfNode* node);
+		void visit_for(ForNode* node);
+		void visit_return(ReturnNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_call(FunctionCallNode* node);
+
+		// inlines the calls held in slot and below it
+		void expand(AstNode*& slot);
+
+		inline size_t inlined_count() const {
+			return m_Inlined;
+		}
+
+	private:
+		enum class State {
+			Pending,
+			Running,
+			Done,
+		};
+
+		struct Summary {
+			State state = State::Pending;
+			// the returned expression when the function can be inlined, otherwise nullptr
+			AstNode* expr = nullptr;
+			std::vector<size_t> uses;
+		};
+
+		Summary& summarize(FunctionDefinitionNode* func);
+		bool try_inline(AstNode*& slot);
+
+	private:
+		static constexpr size_t s_MaxSize = 8;
+		static constexpr size_t s_MaxInlineSize = 32;
+
+		ParserContext& m_Context;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+		std::unordered_map<FunctionDefinitionNode*, Summary> m_Summaries;
+
+		size_t m_Inlined = 0;
+	};
+
+	/*
+	Copy of an expression accepted by is_pure or is_leaf_expression, keeping the types and
+	operators the checker resolved. With func and args set, parameters of func are replaced
+	by copies of the matching argument. Returns nullptr for anything else.
+	*/
+	AstNode* copy_expression(AstNode* node, FunctionDefinitionNode* func = nullptr, const std::vector<AstNode*>* args = nullptr);
+
+	// returns the number of calls replaced by the callee's body
+	size_t InlineFunctions(ModuleNode* module, ParserContext& ctx);
+}
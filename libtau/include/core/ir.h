@@ -0,0 +1,217 @@
+#pragma once
+
+#include "parser.h"
+#include "const_fold.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace tau {
+
+	enum class IrOp {
+		Const,
+		Param,
+		// a local's stack slot, only read and written by Load and Store until PromoteLocals runs
+		Alloca,
+		Load,
+		Store,
+		Binary,
+		Unary,
+		// C conversion of the operand to type
+		Convert,
+		Call,
+		Phi,
+
+		// terminators, the last instruction of every block
+		Jump,
+		Branch,
+		Return,
+		Unreachable,
+	};
+
+	class IrBlock;
+
+	/*
+	An instruction is also the SSA value it defines. type is the C type the value has
+	when the emitted C computes it, after integer promotion and the usual arithmetic
+	conversions, so keeping it in a local of that type changes nothing. Comparisons and
+	logic yield bool, instructions without a value are TYPE_VOID.
+	*/
+	class IrInstruction {
+	public:
+		inline IrInstruction(IrOp op, _type_id type) : op{ op }, type{ type } {}
+
+		IrOp op;
+		_type_id type;
+		// Binary and Unary
+		OperatorID oper = OperatorID::Undefined;
+
+		// Load: slot, Store: slot and value, Branch: condition, Return: value if any
+		std::vector<IrInstruction*> operands;
+		// Phi: the predecessor each operand comes in from
+		std::vector<IrBlock*> incoming;
+		// Jump: target, Branch: taken and not taken
+		IrBlock* targets[2] = { nullptr, nullptr };
+		// Branch: the way the source's if is expected to go, and its counters when instrumented
+		BranchHint hint = BranchHint::None;
+		size_t profile_counter = NO_PROFILE_COUNTER;
+
+		// Const
+		Constant value;
+		// Param: position in the parameter list
+		size_t index = 0;
+		// Call: the call it was lowered from, which names the callee, Unreachable: the call before it that does not return
+		FunctionCallNode* call = nullptr;
+
+		IrBlock* block = nullptr;
+		u32 id = 0;
+
+		inline bool is_terminator() const {
+			return op >= IrOp::Jump;
+		}
+
+		// computes a value and nothing else, so it can be removed, merged or moved when unused
+		inline bool is_pure() const {
+			return op == IrOp::Const || op == IrOp::Param || op == IrOp::Binary || op == IrOp::Unary || op == IrOp::Convert || op == IrOp::Phi;
+		}
+	};
+
+	class IrBlock {
+	public:
+		inline IrBlock(u32 id) : id{ id } {}
+
+		u32 id;
+		std::vector<IrInstruction*> instructions;
+		// filled in by IrFunction::compute_predecessors
+		std::vector<IrBlock*> predecessors;
+
+		inline IrInstruction* terminator() const {
+			return instructions.empty() || !instructions.back()->is_terminator() ? nullptr : instructions.back();
+		}
+
+		std::vector<IrBlock*> successors() const;
+
+		// in front of the terminator
+		void insert(IrInstruction* inst);
+		void replace_successor(IrBlock* from, IrBlock* to);
+		// drops the phi operands coming in from pred
+		void remove_incoming(IrBlock* pred);
+	};
+
+	/*
+	A function body as basic blocks of SSA values, lowered from the AST by LowerToIr.
+
+	Locals start out as Alloca slots accessed through explicit Load and Store, and are
+	turned into SSA values with Phi at the joins by PromoteLocals. Instructions and blocks
+	are owned by the function and stay allocated until it goes away, so a pass can drop
+	one from its block while others still point at it.
+
+	When set on a FunctionDefinitionNode, codegen emits the body from here instead of the
+	AST: every value is a C local assigned once in its block, blocks are labels and edges
+	gotos, and phis are assigned on the edges that reach them.
+	*/
+	class IrFunction {
+	public:
+		inline IrFunction(FunctionDefinitionNode* definition) : definition{ definition } {}
+
+		IrInstruction* create(IrOp op, _type_id type);
+		IrBlock* create_block();
+
+		inline IrBlock* entry() const {
+			return blocks.front();
+		}
+
+		inline size_t block_ids() const {
+			return m_Blocks.size();
+		}
+
+		inline size_t value_ids() const {
+			return m_Values.size();
+		}
+
+		void compute_predecessors();
+		// drops the blocks the entry cannot reach, returns how many
+		size_t remove_unreachable_blocks();
+		// points every operand at what it maps to, following chains of replacements
+		void replace_uses(std::unordered_map<IrInstruction*, IrInstruction*>& replacements);
+
+		void print(std::ostream& output, ParserContext& ctx);
+		bool compile(std::ostream& output, ParserContext& ctx);
+
+		FunctionDefinitionNode* definition;
+		// in emission order, the entry first
+		std::vector<IrBlock*> blocks;
+
+	private:
+		std::deque<IrInstruction> m_Values;
+		std::deque<IrBlock> m_Blocks;
+	};
+
+	// what instruction maps to in replacements, itself if nothing
+	IrInstruction* resolve_replacement(std::unordered_map<IrInstruction*, IrInstruction*>& replacements, IrInstruction* inst);
+
+	/*
+	Lowers the AST functions that only compute on scalars to IR: locals, parameters, calls
+	and returns of types i32, u32, i64, u64, f32, f64 and bool, the builtin operators on
+	them, if and for. Functions that touch anything else (pointers, structs, strings,
+	narrower integers, annotations, inline C) or that other passes already shaped for the
+	AST codegen (tail loops) keep compiling from the AST.
+	*/
+	class IrBuilder {
+	public:
+		inline IrBuilder(ParserContext& ctx) : m_Context{ ctx } {}
+
+		// makes calls to func known, a call to a noreturn function ends its block
+		void add_function(FunctionDefinitionNode* func);
+
+		// nullptr when the function is not one the IR covers
+		IrFunction* lower(FunctionDefinitionNode* func);
+
+	private:
+		struct Binding {
+			Name name;
+			IrInstruction* slot;
+		};
+
+		IrInstruction* emit(IrOp op, _type_id type);
+		IrInstruction* emit_const(const Constant& value);
+		IrInstruction* emit_convert(IrInstruction* value, _type_id type);
+		void jump(IrBlock* target);
+		void branch(IrInstruction* condition, IrBlock* taken, IrBlock* not_taken, BranchHint hint = BranchHint::None);
+		void begin(IrBlock* block);
+
+		IrInstruction* lookup(AstNode* node);
+		IrInstruction* declare(Name name, _type_id type);
+
+		void statement(AstNode* node);
+		void block(StatementBlockNode* node);
+		void if_statement(IfNode* node);
+		void for_statement(ForNode* node);
+		void variable_decl(VariableDeclNode* node);
+
+		IrInstruction* expression(AstNode* node);
+		IrInstruction* binary(BinaryOperator* node);
+		IrInstruction* unary(UnaryOperator* node);
+		IrInstruction* logic(BinaryOperator* node);
+		IrInstruction* assignment(BinaryOperator* node);
+		IrInstruction* call(FunctionCallNode* node);
+
+		inline IrInstruction* fail() {
+			m_Failed = true;
+			return nullptr;
+		}
+
+	private:
+		ParserContext& m_Context;
+
+		IrFunction* m_Function = nullptr;
+		IrBlock* m_Block = nullptr;
+		bool m_Failed = false;
+
+		std::vector<Binding> m_Bindings;
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+	};
+
+	// returns the number of functions given an IR body
+	size_t LowerToIr(ModuleNode* module, ParserContext& ctx);
+}
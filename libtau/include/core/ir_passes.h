@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ir.h"
+
+namespace tau {
+
+	/*
+	Dominators of the blocks the entry reaches, computed with the iterative algorithm of
+	Cooper, Harvey and Kennedy over reverse postorder. Block ids index the tables, blocks
+	created after construction are unknown to it.
+	*/
+	class DominatorTree {
+	public:
+		DominatorTree(IrFunction& func);
+
+		inline IrBlock* idom(IrBlock* block) const {
+			return m_Idom[block->id];
+		}
+
+		inline bool is_reachable(IrBlock* block) const {
+			return block->id < m_Order.size() && m_Order[block->id] != s_Unvisited;
+		}
+
+		bool dominates(IrBlock* a, IrBlock* b) const;
+
+		inline const std::vector<IrBlock*>& children(IrBlock* block) const {
+			return m_Children[block->id];
+		}
+
+		// reverse postorder
+		inline const std::vector<IrBlock*>& blocks() const {
+			return m_Blocks;
+		}
+
+		// blocks where the dominance of block ends
+		std::vector<std::vector<IrBlock*>> frontiers() const;
+
+	private:
+		static constexpr size_t s_Unvisited = (size_t)-1;
+
+		std::vector<IrBlock*> m_Blocks;
+		// position in reverse postorder
+		std::vector<size_t> m_Order;
+		std::vector<IrBlock*> m_Idom;
+		std::vector<std::vector<IrBlock*>> m_Children;
+	};
+
+	/*
+	The passes over IR functions, each returns how many instructions or blocks it changed.
+
+	PromoteLocals turns the Alloca slots into SSA values, with a Phi wherever the stores
+	that reach a block disagree (on the iterated dominance frontier of the stores). A load
+	before any store reads zero.
+
+	EliminateDeadValues folds branches on constants, drops unreachable blocks, phis that
+	only merge one value, blocks that just continue their only predecessor and values
+	nothing effectful depends on.
+
+	NumberValues is dominator based global value numbering: a value computed again with
+	the same operator and operands where the first computation dominates it is replaced by
+	the first, and operators on constants are folded with the C semantics of the constant
+	folder, leaving undefined cases alone.
+
+	HoistInvariants moves values a loop computes from operands defined outside of it to a
+	preheader in front of the loop. Values that may be undefined for some operands (signed
+	overflow, division, shifts, float to integer conversion) are only hoisted from blocks
+	every iteration that leaves the loop passes through, and only out of loops without
+	calls, which might not return, so they are not computed where the source would not
+	have computed them.
+	*/
+	size_t PromoteLocals(IrFunction& func, ParserContext& ctx);
+	size_t EliminateDeadValues(IrFunction& func, ParserContext& ctx);
+	size_t NumberValues(IrFunction& func, ParserContext& ctx);
+	size_t HoistInvariants(IrFunction& func, ParserContext& ctx);
+}
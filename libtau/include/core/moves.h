@@ -0,0 +1,87 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tau {
+
+	/*
+	Ownership check for @moves parameters, run after TypeCheckModule.
+
+	A @moves(v) parameter takes over the caller's struct value. The callee receives it
+	by address instead of as a copy, so the argument has to be a local the caller does
+	not touch again, or a temporary such as a call result. Each function is walked in
+	order with the set of locals that were moved out. Mentioning one of them again is an
+	error until it is assigned a new value, an if keeps what any branch that falls through
+	moved, and moving a local inside a loop it was declared outside of is an error since
+	the next iteration would move it again. Moving a local and using it elsewhere in the
+	same statement is an error too, as C does not order the two.
+
+	Calls are marked with the arguments they move, which codegen passes by address.
+	*/
+	class MoveChecker : public AstVisitor<MoveChecker> {
+	public:
+		inline MoveChecker(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_function(FunctionDefinitionNode* func);
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_block(StatementBlockNode* node);
+		void visit_if(IfNode* node);
+		void visit_for(ForNode* node);
+		void visit_return(ReturnNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_binary(BinaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_variable(VariableNode* node);
+		void visit_cblock(InlineCBlock* node);
+
+		inline size_t error_count() const {
+			return m_ErrorCount;
+		}
+
+	private:
+		struct Local {
+			Name name;
+			// loops the declaration is nested in
+			size_t loop;
+			// whether the name it shadows was moved out
+			bool shadowed_moved;
+		};
+
+		struct Move {
+			Name name;
+			Name callee;
+		};
+
+		// checks the uses and records the moves of one statement's expression
+		void statement(AstNode* expr);
+		void declare(Name name);
+		void end_frame(size_t size);
+		size_t loop_of(Name name) const;
+		void error(const std::string& message);
+
+	private:
+		ParserContext& m_Context;
+		size_t m_ErrorCount = 0;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+		Name m_Function;
+
+		std::unordered_set<Name> m_Moved;
+		std::vector<Local> m_Locals;
+		size_t m_Loop = 0;
+		bool m_Reachable = true;
+
+		// the statement being checked
+		std::unordered_map<Name, size_t> m_Uses;
+		std::vector<Move> m_Moves;
+		std::vector<Name> m_Assigned;
+	};
+
+	// marks the moved arguments of every call, returns false when a moved value is used again
+	bool CheckMoves(ModuleNode* module, ParserContext& ctx);
+}
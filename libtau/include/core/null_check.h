@@ -0,0 +1,158 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tau {
+
+	// single segment variable, the only kind of name flow facts are kept for
+	inline bool local_name(AstNode* node, Name& name) {
+		VariableNode* var = node_cast<VariableNode>(node);
+		if (var == nullptr || var->path() == nullptr || var->path()->nodes.size() != 1) {
+			return false;
+		}
+		name = var->path()->nodes[0].bit;
+		return true;
+	}
+
+	// @not_null(p) passes p on unchanged
+	inline AstNode* strip_not_null(AstNode* node) {
+		AnnotationNode* annotation = node_cast<AnnotationNode>(node);
+		while (annotation != nullptr && annotation->annotation_type() == "not_null") {
+			node = annotation->body();
+			annotation = node_cast<AnnotationNode>(node);
+		}
+		return node;
+	}
+
+	// names a subtree writes to, and names whose address escapes it
+	class WriteCollector : public AstVisitor<WriteCollector> {
+	public:
+		void visit_binary(BinaryOperator* node) {
+			Name name;
+			if (is_assignment(node->m_Operator) && local_name(node->m_Lhs, name)) {
+				written[name]++;
+			}
+			AstVisitor<WriteCollector>::visit_binary(node);
+		}
+
+		void visit_unary(UnaryOperator* node) {
+			Name name;
+			if (local_name(node->m_Child, name)) {
+				switch (node->m_Operator) {
+				case OperatorID::PreInc:
+				case OperatorID::PreDec:
+				case OperatorID::PostInc:
+				case OperatorID::PostDec:
+					written[name]++;
+					break;
+				case OperatorID::Reference:
+					escaped.insert(name);
+					break;
+				default:
+					break;
+				}
+			}
+			AstVisitor<WriteCollector>::visit_unary(node);
+		}
+
+		void visit_cblock(InlineCBlock* node) {
+			inline_c = true;
+			for (auto& tok : node->tokens) {
+				if (tok.type == TokenType::Identifier) {
+					escaped.insert(Name{ tok.literal });
+				}
+			}
+		}
+
+		inline size_t writes(Name name) const {
+			auto f = written.find(name);
+			return f != written.end() ? f->second : 0;
+		}
+
+		std::unordered_map<Name, size_t> written;
+		std::unordered_set<Name> escaped;
+		bool inline_c = false;
+	};
+
+	/*
+	Flow-sensitive removal of redundant null checks, run after FoldConstants and before
+	EliminateDeadCode.
+
+	Each function is walked forward with the set of pointer locals known not to be null.
+	A name joins the set through a @null_check of the function's own parameters or a
+	@null_check statement, through a call that passed it to a @null_check parameter (the
+	callee aborted otherwise), or by being assigned &x, @not_null(..), an @alloc that
+	PromoteAllocations gave a fixed local array or a pointer already in the set. Assignments and ++/-- take it out again, inline C clears the set, and
+	locals whose address is taken or that inline C mentions never join it. An if keeps
+	what all of its branches that fall through agree on, a loop only what it never writes.
+
+	A @null_check statement drops the names already known and disappears once none are
+	left. A call to a module function with @null_check parameters whose checked arguments
+	are all known calls the function's __unchecked entry, which skips the checks, so chains
+	of checked functions only check once (as long as EliminateBoundsChecks proves their
+	preconditions too).
+	*/
+	class NullCheckElider : public AstVisitor<NullCheckElider> {
+	public:
+		inline NullCheckElider(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_function(FunctionDefinitionNode* func);
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_block(StatementBlockNode* node);
+		void visit_if(IfNode* node);
+		void visit_for(ForNode* node);
+		void visit_return(ReturnNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_binary(BinaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_cblock(InlineCBlock* node);
+
+		inline size_t elided_count() const {
+			return m_Elided;
+		}
+
+	private:
+		struct Gen {
+			Name name;
+			// set by an assignment rather than by a checked call
+			bool assigned;
+		};
+
+		struct Shadowed {
+			Name name;
+			bool known;
+		};
+
+		// runs the expression of a statement, decisions see the facts from before it
+		void expression(AstNode* expr);
+		// the statement is gone when every name it checked was already known
+		bool null_check(AnnotationNode* node);
+		bool is_known(AstNode* expr) const;
+		void end_frame();
+
+	private:
+		ParserContext& m_Context;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Functions;
+
+		std::unordered_set<Name> m_Known;
+		std::unordered_set<Name> m_Escaped;
+		bool m_Reachable = true;
+
+		std::vector<Gen> m_Gens;
+		size_t m_Conditional = 0;
+
+		// one entry per open block, the names it declared and whether the outer one was known
+		std::vector<std::vector<Shadowed>> m_Frames;
+
+		size_t m_Elided = 0;
+	};
+
+	// returns the number of null checks removed or skipped at a call
+	size_t ElideNullChecks(ModuleNode* module, ParserContext& ctx);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "core.h"
+#include "tau_types.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace tau {
+	class AstNode;
+
+	struct AllowedBinaryOperator {
+		OperatorID operator_;
+		_type_id left_type;
+		_type_id right_type;
+		_type_id resulting_type;
+
+		AstNode* overload_function = nullptr;
+	};
+	struct AllowedUnaryOperator {
+		OperatorID operator_;
+		_type_id value_type;
+		_type_id resulting_type;
+
+		AstNode* overload_function = nullptr;
+	};
+
+	struct OperatorKey {
+		OperatorID operator_;
+		_type_id left_type;
+		_type_id right_type;
+
+		inline bool operator==(const OperatorKey& other) const {
+			return operator_ == other.operator_ && left_type == other.left_type && right_type == other.right_type;
+		}
+	};
+
+	struct OperatorKeyHash {
+		inline size_t operator()(const OperatorKey& key) const {
+			u64 h = (u64)key.operator_;
+			h = h * 0x9E3779B97F4A7C15ull ^ key.left_type;
+			h = h * 0x9E3779B97F4A7C15ull ^ key.right_type;
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+
+	/*
+	Operator resolution keyed on (operator, lhs type, rhs type).
+
+	Integer and float literals carry the placeholder types "long long" and "double".
+	When an entry is added, every literal form it can serve is indexed as well, so a
+	literal operand resolves in a single lookup. A literal prefers the type of the other
+	operand; two literals resolve to the widest signed type (i64 / f64).
+
+	Entries live in a deque so the pointers handed out stay valid when user-defined
+	overloads are added later.
+	*/
+	class OperatorTable {
+	public:
+		OperatorTable();
+
+		void add(const AllowedBinaryOperator& op);
+		void add(const AllowedUnaryOperator& op);
+
+		const AllowedBinaryOperator* find(OperatorID op, _type_id lhs, _type_id rhs) const;
+		const AllowedUnaryOperator* find(OperatorID op, _type_id value) const;
+
+		inline size_t binary_count() const { return m_Binary.size(); }
+		inline size_t unary_count() const { return m_Unary.size(); }
+
+	private:
+		struct Promoted {
+			const void* entry;
+			u32 rank;
+		};
+
+		// literal placeholder for the given type (or 0) and the preference rank of the type under that literal
+		_type_id literal_of(_type_id type, u32& rank) const;
+		void promote(const OperatorKey& key, const void* entry, u32 rank, std::unordered_map<OperatorKey, Promoted, OperatorKeyHash>& index);
+
+	private:
+		std::deque<AllowedBinaryOperator> m_Binary;
+		std::deque<AllowedUnaryOperator> m_Unary;
+
+		std::unordered_map<OperatorKey, const AllowedBinaryOperator*, OperatorKeyHash> m_BinaryIndex;
+		std::unordered_map<OperatorKey, const AllowedUnaryOperator*, OperatorKeyHash> m_UnaryIndex;
+		std::unordered_map<OperatorKey, Promoted, OperatorKeyHash> m_BinaryPromoted;
+		std::unordered_map<OperatorKey, Promoted, OperatorKeyHash> m_UnaryPromoted;
+	};
+
+	OperatorTable& GetOperatorTable();
+}
@@ -4,6 +4,8 @@
 #include "tokenizer.h"
 #include "ast.h"
 #include "tau_types.h"
+#include "operators.h"
+#include "symbols.h"
 
 #include <functional>
 #include <unordered_map>
@@ -15,22 +17,6 @@ namespace tau {
 
 	typedef std::unordered_map<std::string, AstNode*> TokenResultView;
 
-	struct AllowedBinaryOperator {
-		OperatorID operator_;
-		_type_id left_type;
-		_type_id right_type;
-		_type_id resulting_type;
-
-		AstNode* overload_function = nullptr;
-	};
-	struct AllowedUnaryOperator {
-		OperatorID operator_;
-		_type_id value_type;
-		_type_id resulting_type;
-
-		AstNode* overload_function = nullptr;
-	};
-
 	std::vector<AllowedBinaryOperator>& GetAllowedOperators();
 	std::vector<AllowedUnaryOperator>& GetAllowedUnaryOperators();
 
@@ -42,38 +28,93 @@ namespace tau {
 		bool is_enum = false;
 		bool is_module = false;
 		bool is_primitive_type = false;
+		// a @moves parameter, held as a pointer to the caller's value
+		bool is_indirect = false;
 
 		_type_id type_id = 0;
 		PathNode* path_id = nullptr;
 	};
 
+	/*
+	Scoped symbol table. Every live binding is an entry on a single stack, an open-addressing
+	table keyed on Symbol points at the innermost binding of each name and every entry links
+	to the binding it shadows. Lookups are one probe sequence regardless of nesting depth and
+	end() only touches the entries its frame added.
+	*/
 	struct Scope {
-		std::vector<std::unordered_map<std::string, ItemInfo>> frames;
+		Scope();
 
 		void begin();
 		void end();
 
-		bool exists(const std::string& name);
-		ItemInfo get(const std::string& name);
+		bool exists(Symbol name) const;
+		bool exists(const Name& name) const;
+
+		// innermost binding of name, nullptr if it is not bound
+		const ItemInfo* lookup(Symbol name) const;
+		const ItemInfo* lookup(const Name& name) const;
+
+		void add(Symbol name, const ItemInfo& info);
+		void add(const Name& name, const ItemInfo& info);
+		void add_variable(const Name& name, _type_id type, bool is_pointer = false, bool is_optional = false, bool is_indirect = false);
+
+	private:
+		static constexpr u32 NO_ENTRY = 0xFFFFFFFF;
 
-		void add(const std::string& name, const ItemInfo& info);
-		void add_variable(const std::string& name, _type_id type, bool is_pointer = false, bool is_optional = false);
+		struct Entry {
+			Symbol name;
+			u32 shadowed;
+			ItemInfo info;
+		};
+
+		// slots are never cleared once claimed, a name that goes out of scope keeps its slot with head == NO_ENTRY
+		struct Slot {
+			Symbol name = NULL_SYMBOL;
+			u32 head = NO_ENTRY;
+		};
+
+		size_t probe(Symbol name) const;
+		void grow();
+
+	private:
+		std::vector<Entry> m_Entries;
+		std::vector<u32> m_Frames;
+		std::vector<Slot> m_Slots;
+		size_t m_SlotsUsed = 0;
 	};
 
 	struct ParserContext {
 		TypeRegistry& types;
-		std::vector<AllowedBinaryOperator>& operators;
-		std::vector<AllowedUnaryOperator>& uoperators;
+		OperatorTable& operators;
 		std::unordered_set<std::string_view> flags;
 		std::vector<std::string> errors;
 
+		// (namescope, name) symbol pair -> mangled name
+		std::unordered_map<u64, Name> qualified_names;
 
 		Scope* active_symbol_scope = nullptr;
 		PathNode* current_namescope = nullptr;
 		ModuleNode* current_module = nullptr;
-		
-
-		inline void begin_namescope(const std::string& name) {
+		FunctionDefinitionNode* current_function = nullptr;
+
+		// template parameters of the generic definition being parsed, see TEMPLATE_TYPE_BASE
+		std::vector<Name>* template_params = nullptr;
+		// full name of the module being parsed, set once its mod line is read
+		Name* parsing_module = nullptr;
+
+		// template parameter, generic struct instance or registered type named by path, 0 if unknown
+		_type_id resolve_type(PathNode* path);
+		// same, ignoring the indirection of path
+		_type_id resolve_named_type(PathNode* path);
+
+		/*
+		T* together with the builtin operators on it (&T, *T*, == and !=). Pointer types are
+		only created here, while parsing, so the operator table is complete before the
+		parallel type check reads it: &x needs the pointer type to be named somewhere.
+		*/
+		_type_id pointer_to(_type_id pointee);
+
+		inline void begin_namescope(Name name) {
 			if (current_namescope == nullptr) {
 				current_namescope = new PathNode();
 			}
@@ -82,19 +123,31 @@ namespace tau {
 					name, nullptr
 				}
 			);
+			current_namescope->invalidate_name();
 		}
 
 		inline void end_namescope() {
 			current_namescope->nodes.pop_back();
+			current_namescope->invalidate_name();
 		}
 
-		inline std::string get_fully_qualified_name(const std::string& name) {
+		inline Name get_fully_qualified_name(Name name) {
 			if (current_namescope == nullptr ||
 				current_namescope->nodes.empty()) {
 				return name;
 			}
 			
-			return current_namescope->get_full_name(*this) + "_" + name;
+			Name scope = current_namescope->get_full_name(*this);
+			u64 key = ((u64)scope.symbol() << 32) | name.symbol();
+
+			auto f = qualified_names.find(key);
+			if (f != qualified_names.end()) {
+				return f->second;
+			}
+
+			Name qualified{ scope + "_" + name };
+			qualified_names[key] = qualified;
+			return qualified;
 		}
 	};
 
@@ -140,6 +193,8 @@ namespace tau {
 	private:
 		std::unordered_map<std::string, std::vector<Rule>> m_Rules;
 		Scope m_TypeScope;
+		std::vector<Name> m_TemplateParams;
+		Name m_ModuleName;
 	};
 
 	struct RuleBuilder {
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ir.h"
+
+#include <functional>
+
+namespace tau {
+
+	struct PassTiming {
+		std::string name;
+		double milliseconds = 0.0;
+		// summed over runs, what the pass returned
+		size_t changes = 0;
+		size_t runs = 0;
+	};
+
+	/*
+	Runs a module through a pipeline of named passes and times each of them.
+
+	Module passes work on the AST, the existing passes such as InlineFunctions or
+	EliminateDeadCode have this shape. Function passes work on the IR and run on every
+	function LowerToIr gave an IR body, so they only make sense after a LowerToIr module
+	pass. A pass may appear more than once, its timings are summed under its name.
+
+	The pipeline stops after the first module pass that leaves errors in the context.
+	*/
+	class PassManager {
+	public:
+		typedef std::function<size_t(ModuleNode*, ParserContext&)> ModulePass;
+		typedef std::function<size_t(IrFunction&, ParserContext&)> FunctionPass;
+
+		inline PassManager(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add_module_pass(const std::string& name, ModulePass pass);
+		void add_function_pass(const std::string& name, FunctionPass pass);
+
+		// false when a pass reported errors
+		bool run(ModuleNode* module);
+
+		inline const std::vector<PassTiming>& timings() const {
+			return m_Timings;
+		}
+
+		void print_timings(std::ostream& output) const;
+
+	private:
+		struct Pass {
+			size_t timing;
+			ModulePass module_pass;
+			FunctionPass function_pass;
+		};
+
+		size_t timing_of(const std::string& name);
+
+	private:
+		ParserContext& m_Context;
+		std::vector<Pass> m_Passes;
+		std::vector<PassTiming> m_Timings;
+	};
+
+	// the optimization pipeline run between type checking and codegen
+	void AddDefaultPasses(PassManager& passes);
+}
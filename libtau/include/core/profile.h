@@ -0,0 +1,82 @@
+#pragma once
+
+#include "visitor.h"
+
+#include <istream>
+#include <unordered_map>
+
+namespace tau {
+
+	/*
+	Execution counts written by an instrumented build, one site per line:
+
+		fn <module>.<function> <calls>
+		br <module>.<function> <if> <taken> <not taken>
+
+	where <if> numbers the ifs of the function in source order, else ifs included. Every
+	run of the program appends its counts, load sums the lines of the same site.
+	*/
+	class Profile {
+	public:
+		struct Branch {
+			u64 taken = 0;
+			u64 not_taken = 0;
+		};
+
+		result<bool> load(std::istream& input);
+
+		// nullptr when the profile does not know the function
+		const u64* calls(const std::string& function) const;
+		const Branch* branch(const std::string& function, size_t ordinal) const;
+
+		inline u64 max_calls() const {
+			return m_MaxCalls;
+		}
+
+		inline bool empty() const {
+			return m_Calls.empty() && m_Branches.empty();
+		}
+
+	private:
+		std::unordered_map<std::string, u64> m_Calls;
+		std::unordered_map<std::string, Branch> m_Branches;
+		u64 m_MaxCalls = 0;
+	};
+
+	// the ifs of a function in the order the profile numbers them
+	class BranchSites : public AstVisitor<BranchSites> {
+	public:
+		void visit_if(IfNode* node);
+
+		std::vector<IfNode*> sites;
+	};
+
+	// <module>.<function>, how the profile names a function
+	std::string profile_key(ModuleNode* module, FunctionDefinitionNode* func);
+
+	/*
+	Gives every function of the module a call counter and every if a taken and a not taken
+	counter, which codegen increments and dumps at exit. Templates and public inline
+	functions, whose bodies are emitted in headers, are left alone. Run it before the
+	optimization passes, where ApplyProfile runs, so both number the same ifs. Counters of
+	code the passes remove stay at zero.
+
+	Returns the number of counters.
+	*/
+	size_t InstrumentModule(ModuleNode* module, ParserContext& ctx);
+
+	/*
+	Feeds the counts of an earlier instrumented run back into the module, run before the
+	optimization passes:
+	  - functions never called are marked cold, and not inlined,
+	  - functions called at least a hundredth as often as the most called one are marked hot,
+	    and inlined with the budget of an inline function,
+	  - functions are emitted most called first, so the hot ones share pages,
+	  - an if with enough samples that goes one way at least nine times in ten gets that
+	    way as its branch hint.
+	Modules the profile knows nothing about are left as they are.
+
+	Returns the number of functions and ifs changed.
+	*/
+	size_t ApplyProfile(ModuleNode* module, ParserContext& ctx, const Profile& profile);
+}
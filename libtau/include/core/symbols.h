@@ -0,0 +1,124 @@
+#pragma once
+
+#include "core.h"
+
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace tau {
+
+	typedef u32 Symbol;
+
+	constexpr Symbol NULL_SYMBOL = 0;
+
+	/*
+	Maps identifier text to a dense 32-bit Symbol. One interner is shared by the whole
+	process and only ever grows, so a Symbol means the same text in every module and the
+	strings handed out by name_of stay valid until exit.
+
+	Strings live in fixed-size chunks that are never moved. intern() and find() take a
+	shared lock on the index and only a miss in intern() takes the exclusive one, while
+	name_of takes no lock at all: a string is stored before the count that publishes it.
+	*/
+	class SymbolInterner {
+	public:
+		static SymbolInterner& instance();
+
+		Symbol intern(std::string_view name);
+
+		// NULL_SYMBOL if the name was never interned
+		Symbol find(std::string_view name) const;
+
+		const std::string& name_of(Symbol symbol) const;
+
+		size_t size() const;
+
+	private:
+		SymbolInterner();
+
+	private:
+		static constexpr size_t CHUNK_SIZE = 4096;
+		static constexpr size_t CHUNK_COUNT = 4096;
+
+	private:
+		std::unique_ptr<std::string[]> m_Chunks[CHUNK_COUNT];
+		std::atomic<Symbol> m_Count{ 0 };
+		std::unordered_map<std::string_view, Symbol> m_Index;
+		mutable std::shared_mutex m_Lock;
+	};
+
+	/*
+	Interned identifier. Copies are a single u32, equality is an integer compare and the
+	text is only touched when a name is printed.
+	*/
+	class Name {
+	public:
+		inline Name() = default;
+		inline explicit Name(std::string_view text) : m_Symbol{ SymbolInterner::instance().intern(text) } {}
+		inline explicit Name(const std::string& text) : Name{ std::string_view{ text } } {}
+		inline explicit Name(const char* text) : Name{ std::string_view{ text } } {}
+
+		inline static Name from_symbol(Symbol symbol) {
+			Name name;
+			name.m_Symbol = symbol;
+			return name;
+		}
+
+		inline Symbol symbol() const {
+			return m_Symbol;
+		}
+
+		inline const std::string& str() const {
+			return SymbolInterner::instance().name_of(m_Symbol);
+		}
+
+		inline bool empty() const {
+			return m_Symbol == NULL_SYMBOL;
+		}
+
+		inline explicit operator const std::string&() const {
+			return str();
+		}
+
+		inline explicit operator std::string_view() const {
+			return str();
+		}
+
+		inline bool operator==(const Name& other) const {
+			return m_Symbol == other.m_Symbol;
+		}
+
+		inline bool operator!=(const Name& other) const {
+			return m_Symbol != other.m_Symbol;
+		}
+
+	private:
+		Symbol m_Symbol = NULL_SYMBOL;
+	};
+
+	// interned once, so the passes looking for the entry point compare symbols
+	inline const Name s_Main{ "main" };
+
+	inline std::ostream& operator<<(std::ostream& stream, const Name& name) {
+		return stream << name.str();
+	}
+
+	inline std::string operator+(const std::string& lhs, const Name& rhs) {
+		return lhs + rhs.str();
+	}
+
+	inline std::string operator+(const Name& lhs, const std::string& rhs) {
+		return lhs.str() + rhs;
+	}
+}
+
+template<>
+struct std::hash<tau::Name> {
+	inline size_t operator()(const tau::Name& name) const {
+		return std::hash<tau::Symbol>{}(name.symbol());
+	}
+};
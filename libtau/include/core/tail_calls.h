@@ -0,0 +1,60 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+namespace tau {
+
+	/*
+	Turns self recursion into loops, run after EliminateBoundsChecks (which decides the
+	entry a call goes to) and before EliminateDeadCode.
+
+	A function qualifies when every call it makes to itself is returned directly,
+	return f(..), or combined with an operand that has no calls or side effects,
+	return e + f(..) or return e * f(..). The operator has to be the same in all such
+	returns and the return type an integer, whose + and * can be regrouped. Each of
+	these returns then assigns the call's arguments to the parameters, folds e into an
+	accumulator, and jumps back to the start of the body. Every other return gives back
+	the accumulator combined with its value, so n * f(n - 1) runs as a loop that
+	multiplies n into the accumulator.
+
+	Functions that take an address (&x), contain inline C or got a stack allocation from
+	PromoteAllocations are left alone, because their locals stop existing when the body
+	starts over. So are functions with @moves parameters, and tail calls that would
+	skip the callee's entry checks.
+	*/
+	class TailCallEliminator : public AstVisitor<TailCallEliminator> {
+	public:
+		inline TailCallEliminator(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_return(ReturnNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_unary(UnaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_cblock(InlineCBlock* node);
+
+		inline size_t eliminated_count() const {
+			return m_Eliminated;
+		}
+
+	private:
+		bool is_self_call(AstNode* node) const;
+		// the call of a returned value in tail position, with the operand accumulated next to it
+		FunctionCallNode* tail_call(ReturnNode* node, AstNode*& accumulated, OperatorID& op) const;
+
+	private:
+		ParserContext& m_Context;
+
+		// state of the function being looked at
+		FunctionDefinitionNode* m_Function = nullptr;
+		std::vector<ReturnNode*> m_Returns;
+		size_t m_SelfCalls = 0;
+		bool m_Unsafe = false;
+
+		size_t m_Eliminated = 0;
+	};
+
+	// returns the number of self calls that became jumps
+	size_t EliminateTailCalls(ModuleNode* module, ParserContext& ctx);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core.h"
+#include "symbols.h"
 
 #include <unordered_map>
 
@@ -9,12 +10,75 @@ namespace tau {
 
 	constexpr _type_id TEMPLATE_TYPE_BASE = 0x1000000000000000;
 
+	// primitive ids are fixed at registry construction, hot paths use these instead of name lookups
+	constexpr _type_id TYPE_UNDEFINED = 0;
+	constexpr _type_id TYPE_VOID = 1;
+	constexpr _type_id TYPE_U8 = 2;
+	constexpr _type_id TYPE_U16 = 3;
+	constexpr _type_id TYPE_U32 = 4;
+	constexpr _type_id TYPE_U64 = 5;
+	constexpr _type_id TYPE_I8 = 6;
+	constexpr _type_id TYPE_I16 = 7;
+	constexpr _type_id TYPE_I32 = 8;
+	constexpr _type_id TYPE_I64 = 9;
+	constexpr _type_id TYPE_F32 = 10;
+	constexpr _type_id TYPE_F64 = 11;
+	constexpr _type_id TYPE_CHAR = 12;
+	constexpr _type_id TYPE_BOOL = 13;
+	constexpr _type_id TYPE_STATIC_INT = 14;
+	constexpr _type_id TYPE_STATIC_FLOAT = 15;
+	constexpr _type_id FIRST_USER_TYPE = 16;
+
 	struct FieldDef {
-		std::string name;
+		Name name;
 		size_t offset;
 		_type_id type;
 	};
 
+	// struct level layout controls, set through @reorder, @packed and @align(N)
+	struct StructLayout {
+		bool reorder = false;
+		bool packed = false;
+		size_t align = 0;
+		// declared as an enum, the fields are its cases and only one of them is held at a time
+		bool variant = false;
+	};
+
+	/*
+	Bit patterns a value of the type never holds, an enum around it stores its other cases
+	there instead of in a tag of its own: count values from first, read as an unsigned
+	integer of size bytes at offset.
+	*/
+	struct Niche {
+		size_t offset = 0;
+		size_t size = 0;
+		u64 first = 0;
+		u64 count = 0;
+	};
+
+	/*
+	How an enum tells its cases apart. Case i is tag value i, kept in a tag of the smallest
+	unsigned type that counts all cases, placed after the payloads, which share offset 0.
+	When one case has a payload and its niche has room for all the others, there is no tag:
+	a value in the niche means the other case with index niche.first + k is held, where k
+	counts the other cases in declaration order, anything else the payload's case.
+
+	Bools leave every value but 0 and 1 free and tags every value past the last case. A
+	pointer payload gives up null, so an option of a pointer holding null is None, which
+	is what null means already. A struct only lends the niches of fields that are not
+	pointers, a struct with a null field is still a value.
+	*/
+	struct VariantLayout {
+		// every case in declaration order, payloadless ones included
+		std::vector<Name> cases;
+		// TYPE_UNDEFINED for an enum without a tag
+		_type_id tag = TYPE_UNDEFINED;
+		size_t tag_offset = 0;
+		// the case stored in the payload when there is no tag
+		size_t niche_case = 0;
+		Niche niche;
+	};
+
 	class TypeRegistry;
 
 	struct TypeID {
@@ -24,11 +88,20 @@ namespace tau {
 		bool is_user_defined;
 		std::string true_name;
 		size_t size;
+		size_t align = 1;
 		
+		// for an enum, its cases that hold a payload
 		std::vector<FieldDef> fields;
+		StructLayout layout;
+		VariantLayout variant;
+		Niche niche;
+
+		// type pointed to when this is a pointer type, 0 otherwise
+		_type_id pointee = 0;
 
 	private:
 		void calculate_size_and_offsets(TypeRegistry&);
+		void calculate_variant_layout(TypeRegistry&);
 	};
 
 	class TypeRegistry {
@@ -43,19 +116,38 @@ namespace tau {
 		_type_id get_id_from_name(std::string_view name);
 		
 		size_t size_of(_type_id id);
+		size_t align_of(_type_id id);
 		std::string name_of(_type_id id);
 		std::vector<FieldDef>& fields_of(_type_id id);
-		size_t offset_of(_type_id id, const std::string& field_name);
+		size_t offset_of(_type_id id, Name field_name);
 
 		bool is_struct(_type_id id);
-		_type_id get_struct_field_type(_type_id struct_type, const std::string& field_name);
+		_type_id get_struct_field_type(_type_id struct_type, Name field_name);
+
+		bool is_variant(_type_id id);
+		const VariantLayout& variant_of(_type_id id);
+		// payload of the enum's case at index, TYPE_VOID when it has none
+		_type_id case_type(_type_id variant, size_t index);
+		// count is 0 when every bit pattern is a value
+		Niche niche_of(_type_id id);
+
+		// T*, registered on first use and spelled the way C spells it
+		_type_id pointer_to(_type_id pointee);
+		bool is_pointer(_type_id id);
+		_type_id pointee_of(_type_id id);
 
 		result<_type_id> define_type(const std::string& type_name, size_t size);
-		result<_type_id> define_type(const std::string& type_name, std::vector<FieldDef>& fields);
+		result<_type_id> define_type(const std::string& type_name, std::vector<FieldDef>& fields, const StructLayout& layout = {});
+
 
+	private:
+		_type_id define_primitive(const std::string& name, size_t size);
+		TypeID* lookup(_type_id id);
 
 	private:
-		std::unordered_map<_type_id, TypeID> m_Types;
+		// dense storage indexed by _type_id, slot 0 is the undefined type
+		std::vector<TypeID> m_Types;
+		std::unordered_map<std::string, _type_id> m_NameIndex;
 	};
 
 
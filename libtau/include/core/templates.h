@@ -0,0 +1,99 @@
+#pragma once
+
+#include "parser.h"
+
+#include <unordered_set>
+
+namespace tau {
+
+	/*
+	Type ids at and above TEMPLATE_TYPE_BASE never reach the registry. Inside a generic
+	definition TEMPLATE_TYPE_BASE + i stands for its i-th template parameter, and a generic
+	struct applied to arguments that still mention parameters (vector<_ty> inside another
+	template) gets a dependent id from TEMPLATE_DEPENDENT_BASE up. Instantiation substitutes
+	both kinds away, so only concrete ids are left once a definition is specialised.
+	*/
+	constexpr size_t MAX_TEMPLATE_PARAMS = 256;
+	constexpr _type_id TEMPLATE_DEPENDENT_BASE = TEMPLATE_TYPE_BASE + MAX_TEMPLATE_PARAMS;
+
+	inline bool is_template_type(_type_id id) {
+		return id >= TEMPLATE_TYPE_BASE;
+	}
+
+	// a generic struct, kept by value so it outlives the module that declared it
+	struct StructTemplate {
+		Name name;
+		Name module;
+		size_t param_count = 0;
+		std::vector<FieldDef> fields;
+		StructLayout layout;
+	};
+
+	/*
+	Process wide cache of generic structs and their instances, shared by every module the
+	compiler sees. Generic structs are keyed by module and name (module.name), two modules
+	may each declare a vector<T> of their own. An instance is keyed by its mangled name
+	(module_vector__i64), which is derived from that key and the concrete argument types,
+	so one module's vector<i64> is registered once and every module that uses it gets the
+	same type id and the same C definition.
+	*/
+	class TemplateCache {
+	public:
+		static TemplateCache& instance();
+
+		TemplateCache(const TemplateCache&) = delete;
+
+		void add_struct(const StructTemplate& generic);
+		bool has_struct(Name key) const;
+
+		/*
+		Key of the generic struct name as seen from module: its own one first, otherwise the
+		only module declaring it. An error when no module or more than one other module does,
+		the name has to be written with its module then.
+		*/
+		result<Name> qualify_struct(Name name, Name module) const;
+
+		// concrete id for key<args>, or a dependent id while args still mention template parameters
+		result<_type_id> apply_struct(Name key, const std::vector<_type_id>& args, TypeRegistry& types);
+
+		// replaces template parameters in type with args, instantiating dependent structs on the way
+		result<_type_id> substitute(_type_id type, const std::vector<_type_id>& args, TypeRegistry& types);
+
+		bool is_instance(_type_id id) const;
+		const StructLayout& layout_of(_type_id instance) const;
+
+		// C identifier of name<args>: name__arg0_arg1
+		static std::string mangle(Name name, const std::vector<_type_id>& args, TypeRegistry& types);
+
+	private:
+		TemplateCache() = default;
+
+		result<_type_id> instantiate_struct(const StructTemplate& generic, const std::vector<_type_id>& args, TypeRegistry& types);
+
+	private:
+		struct Dependent {
+			Name key;
+			std::vector<_type_id> args;
+		};
+
+		std::unordered_map<Name, StructTemplate> m_Structs;
+		// plain name -> modules declaring a generic struct of that name
+		std::unordered_map<Name, std::vector<Name> > m_Modules;
+		std::unordered_map<_type_id, StructLayout> m_Instances;
+		std::vector<Dependent> m_Dependent;
+
+		size_t m_Depth = 0;
+	};
+
+	/*
+	Monomorphization of generic functions. Every call written with explicit template
+	arguments (max<i64>(a, b)) is pointed at a specialised copy of the template, created
+	the first time that (template, argument types) pair is seen in the module. Copies are
+	scanned for calls of their own, so generic code calling generic code is expanded until
+	no template call is left. Calls building an enum case, shape.Small(1) or
+	result<i64, u8>.Ok(x), are resolved to their enum here too, since that may instantiate
+	it. Run it before TypeCheckModule, the instances are ordinary functions to every later
+	pass and the parallel type check only reads the registry.
+	*/
+	size_t InstantiateTemplates(ModuleNode* module, ParserContext& ctx);
+}
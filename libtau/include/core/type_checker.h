@@ -0,0 +1,69 @@
+#pragma once
+
+#include "parser.h"
+#include "visitor.h"
+
+namespace tau {
+
+	/*
+	Semantic analysis pass. Walks a module once, children before parents, and stores
+	the resolved _type_id on every expression node (and the chosen operator table entry
+	on operators). Codegen reads those annotations instead of re-resolving each subtree,
+	which keeps type resolution linear in the size of the program.
+
+	Analysis runs in two phases. declare_module() registers everything visible at module
+	level (the module itself, its struct types and every function signature). After that
+	the module scope is frozen and each function body only reads it, so bodies can be
+	checked independently.
+	*/
+	class TypeChecker : public AstVisitor<TypeChecker> {
+	public:
+		TypeChecker(ParserContext& ctx);
+
+		// opens the module frame on the active scope, close it with end_module()
+		void declare_module(ModuleNode* node);
+		void end_module();
+
+		void visit_module(ModuleNode* node);
+		void visit_function(FunctionDefinitionNode* node);
+		void visit_block(StatementBlockNode* node);
+		void visit_for(ForNode* node);
+		void visit_variable_decl(VariableDeclNode* node);
+		void visit_binary(BinaryOperator* node);
+		void visit_unary(UnaryOperator* node);
+		void visit_call(FunctionCallNode* node);
+		void visit_propagate(PropagateNode* node);
+		void visit_annotation(AnnotationNode* node);
+		void visit_variable(VariableNode* node);
+
+		inline void visit_int(StaticIntegerNode* node) { node->get_type(m_Context); }
+		inline void visit_float(StaticFloatNode* node) { node->get_type(m_Context); }
+		inline void visit_bool(StaticBoolNode* node) { node->get_type(m_Context); }
+		inline void visit_char(StaticCharNode* node) { node->get_type(m_Context); }
+		inline void visit_string(StaticStringNode* node) { node->get_type(m_Context); }
+
+		inline size_t error_count() const {
+			return m_ErrorCount;
+		}
+
+	private:
+		void error(const std::string& message);
+		// @pre_assert conditions have to be bool
+		void assertion(AstNode* condition, const std::string& what);
+		// Enum.Case(...) takes exactly the case's payload
+		void construction(FunctionCallNode* node);
+
+	private:
+		ParserContext& m_Context;
+		FunctionDefinitionNode* m_Function = nullptr;
+		size_t m_ErrorCount = 0;
+	};
+
+	/*
+	Declarations are collected on the calling thread, function bodies are then checked on
+	up to `threads` workers (0 picks std::thread::hardware_concurrency()). Each worker owns
+	a copy of the frozen scope and its own error list; errors are merged back in function
+	order so the output does not depend on the thread count.
+	*/
+	bool TypeCheckModule(ModuleNode* module, ParserContext& ctx, size_t threads = 0);
+}
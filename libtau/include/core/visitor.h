@@ -0,0 +1,152 @@
+#pragma once
+
+#include "ast.h"
+
+namespace tau {
+
+	/*
+	Tag dispatched traversal over the AstNode tree.
+
+	Passes derive from AstVisitor<Pass> and shadow the visit_* functions they care about.
+	Dispatch is a single switch on AstNode::kind() and a static_cast, no RTTI involved.
+	The default implementations walk into the children, so a pass only has to handle
+	the nodes it is interested in.
+	*/
+	template<typename _derived>
+	class AstVisitor {
+	public:
+		void visit(AstNode* node) {
+			if (node == nullptr) {
+				return;
+			}
+
+			switch (node->kind()) {
+			case NodeType::Module: return self().visit_module(static_cast<ModuleNode*>(node));
+			case NodeType::ModuleBody: return self().visit_module_body(static_cast<ModuleBodyNode*>(node));
+			case NodeType::Include: return self().visit_include(static_cast<IncludeNode*>(node));
+			case NodeType::Struct: return self().visit_struct(static_cast<StructDefNode*>(node));
+			case NodeType::FunctionDefinition: return self().visit_function(static_cast<FunctionDefinitionNode*>(node));
+			case NodeType::StatementBlock: return self().visit_block(static_cast<StatementBlockNode*>(node));
+			case NodeType::If: return self().visit_if(static_cast<IfNode*>(node));
+			case NodeType::Else: return self().visit_else(static_cast<ElseNode*>(node));
+			case NodeType::For: return self().visit_for(static_cast<ForNode*>(node));
+			case NodeType::Return: return self().visit_return(static_cast<ReturnNode*>(node));
+			case NodeType::VariableDeclaration: return self().visit_variable_decl(static_cast<VariableDeclNode*>(node));
+			case NodeType::BinaryOperator: return self().visit_binary(static_cast<BinaryOperator*>(node));
+			case NodeType::UnaryOperator: return self().visit_unary(static_cast<UnaryOperator*>(node));
+			case NodeType::FunctionCall: return self().visit_call(static_cast<FunctionCallNode*>(node));
+			case NodeType::Propagate: return self().visit_propagate(static_cast<PropagateNode*>(node));
+			case NodeType::Variable: return self().visit_variable(static_cast<VariableNode*>(node));
+			case NodeType::CBlock: return self().visit_cblock(static_cast<InlineCBlock*>(node));
+			case NodeType::Annotation: return self().visit_annotation(static_cast<AnnotationNode*>(node));
+			case NodeType::ImmediateInt: return self().visit_int(static_cast<StaticIntegerNode*>(node));
+			case NodeType::ImmediateFloat: return self().visit_float(static_cast<StaticFloatNode*>(node));
+			case NodeType::ImmediateBool: return self().visit_bool(static_cast<StaticBoolNode*>(node));
+			case NodeType::ImmediateChar: return self().visit_char(static_cast<StaticCharNode*>(node));
+			case NodeType::ImmediateString: return self().visit_string(static_cast<StaticStringNode*>(node));
+			default: return;
+			}
+		}
+
+		void visit_module(ModuleNode* node) {
+			visit(node->body);
+		}
+
+		void visit_module_body(ModuleBodyNode* node) {
+			for (auto& inc : node->includes) {
+				visit(inc);
+			}
+			for (auto& structDef : node->structs) {
+				visit(structDef);
+			}
+			for (auto& funcDef : node->functions) {
+				visit(funcDef);
+			}
+		}
+
+		void visit_include(IncludeNode* node) {}
+
+		void visit_struct(StructDefNode* node) {
+			for (auto& member : node->members->members) {
+				visit(member);
+			}
+		}
+
+		void visit_function(FunctionDefinitionNode* node) {
+			visit(node->body);
+		}
+
+		void visit_block(StatementBlockNode* node) {
+			for (auto& statement : node->statements) {
+				visit(statement);
+			}
+		}
+
+		void visit_if(IfNode* node) {
+			visit(node->condition);
+			visit(node->body);
+			visit(node->elseBranch);
+		}
+
+		void visit_else(ElseNode* node) {
+			visit(node->ifBranch);
+			visit(node->body);
+		}
+
+		void visit_for(ForNode* node) {
+			visit(node->init);
+			visit(node->condition);
+			visit(node->step);
+			visit(node->body);
+		}
+
+		void visit_return(ReturnNode* node) {
+			visit(node->returnValue);
+		}
+
+		void visit_variable_decl(VariableDeclNode* node) {
+			visit(node->default_value);
+		}
+
+		void visit_binary(BinaryOperator* node) {
+			visit(node->m_Lhs);
+			visit(node->m_Rhs);
+		}
+
+		void visit_unary(UnaryOperator* node) {
+			visit(node->m_Child);
+		}
+
+		void visit_call(FunctionCallNode* node) {
+			if (node->arguments != nullptr) {
+				for (auto& arg : node->arguments->args) {
+					visit(arg);
+				}
+			}
+		}
+
+		void visit_propagate(PropagateNode* node) {
+			visit(node->value);
+		}
+
+		void visit_annotation(AnnotationNode* node) {
+			for (auto& param : node->params()) {
+				visit(param);
+			}
+			visit(node->body());
+		}
+
+		void visit_variable(VariableNode* node) {}
+		void visit_cblock(InlineCBlock* node) {}
+		void visit_int(StaticIntegerNode* node) {}
+		void visit_float(StaticFloatNode* node) {}
+		void visit_bool(StaticBoolNode* node) {}
+		void visit_char(StaticCharNode* node) {}
+		void visit_string(StaticStringNode* node) {}
+
+	private:
+		inline _derived& self() {
+			return *static_cast<_derived*>(this);
+		}
+	};
+}
@@ -2,4 +2,22 @@
 
 #include "core/core.h"
 #include "core/tokenizer.h"
-#include "core/parser.h"
\ No newline at end of file
+#include "core/symbols.h"
+#include "core/parser.h"
+#include "core/visitor.h"
+#include "core/type_checker.h"
+#include "core/const_fold.h"
+#include "core/const_eval.h"
+#include "core/templates.h"
+#include "core/inliner.h"
+#include "core/dead_code.h"
+#include "core/null_check.h"
+#include "core/bounds_check.h"
+#include "core/escape.h"
+#include "core/moves.h"
+#include "core/tail_calls.h"
+#include "core/ir.h"
+#include "core/ir_passes.h"
+#include "core/pass_manager.h"
+#include "core/attributes.h"
+#include "core/profile.h"
\ No newline at end of file
@@ -1,7 +1,14 @@
 #include "core/ast.h"
+#include "core/ir.h"
 #include "core/parser.h"
+#include "core/templates.h"
+#include "core/visitor.h"
 
+#include <iomanip>
+#include <limits>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 
 namespace tau {
@@ -9,8 +16,29 @@ namespace tau {
 		return true;
 	}
 
+	Typed* as_typed(AstNode* node) {
+		if (node == nullptr) {
+			return nullptr;
+		}
+
+		switch (node->kind()) {
+		case NodeType::ImmediateInt: return static_cast<StaticIntegerNode*>(node);
+		case NodeType::ImmediateFloat: return static_cast<StaticFloatNode*>(node);
+		case NodeType::ImmediateBool: return static_cast<StaticBoolNode*>(node);
+		case NodeType::ImmediateChar: return static_cast<StaticCharNode*>(node);
+		case NodeType::ImmediateString: return static_cast<StaticStringNode*>(node);
+		case NodeType::Variable: return static_cast<VariableNode*>(node);
+		case NodeType::FunctionCall: return static_cast<FunctionCallNode*>(node);
+		case NodeType::Propagate: return static_cast<PropagateNode*>(node);
+		case NodeType::BinaryOperator: return static_cast<BinaryOperator*>(node);
+		case NodeType::UnaryOperator: return static_cast<UnaryOperator*>(node);
+		case NodeType::Annotation: return static_cast<AnnotationNode*>(node);
+		default: return nullptr;
+		}
+	}
 
-	BinaryOperator::BinaryOperator(OperatorID _operator, AstNode* lhs, AstNode* rhs) : m_Operator{ _operator }, m_Lhs{ lhs }, m_Rhs{ rhs } {
+
+	BinaryOperator::BinaryOperator(OperatorID _operator, AstNode* lhs, AstNode* rhs) : AstNode(Kind), m_Operator{ _operator }, m_Lhs{ lhs }, m_Rhs{ rhs } {
 
 	}
 	BinaryOperator::~BinaryOperator() {
@@ -25,94 +53,24 @@ namespace tau {
 	}
 
 	_type_id BinaryOperator::get_type(ParserContext& ctx) {
-		_type_id a = dynamic_cast<Typed*>(m_Lhs)->get_type(ctx);
-		_type_id b = dynamic_cast<Typed*>(m_Rhs)->get_type(ctx);
-
-		_type_id STATIC_INT = ctx.types.get_id_from_name("long long");
-		_type_id STATIC_FLOAT = ctx.types.get_id_from_name("double");
-
-		_type_id ints[] = {
-			ctx.types.get_id_from_name("i64"),
-			ctx.types.get_id_from_name("u64"),
-			ctx.types.get_id_from_name("i32"),
-			ctx.types.get_id_from_name("u32"),
-			ctx.types.get_id_from_name("i16"),
-			ctx.types.get_id_from_name("u16"),
-			ctx.types.get_id_from_name("i8"),
-			ctx.types.get_id_from_name("u8"),
-		};
-		size_t ints_count = 8;
-
-		_type_id floats[] = {
-			ctx.types.get_id_from_name("f64"),
-			ctx.types.get_id_from_name("f32"),
-		};
-		size_t floats_count = 2;
-
-		for (size_t i = 0; i < ctx.operators.size(); i++) {
-			if (ctx.operators[i].operator_ != m_Operator) continue;
-
-			bool left_match = false;
-			bool right_match = false;
-
-			size_t true_a = -1;
-			size_t true_b = -1;
-
-			if (a == STATIC_INT) {
-				for (size_t j = 0; j < ints_count; j++) {
-					if (ints[j] == ctx.operators[i].left_type) {
-						left_match = true;
-						true_a = j;
-						break;
-					}
-				}
-			}
-			else if (a == STATIC_FLOAT) {
-				for (size_t j = 0; j < floats_count; j++) {
-					if (floats[j] == ctx.operators[i].left_type) {
-						left_match = true;
-						true_a = j;
-					}
-				}
-			}
-			else {
-				left_match = ctx.operators[i].left_type == a;
-				true_a = a;
-			}
-
-
-			if (b == STATIC_INT) {
-				for (size_t j = 0; j < ints_count; j++) {
-					if (ints[j] == ctx.operators[i].right_type) {
-						right_match = true;
-						true_b = j;
-					}
-				}
-			}
-			else if (b == STATIC_FLOAT) {
-				for (size_t j = 0; j < floats_count; j++) {
-					if (floats[j] == ctx.operators[i].right_type) {
-						right_match = true;
-						true_b = j;
-					}
-				}
-			}
-			else {
-				right_match = ctx.operators[i].right_type == b;
-				true_b = b;
-			}
+		if (resolved_operator != nullptr) {
+			return resolved_type;
+		}
 
-			if (!left_match || !right_match) {
-				continue;
-			}
+		_type_id a = as_typed(m_Lhs)->get_type(ctx);
+		_type_id b = as_typed(m_Rhs)->get_type(ctx);
 
-			return ctx.operators[i].resulting_type;
+		resolved_operator = ctx.operators.find(m_Operator, a, b);
+		if (resolved_operator == nullptr) {
+			return 0;
 		}
 
-		return 0;
+		resolved_type = resolved_operator->resulting_type;
+		return resolved_type;
 	}
 
-	UnaryOperator::UnaryOperator(OperatorID _operator, AstNode* child) : m_Operator{ _operator }, m_Child{ child } {
+
+	UnaryOperator::UnaryOperator(OperatorID _operator, AstNode* child) : AstNode(Kind), m_Operator{ _operator }, m_Child{ child } {
 		
 	}
 	UnaryOperator::~UnaryOperator() {
@@ -139,68 +97,45 @@ namespace tau {
 	// TODO: Annotations
 	// TODO: Static Reflection
 	_type_id UnaryOperator::get_type(ParserContext& ctx) {
-		_type_id a = dynamic_cast<Typed*>(m_Child)->get_type(ctx);
-
-		_type_id STATIC_INT = ctx.types.get_id_from_name("long long");
-		_type_id STATIC_FLOAT = ctx.types.get_id_from_name("double");
-
-		_type_id ints[] = {
-			ctx.types.get_id_from_name("i64"),
-			ctx.types.get_id_from_name("u64"),
-			ctx.types.get_id_from_name("i32"),
-			ctx.types.get_id_from_name("u32"),
-			ctx.types.get_id_from_name("i16"),
-			ctx.types.get_id_from_name("u16"),
-			ctx.types.get_id_from_name("i8"),
-			ctx.types.get_id_from_name("u8"),
-		};
-		size_t ints_count = 8;
-
-		_type_id floats[] = {
-			ctx.types.get_id_from_name("f64"),
-			ctx.types.get_id_from_name("f32"),
-		};
-		size_t floats_count = 2;
-
-		for (size_t i = 0; i < ctx.uoperators.size(); i++) {
-			if (ctx.uoperators[i].operator_ != m_Operator) continue;
-		
-			bool match = false;
-			size_t true_a = -1;
-
-			if (a == STATIC_INT) {
-				for (size_t j = 0; j < ints_count; j++) {
-					if (ints[j] == ctx.operators[i].left_type) {
-						match = true;
-						true_a = j;
-						break;
-					}
-				}
-			}
-			else if (a == STATIC_FLOAT) {
-				for (size_t j = 0; j < floats_count; j++) {
-					if (floats[j] == ctx.operators[i].left_type) {
-						match = true;
-						true_a = j;
-					}
-				}
-			}
-			else {
-				match = ctx.operators[i].left_type == a;
-				true_a = a;
-			}
+		if (resolved_operator != nullptr) {
+			return resolved_type;
+		}
 
-			if (!match) {
-				continue;
-			}
+		_type_id a = as_typed(m_Child)->get_type(ctx);
+
+		resolved_operator = ctx.operators.find(m_Operator, a);
+		if (resolved_operator == nullptr) {
+			return 0;
+		}
+
+		resolved_type = resolved_operator->resulting_type;
+		return resolved_type;
+	}
 
-			return ctx.uoperators[i].resulting_type;
+	AnnotationNode::AnnotationNode(const std::string& annotation_type, std::vector<AstNode*> params, AstNode* body) : AstNode(Kind), m_AnnotationType{ annotation_type }, m_Params{ params }, m_Body{ body } {}
+	AnnotationNode::~AnnotationNode() {
+		for (auto& param : m_Params) {
+			delete param;
+			param = nullptr;
 		}
+		if (m_Body != nullptr) {
+			delete m_Body;
+			m_Body = nullptr;
+		}
+	}
 
-		return 0;
+	_type_id AnnotationNode::get_type(ParserContext& ctx) {
+		if (m_AnnotationType == "alloc") {
+			return value_type;
+		}
+		if (m_Body == nullptr) {
+			return TYPE_VOID;
+		}
+		Typed* typed = as_typed(m_Body);
+		return typed != nullptr ? typed->get_type(ctx) : TYPE_VOID;
 	}
 
-	ListNode::ListNode() {};
+	ListNode::ListNode() : AstNode(Kind) {};
 	ListNode::~ListNode() {
 		for (auto& ptr : entries) {
 			delete ptr;
@@ -225,7 +160,11 @@ namespace tau {
 		}
 	}
 
-	std::string PathSpecNode::get_full_name() {
+	Name PathSpecNode::get_full_name() {
+		if (!m_FullName.empty()) {
+			return m_FullName;
+		}
+
 		std::stringstream namebuf;
 
 
@@ -244,7 +183,8 @@ namespace tau {
 			}
 		}
 
-		return namebuf.str();
+		m_FullName = Name{ namebuf.str() };
+		return m_FullName;
 	}
 
 	/*
@@ -283,15 +223,25 @@ namespace tau {
 		return 0;
 	*/
 
-	std::string PathNode::get_full_name(ParserContext& ctx) {
+	Name PathNode::get_full_name(ParserContext& ctx) {
+		if (m_FullName.empty()) {
+			m_FullName = resolve_full_name(ctx);
+		}
+		return m_FullName;
+	}
+
+	Name PathNode::resolve_full_name(ParserContext& ctx) {
 		std::stringstream namebuf;
 
+		static const ItemInfo s_Unbound;
+
 		auto node = nodes.begin();
-		ItemInfo current_info;
 		_type_id type;
 		while (node != nodes.end()) {
-			if (!ctx.active_symbol_scope->exists(node->bit)) {
-				if (nodes.begin()->bit != ctx.current_module->moduleName->bits[0].current) {
+			const ItemInfo* info = ctx.active_symbol_scope->lookup(node->bit);
+			if (info == nullptr) {
+				// while parsing there is no module yet to qualify the path with
+				if (ctx.current_module != nullptr && nodes.begin()->bit != ctx.current_module->moduleName->bits[0].current) {
 					PathNode* fullAttempt = new PathNode();
 					for (size_t i = 0; i < ctx.current_module->moduleName->bits.size(); i++) {
 						fullAttempt->nodes.push_back({
@@ -302,7 +252,7 @@ namespace tau {
 						fullAttempt->nodes.push_back(nodes[i]);
 					}
 
-					std::string res = fullAttempt->get_full_name(ctx);
+					Name res = fullAttempt->get_full_name(ctx);
 					delete fullAttempt;
 					return res;
 				}
@@ -310,7 +260,7 @@ namespace tau {
 
 				std::cout << "Unknown symbol: " << node->bit << "\n";
 			}
-			current_info = ctx.active_symbol_scope->get(node->bit);
+			const ItemInfo& current_info = info != nullptr ? *info : s_Unbound;
 
 			if (current_info.is_module || current_info.is_enum || current_info.is_struct) {
 				namebuf << node->bit;
@@ -324,7 +274,7 @@ namespace tau {
 			if(current_info.is_function){
 				if ((node + 1) != nodes.end()) {
 					std::cout << "Functions may not contain subtypes\n";
-					return "";
+					return Name{};
 				}
 				namebuf << node->bit;
 				break;
@@ -336,9 +286,11 @@ namespace tau {
 				namebuf << node->bit;
 				node++;
 
-				if (node != nodes.end()) {
-					namebuf << ".";
+				// the struct value itself, not one of its fields
+				if (node == nodes.end()) {
+					return Name{ namebuf.str() };
 				}
+				namebuf << ".";
 
 				type = ctx.types.get_struct_field_type(type, node->bit);
 			}
@@ -351,7 +303,7 @@ namespace tau {
 			}
 
 			std::cout << "Error, " << bit.bit << " is not a struct type for member access.\n";
-			return "";
+			return Name{};
 		}
 		//for (size_t i = 0; i < nodes.size(); i++) {
 		//	auto& node = nodes[i];
@@ -369,12 +321,12 @@ namespace tau {
 		//	}
 		//}
 
-		return namebuf.str();
+		return Name{ namebuf.str() };
 	}
 
 	std::string PathNode::get_local_name() {
 		if (nodes.empty()) return "";
-		return nodes.rbegin()->bit; // TODO: Tempalte
+		return nodes.rbegin()->bit.str(); // TODO: Tempalte
 	}
 
 	TemplateArgsNode::~TemplateArgsNode() {
@@ -386,7 +338,7 @@ namespace tau {
 		}
 	}
 
-	VariableDeclNode::VariableDeclNode(const std::string& name, _type_id type) : var_name{ name }, type{ type }, visibility{ Visibility::Private } {}
+	VariableDeclNode::VariableDeclNode(Name name, _type_id type) : AstNode(Kind), var_name{ name }, type{ type }, visibility{ Visibility::Private } {}
 
 	StructMembersNode::~StructMembersNode() {
 		for (auto& member : members) {
@@ -395,7 +347,12 @@ namespace tau {
 		}
 	}
 
-	StructDefNode::StructDefNode(const std::string& name, StructMembersNode* members, TypeRegistry& registry) : struct_name{ name }, members{ members }, visibility{ Visibility::Private } {
+	StructDefNode::StructDefNode(Name name, StructMembersNode* members, TypeRegistry& registry, const StructLayout& layout, TemplateParamsNode* templateParams)
+		: AstNode(Kind), visibility{ Visibility::Private }, struct_name{ name }, members{ members }, templateParams{ templateParams }, layout{ layout } {
+
+		if (templateParams != nullptr) {
+			return;
+		}
 
 		std::vector<FieldDef> fields;
 		for (auto& var : members->members) {
@@ -406,7 +363,7 @@ namespace tau {
 			fields.push_back(field);
 		}
 
-		auto r = registry.define_type(name, fields);
+		auto r = registry.define_type(name.str(), fields, layout);
 		
 		if (r.error_bit) {
 			throw r.error;
@@ -419,6 +376,7 @@ namespace tau {
 			struct_name.args = nullptr;
 		}
 
+		delete templateParams;
 		delete members;
 	}
 
@@ -434,26 +392,78 @@ namespace tau {
 	}
 
 	_type_id FunctionCallNode::get_type(ParserContext& ctx) {
-		if (ctx.active_symbol_scope->exists(function_name->get_full_name(ctx))) {
-			auto item = ctx.active_symbol_scope->get(function_name->get_full_name(ctx));
-			if (!item.is_function) {
-				std::cout << function_name->get_full_name(ctx) << " is not defined as a function\n";
+		if (resolved_type != 0) {
+			return resolved_type;
+		}
+
+		if (variant != 0) {
+			resolved_type = variant;
+			return resolved_type;
+		}
+
+		Name full_name = function_name->get_full_name(ctx);
+		const ItemInfo* item = ctx.active_symbol_scope->lookup(full_name);
+		if (item != nullptr) {
+			if (!item->is_function) {
+				std::cout << full_name << " is not defined as a function\n";
 				return 0;
 			}
-			return item.type_id;
+			resolved_type = item->type_id;
+			return resolved_type;
 		}
 		return 0;
 	}
 
+	// suffix of the entry point of a function with entry checks that skips them
+	static constexpr std::string_view s_UncheckedSuffix = "__unchecked";
+
+	// label and accumulator of a function EliminateTailCalls turned into a loop
+	static constexpr std::string_view s_TailStart = "tail__start";
+	static constexpr std::string_view s_TailAccumulator = "tail__acc";
+
+	// the field holding which case of an enum is set, when it needs one
+	static constexpr std::string_view s_VariantTag = "tag__";
+
+	// C name of an enum for its helpers, without the "struct "
+	static std::string variant_name(ParserContext& ctx, _type_id variant) {
+		return ctx.types.name_of(variant).substr(7);
+	}
+
 	bool FunctionCallNode::compile(std::ostream& output, ParserContext& ctx) {
-		output << function_name->get_full_name(ctx) << "(";
+		if (variant != 0) {
+			output << variant_name(ctx, variant) << "__" << ctx.types.variant_of(variant).cases[variant_case] << "(";
+			if (arguments != nullptr && !arguments->args.empty() && !arguments->args[0]->compile(output, ctx)) {
+				return false;
+			}
+			output << ")";
+			return true;
+		}
+
+		output << function_name->get_full_name(ctx);
+		if (unchecked) {
+			output << s_UncheckedSuffix;
+		}
+		output << "(";
 		
 		if (arguments != nullptr) {
 			for (size_t i = 0; i < arguments->args.size(); i++) {
+				// a moved local is passed by address, a temporary through a compound literal holding it
+				bool moved = i < moves.size() && moves[i];
+				if (moved && arguments->args[i]->kind() == NodeType::Variable) {
+					output << "&";
+				}
+				else if (moved) {
+					output << "(" << ctx.types.name_of(as_typed(arguments->args[i])->get_type(ctx)) << "[1]){ ";
+				}
+
 				if (!arguments->args[i]->compile(output, ctx)) {
 					return false;
 				}
 
+				if (moved && arguments->args[i]->kind() != NodeType::Variable) {
+					output << " }";
+				}
+
 				if (i + 1 < arguments->args.size()) {
 					output << ", ";
 				}
@@ -463,6 +473,70 @@ namespace tau {
 		return true;
 	}
 
+	PropagateNode::~PropagateNode() {
+		if (value != nullptr) {
+			delete value;
+			value = nullptr;
+		}
+	}
+
+	_type_id PropagateNode::get_type(ParserContext& ctx) {
+		if (resolved_type != 0) {
+			return resolved_type;
+		}
+
+		Typed* typed = as_typed(value);
+		_type_id type = typed != nullptr ? typed->get_type(ctx) : 0;
+		if (!ctx.types.is_variant(type) || ctx.types.variant_of(type).cases.size() < 2) {
+			return 0;
+		}
+		resolved_type = ctx.types.case_type(type, 0);
+		return resolved_type;
+	}
+
+	// the value ? is applied to, named so the early return can hand its failure on
+	static constexpr std::string_view s_Propagated = "propagate__";
+
+	/*
+	A statement expression testing the case of the value once, the failure path is the
+	unlikely side of the branch so the success path falls through. A failure of another enum
+	is rebuilt case by case with the constructors of the function's enum.
+	*/
+	bool PropagateNode::compile(std::ostream& output, ParserContext& ctx) {
+		_type_id type = as_typed(value)->get_type(ctx);
+		_type_id returned = ctx.current_function->returnType;
+		const VariantLayout& variant = ctx.types.variant_of(type);
+		std::string name = variant_name(ctx, type);
+
+		output << "({ struct " << name << " " << s_Propagated << " = ";
+		if (!value->compile(output, ctx)) {
+			return false;
+		}
+		output << "; if (__builtin_expect(" << name << "__case(&" << s_Propagated << ") != 0, 0)) { ";
+		if (returned == type) {
+			output << "return " << s_Propagated << "; ";
+		}
+		else {
+			std::string target = variant_name(ctx, returned);
+			for (size_t i = 1; i < variant.cases.size(); i++) {
+				if (i + 1 < variant.cases.size()) {
+					output << "if (" << name << "__case(&" << s_Propagated << ") == " << i << ") ";
+				}
+				output << "return " << target << "__" << variant.cases[i] << "(";
+				if (ctx.types.case_type(type, i) != TYPE_VOID) {
+					output << s_Propagated << "." << variant.cases[i];
+				}
+				output << "); ";
+			}
+		}
+		output << "} ";
+		if (ctx.types.case_type(type, 0) != TYPE_VOID) {
+			output << s_Propagated << "." << variant.cases[0] << "; ";
+		}
+		output << "})";
+		return true;
+	}
+
 	ArgumentsNode::~ArgumentsNode() {
 		for (auto& arg : args) {
 			delete arg;
@@ -470,14 +544,58 @@ namespace tau {
 	}
 
 
+	static size_t profile_counter_count(ModuleNode* module) {
+		size_t count = 0;
+		for (auto& site : module->profile_sites) {
+			count = std::max(count, site.counter + (site.ordinal != NO_PROFILE_COUNTER ? 2 : 1));
+		}
+		return count;
+	}
+
+	static void compile_profile_counters(ModuleNode* module, std::ostream& output) {
+		output << "#include <stdio.h>\n\n";
+		output << "static u64 __tau_profile[" << profile_counter_count(module) << "];\n\n";
+		output << "static inline bool __tau_profile_branch(bool taken, size_t counter) {\n";
+		output << "__tau_profile[taken ? counter : counter + 1]++;\n";
+		output << "return taken;\n";
+		output << "}\n";
+	}
+
+	// appends the module's counts in the format Profile reads, to $TAU_PROFILE or ./tau.profile
+	static void compile_profile_dump(ModuleNode* module, std::ostream& output) {
+		output << "static void __tau_profile_dump(void) {\n";
+		output << "const char* path = getenv(\"TAU_PROFILE\");\n";
+		output << "FILE* file = fopen(path != NULL ? path : \"tau.profile\", \"a\");\n";
+		output << "if (file == NULL) { return; }\n";
+		for (auto& site : module->profile_sites) {
+			if (site.ordinal == NO_PROFILE_COUNTER) {
+				output << "fprintf(file, \"fn " << site.function << " %llu\\n\", (unsigned long long)__tau_profile[" << site.counter << "]);\n";
+			}
+			else {
+				output << "fprintf(file, \"br " << site.function << " " << site.ordinal << " %llu %llu\\n\", (unsigned long long)__tau_profile[" <<
+					site.counter << "], (unsigned long long)__tau_profile[" << site.counter + 1 << "]);\n";
+			}
+		}
+		output << "fclose(file);\n";
+		output << "}\n\n";
+		output << "__attribute__((constructor)) static void __tau_profile_init(void) {\n";
+		output << "atexit(__tau_profile_dump);\n";
+		output << "}\n\n";
+	}
+
 	bool ModuleNode::compile(std::ostream& output, ParserContext& ctx) {
 		output << "// MODULE " << moduleName->get_full_name() << "\n";
 		output << "#include <stdbool.h>\n";
+		output << "#include <stddef.h>\n";
 		output << "#include <stdlib.h>\n\n";
 		output << "#include \"tautypes.h\"\n";
 		output << "#include \"" << moduleName->get_full_name() << ".h\"\n";
 
 
+		if (!profile_sites.empty()) {
+			compile_profile_counters(this, output);
+		}
+
 		output << "\n\n";
 		ctx.current_module = this;
 		ItemInfo self;
@@ -488,6 +606,10 @@ namespace tau {
 		ctx.current_module = nullptr;
 		ctx.active_symbol_scope->end();
 
+		if (result && !profile_sites.empty()) {
+			compile_profile_dump(this, output);
+		}
+
 		output << "// END MODULE\n\n";
 
 		return result;
@@ -496,6 +618,7 @@ namespace tau {
 	bool ModuleNode::compile_header(std::ostream& output, ParserContext& ctx) {
 		output << "#ifndef __" << moduleName->get_full_name() << "_H__\n";
 		output << "#define __" << moduleName->get_full_name() << "_H__\n\n";
+		output << "#include <stddef.h>\n\n";
 
 		ctx.current_module = this;
 		bool result = body->compile_header(output, ctx);
@@ -506,76 +629,371 @@ namespace tau {
 		return result;
 	}
 
-	bool ModuleBodyNode::compile_header(std::ostream& output, ParserContext& ctx) {
+	static void compile_linkage(FunctionDefinitionNode* funcDef, std::ostream& output) {
+		if (funcDef->is_inline) {
+			output << "static inline ";
+		}
+		else if (funcDef->visibility == Visibility::Private) {
+			output << "static ";
+		}
+	}
 
-		for (auto& inc : this->includes) {
-			inc->compile(output, ctx);
+	static void compile_parameters(FunctionDefinitionNode* funcDef, bool named, std::ostream& output, ParserContext& ctx) {
+		if (funcDef->params == nullptr) {
+			return;
 		}
 
-		for (auto& structDef : this->structs) {
-			if (structDef->struct_name.args != nullptr) {
-				continue; // todo
+		for (size_t i = 0; i < funcDef->params->params.size(); i++) {
+			auto& param = funcDef->params->params[i];
+			output << ctx.types.name_of(param.type);
+			if (param.moves) {
+				output << "* restrict";
+			}
+			else if (param.noalias) {
+				output << " restrict";
+			}
+			if (named) {
+				output << " " << param.name;
 			}
 
-			std::string fullName = ctx.current_module->moduleName->get_full_name();
-			fullName += ".";
-			fullName += structDef->struct_name.bit;
+			if (i + 1 < funcDef->params->params.size()) {
+				output << ", ";
+			}
+		}
+	}
+
+	// what InferAttributes found out about the function, only prototypes can carry it after the parameter list
+	static void compile_attributes(FunctionDefinitionNode* funcDef, std::ostream& output) {
+		if (funcDef->purity == Purity::Const) {
+			output << " __attribute__((const))";
+		}
+		else if (funcDef->purity == Purity::Pure) {
+			output << " __attribute__((pure))";
+		}
+		if (funcDef->noreturn) {
+			output << " __attribute__((noreturn))";
+		}
+		if (funcDef->heat == FunctionHeat::Hot) {
+			output << " __attribute__((hot))";
+		}
+		else if (funcDef->heat == FunctionHeat::Cold) {
+			output << " __attribute__((cold))";
+		}
+	}
+
+	static void compile_prototype(FunctionDefinitionNode* funcDef, std::ostream& output, ParserContext& ctx) {
+		compile_linkage(funcDef, output);
+		output << ctx.types.name_of(funcDef->returnType) << " " << funcDef->functionName << "(";
+		compile_parameters(funcDef, false, output, ctx);
+		output << ")";
+		compile_attributes(funcDef, output);
+		output << ";\n";
+
+		if (funcDef->has_entry_checks()) {
+			compile_linkage(funcDef, output);
+			output << ctx.types.name_of(funcDef->returnType) << " " << funcDef->functionName << s_UncheckedSuffix << "(";
+			compile_parameters(funcDef, false, output, ctx);
+			output << ")";
+			compile_attributes(funcDef, output);
+			output << ";\n";
+		}
+	}
 
-			std::vector<FieldDef> fields;
-			for (auto& member : structDef->members->members) {
-				FieldDef field;
-				field.name = member->var_name;
-				field.type = member->type;
+	// the checked entry point, asserts the @null_check'ed parameters and the preconditions, then forwards to <name>__unchecked
+	static bool compile_checked_entry(FunctionDefinitionNode* funcDef, std::ostream& output, ParserContext& ctx) {
+		compile_linkage(funcDef, output);
+		output << ctx.types.name_of(funcDef->returnType) << " " << funcDef->functionName << "(";
+		compile_parameters(funcDef, true, output, ctx);
+		output << ") {\n";
+
+		for (auto& index : funcDef->null_checks) {
+			output << "if (__builtin_expect(" << funcDef->params->params[index].name << " == NULL, 0)) { abort(); }\n";
+		}
+
+		ctx.active_symbol_scope->begin();
+		for (auto& param : funcDef->params->params) {
+			ctx.active_symbol_scope->add_variable(param.name, param.type);
+		}
+		for (auto& condition : funcDef->preconditions) {
+			output << "if (__builtin_expect(!(";
+			if (!condition->compile(output, ctx)) {
+				return false;
+			}
+			output << "), 0)) { abort(); }\n";
+		}
+		ctx.active_symbol_scope->end();
 
-				fields.push_back(field);
+		if (funcDef->returnType != TYPE_VOID) {
+			output << "return ";
+		}
+		output << funcDef->functionName << s_UncheckedSuffix << "(";
+		for (size_t i = 0; i < funcDef->params->params.size(); i++) {
+			output << funcDef->params->params[i].name;
+			if (i + 1 < funcDef->params->params.size()) {
+				output << ", ";
 			}
+		}
+		output << ");\n}\n\n";
+		return true;
+	}
 
-			ctx.types.define_type(fullName, fields);
+	/*
+	Every enum gets NAME__case, the index of the case it holds, and a constructor
+	NAME__Case per case, which is what Enum.Case(...) and ? compile to. Without a tag the
+	other cases live in the payload's niche, read and written as a little endian integer.
+	*/
+	static void compile_variant_helpers(std::ostream& output, ParserContext& ctx, _type_id id, const std::string& name) {
+		const VariantLayout& variant = ctx.types.variant_of(id);
+		bool tagged = variant.tag != TYPE_UNDEFINED;
 
-			output << "struct " << structDef->struct_name.bit << ";\n";
+		output << "static inline u32 " << name << "__case(const struct " << name << "* v) {\n";
+		if (tagged) {
+			output << "    return v->" << s_VariantTag << ";\n";
 		}
+		else {
+			output << "    u64 n = 0;\n";
+			output << "    __builtin_memcpy(&n, (const char*)v + " << variant.niche.offset << ", " << variant.niche.size << ");\n";
+			output << "    u64 k = n - " << variant.niche.first << "ull;\n";
+			output << "    if (k >= " << variant.niche.count << "ull) { return " << variant.niche_case << "; }\n";
+			output << "    return k < " << variant.niche_case << " ? (u32)k : (u32)k + 1;\n";
+		}
+		output << "}\n";
 
-		output << "\n\n";
+		size_t other = 0;
+		for (size_t i = 0; i < variant.cases.size(); i++) {
+			_type_id payload = ctx.types.case_type(id, i);
+			output << "static inline struct " << name << " " << name << "__" << variant.cases[i] << "(";
+			if (payload != TYPE_VOID) {
+				output << ctx.types.name_of(payload) << " payload) {\n";
+				output << "    struct " << name << " v;\n";
+				output << "    v." << variant.cases[i] << " = payload;\n";
+			}
+			else {
+				output << "void) {\n";
+				output << "    struct " << name << " v = { 0 };\n";
+			}
 
-		for (auto& structDef : this->structs) {
+			if (tagged) {
+				output << "    v." << s_VariantTag << " = " << i << ";\n";
+			}
+			else if (i != variant.niche_case) {
+				output << "    u64 n = " << variant.niche.first + other << "ull;\n";
+				output << "    __builtin_memcpy((char*)&v + " << variant.niche.offset << ", &n, " << variant.niche.size << ");\n";
+				other++;
+			}
+			output << "    return v;\n";
+			output << "}\n";
+		}
+		output << "\n";
+	}
+
+	static void compile_struct_definition(std::ostream& output, ParserContext& ctx, _type_id id, const std::string& name, const StructLayout& layout) {
+		// fields come out in registry order, which is the declared order unless @reorder is set
+		std::vector<FieldDef>& fields = ctx.types.fields_of(id);
+		bool tagged = ctx.types.is_variant(id) && ctx.types.variant_of(id).tag != TYPE_UNDEFINED;
+
+		output << "struct " << name << " {\n";
+		// an enum's payloads share an anonymous union, so they are still named like fields
+		if (tagged && !fields.empty()) {
+			output << "    union {\n";
+		}
+		for (auto& field : fields) {
+			std::string ptr = "";
+			output << (tagged ? "        " : "    ") << ctx.types.name_of(field.type) << ptr << " " << field.name << ";\n";
+		}
+		if (tagged && !fields.empty()) {
+			output << "    };\n";
+		}
+		if (tagged) {
+			output << "    " << ctx.types.name_of(ctx.types.variant_of(id).tag) << " " << s_VariantTag << ";\n";
+		}
+		output << "}";
+		if (layout.packed) {
+			output << " __attribute__((packed))";
+		}
+		if (layout.align != 0) {
+			output << " __attribute__((aligned(" << layout.align << ")))";
+		}
+		output << ";\n";
+
+		// the C compiler has to agree with the layout the type registry computed
+		output << "_Static_assert(sizeof(struct " << name << ") == " << ctx.types.size_of(id) << ", \"layout of " << name << "\");\n";
+		for (auto& field : fields) {
+			output << "_Static_assert(offsetof(struct " << name << ", " << field.name << ") == " << field.offset << ", \"layout of " << name << "." << field.name << "\");\n";
+		}
+		if (tagged) {
+			output << "_Static_assert(offsetof(struct " << name << ", " << s_VariantTag << ") == " << ctx.types.variant_of(id).tag_offset << ", \"layout of " << name << "." << s_VariantTag << "\");\n";
+		}
+		output << "\n";
+
+		if (ctx.types.is_variant(id)) {
+			compile_variant_helpers(output, ctx, id, name);
+		}
+	}
 
-			if (structDef->struct_name.args != nullptr) {
-				continue; // TODO: Implement
+	// structs a module refers to, each after the structs it holds by value
+	class InstanceCollector : public AstVisitor<InstanceCollector> {
+	public:
+		inline InstanceCollector(ParserContext& ctx) : m_Context{ ctx } {}
+
+		void add(_type_id type) {
+			if (m_Context.types.is_pointer(type)) {
+				return add(m_Context.types.pointee_of(type));
+			}
+			if (!m_Context.types.is_struct(type) || !m_Seen.insert(type).second) {
+				return;
 			}
+			for (auto& field : m_Context.types.fields_of(type)) {
+				add(field.type);
+			}
+			structs.push_back(type);
+		}
 
-			if (structDef->visibility != Visibility::Public) {
+		inline void visit_variable_decl(VariableDeclNode* node) {
+			add(node->type);
+			AstVisitor<InstanceCollector>::visit_variable_decl(node);
+		}
+
+		void visit_function(FunctionDefinitionNode* node) {
+			if (node->templateParams != nullptr) {
+				return;
+			}
+			add(node->returnType);
+			if (node->params != nullptr) {
+				for (auto& param : node->params->params) {
+					add(param.type);
+				}
+			}
+			visit(node->body);
+		}
+
+		inline void visit_struct(StructDefNode* node) {
+			if (node->templateParams == nullptr) {
+				AstVisitor<InstanceCollector>::visit_struct(node);
+			}
+		}
+
+		std::vector<_type_id> structs;
+
+	private:
+		ParserContext& m_Context;
+		std::unordered_set<_type_id> m_Seen;
+	};
+
+	/*
+	Public structs and the instances the module refers to, in an order where everything a
+	struct holds by value is complete before it. Instances are shared between modules, every
+	module that uses one emits its definition under a guard named after the instance so
+	translation units that see it twice agree.
+	*/
+	static bool compile_header_structs(ModuleBodyNode* body, std::ostream& output, ParserContext& ctx) {
+		InstanceCollector collector(ctx);
+		std::unordered_map<_type_id, StructDefNode*> publics;
+
+		std::string moduleName = ctx.current_module->moduleName->get_full_name().str();
+		for (auto& structDef : body->structs) {
+			if (structDef->templateParams != nullptr || structDef->visibility != Visibility::Public) {
 				continue;
 			}
 
-			if (!structDef->compile(output, ctx)) {
-				return false;
+			_type_id id = ctx.types.get_id_from_name(moduleName + "." + structDef->struct_name.bit);
+			publics[id] = structDef;
+			collector.add(id);
+		}
+		collector.visit(body);
+
+		for (auto& type : collector.structs) {
+			auto found = publics.find(type);
+			if (found != publics.end()) {
+				if (!found->second->compile(output, ctx)) {
+					return false;
+				}
+				continue;
+			}
+
+			if (!TemplateCache::instance().is_instance(type)) {
+				continue; // private or from another module
+			}
+
+			std::string name = ctx.types.name_of(type).substr(7); // drop "struct "
+
+			output << "#ifndef __tau_instance_" << name << "\n";
+			output << "#define __tau_instance_" << name << "\n";
+			compile_struct_definition(output, ctx, type, name, TemplateCache::instance().layout_of(type));
+			output << "#endif\n\n";
+		}
+		return true;
+	}
+
+	bool ModuleBodyNode::compile_header(std::ostream& output, ParserContext& ctx) {
+
+		for (auto& inc : this->includes) {
+			inc->compile(output, ctx);
+		}
+
+		for (auto& structDef : this->structs) {
+			if (structDef->templateParams != nullptr) {
+				continue; // generic, only its instances are emitted
+			}
+
+			std::string fullName = ctx.current_module->moduleName->get_full_name().str();
+			fullName += ".";
+			fullName += structDef->struct_name.bit.str();
+
+			// already registered when the module went through TypeCheckModule
+			if (ctx.types.get_id_from_name(fullName) == 0) {
+				std::vector<FieldDef> fields;
+				for (auto& member : structDef->members->members) {
+					FieldDef field;
+					field.name = member->var_name;
+					field.type = member->type;
+
+					fields.push_back(field);
+				}
+
+				ctx.types.define_type(fullName, fields, structDef->layout);
 			}
+
+			output << "struct " << structDef->struct_name.bit << ";\n";
+		}
+
+		output << "\n\n";
+
+		if (!compile_header_structs(this, output, ctx)) {
+			return false;
 		}
 
 		for (auto& funcDef : this->functions) {
 			if (funcDef->templateParams != nullptr) {
-				continue; // todo: implement
+				continue; // generic, InstantiateTemplates added its instances as plain functions
 			}
 
 			if (funcDef->visibility != Visibility::Public) {
 				continue;
 			}
 
-			output << ctx.types.name_of(funcDef->returnType) << " " << funcDef->functionName << "(";
+			compile_prototype(funcDef, output, ctx);
+		}
 
-			
+		/*
+		Public inline functions are defined right here so every module including the header
+		can have the C compiler inline them, the module's own source gets them the same way.
+		*/
+		bool included_stdlib = false;
+		for (auto& funcDef : this->functions) {
+			if (funcDef->templateParams != nullptr || funcDef->visibility != Visibility::Public || !funcDef->is_inline) {
+				continue;
+			}
 
-			if (funcDef->params != nullptr) {
-				for (size_t i = 0; i < funcDef->params->params.size(); i++) {
-					auto& param = funcDef->params->params[i];
-					output << ctx.types.name_of(param.type);
+			// abort() of the checked entry point
+			if (funcDef->has_entry_checks() && !included_stdlib) {
+				output << "#include <stdlib.h>\n";
+				included_stdlib = true;
+			}
 
-					if (i + 1 < funcDef->params->params.size()) {
-						output << ", ";
-					}
-				}
+			if (!funcDef->compile(output, ctx)) {
+				return false;
 			}
-			output << ");\n";
 		}
 
 		return true;
@@ -587,8 +1005,8 @@ namespace tau {
 		}
 
 		for (auto& structDef : this->structs) {
-			if (structDef->struct_name.args != nullptr) {
-				continue; // todo
+			if (structDef->templateParams != nullptr) {
+				continue; // generic, only its instances are emitted
 			}
 
 			output << "struct " << structDef->struct_name.bit << ";\n";
@@ -597,8 +1015,8 @@ namespace tau {
 
 		for (auto& structDef : this->structs) {
 
-			if (structDef->struct_name.args != nullptr) {
-				continue; // TODO: Implement
+			if (structDef->templateParams != nullptr) {
+				continue;
 			}
 
 			if (structDef->visibility != Visibility::Private) {
@@ -612,26 +1030,15 @@ namespace tau {
 
 		for (auto& funcDef : this->functions) {
 			if (funcDef->templateParams != nullptr) {
-				continue; // todo: implement
+				continue; // generic, InstantiateTemplates added its instances as plain functions
 			}
 
-			if (funcDef->visibility == Visibility::Private) {
-				output << "static ";
+			// public inline functions come with the module header
+			if (funcDef->is_inline && funcDef->visibility == Visibility::Public) {
+				continue;
 			}
 
-			output << ctx.types.name_of(funcDef->returnType) << " " << funcDef->functionName << "(";
-
-			if (funcDef->params != nullptr) {
-				for (size_t i = 0; i < funcDef->params->params.size(); i++) {
-					auto& param = funcDef->params->params[i];
-					output << ctx.types.name_of(param.type);
-
-					if (i + 1 < funcDef->params->params.size()) {
-						output << ", ";
-					}
-				}
-			}
-			output << ");\n";
+			compile_prototype(funcDef, output, ctx);
 		}
 		output << "\n\n";
 		
@@ -640,6 +1047,11 @@ namespace tau {
 				continue;
 			}
 
+			if (funcDef->is_inline && funcDef->visibility == Visibility::Public) {
+				funcDef->declare(ctx);
+				continue;
+			}
+
 			if (!funcDef->compile(output, ctx)) {
 				return false;
 			}
@@ -649,19 +1061,13 @@ namespace tau {
 	}
 
 	bool StructDefNode::compile(std::ostream& output, ParserContext& ctx) {
-		if (struct_name.args != nullptr) {
+		if (templateParams != nullptr) {
 			return false;
 		}
 
 		
 		
-		output << "struct " << struct_name.bit << " {\n";
-		for (auto& member : members->members) {
-			std::string ptr = "";
-			output << "    " << ctx.types.name_of(member->type) << ptr << " " << member->var_name << ";\n";
-		}
-		output << "};\n\n";
-
+		compile_struct_definition(output, ctx, struct_id, struct_name.bit.str(), layout);
 		return true;
 	}
 
@@ -670,47 +1076,68 @@ namespace tau {
 			return false;
 		}
 
-		if (this->visibility == Visibility::Private) {
-			output << "static ";
-		}
+		compile_linkage(this, output);
 
-		output << ctx.types.name_of(returnType) << " " << functionName << "(";
-
-		if (params != nullptr) {
-			for (size_t i = 0; i < params->params.size(); i++) {
-				auto& param = params->params[i];
-
-				output << ctx.types.name_of(param.type) << " " << param.name;
-
-				if (i + 1 < params->params.size()) {
-					output << ", ";
-				}
-			}
+		output << ctx.types.name_of(returnType) << " " << functionName;
+		if (has_entry_checks()) {
+			output << s_UncheckedSuffix;
 		}
+		output << "(";
+		compile_parameters(this, true, output, ctx);
 		output << ") ";
 
-		ItemInfo self;
-		self.is_function = true;
-		self.type_id = this->returnType;
-		ctx.active_symbol_scope->add(functionName, self);
+		declare(ctx);
 
 		ctx.active_symbol_scope->begin();
 
 		if (params != nullptr) {
 			for (auto& param : params->params) {
-				ctx.active_symbol_scope->add_variable(param.name, param.type);
+				ctx.active_symbol_scope->add_variable(param.name, param.type, false, false, param.moves);
+			}
+		}
+
+		if (profile_counter != NO_PROFILE_COUNTER) {
+			output << "{\n__tau_profile[" << profile_counter << "]++;\n";
+		}
+
+		// tail calls jump back to the start with new parameters instead of recursing
+		if (tail_loop) {
+			output << "{\n";
+			if (accumulator != OperatorID::Undefined) {
+				output << ctx.types.name_of(returnType) << " " << s_TailAccumulator << " = " << (accumulator == OperatorID::Mul ? "1" : "0") << ";\n";
 			}
+			output << s_TailStart << ": ;\n";
 		}
 
-		if (!body->compile(output, ctx)) {
+		ctx.current_function = this;
+		if (ir != nullptr ? !ir->compile(output, ctx) : !body->compile(output, ctx)) {
 			return false;
 		}
+		ctx.current_function = nullptr;
+
+		if (tail_loop) {
+			output << "}\n";
+		}
+		if (profile_counter != NO_PROFILE_COUNTER) {
+			output << "}\n";
+		}
 
 		ctx.active_symbol_scope->end();
 
+		if (has_entry_checks()) {
+			return compile_checked_entry(this, output, ctx);
+		}
+
 		return true;
 	}
 
+	void FunctionDefinitionNode::declare(ParserContext& ctx) {
+		ItemInfo self;
+		self.is_function = true;
+		self.type_id = this->returnType;
+		ctx.active_symbol_scope->add(functionName, self);
+	}
+
 	bool StatementBlockNode::compile(std::ostream& output, ParserContext& ctx) {
 		output << "{\n";
 		ctx.active_symbol_scope->begin();
@@ -718,6 +1145,12 @@ namespace tau {
 			if (!statement->compile(output, ctx)) {
 				return false;
 			}
+
+			// declarations, returns and statement annotations end themselves, expressions do not
+			AnnotationNode* annotation = node_cast<AnnotationNode>(statement);
+			if (as_typed(statement) != nullptr && (annotation == nullptr || annotation->body() != nullptr)) {
+				output << ";\n";
+			}
 		}
 		ctx.active_symbol_scope->end();
 
@@ -725,193 +1158,180 @@ namespace tau {
 		return true;
 	}
 
+	/*
+	Compiles an operand of an operator with precedence prec, in parentheses whenever C would
+	otherwise group the emitted tokens differently from the tree. Operands of unary operators
+	(prec 0 here) are always wrapped, which also keeps - -a from turning into --a.
+	*/
+	static bool compile_operand(AstNode* operand, int prec, bool wrap_equal, std::ostream& output, ParserContext& ctx) {
+		bool wrap = false;
+		if (operand->kind() == NodeType::BinaryOperator) {
+			int operand_prec = get_operator_prec(static_cast<BinaryOperator*>(operand)->m_Operator);
+			wrap = prec == 0 || operand_prec > prec || (operand_prec == prec && wrap_equal);
+		}
+		else if (operand->kind() == NodeType::UnaryOperator) {
+			wrap = prec == 0;
+		}
+
+		if (wrap) {
+			output << "(";
+		}
+		if (!operand->compile(output, ctx)) {
+			return false;
+		}
+		if (wrap) {
+			output << ")";
+		}
+		return true;
+	}
+
 	bool UnaryOperator::compile(std::ostream& output, ParserContext& ctx) {
-		_type_id a = dynamic_cast<Typed*>(m_Child)->get_type(ctx);
-
-		_type_id STATIC_INT = ctx.types.get_id_from_name("long long");
-		_type_id STATIC_FLOAT = ctx.types.get_id_from_name("double");
-
-		_type_id ints[] = {
-			ctx.types.get_id_from_name("i64"),
-			ctx.types.get_id_from_name("u64"),
-			ctx.types.get_id_from_name("i32"),
-			ctx.types.get_id_from_name("u32"),
-			ctx.types.get_id_from_name("i16"),
-			ctx.types.get_id_from_name("u16"),
-			ctx.types.get_id_from_name("i8"),
-			ctx.types.get_id_from_name("u8"),
-		};
-		size_t ints_count = 8;
-
-		_type_id floats[] = {
-			ctx.types.get_id_from_name("f64"),
-			ctx.types.get_id_from_name("f32"),
-		};
-		size_t floats_count = 2;
-
-		for (size_t i = 0; i < ctx.uoperators.size(); i++) {
-			if (ctx.uoperators[i].operator_ != m_Operator) continue;
-
-			bool match = false;
-			size_t true_a = -1;
-
-			if (a == STATIC_INT) {
-				for (size_t j = 0; j < ints_count; j++) {
-					if (ints[j] == ctx.operators[i].left_type) {
-						match = true;
-						true_a = j;
-						break;
-					}
-				}
-			}
-			else if (a == STATIC_FLOAT) {
-				for (size_t j = 0; j < floats_count; j++) {
-					if (floats[j] == ctx.operators[i].left_type) {
-						match = true;
-						true_a = j;
-					}
-				}
-			}
-			else {
-				match = ctx.operators[i].left_type == a;
-				true_a = a;
-			}
+		if (resolved_operator == nullptr) {
+			get_type(ctx);
+		}
 
-			if (!match) {
-				continue;
-			}
+		if (resolved_operator == nullptr) {
+			std::cout << "Could not find operator implementation for unary operator: " << get_opstr(m_Operator) << " using (" <<
+				ctx.types.name_of(as_typed(m_Child)->get_type(ctx)) << ")\n";
+			return false;
+		}
 
-			if (ctx.uoperators[i].overload_function != nullptr) {
-				FunctionCallNode* operatorFunc = dynamic_cast<FunctionCallNode*>(ctx.operators[i].overload_function);
+		if (resolved_operator->overload_function != nullptr) {
+			FunctionCallNode* operatorFunc = node_cast<FunctionCallNode>(resolved_operator->overload_function);
 
-				operatorFunc->arguments->args.push_back(m_Child);
+			operatorFunc->arguments->args.push_back(m_Child);
 
-				return operatorFunc->compile(output, ctx);
-			}
+			return operatorFunc->compile(output, ctx);
+		}
 
-			if (m_Operator == OperatorID::PostInc || m_Operator == OperatorID::PostDec) {
-				if (!m_Child->compile(output, ctx)) return false;
-				output << get_opstr(m_Operator) << " ";
-				return true;
-			}
-			output << get_opstr(m_Operator);
-			if (!m_Child->compile(output, ctx)) return false;
+		if (m_Operator == OperatorID::PostInc || m_Operator == OperatorID::PostDec) {
+			if (!compile_operand(m_Child, 0, true, output, ctx)) return false;
+			output << get_opstr(m_Operator) << " ";
 			return true;
 		}
-
-		return false;
+		output << get_opstr(m_Operator);
+		if (!compile_operand(m_Child, 0, true, output, ctx)) return false;
+		return true;
 	}
 
-	bool BinaryOperator::compile(std::ostream& output, ParserContext& ctx) {
-		_type_id a = dynamic_cast<Typed*>(m_Lhs)->get_type(ctx);
-		_type_id b = dynamic_cast<Typed*>(m_Rhs)->get_type(ctx);
-
-		_type_id STATIC_INT = ctx.types.get_id_from_name("long long");
-		_type_id STATIC_FLOAT = ctx.types.get_id_from_name("double");
-
-		_type_id ints[] = {
-			ctx.types.get_id_from_name("i64"),
-			ctx.types.get_id_from_name("u64"),
-			ctx.types.get_id_from_name("i32"),
-			ctx.types.get_id_from_name("u32"),
-			ctx.types.get_id_from_name("i16"),
-			ctx.types.get_id_from_name("u16"),
-			ctx.types.get_id_from_name("i8"),
-			ctx.types.get_id_from_name("u8"),
-		};
-		size_t ints_count = 8;
-
-		_type_id floats[] = {
-			ctx.types.get_id_from_name("f64"),
-			ctx.types.get_id_from_name("f32"),
-		};
-		size_t floats_count = 2;
-
-		for (size_t i = 0; i < ctx.operators.size(); i++) {
-			if (ctx.operators[i].operator_ != m_Operator) continue;
-
-			bool left_match = false;
-			bool right_match = false;
-
-			size_t true_a = -1;
-			size_t true_b = -1;
-
-			if (a == STATIC_INT) {
-				for (size_t j = 0; j < ints_count; j++) {
-					if (ints[j] == ctx.operators[i].left_type) {
-						left_match = true;
-						true_a = j;
-						break;
-					}
-				}
-			}
-			else if (a == STATIC_FLOAT) {
-				for (size_t j = 0; j < floats_count; j++) {
-					if (floats[j] == ctx.operators[i].left_type) {
-						left_match = true;
-						true_a = j;
-						break;
-					}
+	bool AnnotationNode::compile(std::ostream& output, ParserContext& ctx) {
+		if (m_AnnotationType == "null_check") {
+			for (auto& param : m_Params) {
+				output << "if (__builtin_expect(";
+				if (!param->compile(output, ctx)) {
+					return false;
 				}
+				output << " == NULL, 0)) { abort(); }\n";
 			}
-			else {
-				left_match = ctx.operators[i].left_type == a;
+			return true;
+		}
+
+		if (m_AnnotationType == "pre_assert") {
+			output << "if (__builtin_expect(!(";
+			if (!m_Params[0]->compile(output, ctx)) {
+				return false;
 			}
+			output << "), 0)) { abort(); }\n";
+			return true;
+		}
 
+		if (m_AnnotationType == "free") {
+			if (!stack_buffer.empty()) {
+				output << "if (";
+				m_Params[0]->compile(output, ctx);
+				output << " != " << stack_buffer << ") ";
+			}
+			output << "free(";
+			if (!m_Params[0]->compile(output, ctx)) {
+				return false;
+			}
+			output << ");\n";
+			return true;
+		}
 
-			if (b == STATIC_INT) {
-				for (size_t j = 0; j < ints_count; j++) {
-					if (ints[j] == ctx.operators[i].right_type) {
-						right_match = true;
-						true_b = j;
-						break;
-					}
+		if (m_AnnotationType == "alloc") {
+			std::string element = ctx.types.name_of(ctx.types.pointee_of(value_type));
+			if (stack_capacity != 0) {
+				if (m_Body->kind() == NodeType::ImmediateInt) {
+					output << stack_buffer;
+					return true;
 				}
-			}
-			else if (b == STATIC_FLOAT) {
-				for (size_t j = 0; j < floats_count; j++) {
-					if (floats[j] == ctx.operators[i].right_type) {
-						right_match = true;
-						true_b = j;
-						break;
-					}
+				output << "(";
+				if (!m_Body->compile(output, ctx)) {
+					return false;
 				}
+				output << ") <= " << stack_capacity << " ? " << stack_buffer << " : ";
 			}
-			else {
-				right_match = ctx.operators[i].right_type == b;
+			output << "(" << ctx.types.name_of(value_type) << ")malloc(sizeof(" << element << ") * (";
+			if (!m_Body->compile(output, ctx)) {
+				return false;
 			}
+			output << "))";
+			return true;
+		}
 
-			if (!right_match || !left_match) {
-				continue;
-			}
+		// @not_null only informs ElideNullChecks, the value is passed through
+		if (m_Body != nullptr) {
+			return compile_operand(m_Body, 0, true, output, ctx);
+		}
+		return true;
+	}
+
+	bool BinaryOperator::compile(std::ostream& output, ParserContext& ctx) {
+		if (resolved_operator == nullptr) {
+			get_type(ctx);
+		}
+
+		if (resolved_operator == nullptr) {
+			std::cout << "Could not find operator implementation for binary operator: " << get_opstr(m_Operator) << " using (" <<
+				ctx.types.name_of(as_typed(m_Lhs)->get_type(ctx)) << ", " << ctx.types.name_of(as_typed(m_Rhs)->get_type(ctx)) << ")\n";
+			return false;
+		}
 
-			if (ctx.operators[i].overload_function != nullptr) {
-				FunctionCallNode* operatorFunc = dynamic_cast<FunctionCallNode*>(ctx.operators[i].overload_function);
+		if (resolved_operator->overload_function != nullptr) {
+			FunctionCallNode* operatorFunc = node_cast<FunctionCallNode>(resolved_operator->overload_function);
 
-				operatorFunc->arguments->args.push_back(m_Lhs);
-				operatorFunc->arguments->args.push_back(m_Rhs);
+			operatorFunc->arguments->args.push_back(m_Lhs);
+			operatorFunc->arguments->args.push_back(m_Rhs);
 
-				return operatorFunc->compile(output, ctx);
-			}
-			
-			if (!m_Lhs->compile(output, ctx)) {
+			return operatorFunc->compile(output, ctx);
+		}
+
+		int prec = get_operator_prec(m_Operator);
+		bool right = is_right_associative(m_Operator);
+
+		if (m_Operator == OperatorID::ArrayAccess) {
+			if (!compile_operand(m_Lhs, prec, false, output, ctx)) {
 				return false;
 			}
-
-			output << " " << get_opstr(m_Operator) << " ";
-			
+			output << "[";
 			if (!m_Rhs->compile(output, ctx)) {
 				return false;
 			}
-
+			output << "]";
 			return true;
 		}
-		std::cout << "Could not find operator implementation for binary operator: " << get_opstr(m_Operator) << " using (" <<
-				ctx.types.name_of(a) << ", " << ctx.types.name_of(b) << ")\n";
-		return false;
+
+		if (!compile_operand(m_Lhs, prec, right, output, ctx)) {
+			return false;
+		}
+
+		output << " " << get_opstr(m_Operator) << " ";
+
+		if (!compile_operand(m_Rhs, prec, !right, output, ctx)) {
+			return false;
+		}
+
+		return true;
 	}
 
 	bool VariableDeclNode::compile(std::ostream& output, ParserContext& ctx) {
+		// the array backing an @alloc PromoteAllocations moved to the stack
+		AnnotationNode* alloc = node_cast<AnnotationNode>(default_value);
+		if (alloc != nullptr && alloc->stack_capacity != 0) {
+			output << ctx.types.name_of(ctx.types.pointee_of(type)) << " " << alloc->stack_buffer << "[" << alloc->stack_capacity << "];\n";
+		}
+
 		output << ctx.types.name_of(type) << " " << var_name;
 
 		if (default_value != nullptr) {
@@ -929,10 +1349,20 @@ namespace tau {
 	}
 
 	bool VariableNode::compile(std::ostream& output, ParserContext& ctx) {
-		if (!ctx.active_symbol_scope->exists(m_VariableName->get_full_name(ctx))) {
-			std::cout << "Undeclared variable: " << m_VariableName->get_full_name(ctx) << "\n";
+		Name full_name = m_VariableName->get_full_name(ctx);
+		if (!ctx.active_symbol_scope->exists(full_name)) {
+			std::cout << "Undeclared variable: " << full_name << "\n";
 		}
-		output << m_VariableName->get_full_name(ctx);
+
+		// a @moves parameter is the caller's value behind a pointer
+		const std::string& root = m_VariableName->nodes[0].bit.str();
+		const ItemInfo* info = ctx.active_symbol_scope->lookup(m_VariableName->nodes[0].bit);
+		if (info != nullptr && info->is_indirect && full_name.str().compare(0, root.size(), root) == 0) {
+			output << "(*" << root << ")" << full_name.str().substr(root.size());
+			return true;
+		}
+
+		output << full_name;
 		return true;
 	}
 
@@ -955,9 +1385,44 @@ namespace tau {
 	}
 
 	bool ReturnNode::compile(std::ostream& output, ParserContext& ctx) {
+		FunctionDefinitionNode* func = ctx.current_function;
+
+		if (tail_call != nullptr) {
+			// every argument is evaluated before the first parameter is overwritten
+			auto& params = func->params->params;
+			auto& args = tail_call->arguments->args;
+			output << "{\n";
+			for (size_t i = 0; i < params.size(); i++) {
+				output << ctx.types.name_of(params[i].type) << " tail__arg" << i << " = ";
+				if (!args[i]->compile(output, ctx)) {
+					return false;
+				}
+				output << ";\n";
+			}
+			if (accumulated != nullptr) {
+				output << s_TailAccumulator << " = " << s_TailAccumulator << " " << get_opstr(func->accumulator) << " (";
+				if (!accumulated->compile(output, ctx)) {
+					return false;
+				}
+				output << ");\n";
+			}
+			for (size_t i = 0; i < params.size(); i++) {
+				output << params[i].name << " = tail__arg" << i << ";\n";
+			}
+			output << "goto " << s_TailStart << ";\n}\n";
+			return true;
+		}
+
 		output << "return ";
 		if (returnValue != nullptr) {
-			returnValue->compile(output, ctx);
+			if (func != nullptr && func->accumulator != OperatorID::Undefined) {
+				output << s_TailAccumulator << " " << get_opstr(func->accumulator) << " (";
+				returnValue->compile(output, ctx);
+				output << ")";
+			}
+			else {
+				returnValue->compile(output, ctx);
+			}
 		}
 		output << ";\n";
 
@@ -967,7 +1432,19 @@ namespace tau {
 
 	bool IfNode::compile(std::ostream& output, ParserContext& ctx) {
 		output << "if (";
+		if (hint != BranchHint::None) {
+			output << "__builtin_expect(!!(";
+		}
+		if (profile_counter != NO_PROFILE_COUNTER) {
+			output << "__tau_profile_branch(";
+		}
 		if (!condition->compile(output, ctx)) return false; // this is failing for if(n <= 1)? 
+		if (profile_counter != NO_PROFILE_COUNTER) {
+			output << ", " << profile_counter << ")";
+		}
+		if (hint != BranchHint::None) {
+			output << "), " << (hint == BranchHint::Likely ? 1 : 0) << ")";
+		}
 		output << ")\n";
 
 		if (body != nullptr) {
@@ -980,6 +1457,32 @@ namespace tau {
 		return true;
 	}
 
+	bool ForNode::compile(std::ostream& output, ParserContext& ctx) {
+		// the loop variable is only visible inside the loop
+		ctx.active_symbol_scope->begin();
+
+		output << "for (";
+		if (init != nullptr) {
+			if (!init->compile(output, ctx)) return false;
+		}
+		if (init == nullptr || init->kind() != NodeType::VariableDeclaration) {
+			output << "; ";
+		}
+		if (condition != nullptr) {
+			if (!condition->compile(output, ctx)) return false;
+		}
+		output << "; ";
+		if (step != nullptr) {
+			if (!step->compile(output, ctx)) return false;
+		}
+		output << ")\n";
+
+		if (!body->compile(output, ctx)) return false;
+
+		ctx.active_symbol_scope->end();
+		return true;
+	}
+
 	bool ElseNode::compile(std::ostream& output, ParserContext& ctx) {
 		output << "else ";
 		if (ifBranch != nullptr) {
@@ -993,24 +1496,87 @@ namespace tau {
 
 
 	_type_id StaticIntegerNode::get_type(ParserContext& registry) {
-		return registry.types.get_id_from_name("long long");
+		if (resolved_type == 0) resolved_type = TYPE_STATIC_INT;
+		return resolved_type;
 	}
 	_type_id StaticFloatNode::get_type(ParserContext& registry) {
-		return registry.types.get_id_from_name("double");
+		if (resolved_type == 0) resolved_type = TYPE_STATIC_FLOAT;
+		return resolved_type;
+	}
+
+	/*
+	Source literals are printed as written. Literals produced by constant folding carry the
+	C type they were computed in and get the matching suffix, so the C compiler sees the
+	same type and value; negative values are parenthesised so they can sit next to any operator.
+	*/
+	bool StaticIntegerNode::compile(std::ostream& output, ParserContext& ctx) {
+		switch (resolved_type) {
+		case TYPE_I32:
+			if (m_Value == std::numeric_limits<i32>::min()) output << "(-2147483647 - 1)";
+			else if (m_Value < 0) output << "(" << m_Value << ")";
+			else output << m_Value;
+			break;
+		case TYPE_U32:
+			output << (u32)m_Value << "U";
+			break;
+		case TYPE_I64:
+			if (m_Value == std::numeric_limits<i64>::min()) output << "(-9223372036854775807LL - 1)";
+			else if (m_Value < 0) output << "(" << m_Value << "LL)";
+			else output << m_Value << "LL";
+			break;
+		case TYPE_U64:
+			output << (u64)m_Value << "ULL";
+			break;
+		default:
+			output << m_Value;
+			break;
+		}
+		return true;
+	}
+
+	bool StaticFloatNode::compile(std::ostream& output, ParserContext& ctx) {
+		// source literals are doubles unless they were typed f32, and must not print as an int
+		std::stringstream text;
+		text << std::setprecision(resolved_type == TYPE_F32 ? std::numeric_limits<float>::max_digits10 : std::numeric_limits<double>::max_digits10) << m_Value;
+
+		std::string digits = text.str();
+		if (digits.find_first_of(".e") == std::string::npos) {
+			digits += ".0";
+		}
+		if (resolved_type == TYPE_F32) {
+			digits += "f";
+		}
+
+		if (m_Value < 0) output << "(" << digits << ")";
+		else output << digits;
+		return true;
 	}
 	_type_id StaticBoolNode::get_type(ParserContext& registry) {
-		return registry.types.get_id_from_name(m_TypeName);
+		if (resolved_type == 0) resolved_type = registry.types.get_id_from_name(m_TypeName);
+		return resolved_type;
 	}
 	_type_id StaticCharNode::get_type(ParserContext& registry) {
-		return registry.types.get_id_from_name(m_TypeName);
+		if (resolved_type == 0) resolved_type = registry.types.get_id_from_name(m_TypeName);
+		return resolved_type;
 	}
 	_type_id StaticStringNode::get_type(ParserContext& registry) {
-		return registry.types.get_id_from_name(m_TypeName);
+		if (resolved_type == 0) resolved_type = registry.types.get_id_from_name(m_TypeName);
+		return resolved_type;
 	}
 	_type_id VariableNode::get_type(ParserContext& ctx) {
-		if (ctx.active_symbol_scope->exists(m_VariableName->get_full_name(ctx))) {
-			auto r = ctx.active_symbol_scope->get(m_VariableName->get_full_name(ctx));
-			return r.type_id;
+		if (resolved_type != 0) {
+			return resolved_type;
+		}
+
+		resolved_type = lookup_type(ctx);
+		return resolved_type;
+	}
+
+	_type_id VariableNode::lookup_type(ParserContext& ctx) {
+		Name full_name = m_VariableName->get_full_name(ctx);
+		const ItemInfo* info = ctx.active_symbol_scope->lookup(full_name);
+		if (info != nullptr) {
+			return info->type_id;
 		}
 
 		PathNode* name = this->m_VariableName;
@@ -1018,12 +1584,13 @@ namespace tau {
 
 		auto node = name->nodes.begin();
 		while (node != name->nodes.end()) {
-			if (!ctx.active_symbol_scope->exists(node->bit)) {
+			const ItemInfo* bit_info = ctx.active_symbol_scope->lookup(node->bit);
+			if (bit_info == nullptr) {
 				std::cout << "Unknown variable: " << node->bit << "\n";
 				return 0;
 			}
 
-			type = ctx.active_symbol_scope->get(node->bit).type_id;
+			type = bit_info->type_id;
 
 			while (ctx.types.is_struct(type)) {
 				node++;
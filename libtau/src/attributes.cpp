@@ -0,0 +1,405 @@
+#include "core/attributes.h"
+#include "core/null_check.h"
+#include "core/operators.h"
+
+namespace tau {
+
+	static bool is_endless(ForNode* node) {
+		StaticBoolNode* condition = node_cast<StaticBoolNode>(node->condition);
+		return node->condition == nullptr || (condition != nullptr && condition->value());
+	}
+
+	static AnnotationNode* allocation_of(VariableDeclNode* node) {
+		AnnotationNode* alloc = node_cast<AnnotationNode>(node->default_value);
+		return alloc != nullptr && alloc->annotation_type() == "alloc" ? alloc : nullptr;
+	}
+
+	void AttributeInference::add_function(FunctionDefinitionNode* func) {
+		m_Order.push_back(func);
+		m_Functions[func->functionName] = func;
+	}
+
+	void AttributeInference::collect() {
+		for (auto& func : m_Order) {
+			m_Current = &m_Facts[func];
+
+			bool moves = false;
+			if (func->params != nullptr) {
+				for (auto& param : func->params->params) {
+					moves |= param.moves;
+				}
+			}
+			// instrumented functions count their calls
+			if (func->returnType == TYPE_VOID || func->functionName == s_Main || func->has_entry_checks() || moves || func->profile_counter != NO_PROFILE_COUNTER) {
+				m_Current->purity = Purity::Impure;
+			}
+
+			visit(func->body);
+
+			// a tail loop that never returns has no way out, like a loop without a condition
+			if (func->tail_loop && !m_Current->returns) {
+				m_Current->purity = Purity::Impure;
+			}
+		}
+		m_Current = nullptr;
+	}
+
+	FunctionDefinitionNode* AttributeInference::callee_of(FunctionCallNode* call) const {
+		if (call->function_name == nullptr || call->function_name->nodes.size() != 1) {
+			return nullptr;
+		}
+		auto f = m_Functions.find(call->function_name->nodes[0].bit);
+		return f != m_Functions.end() ? f->second : nullptr;
+	}
+
+	void AttributeInference::lower(Purity purity) {
+		if (purity < m_Current->purity) {
+			m_Current->purity = purity;
+		}
+	}
+
+	size_t AttributeInference::infer_purity() {
+		// a function is only as pure as its least pure callee, which settles since purities only go down
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto& func : m_Order) {
+				Facts& facts = m_Facts[func];
+				for (auto& call : facts.calls) {
+					FunctionDefinitionNode* callee = callee_of(call);
+					Purity purity = callee != nullptr ? m_Facts[callee].purity : Purity::Impure;
+					if (purity < facts.purity) {
+						facts.purity = purity;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		size_t found = 0;
+		for (auto& func : m_Order) {
+			func->purity = m_Facts[func].purity;
+			found += func->purity != Purity::Impure;
+		}
+		return found;
+	}
+
+	bool AttributeInference::never_completes(AstNode* statement, bool loops) const {
+		if (statement == nullptr) {
+			return false;
+		}
+
+		switch (statement->kind()) {
+		case NodeType::StatementBlock:
+			for (auto& inner : static_cast<StatementBlockNode*>(statement)->statements) {
+				if (never_completes(inner, loops)) {
+					return true;
+				}
+			}
+			return false;
+		case NodeType::If: {
+			IfNode* node = static_cast<IfNode*>(statement);
+			return node->elseBranch != nullptr && never_completes(node->body, loops) && never_completes(node->elseBranch, loops);
+		}
+		case NodeType::Else: {
+			ElseNode* node = static_cast<ElseNode*>(statement);
+			return node->ifBranch != nullptr ? never_completes(node->ifBranch, loops) : never_completes(node->body, loops);
+		}
+		case NodeType::For:
+			// there is no break, only a return could leave it
+			return loops && is_endless(static_cast<ForNode*>(statement));
+		case NodeType::Return:
+			// a self tail call EliminateTailCalls turned into a jump back to the start
+			return loops && static_cast<ReturnNode*>(statement)->tail_call != nullptr;
+		case NodeType::FunctionCall: {
+			FunctionDefinitionNode* callee = callee_of(static_cast<FunctionCallNode*>(statement));
+			return callee != nullptr && callee->noreturn;
+		}
+		default:
+			return false;
+		}
+	}
+
+	size_t AttributeInference::infer_noreturn() {
+		// starts from every function returning, so a function that only calls itself is not taken to diverge
+		size_t found = 0;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto& func : m_Order) {
+				if (func->noreturn || func->functionName == s_Main || m_Facts[func].returns) {
+					continue;
+				}
+				if (never_completes(func->body, true)) {
+					func->noreturn = true;
+					changed = true;
+					found++;
+				}
+			}
+		}
+		return found;
+	}
+
+	bool AttributeInference::root_of(FunctionDefinitionNode* caller, AstNode* arg, Name& root) {
+		if (!local_name(strip_not_null(arg), root)) {
+			return false;
+		}
+
+		if (caller->params != nullptr) {
+			for (auto& param : caller->params->params) {
+				if (param.name == root) {
+					return param.noalias;
+				}
+			}
+		}
+		auto& allocations = m_Facts[caller].allocations;
+		return allocations.find(root) != allocations.end();
+	}
+
+	size_t AttributeInference::infer_noalias(EscapeAnalysis& escape) {
+		// summaries only ever go from not escaping to escaping, so this settles
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto& func : m_Order) {
+				changed |= escape.analyze(func);
+			}
+		}
+
+		for (auto& func : m_Order) {
+			Facts& facts = m_Facts[func];
+			escape.analyze(func);
+			for (auto it = facts.allocations.begin(); it != facts.allocations.end();) {
+				it = escape.escapes(*it) ? facts.allocations.erase(it) : std::next(it);
+			}
+
+			if (func->params == nullptr || func->visibility == Visibility::Public || func->functionName == s_Main ||
+				facts.inline_c || m_Unseen.find(func->functionName) != m_Unseen.end()) {
+				continue;
+			}
+			for (auto& param : func->params->params) {
+				param.noalias = !param.moves && m_Context.types.is_pointer(param.type) && facts.written.find(param.name) == facts.written.end();
+			}
+		}
+
+		// starts from every candidate being restrict and drops those some call breaks, restrict callers included
+		changed = true;
+		while (changed) {
+			changed = false;
+			for (auto& caller : m_Order) {
+				for (auto& call : m_Facts[caller].calls) {
+					FunctionDefinitionNode* callee = callee_of(call);
+					if (callee == nullptr || callee->params == nullptr) {
+						continue;
+					}
+
+					auto& params = callee->params->params;
+					size_t count = call->arguments != nullptr ? call->arguments->args.size() : 0;
+					bool known = count == params.size();
+
+					std::vector<Name> roots(params.size());
+					for (size_t i = 0; known && i < params.size(); i++) {
+						if (params[i].moves || m_Context.types.is_struct(params[i].type)) {
+							known = false;
+						}
+						else if (m_Context.types.is_pointer(params[i].type)) {
+							known = root_of(caller, call->arguments->args[i], roots[i]);
+						}
+					}
+
+					for (size_t i = 0; i < params.size(); i++) {
+						if (!params[i].noalias) {
+							continue;
+						}
+
+						bool distinct = known;
+						for (size_t j = 0; distinct && j < params.size(); j++) {
+							distinct = j == i || !m_Context.types.is_pointer(params[j].type) || roots[j] != roots[i];
+						}
+						if (!distinct) {
+							params[i].noalias = false;
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+
+		size_t found = 0;
+		for (auto& func : m_Order) {
+			if (func->params != nullptr) {
+				for (auto& param : func->params->params) {
+					found += param.noalias;
+				}
+			}
+		}
+		return found;
+	}
+
+	size_t AttributeInference::hint_branches() {
+		size_t hinted = 0;
+		for (auto& func : m_Order) {
+			for (auto& branch : m_Facts[func].branches) {
+				bool cold_body = never_completes(branch->body, false);
+				bool cold_else = never_completes(branch->elseBranch, false);
+				if (cold_body != cold_else) {
+					branch->hint = cold_body ? BranchHint::Unlikely : BranchHint::Likely;
+					hinted++;
+				}
+			}
+		}
+		return hinted;
+	}
+
+	void AttributeInference::visit_if(IfNode* node) {
+		m_Current->branches.push_back(node);
+		AstVisitor<AttributeInference>::visit_if(node);
+	}
+
+	void AttributeInference::visit_for(ForNode* node) {
+		// the C compiler may only assume loops with a condition terminate
+		if (is_endless(node)) {
+			lower(Purity::Impure);
+		}
+		AstVisitor<AttributeInference>::visit_for(node);
+	}
+
+	void AttributeInference::visit_return(ReturnNode* node) {
+		// a tail call only jumps back to the start of the function
+		if (node->tail_call == nullptr) {
+			m_Current->returns = true;
+		}
+		AstVisitor<AttributeInference>::visit_return(node);
+	}
+
+	void AttributeInference::visit_propagate(PropagateNode* node) {
+		// a failure returns from the function
+		m_Current->returns = true;
+		AstVisitor<AttributeInference>::visit_propagate(node);
+	}
+
+	void AttributeInference::visit_variable_decl(VariableDeclNode* node) {
+		// a local shadowing a parameter is as good as writing it
+		m_Current->written.insert(node->var_name);
+		if (allocation_of(node) != nullptr) {
+			m_Current->allocations.insert(node->var_name);
+		}
+		AstVisitor<AttributeInference>::visit_variable_decl(node);
+	}
+
+	void AttributeInference::visit_binary(BinaryOperator* node) {
+		if (node->resolved_operator == nullptr || node->resolved_operator->overload_function != nullptr) {
+			FunctionDefinitionNode* overload = node->resolved_operator != nullptr ? node_cast<FunctionDefinitionNode>(node->resolved_operator->overload_function) : nullptr;
+			if (overload != nullptr) {
+				m_Unseen.insert(overload->functionName);
+			}
+			lower(Purity::Impure);
+		}
+
+		Name name;
+		if (is_assignment(node->m_Operator)) {
+			if (local_name(node->m_Lhs, name)) {
+				m_Current->written.insert(name);
+			}
+			else {
+				lower(Purity::Impure);
+			}
+		}
+		else if (node->m_Operator == OperatorID::ArrayAccess || node->m_Operator == OperatorID::Dot) {
+			lower(Purity::Pure);
+		}
+		AstVisitor<AttributeInference>::visit_binary(node);
+	}
+
+	void AttributeInference::visit_unary(UnaryOperator* node) {
+		if (node->resolved_operator == nullptr || node->resolved_operator->overload_function != nullptr) {
+			FunctionDefinitionNode* overload = node->resolved_operator != nullptr ? node_cast<FunctionDefinitionNode>(node->resolved_operator->overload_function) : nullptr;
+			if (overload != nullptr) {
+				m_Unseen.insert(overload->functionName);
+			}
+			lower(Purity::Impure);
+		}
+
+		Name name;
+		switch (node->m_Operator) {
+		case OperatorID::PreInc:
+		case OperatorID::PreDec:
+		case OperatorID::PostInc:
+		case OperatorID::PostDec:
+			if (local_name(node->m_Child, name)) {
+				m_Current->written.insert(name);
+			}
+			else {
+				lower(Purity::Impure);
+			}
+			break;
+		case OperatorID::Reference:
+			// whatever the address reaches may be written
+			if (local_name(node->m_Child, name)) {
+				m_Current->written.insert(name);
+			}
+			lower(Purity::Impure);
+			break;
+		case OperatorID::Dereference:
+			lower(Purity::Pure);
+			break;
+		default:
+			break;
+		}
+		AstVisitor<AttributeInference>::visit_unary(node);
+	}
+
+	void AttributeInference::visit_call(FunctionCallNode* node) {
+		m_Current->calls.push_back(node);
+		if (callee_of(node) == nullptr) {
+			lower(Purity::Impure);
+		}
+		AstVisitor<AttributeInference>::visit_call(node);
+	}
+
+	void AttributeInference::visit_annotation(AnnotationNode* node) {
+		if (node->annotation_type() != "not_null") {
+			lower(Purity::Impure);
+		}
+		AstVisitor<AttributeInference>::visit_annotation(node);
+	}
+
+	void AttributeInference::visit_variable(VariableNode* node) {
+		// a.b reads a field
+		if (node->path() != nullptr && node->path()->nodes.size() > 1) {
+			lower(Purity::Pure);
+		}
+	}
+
+	void AttributeInference::visit_cblock(InlineCBlock* node) {
+		m_Current->inline_c = true;
+		lower(Purity::Impure);
+		for (auto& tok : node->tokens) {
+			if (tok.type == TokenType::Identifier) {
+				m_Unseen.insert(Name{ tok.literal });
+			}
+		}
+	}
+
+	size_t InferAttributes(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		AttributeInference inference(ctx);
+		EscapeAnalysis escape(ctx);
+		for (auto& funcDef : module->body->functions) {
+			if (funcDef->templateParams == nullptr && funcDef->body != nullptr) {
+				inference.add_function(funcDef);
+				escape.add_function(funcDef);
+			}
+		}
+		inference.collect();
+
+		size_t found = inference.infer_purity();
+		found += inference.infer_noreturn();
+		found += inference.infer_noalias(escape);
+		found += inference.hint_branches();
+		return found;
+	}
+}
@@ -0,0 +1,491 @@
+#include "core/bounds_check.h"
+#include "core/inliner.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace tau {
+
+	// largest value of an integer type, 0 for everything else
+	static i64 max_of(_type_id type) {
+		switch (type) {
+		case TYPE_U8: return std::numeric_limits<u8>::max();
+		case TYPE_U16: return std::numeric_limits<u16>::max();
+		case TYPE_U32: return std::numeric_limits<u32>::max();
+		case TYPE_I8: return std::numeric_limits<i8>::max();
+		case TYPE_I16: return std::numeric_limits<i16>::max();
+		case TYPE_I32: return std::numeric_limits<i32>::max();
+		case TYPE_U64:
+		case TYPE_I64:
+			return std::numeric_limits<i64>::max();
+		default:
+			return 0;
+		}
+	}
+
+	static inline bool is_unsigned(_type_id type) {
+		return type == TYPE_U8 || type == TYPE_U16 || type == TYPE_U32 || type == TYPE_U64;
+	}
+
+	// literals are only compared when non-negative, larger u64 values come out negative
+	static bool literal(AstNode* node, i64& value) {
+		StaticIntegerNode* lit = node_cast<StaticIntegerNode>(node);
+		if (lit == nullptr || lit->value() < 0) {
+			return false;
+		}
+		value = lit->value();
+		return true;
+	}
+
+	// an integer local or a non-negative integer literal
+	static bool is_term(AstNode* node) {
+		i64 value;
+		Name name;
+		if (literal(node, value)) {
+			return true;
+		}
+		return local_name(node, name) && max_of(static_cast<VariableNode*>(node)->resolved_type) != 0;
+	}
+
+	static bool same_term(AstNode* a, AstNode* b) {
+		Name x, y;
+		if (local_name(a, x) && local_name(b, y)) {
+			return x == y;
+		}
+		i64 i, j;
+		return literal(a, i) && literal(b, j) && i == j;
+	}
+
+	// condition as a < b (strict) or a <= b, or its negation when it does not hold
+	static bool comparison(AstNode* condition, bool holds, AstNode*& a, AstNode*& b, bool& strict) {
+		BinaryOperator* op = node_cast<BinaryOperator>(condition);
+		if (op == nullptr || op->resolved_operator == nullptr || op->resolved_operator->overload_function != nullptr) {
+			return false;
+		}
+
+		switch (op->m_Operator) {
+		case OperatorID::LessThan: a = op->m_Lhs; b = op->m_Rhs; strict = true; break;
+		case OperatorID::LessEquals: a = op->m_Lhs; b = op->m_Rhs; strict = false; break;
+		case OperatorID::GreaterThan: a = op->m_Rhs; b = op->m_Lhs; strict = true; break;
+		case OperatorID::GreaterEquals: a = op->m_Rhs; b = op->m_Lhs; strict = false; break;
+		default:
+			return false;
+		}
+
+		// !(a < b) is b <= a, !(a <= b) is b < a
+		if (!holds) {
+			std::swap(a, b);
+			strict = !strict;
+		}
+		return true;
+	}
+
+	// node reads the same values wherever it is evaluated in a region that writes none of its names
+	static bool is_invariant(AstNode* node, const WriteCollector& writes, Name induction) {
+		switch (node->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+			return true;
+		case NodeType::Variable: {
+			Name name;
+			return local_name(node, name) && name != induction && writes.writes(name) == 0 && writes.escaped.find(name) == writes.escaped.end();
+		}
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			return op->resolved_operator != nullptr && op->resolved_operator->overload_function == nullptr &&
+				!is_assignment(op->m_Operator) && op->m_Operator != OperatorID::ArrayAccess && op->m_Operator != OperatorID::Dot &&
+				is_invariant(op->m_Lhs, writes, induction) && is_invariant(op->m_Rhs, writes, induction);
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			return op->resolved_operator != nullptr && op->resolved_operator->overload_function == nullptr &&
+				(op->m_Operator == OperatorID::Not || op->m_Operator == OperatorID::Negative || op->m_Operator == OperatorID::BinaryNot) &&
+				is_invariant(op->m_Child, writes, induction);
+		}
+		default:
+			return false;
+		}
+	}
+
+	static AnnotationNode* pre_assert(AstNode* statement) {
+		AnnotationNode* annotation = node_cast<AnnotationNode>(statement);
+		if (annotation == nullptr || annotation->annotation_type() != "pre_assert" || annotation->params().size() != 1) {
+			return nullptr;
+		}
+		return annotation;
+	}
+
+	void BoundsCheckEliminator::add_function(FunctionDefinitionNode* func) {
+		m_Functions[func->functionName] = func;
+	}
+
+	AstNode* BoundsCheckEliminator::term(AstNode* node, const Binding* binding) const {
+		if (binding == nullptr) {
+			return is_term(node) ? node : nullptr;
+		}
+
+		// inside a callee's precondition every name is a parameter, it stands for the argument
+		Name name;
+		i64 value;
+		if (literal(node, value)) {
+			return node;
+		}
+		if (!local_name(node, name) || binding->callee->params == nullptr) {
+			return nullptr;
+		}
+
+		auto& params = binding->callee->params->params;
+		for (size_t i = 0; i < params.size() && i < binding->args->size(); i++) {
+			if (params[i].name != name) {
+				continue;
+			}
+
+			// the argument is converted to the parameter type, only values that survive it unchanged count
+			AstNode* arg = (*binding->args)[i];
+			if (literal(arg, value)) {
+				return value <= max_of(params[i].type) ? arg : nullptr;
+			}
+			return is_term(arg) && as_typed(arg)->resolved_type == params[i].type ? arg : nullptr;
+		}
+		return nullptr;
+	}
+
+	bool BoundsCheckEliminator::known_less(AstNode* a, AstNode* b, bool strict) const {
+		i64 x, y;
+		if (literal(a, x) && literal(b, y)) {
+			return strict ? x < y : x <= y;
+		}
+		if (!strict && literal(a, x) && x == 0 && is_unsigned(as_typed(b)->resolved_type)) {
+			return true;
+		}
+
+		for (auto& fact : m_Facts) {
+			bool enough = fact.strict || !strict;
+			if (same_term(fact.lhs, a) && same_term(fact.rhs, b) && enough) {
+				return true;
+			}
+			// a <= k < b or a < k <= b, with a and k literals
+			if (same_term(fact.rhs, b) && literal(a, x) && literal(fact.lhs, y) && (x < y || (x == y && enough))) {
+				return true;
+			}
+			if (same_term(fact.lhs, a) && literal(b, y) && literal(fact.rhs, x) && (x < y || (x == y && enough))) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool BoundsCheckEliminator::prove_less(AstNode* a, AstNode* b, bool strict) const {
+		if (known_less(a, b, strict)) {
+			return true;
+		}
+
+		// a < m <= b or a <= m < b
+		for (auto& fact : m_Facts) {
+			if (same_term(fact.lhs, a) && known_less(fact.rhs, b, strict && !fact.strict)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool BoundsCheckEliminator::prove(AstNode* condition, const Binding* binding) const {
+		BinaryOperator* op = node_cast<BinaryOperator>(condition);
+		if (op != nullptr && op->m_Operator == OperatorID::LogicAnd) {
+			return prove(op->m_Lhs, binding) && prove(op->m_Rhs, binding);
+		}
+
+		AstNode* a;
+		AstNode* b;
+		bool strict;
+		if (!comparison(condition, true, a, b, strict)) {
+			return false;
+		}
+
+		a = term(a, binding);
+		b = term(b, binding);
+		return a != nullptr && b != nullptr && prove_less(a, b, strict);
+	}
+
+	bool BoundsCheckEliminator::stable(AstNode* node, const WriteCollector& region) const {
+		Name name;
+		if (!local_name(node, name)) {
+			return true;
+		}
+		return region.writes(name) == 0 && m_FunctionWrites.escaped.find(name) == m_FunctionWrites.escaped.end();
+	}
+
+	void BoundsCheckEliminator::assume(AstNode* condition, bool holds, const WriteCollector& region) {
+		BinaryOperator* op = node_cast<BinaryOperator>(condition);
+		if (holds && op != nullptr && op->m_Operator == OperatorID::LogicAnd) {
+			assume(op->m_Lhs, holds, region);
+			assume(op->m_Rhs, holds, region);
+			return;
+		}
+
+		AstNode* a;
+		AstNode* b;
+		bool strict;
+		if (comparison(condition, holds, a, b, strict) && is_term(a) && is_term(b) && stable(a, region) && stable(b, region)) {
+			m_Facts.push_back(Fact{ a, b, strict });
+		}
+	}
+
+	void BoundsCheckEliminator::forget(Name name) {
+		auto mentions = [&](const Fact& fact) {
+			Name x;
+			return (local_name(fact.lhs, x) && x == name) || (local_name(fact.rhs, x) && x == name);
+		};
+		m_Facts.erase(std::remove_if(m_Facts.begin(), m_Facts.end(), mentions), m_Facts.end());
+	}
+
+	size_t BoundsCheckEliminator::hoist(ForNode* loop, std::vector<AstNode*>& statements, size_t index) {
+		if (loop->body == nullptr || loop->body->statements.empty() || pre_assert(loop->body->statements.front()) == nullptr) {
+			return 0;
+		}
+
+		// the header has to run nothing but the declaration and a comparison of terms for the entry condition to be known
+		VariableDeclNode* decl = node_cast<VariableDeclNode>(loop->init);
+		if (loop->init != nullptr && (decl == nullptr || decl->default_value == nullptr || !is_term(decl->default_value))) {
+			return 0;
+		}
+
+		Name induction;
+		if (decl != nullptr) {
+			induction = decl->var_name;
+		}
+
+		AstNode* a = nullptr;
+		AstNode* b = nullptr;
+		bool strict;
+		if (loop->condition != nullptr && (!comparison(loop->condition, true, a, b, strict) || !is_term(a) || !is_term(b))) {
+			return 0;
+		}
+
+		WriteCollector writes;
+		writes.visit(loop->condition);
+		writes.visit(loop->step);
+		writes.visit(loop->body);
+		writes.escaped.insert(m_FunctionWrites.escaped.begin(), m_FunctionWrites.escaped.end());
+
+		std::vector<AstNode*> hoisted;
+		auto& body = loop->body->statements;
+		while (!body.empty() && pre_assert(body.front()) != nullptr && is_invariant(pre_assert(body.front())->params()[0], writes, induction)) {
+			hoisted.push_back(body.front());
+			body.erase(body.begin());
+		}
+		if (hoisted.empty()) {
+			return 0;
+		}
+		m_Eliminated += hoisted.size();
+
+		// the checks ran on entry to the first pass, so only where the loop is entered at all
+		BinaryOperator* guard = nullptr;
+		if (loop->condition != nullptr) {
+			BinaryOperator* condition = static_cast<BinaryOperator*>(loop->condition);
+			auto entry = [&](AstNode* side) {
+				Name name;
+				return copy_expression(decl != nullptr && local_name(side, name) && name == induction ? decl->default_value : side);
+			};
+
+			guard = new BinaryOperator(condition->m_Operator, entry(condition->m_Lhs), entry(condition->m_Rhs));
+			guard->resolved_operator = condition->resolved_operator;
+			guard->resolved_type = condition->resolved_type;
+
+			if (prove(guard)) {
+				delete guard;
+				guard = nullptr;
+			}
+		}
+
+		if (guard == nullptr) {
+			statements.insert(statements.begin() + index, hoisted.begin(), hoisted.end());
+			return hoisted.size();
+		}
+
+		IfNode* entered = new IfNode();
+		entered->condition = guard;
+		entered->body = new StatementBlockNode();
+		entered->body->statements = std::move(hoisted);
+		statements.insert(statements.begin() + index, entered);
+		return 1;
+	}
+
+	void BoundsCheckEliminator::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr || node->body == nullptr) {
+			return;
+		}
+
+		m_FunctionWrites = WriteCollector{};
+		m_FunctionWrites.visit(node->body);
+
+		m_Facts.clear();
+		m_Saved.clear();
+
+		// the __unchecked body only runs once the preconditions passed
+		for (auto& condition : node->preconditions) {
+			assume(condition, true, m_FunctionWrites);
+		}
+
+		visit_block(node->body);
+	}
+
+	void BoundsCheckEliminator::visit_block(StatementBlockNode* node) {
+		if (node == nullptr) {
+			return;
+		}
+
+		m_Saved.push_back(m_Facts);
+
+		auto& statements = node->statements;
+		for (size_t i = 0; i < statements.size();) {
+			AstNode* statement = statements[i];
+
+			AnnotationNode* check = pre_assert(statement);
+			if (check != nullptr) {
+				AstNode* condition = check->params()[0];
+				if (prove(condition)) {
+					delete statement;
+					statements.erase(statements.begin() + i);
+					m_Eliminated++;
+					continue;
+				}
+
+				// past the check the condition holds for as long as nothing it reads changes
+				visit(condition);
+				assume(condition, true, m_FunctionWrites);
+				i++;
+				continue;
+			}
+
+			// the hoisted checks now sit at i, visit them before the loop
+			if (statement->kind() == NodeType::For && hoist(static_cast<ForNode*>(statement), statements, i) != 0) {
+				continue;
+			}
+
+			visit(statement);
+			i++;
+		}
+
+		m_Facts = std::move(m_Saved.back());
+		m_Saved.pop_back();
+	}
+
+	void BoundsCheckEliminator::visit_if(IfNode* node) {
+		visit(node->condition);
+
+		WriteCollector taken;
+		taken.visit(node->body);
+
+		m_Saved.push_back(m_Facts);
+		assume(node->condition, true, taken);
+		visit_block(node->body);
+		m_Facts = m_Saved.back();
+
+		if (node->elseBranch != nullptr) {
+			WriteCollector other;
+			other.visit(node->elseBranch);
+
+			assume(node->condition, false, other);
+			visit(node->elseBranch);
+		}
+
+		m_Facts = std::move(m_Saved.back());
+		m_Saved.pop_back();
+	}
+
+	void BoundsCheckEliminator::visit_for(ForNode* node) {
+		m_Saved.push_back(m_Facts);
+		visit(node->init);
+		visit(node->condition);
+
+		WriteCollector body;
+		body.visit(node->body);
+
+		WriteCollector loop;
+		loop.visit(node->condition);
+		loop.visit(node->step);
+		loop.visit(node->body);
+
+		// the condition was just checked and the body does not change what it compares
+		assume(node->condition, true, body);
+
+		// for (T i = a; i < n; i++) counts up from a and stops before i could wrap
+		VariableDeclNode* decl = node_cast<VariableDeclNode>(node->init);
+		UnaryOperator* step = node_cast<UnaryOperator>(node->step);
+		AstNode* a;
+		AstNode* b;
+		bool strict;
+		Name i, counted;
+		i64 start, bound;
+		if (decl != nullptr && literal(decl->default_value, start) && step != nullptr &&
+			(step->m_Operator == OperatorID::PostInc || step->m_Operator == OperatorID::PreInc) &&
+			local_name(step->m_Child, counted) && counted == decl->var_name &&
+			comparison(node->condition, true, a, b, strict) && strict && local_name(a, i) && i == decl->var_name &&
+			loop.writes(i) == 1 && stable(a, body) && is_term(b) && stable(b, loop) &&
+			(literal(b, bound) ? bound <= max_of(decl->type) : as_typed(b)->resolved_type == decl->type)) {
+			m_Facts.push_back(Fact{ decl->default_value, a, false });
+		}
+
+		visit_block(node->body);
+		visit(node->step);
+
+		m_Facts = std::move(m_Saved.back());
+		m_Saved.pop_back();
+	}
+
+	void BoundsCheckEliminator::visit_variable_decl(VariableDeclNode* node) {
+		AstVisitor<BoundsCheckEliminator>::visit_variable_decl(node);
+		// the facts were about the name this declaration shadows
+		forget(node->var_name);
+	}
+
+	void BoundsCheckEliminator::visit_call(FunctionCallNode* node) {
+		AstVisitor<BoundsCheckEliminator>::visit_call(node);
+
+		if (node->in_bounds_proven || node->function_name == nullptr || node->function_name->nodes.size() != 1) {
+			return;
+		}
+
+		auto f = m_Functions.find(node->function_name->nodes[0].bit);
+		if (f == m_Functions.end()) {
+			return;
+		}
+
+		FunctionDefinitionNode* callee = f->second;
+		std::vector<AstNode*> none;
+		Binding binding{ callee, node->arguments != nullptr ? &node->arguments->args : &none };
+
+		for (auto& condition : callee->preconditions) {
+			if (!prove(condition, &binding)) {
+				return;
+			}
+		}
+
+		node->in_bounds_proven = true;
+		node->unchecked = callee->passes_entry_checks(node);
+		m_Eliminated++;
+	}
+
+	size_t EliminateBoundsChecks(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		BoundsCheckEliminator eliminator(ctx);
+
+		for (auto& funcDef : module->body->functions) {
+			if (funcDef->templateParams == nullptr && !funcDef->preconditions.empty()) {
+				eliminator.add_function(funcDef);
+			}
+		}
+
+		for (auto& funcDef : module->body->functions) {
+			eliminator.visit(funcDef);
+		}
+
+		return eliminator.eliminated_count();
+	}
+}
@@ -0,0 +1,351 @@
+#include "core/const_eval.h"
+
+#include <cstring>
+
+namespace tau {
+
+	// arithmetic operator a compound assignment applies before storing
+	static OperatorID compound_operator(OperatorID op) {
+		switch (op) {
+		case OperatorID::AddAssign: return OperatorID::Add;
+		case OperatorID::SubAssign: return OperatorID::Sub;
+		case OperatorID::MulAssign: return OperatorID::Mul;
+		case OperatorID::DivAssign: return OperatorID::Div;
+		case OperatorID::ModAssign: return OperatorID::Mod;
+		case OperatorID::AndAssign: return OperatorID::BinaryAnd;
+		case OperatorID::OrAssign: return OperatorID::BinaryOr;
+		case OperatorID::XorAssign: return OperatorID::BinaryXor;
+		case OperatorID::LeftShiftAssign: return OperatorID::LeftShift;
+		case OperatorID::RightShiftAssign: return OperatorID::RightShift;
+		default: return OperatorID::Assign;
+		}
+	}
+
+	static inline bool is_builtin(const AllowedBinaryOperator* op) {
+		return op != nullptr && op->overload_function == nullptr;
+	}
+
+	static inline bool is_builtin(const AllowedUnaryOperator* op) {
+		return op != nullptr && op->overload_function == nullptr;
+	}
+
+	void ConstEvaluator::add_function(FunctionDefinitionNode* func) {
+		if (func->templateParams != nullptr || func->body == nullptr) {
+			return;
+		}
+		m_Functions[func->functionName] = func;
+	}
+
+	FunctionDefinitionNode* ConstEvaluator::find_function(FunctionCallNode* call) const {
+		PathNode* path = call->function_name;
+		if (path == nullptr || path->nodes.size() != 1 || path->nodes[0].args != nullptr) {
+			return nullptr;
+		}
+
+		auto f = m_Functions.find(path->nodes[0].bit);
+		if (f == m_Functions.end()) {
+			return nullptr;
+		}
+		return f->second;
+	}
+
+	bool ConstEvaluator::evaluate(FunctionDefinitionNode* func, const std::vector<Constant>& args, Constant& out) {
+		m_Steps = 0;
+		m_Depth = 0;
+		m_Locals.clear();
+		m_Frame = 0;
+		m_Current = nullptr;
+
+		return invoke(func, args, out);
+	}
+
+	bool ConstEvaluator::invoke(FunctionDefinitionNode* func, const std::vector<Constant>& args, Constant& out) {
+		if (func->returnType == TYPE_VOID || m_Depth >= s_MaxDepth) {
+			return false;
+		}
+
+		size_t param_count = func->params != nullptr ? func->params->params.size() : 0;
+		if (args.size() != param_count) {
+			return false;
+		}
+
+		// arguments are converted to the parameter types exactly like the C call would
+		std::vector<Constant> values(param_count);
+		CallKey key{ func, {} };
+		for (size_t i = 0; i < param_count; i++) {
+			if (!convert_constant(args[i], func->params->params[i].type, values[i])) {
+				return false;
+			}
+
+			u64 real;
+			std::memcpy(&real, &values[i].real, sizeof(real));
+			key.second.push_back(((u64)values[i].type << 1) | (values[i].is_bool ? 1 : 0));
+			key.second.push_back(values[i].bits);
+			key.second.push_back(real);
+		}
+
+		auto cached = m_Cache.find(key);
+		if (cached != m_Cache.end()) {
+			out = cached->second.second;
+			return cached->second.first;
+		}
+
+		size_t saved_frame = m_Frame;
+		size_t saved_size = m_Locals.size();
+		FunctionDefinitionNode* saved_current = m_Current;
+
+		m_Frame = m_Locals.size();
+		m_Current = func;
+		m_Depth++;
+
+		for (size_t i = 0; i < param_count; i++) {
+			auto& param = func->params->params[i];
+			m_Locals.push_back(Local{ param.name, param.type, true, values[i] });
+		}
+
+		// falling off the end of a function returning a value is not a result
+		bool ok = exec_block(func->body) == Flow::Return;
+		if (ok) {
+			out = m_Result;
+		}
+
+		m_Depth--;
+		m_Current = saved_current;
+		m_Locals.resize(saved_size);
+		m_Frame = saved_frame;
+
+		// a budget miss says nothing about the call itself, it may fit on its own later
+		if (ok || m_Steps <= s_MaxSteps) {
+			m_Cache[key] = { ok, ok ? out : Constant{} };
+		}
+		return ok;
+	}
+
+	ConstEvaluator::Flow ConstEvaluator::exec_block(StatementBlockNode* block) {
+		if (block == nullptr) {
+			return Flow::Next;
+		}
+
+		size_t saved_size = m_Locals.size();
+		for (auto& statement : block->statements) {
+			Flow flow = exec(statement);
+			if (flow != Flow::Next) {
+				m_Locals.resize(saved_size);
+				return flow;
+			}
+		}
+		m_Locals.resize(saved_size);
+		return Flow::Next;
+	}
+
+	ConstEvaluator::Flow ConstEvaluator::exec(AstNode* statement) {
+		if (!step()) {
+			return Flow::Abort;
+		}
+
+		switch (statement->kind()) {
+		case NodeType::StatementBlock:
+			return exec_block(static_cast<StatementBlockNode*>(statement));
+		case NodeType::VariableDeclaration: {
+			VariableDeclNode* decl = static_cast<VariableDeclNode*>(statement);
+			Local local{ decl->var_name, decl->type, false, {} };
+
+			if (decl->default_value != nullptr) {
+				Constant value;
+				if (!eval(decl->default_value, value) || !convert_constant(value, decl->type, local.value)) {
+					return Flow::Abort;
+				}
+				local.initialized = true;
+			}
+
+			m_Locals.push_back(local);
+			return Flow::Next;
+		}
+		case NodeType::If: {
+			IfNode* node = static_cast<IfNode*>(statement);
+			Constant condition;
+			if (!eval(node->condition, condition)) {
+				return Flow::Abort;
+			}
+
+			if (constant_truthy(condition)) {
+				return exec_block(node->body);
+			}
+			if (node->elseBranch == nullptr) {
+				return Flow::Next;
+			}
+			if (node->elseBranch->ifBranch != nullptr) {
+				return exec(node->elseBranch->ifBranch);
+			}
+			return exec_block(node->elseBranch->body);
+		}
+		case NodeType::Return: {
+			ReturnNode* ret = static_cast<ReturnNode*>(statement);
+			Constant value;
+			if (ret->returnValue == nullptr || !eval(ret->returnValue, value) ||
+				!convert_constant(value, m_Current->returnType, m_Result)) {
+				return Flow::Abort;
+			}
+			return Flow::Return;
+		}
+		case NodeType::BinaryOperator:
+		case NodeType::UnaryOperator:
+		case NodeType::FunctionCall: {
+			Constant discarded;
+			return eval(statement, discarded) ? Flow::Next : Flow::Abort;
+		}
+		default:
+			return Flow::Abort;
+		}
+	}
+
+	bool ConstEvaluator::eval(AstNode* expr, Constant& out) {
+		if (!step()) {
+			return false;
+		}
+
+		switch (expr->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+			return constant_of(expr, out);
+		case NodeType::Variable: {
+			Local* local = find_local(expr);
+			if (local == nullptr || !local->initialized) {
+				return false;
+			}
+			out = local->value;
+			return true;
+		}
+		case NodeType::BinaryOperator:
+			return eval_binary(static_cast<BinaryOperator*>(expr), out);
+		case NodeType::UnaryOperator:
+			return eval_unary(static_cast<UnaryOperator*>(expr), out);
+		case NodeType::FunctionCall:
+			return eval_call(static_cast<FunctionCallNode*>(expr), out);
+		default:
+			return false;
+		}
+	}
+
+	bool ConstEvaluator::eval_binary(BinaryOperator* op, Constant& out) {
+		if (is_assignment(op->m_Operator)) {
+			// the right side may call functions that grow m_Locals, look the target up afterwards
+			Constant rhs;
+			if (!eval(op->m_Rhs, rhs)) {
+				return false;
+			}
+
+			Local* local = find_local(op->m_Lhs);
+			if (local == nullptr) {
+				return false;
+			}
+
+			Constant value = rhs;
+			OperatorID arith = compound_operator(op->m_Operator);
+			if (arith != OperatorID::Assign && (!local->initialized || !fold_binary(arith, local->value, rhs, value))) {
+				return false;
+			}
+			return store(local, value, out);
+		}
+
+		if (!is_builtin(op->resolved_operator)) {
+			return false;
+		}
+
+		Constant lhs, rhs;
+		if (!eval(op->m_Lhs, lhs)) {
+			return false;
+		}
+
+		// && and || only evaluate their right side when C would
+		if (op->m_Operator == OperatorID::LogicAnd && !constant_truthy(lhs)) {
+			return fold_binary(op->m_Operator, lhs, lhs, out);
+		}
+		if (op->m_Operator == OperatorID::LogicOr && constant_truthy(lhs)) {
+			return fold_binary(op->m_Operator, lhs, lhs, out);
+		}
+
+		return eval(op->m_Rhs, rhs) && fold_binary(op->m_Operator, lhs, rhs, out);
+	}
+
+	bool ConstEvaluator::eval_unary(UnaryOperator* op, Constant& out) {
+		switch (op->m_Operator) {
+		case OperatorID::PreInc:
+		case OperatorID::PreDec:
+		case OperatorID::PostInc:
+		case OperatorID::PostDec: {
+			Local* local = find_local(op->m_Child);
+			if (local == nullptr || !local->initialized) {
+				return false;
+			}
+
+			Constant one;
+			one.type = TYPE_I32;
+			one.bits = 1;
+
+			bool increment = op->m_Operator == OperatorID::PreInc || op->m_Operator == OperatorID::PostInc;
+			Constant old = local->value, value, stored;
+			if (!fold_binary(increment ? OperatorID::Add : OperatorID::Sub, old, one, value) || !store(local, value, stored)) {
+				return false;
+			}
+
+			bool prefix = op->m_Operator == OperatorID::PreInc || op->m_Operator == OperatorID::PreDec;
+			out = prefix ? stored : old;
+			return true;
+		}
+		case OperatorID::Reference:
+		case OperatorID::Dereference:
+			return false;
+		default:
+			break;
+		}
+
+		Constant value;
+		return is_builtin(op->resolved_operator) && eval(op->m_Child, value) && fold_unary(op->m_Operator, value, out);
+	}
+
+	bool ConstEvaluator::eval_call(FunctionCallNode* call, Constant& out) {
+		FunctionDefinitionNode* func = find_function(call);
+		if (func == nullptr) {
+			return false;
+		}
+
+		std::vector<Constant> args;
+		if (call->arguments != nullptr) {
+			args.resize(call->arguments->args.size());
+			for (size_t i = 0; i < args.size(); i++) {
+				if (!eval(call->arguments->args[i], args[i])) {
+					return false;
+				}
+			}
+		}
+
+		return invoke(func, args, out);
+	}
+
+	ConstEvaluator::Local* ConstEvaluator::find_local(AstNode* variable) {
+		VariableNode* var = node_cast<VariableNode>(variable);
+		if (var == nullptr || var->path() == nullptr || var->path()->nodes.size() != 1) {
+			return nullptr;
+		}
+
+		Name name = var->path()->nodes[0].bit;
+		for (size_t i = m_Locals.size(); i > m_Frame; i--) {
+			if (m_Locals[i - 1].name == name) {
+				return &m_Locals[i - 1];
+			}
+		}
+		return nullptr;
+	}
+
+	bool ConstEvaluator::store(Local* local, const Constant& value, Constant& out) {
+		if (!convert_constant(value, local->type, local->value)) {
+			return false;
+		}
+		local->initialized = true;
+		out = local->value;
+		return true;
+	}
+}
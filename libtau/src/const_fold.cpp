@@ -0,0 +1,653 @@
+#include "core/const_fold.h"
+#include "core/const_eval.h"
+
+#include <cmath>
+#include <limits>
+
+namespace tau {
+
+	static constexpr i64 s_I32Min = std::numeric_limits<i32>::min();
+	static constexpr i64 s_I32Max = std::numeric_limits<i32>::max();
+	static constexpr i64 s_I64Min = std::numeric_limits<i64>::min();
+	static constexpr i64 s_I64Max = std::numeric_limits<i64>::max();
+
+	static inline bool is_float(_type_id type) {
+		return type == TYPE_F32 || type == TYPE_F64;
+	}
+
+	static inline bool is_signed(_type_id type) {
+		return type == TYPE_I32 || type == TYPE_I64;
+	}
+
+	static inline bool is_wide(_type_id type) {
+		return type == TYPE_I64 || type == TYPE_U64;
+	}
+
+	// reinterprets bits as a value of the given (promoted) integer type
+	static inline u64 wrap(u64 bits, _type_id type) {
+		switch (type) {
+		case TYPE_I32: return (u64)(i64)(i32)(u32)bits;
+		case TYPE_U32: return bits & 0xFFFFFFFFull;
+		default: return bits;
+		}
+	}
+
+	static inline Constant make_int(_type_id type, u64 bits) {
+		Constant c;
+		c.type = type;
+		c.bits = wrap(bits, type);
+		return c;
+	}
+
+	static inline Constant make_bool(bool value) {
+		Constant c;
+		c.type = TYPE_I32;
+		c.bits = value ? 1 : 0;
+		c.is_bool = true;
+		return c;
+	}
+
+	static inline Constant make_float(_type_id type, double value) {
+		Constant c;
+		c.type = type;
+		c.real = type == TYPE_F32 ? (double)(float)value : value;
+		return c;
+	}
+
+	static inline double as_real(const Constant& c) {
+		if (is_float(c.type)) {
+			return c.real;
+		}
+		return is_signed(c.type) ? (double)(i64)c.bits : (double)c.bits;
+	}
+
+	bool constant_truthy(const Constant& c) {
+		return is_float(c.type) ? c.real != 0.0 : c.bits != 0;
+	}
+
+	// width, in bits, of a Tau integer type, 0 for everything else
+	static u32 integer_width(_type_id type) {
+		switch (type) {
+		case TYPE_U8: case TYPE_I8: case TYPE_CHAR: return 8;
+		case TYPE_U16: case TYPE_I16: return 16;
+		case TYPE_U32: case TYPE_I32: return 32;
+		case TYPE_U64: case TYPE_I64: return 64;
+		default: return 0;
+		}
+	}
+
+	static bool integer_signed(_type_id type) {
+		return type == TYPE_I8 || type == TYPE_I16 || type == TYPE_I32 || type == TYPE_I64 || type == TYPE_CHAR;
+	}
+
+	bool constant_of(AstNode* node, Constant& out) {
+		switch (node->kind()) {
+		case NodeType::ImmediateInt: {
+			StaticIntegerNode* lit = static_cast<StaticIntegerNode*>(node);
+			_type_id type = lit->resolved_type;
+			if (type != TYPE_I32 && type != TYPE_U32 && type != TYPE_I64 && type != TYPE_U64) {
+				// a source literal is an int when it fits and a long long otherwise
+				type = (lit->value() >= s_I32Min && lit->value() <= s_I32Max) ? TYPE_I32 : TYPE_I64;
+			}
+			out = make_int(type, (u64)lit->value());
+			return true;
+		}
+		case NodeType::ImmediateFloat: {
+			StaticFloatNode* lit = static_cast<StaticFloatNode*>(node);
+			out = make_float(lit->resolved_type == TYPE_F32 ? TYPE_F32 : TYPE_F64, lit->value());
+			return true;
+		}
+		case NodeType::ImmediateBool:
+			out = make_bool(static_cast<StaticBoolNode*>(node)->value());
+			return true;
+		case NodeType::ImmediateChar:
+			// character constants are ints in C
+			out = make_int(TYPE_I32, (u64)(i64)(signed char)static_cast<StaticCharNode*>(node)->value());
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool convert_constant(const Constant& value, _type_id type, Constant& out) {
+		if (type == TYPE_BOOL) {
+			out = make_bool(constant_truthy(value));
+			return true;
+		}
+
+		if (type == TYPE_F32 || type == TYPE_F64) {
+			out = make_float(type, as_real(value));
+			return std::isfinite(out.real);
+		}
+
+		u32 width = integer_width(type);
+		if (width == 0) {
+			return false;
+		}
+		bool sign = integer_signed(type);
+
+		u64 bits;
+		if (is_float(value.type)) {
+			// out of range float to integer conversions are undefined
+			double limit = std::ldexp(1.0, sign ? width - 1 : width);
+			double truncated = std::trunc(value.real);
+			if (sign ? (truncated < -limit || truncated >= limit) : (truncated <= -1.0 || truncated >= limit)) {
+				return false;
+			}
+			bits = sign ? (u64)(i64)truncated : (u64)truncated;
+		}
+		else {
+			bits = value.bits;
+		}
+
+		if (width < 64) {
+			u64 mask = (1ull << width) - 1;
+			bits &= mask;
+			if (sign && (bits >> (width - 1)) != 0) {
+				bits |= ~mask;
+			}
+		}
+
+		if (width < 32) {
+			out = make_int(TYPE_I32, bits);
+		}
+		else if (width == 32) {
+			out = make_int(sign ? TYPE_I32 : TYPE_U32, bits);
+		}
+		else {
+			out = make_int(sign ? TYPE_I64 : TYPE_U64, bits);
+		}
+		return true;
+	}
+
+	// usual arithmetic conversions on two promoted integer types
+	static _type_id common_integer(_type_id a, _type_id b) {
+		if (is_wide(a) || is_wide(b)) {
+			return (a == TYPE_U64 || b == TYPE_U64) ? TYPE_U64 : TYPE_I64;
+		}
+		return (a == TYPE_U32 || b == TYPE_U32) ? TYPE_U32 : TYPE_I32;
+	}
+
+	static bool signed_arith(OperatorID op, i64 a, i64 b, _type_id type, i64& r) {
+		i64 lo = type == TYPE_I32 ? s_I32Min : s_I64Min;
+		i64 hi = type == TYPE_I32 ? s_I32Max : s_I64Max;
+
+		switch (op) {
+		case OperatorID::Add:
+			if ((b > 0 && a > hi - b) || (b < 0 && a < lo - b)) return false;
+			r = a + b;
+			return true;
+		case OperatorID::Sub:
+			if ((b < 0 && a > hi + b) || (b > 0 && a < lo + b)) return false;
+			r = a - b;
+			return true;
+		case OperatorID::Mul:
+			if (a == 0 || b == 0) {
+				r = 0;
+				return true;
+			}
+			if ((a == -1 && b == lo) || (b == -1 && a == lo)) return false;
+			r = (i64)((u64)a * (u64)b);
+			if (r / b != a || r < lo || r > hi) return false;
+			return true;
+		case OperatorID::Div:
+		case OperatorID::Mod:
+			if (b == 0 || (a == lo && b == -1)) return false;
+			r = op == OperatorID::Div ? a / b : a % b;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool fold_integer(OperatorID op, const Constant& lhs, const Constant& rhs, Constant& out) {
+		// shifts take the type of the promoted left operand
+		if (op == OperatorID::LeftShift || op == OperatorID::RightShift) {
+			u32 width = is_wide(lhs.type) ? 64 : 32;
+			i64 amount = is_signed(rhs.type) ? (i64)rhs.bits : (rhs.bits > 64 ? 64 : (i64)rhs.bits);
+			if (amount < 0 || amount >= width) {
+				return false;
+			}
+
+			if (is_signed(lhs.type)) {
+				i64 value = (i64)lhs.bits;
+				if (value < 0) {
+					return false;
+				}
+				if (op == OperatorID::RightShift) {
+					out = make_int(lhs.type, (u64)(value >> amount));
+					return true;
+				}
+				i64 hi = lhs.type == TYPE_I32 ? s_I32Max : s_I64Max;
+				if (value > (hi >> amount)) {
+					return false;
+				}
+				out = make_int(lhs.type, (u64)(value << amount));
+				return true;
+			}
+
+			out = make_int(lhs.type, op == OperatorID::LeftShift ? lhs.bits << amount : lhs.bits >> amount);
+			return true;
+		}
+
+		_type_id type = common_integer(lhs.type, rhs.type);
+		u64 a = wrap(lhs.bits, type);
+		u64 b = wrap(rhs.bits, type);
+		bool sign = is_signed(type);
+
+		switch (op) {
+		case OperatorID::Add:
+		case OperatorID::Sub:
+		case OperatorID::Mul:
+		case OperatorID::Div:
+		case OperatorID::Mod: {
+			if (sign) {
+				i64 r;
+				if (!signed_arith(op, (i64)a, (i64)b, type, r)) {
+					return false;
+				}
+				out = make_int(type, (u64)r);
+				return true;
+			}
+			if ((op == OperatorID::Div || op == OperatorID::Mod) && b == 0) {
+				return false;
+			}
+			u64 r = 0;
+			switch (op) {
+			case OperatorID::Add: r = a + b; break;
+			case OperatorID::Sub: r = a - b; break;
+			case OperatorID::Mul: r = a * b; break;
+			case OperatorID::Div: r = a / b; break;
+			default: r = a % b; break;
+			}
+			out = make_int(type, r);
+			return true;
+		}
+		case OperatorID::BinaryAnd: out = make_int(type, a & b); return true;
+		case OperatorID::BinaryOr: out = make_int(type, a | b); return true;
+		case OperatorID::BinaryXor: out = make_int(type, a ^ b); return true;
+		case OperatorID::Equals: out = make_bool(a == b); return true;
+		case OperatorID::NotEquals: out = make_bool(a != b); return true;
+		case OperatorID::LessThan: out = make_bool(sign ? (i64)a < (i64)b : a < b); return true;
+		case OperatorID::GreaterThan: out = make_bool(sign ? (i64)a > (i64)b : a > b); return true;
+		case OperatorID::LessEquals: out = make_bool(sign ? (i64)a <= (i64)b : a <= b); return true;
+		case OperatorID::GreaterEquals: out = make_bool(sign ? (i64)a >= (i64)b : a >= b); return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool fold_float(OperatorID op, const Constant& lhs, const Constant& rhs, Constant& out) {
+		_type_id type = (lhs.type == TYPE_F64 || rhs.type == TYPE_F64) ? TYPE_F64 : TYPE_F32;
+
+		// operands are converted to the common type first, float rounding included
+		double a = make_float(type, as_real(lhs)).real;
+		double b = make_float(type, as_real(rhs)).real;
+
+		switch (op) {
+		case OperatorID::Add: out = make_float(type, a + b); break;
+		case OperatorID::Sub: out = make_float(type, a - b); break;
+		case OperatorID::Mul: out = make_float(type, a * b); break;
+		case OperatorID::Div: out = make_float(type, a / b); break;
+		case OperatorID::Equals: out = make_bool(a == b); return true;
+		case OperatorID::NotEquals: out = make_bool(a != b); return true;
+		case OperatorID::LessThan: out = make_bool(a < b); return true;
+		case OperatorID::GreaterThan: out = make_bool(a > b); return true;
+		case OperatorID::LessEquals: out = make_bool(a <= b); return true;
+		case OperatorID::GreaterEquals: out = make_bool(a >= b); return true;
+		default:
+			return false;
+		}
+
+		return std::isfinite(out.real);
+	}
+
+	bool fold_binary(OperatorID op, const Constant& lhs, const Constant& rhs, Constant& out) {
+		if (op == OperatorID::LogicAnd) {
+			out = make_bool(constant_truthy(lhs) && constant_truthy(rhs));
+			return true;
+		}
+		if (op == OperatorID::LogicOr) {
+			out = make_bool(constant_truthy(lhs) || constant_truthy(rhs));
+			return true;
+		}
+
+		if (is_float(lhs.type) || is_float(rhs.type)) {
+			return fold_float(op, lhs, rhs, out);
+		}
+		return fold_integer(op, lhs, rhs, out);
+	}
+
+	bool fold_unary(OperatorID op, const Constant& value, Constant& out) {
+		switch (op) {
+		case OperatorID::Not:
+			out = make_bool(!constant_truthy(value));
+			return true;
+		case OperatorID::Negative:
+			if (is_float(value.type)) {
+				out = make_float(value.type, -value.real);
+				return true;
+			}
+			if (is_signed(value.type)) {
+				i64 v = (i64)value.bits;
+				if (v == (value.type == TYPE_I32 ? s_I32Min : s_I64Min)) {
+					return false;
+				}
+				out = make_int(value.type, (u64)-v);
+				return true;
+			}
+			out = make_int(value.type, 0 - value.bits);
+			return true;
+		case OperatorID::BinaryNot:
+			if (is_float(value.type)) {
+				return false;
+			}
+			out = make_int(value.type, ~value.bits);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool is_mutation(OperatorID op) {
+		switch (op) {
+		case OperatorID::PreInc:
+		case OperatorID::PreDec:
+		case OperatorID::PostInc:
+		case OperatorID::PostDec:
+		case OperatorID::Reference:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// first segment of a variable path, the local the access goes through
+	static Name root_name(AstNode* node) {
+		VariableNode* var = node_cast<VariableNode>(node);
+		if (var == nullptr || var->path() == nullptr || var->path()->nodes.empty()) {
+			return Name{};
+		}
+		return var->path()->nodes[0].bit;
+	}
+
+	// names written to (or address-taken) anywhere in a function, and whether it contains inline C
+	class AssignmentCollector : public AstVisitor<AssignmentCollector> {
+	public:
+		inline AssignmentCollector(std::unordered_set<Name>& assigned) : m_Assigned{ assigned } {}
+
+		void visit_binary(BinaryOperator* node) {
+			if (is_assignment(node->m_Operator)) {
+				m_Assigned.insert(root_name(node->m_Lhs));
+			}
+			AstVisitor<AssignmentCollector>::visit_binary(node);
+		}
+
+		void visit_unary(UnaryOperator* node) {
+			if (is_mutation(node->m_Operator)) {
+				m_Assigned.insert(root_name(node->m_Child));
+			}
+			AstVisitor<AssignmentCollector>::visit_unary(node);
+		}
+
+		inline void visit_cblock(InlineCBlock* node) {
+			has_inline_c = true;
+		}
+
+		bool has_inline_c = false;
+
+	private:
+		std::unordered_set<Name>& m_Assigned;
+	};
+
+	ConstantFolder::ConstantFolder(ParserContext& ctx, ConstEvaluator* evaluator) : m_Context{ ctx }, m_Evaluator{ evaluator } {}
+
+	const ConstantFolder::Binding* ConstantFolder::find_binding(Name name) const {
+		for (auto b = m_Bindings.rbegin(); b != m_Bindings.rend(); ++b) {
+			if (b->name == name) {
+				return &*b;
+			}
+		}
+		return nullptr;
+	}
+
+	AstNode* constant_node(const Constant& value) {
+		if (value.is_bool) {
+			StaticBoolNode* lit = new StaticBoolNode(value.bits != 0, "bool");
+			lit->resolved_type = TYPE_BOOL;
+			return lit;
+		}
+		if (is_float(value.type)) {
+			StaticFloatNode* lit = new StaticFloatNode(value.real, value.type == TYPE_F32 ? "f32" : "f64");
+			lit->resolved_type = value.type;
+			return lit;
+		}
+
+		StaticIntegerNode* lit = new StaticIntegerNode((i64)value.bits, "i64");
+		lit->resolved_type = value.type;
+		return lit;
+	}
+
+	void ConstantFolder::replace(AstNode*& slot, const Constant& value) {
+		AstNode* node = constant_node(value);
+		delete slot;
+		slot = node;
+	}
+
+	void ConstantFolder::fold(AstNode*& slot) {
+		if (slot == nullptr) {
+			return;
+		}
+
+		switch (slot->kind()) {
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(slot);
+			if (is_assignment(op->m_Operator)) {
+				fold(op->m_Rhs);
+				return;
+			}
+
+			fold(op->m_Lhs);
+			fold(op->m_Rhs);
+
+			if (op->resolved_operator == nullptr || op->resolved_operator->overload_function != nullptr) {
+				return;
+			}
+
+			Constant lhs, rhs, result;
+			if (constant_of(op->m_Lhs, lhs) && constant_of(op->m_Rhs, rhs) && fold_binary(op->m_Operator, lhs, rhs, result)) {
+				replace(slot, result);
+				m_Folded++;
+			}
+			return;
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(slot);
+			if (is_mutation(op->m_Operator) || op->m_Operator == OperatorID::Dereference) {
+				return;
+			}
+
+			fold(op->m_Child);
+
+			if (op->resolved_operator == nullptr || op->resolved_operator->overload_function != nullptr) {
+				return;
+			}
+
+			Constant value, result;
+			if (constant_of(op->m_Child, value) && fold_unary(op->m_Operator, value, result)) {
+				replace(slot, result);
+				m_Folded++;
+			}
+			return;
+		}
+		case NodeType::Variable: {
+			if (!m_Propagate) {
+				return;
+			}
+
+			VariableNode* var = static_cast<VariableNode*>(slot);
+			if (var->path() == nullptr || var->path()->nodes.size() != 1) {
+				return;
+			}
+
+			const Binding* binding = find_binding(var->path()->nodes[0].bit);
+			if (binding != nullptr && binding->is_constant) {
+				replace(slot, binding->value);
+				m_Propagated++;
+			}
+			return;
+		}
+		case NodeType::FunctionCall: {
+			FunctionCallNode* call = static_cast<FunctionCallNode*>(slot);
+			visit_call(call);
+
+			FunctionDefinitionNode* func = m_Evaluator != nullptr ? m_Evaluator->find_function(call) : nullptr;
+			if (func == nullptr) {
+				return;
+			}
+
+			std::vector<Constant> args;
+			bool constant_args = true;
+			if (call->arguments != nullptr) {
+				args.resize(call->arguments->args.size());
+				for (size_t i = 0; i < args.size() && constant_args; i++) {
+					constant_args = constant_of(call->arguments->args[i], args[i]);
+				}
+			}
+
+			Constant result;
+			if (constant_args && m_Evaluator->evaluate(func, args, result)) {
+				replace(slot, result);
+				m_Evaluated++;
+			}
+			else if (func->const_eval) {
+				m_Context.errors.push_back("Call to @const_eval function " + func->functionName + " in " + m_Function + " could not be evaluated at compile time");
+			}
+			return;
+		}
+		case NodeType::Annotation: {
+			// the value of @not_null, the count of @alloc
+			AnnotationNode* annotation = static_cast<AnnotationNode*>(slot);
+			if (annotation->body() != nullptr) {
+				fold(annotation->body());
+			}
+			else {
+				visit(slot);
+			}
+			return;
+		}
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+		case NodeType::ImmediateString:
+			return;
+		default:
+			visit(slot);
+			return;
+		}
+	}
+
+	void ConstantFolder::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr || node->body == nullptr) {
+			return;
+		}
+
+		m_Function = node->functionName;
+
+		m_Assigned.clear();
+		AssignmentCollector collector(m_Assigned);
+		collector.visit(node->body);
+		m_Propagate = !collector.has_inline_c;
+
+		m_Bindings.clear();
+		m_Frames.clear();
+
+		// parameters shadow nothing yet but keep lookups honest if a local reuses the name
+		if (node->params != nullptr) {
+			for (auto& param : node->params->params) {
+				m_Bindings.push_back(Binding{ param.name, false, {} });
+			}
+		}
+
+		visit(node->body);
+
+		m_Bindings.clear();
+	}
+
+	void ConstantFolder::visit_block(StatementBlockNode* node) {
+		m_Frames.push_back(m_Bindings.size());
+		for (auto& statement : node->statements) {
+			// a call on its own is kept as a call, only its arguments fold
+			if (statement->kind() == NodeType::FunctionCall) {
+				visit_call(static_cast<FunctionCallNode*>(statement));
+				continue;
+			}
+			fold(statement);
+		}
+		m_Bindings.resize(m_Frames.back());
+		m_Frames.pop_back();
+	}
+
+	void ConstantFolder::visit_if(IfNode* node) {
+		fold(node->condition);
+		visit(node->body);
+		visit(node->elseBranch);
+	}
+
+	void ConstantFolder::visit_for(ForNode* node) {
+		// a variable declared by the loop goes out of scope with it
+		m_Frames.push_back(m_Bindings.size());
+		fold(node->init);
+		fold(node->condition);
+		fold(node->step);
+		visit(node->body);
+		m_Bindings.resize(m_Frames.back());
+		m_Frames.pop_back();
+	}
+
+	void ConstantFolder::visit_return(ReturnNode* node) {
+		fold(node->returnValue);
+	}
+
+	void ConstantFolder::visit_variable_decl(VariableDeclNode* node) {
+		fold(node->default_value);
+
+		Binding binding{ node->var_name, false, {} };
+
+		Constant value;
+		if (m_Propagate && node->default_value != nullptr && m_Assigned.find(node->var_name) == m_Assigned.end() &&
+			constant_of(node->default_value, value) && convert_constant(value, node->type, binding.value)) {
+			binding.is_constant = true;
+		}
+
+		m_Bindings.push_back(binding);
+	}
+
+	void ConstantFolder::visit_call(FunctionCallNode* node) {
+		if (node->arguments == nullptr) {
+			return;
+		}
+		for (auto& arg : node->arguments->args) {
+			fold(arg);
+		}
+	}
+
+	size_t FoldConstants(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		ConstEvaluator evaluator;
+		for (auto& funcDef : module->body->functions) {
+			evaluator.add_function(funcDef);
+		}
+
+		ConstantFolder folder(ctx, &evaluator);
+		for (auto& funcDef : module->body->functions) {
+			folder.visit(funcDef);
+		}
+
+		return folder.folded_count() + folder.propagated_count() + folder.evaluated_count();
+	}
+}
@@ -0,0 +1,170 @@
+#include "core/dead_code.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace tau {
+
+	void Reachability::use_function(Name name) {
+		if (m_Functions.insert(name).second) {
+			m_Worklist.push_back(name);
+		}
+	}
+
+	void Reachability::use_type(_type_id type) {
+		if (!m_Types.insert(type).second) {
+			return;
+		}
+		if (m_Context.types.is_pointer(type)) {
+			use_type(m_Context.types.pointee_of(type));
+			return;
+		}
+		if (!m_Context.types.is_struct(type)) {
+			return;
+		}
+		for (auto& field : m_Context.types.fields_of(type)) {
+			use_type(field.type);
+		}
+	}
+
+	void Reachability::visit_function(FunctionDefinitionNode* node) {
+		use_type(node->returnType);
+		if (node->params != nullptr) {
+			for (auto& param : node->params->params) {
+				use_type(param.type);
+			}
+		}
+		visit(node->body);
+	}
+
+	void Reachability::visit_struct(StructDefNode* node) {
+		if (node->templateParams != nullptr) {
+			return;
+		}
+		use_type(node->struct_id);
+		AstVisitor<Reachability>::visit_struct(node);
+	}
+
+	void Reachability::visit_variable_decl(VariableDeclNode* node) {
+		use_type(node->type);
+		AstVisitor<Reachability>::visit_variable_decl(node);
+	}
+
+	void Reachability::visit_binary(BinaryOperator* node) {
+		if (node->resolved_operator != nullptr) {
+			FunctionDefinitionNode* overload = node_cast<FunctionDefinitionNode>(node->resolved_operator->overload_function);
+			if (overload != nullptr) {
+				use_function(overload->functionName);
+			}
+		}
+		AstVisitor<Reachability>::visit_binary(node);
+	}
+
+	void Reachability::visit_unary(UnaryOperator* node) {
+		if (node->resolved_operator != nullptr) {
+			FunctionDefinitionNode* overload = node_cast<FunctionDefinitionNode>(node->resolved_operator->overload_function);
+			if (overload != nullptr) {
+				use_function(overload->functionName);
+			}
+		}
+		AstVisitor<Reachability>::visit_unary(node);
+	}
+
+	void Reachability::visit_call(FunctionCallNode* node) {
+		// calls into other modules name functions this module does not have, which is harmless
+		if (node->function_name != nullptr && !node->function_name->nodes.empty()) {
+			use_function(node->function_name->nodes.back().bit);
+		}
+		AstVisitor<Reachability>::visit_call(node);
+	}
+
+	void Reachability::visit_cblock(InlineCBlock* node) {
+		for (auto& tok : node->tokens) {
+			if (tok.type != TokenType::Identifier) {
+				continue;
+			}
+			Name name{ tok.literal };
+			m_Names.insert(name);
+			use_function(name);
+		}
+	}
+
+	bool Reachability::is_reachable(StructDefNode* node) {
+		if (m_Types.find(node->struct_id) != m_Types.end() || m_Names.find(node->struct_name.bit) != m_Names.end()) {
+			return true;
+		}
+
+		// declarations may have resolved to the module qualified registration of the struct
+		_type_id qualified = m_Context.types.get_id_from_name(m_ModuleName + "." + node->struct_name.bit);
+		return qualified != 0 && m_Types.find(qualified) != m_Types.end();
+	}
+
+	void Reachability::run(ModuleNode* module) {
+		ModuleBodyNode* body = module->body;
+		m_ModuleName = module->moduleName->get_full_name().str();
+
+		std::unordered_map<Name, FunctionDefinitionNode*> functions;
+		for (auto& funcDef : body->functions) {
+			if (funcDef->templateParams == nullptr) {
+				functions[funcDef->functionName] = funcDef;
+			}
+		}
+
+		for (auto& funcDef : body->functions) {
+			if (funcDef->templateParams == nullptr && (funcDef->visibility == Visibility::Public || funcDef->functionName == s_Main)) {
+				use_function(funcDef->functionName);
+			}
+		}
+		for (auto& structDef : body->structs) {
+			if (structDef->visibility == Visibility::Public) {
+				visit(structDef);
+			}
+		}
+
+		while (!m_Worklist.empty()) {
+			Name name = m_Worklist.back();
+			m_Worklist.pop_back();
+
+			auto f = functions.find(name);
+			if (f != functions.end()) {
+				visit(f->second);
+			}
+		}
+	}
+
+	size_t EliminateDeadCode(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		Reachability reachability(ctx);
+		reachability.run(module);
+
+		size_t removed = 0;
+
+		auto& functions = module->body->functions;
+		auto dead_function = [&](FunctionDefinitionNode* funcDef) {
+			if (funcDef->visibility == Visibility::Public || reachability.is_reachable(funcDef)) {
+				return false;
+			}
+			delete funcDef;
+			removed++;
+			return true;
+		};
+		functions.erase(std::remove_if(functions.begin(), functions.end(), dead_function), functions.end());
+
+		// generic structs are never emitted themselves, their instances follow the functions that use them
+		auto& structs = module->body->structs;
+		auto dead_struct = [&](StructDefNode* structDef) {
+			if (structDef->visibility == Visibility::Public || structDef->templateParams != nullptr || reachability.is_reachable(structDef)) {
+				return false;
+			}
+			delete structDef;
+			removed++;
+			return true;
+		};
+		structs.erase(std::remove_if(structs.begin(), structs.end(), dead_struct), structs.end());
+
+		return removed;
+	}
+}
@@ -0,0 +1,246 @@
+#include "core/escape.h"
+#include "core/null_check.h"
+
+#include <algorithm>
+
+namespace tau {
+
+	static constexpr size_t s_DefaultStackLimit = 256;
+
+	static AnnotationNode* allocation_of(VariableDeclNode* node) {
+		AnnotationNode* alloc = node_cast<AnnotationNode>(node->default_value);
+		return alloc != nullptr && alloc->annotation_type() == "alloc" ? alloc : nullptr;
+	}
+
+	void EscapeAnalysis::add_function(FunctionDefinitionNode* func) {
+		m_Functions[func->functionName] = func;
+	}
+
+	std::vector<bool>& EscapeAnalysis::summary(FunctionDefinitionNode* func) {
+		std::vector<bool>& params = m_Summaries[func];
+		if (params.empty() && func->params != nullptr) {
+			params.resize(func->params->params.size(), false);
+		}
+		return params;
+	}
+
+	bool EscapeAnalysis::escapes(Name name) const {
+		auto d = m_Declared.find(name);
+		return m_Escaped.find(name) != m_Escaped.end() || (d != m_Declared.end() && d->second > 1);
+	}
+
+	bool EscapeAnalysis::analyze(FunctionDefinitionNode* func) {
+		m_Escaped.clear();
+		m_Declared.clear();
+		m_Allocations.clear();
+		m_Frees.clear();
+		m_Block = nullptr;
+
+		if (func->params != nullptr) {
+			for (auto& param : func->params->params) {
+				m_Declared[param.name]++;
+			}
+		}
+		visit(func->body);
+
+		// a parameter a callee frees is as gone as one it stores
+		std::unordered_set<Name> freed;
+		for (auto& free : m_Frees) {
+			Name name;
+			local_name(free.statement->params()[0], name);
+			freed.insert(name);
+		}
+
+		bool changed = false;
+		std::vector<bool>& params = summary(func);
+		for (size_t i = 0; i < params.size(); i++) {
+			Name name = func->params->params[i].name;
+			bool escaped = m_Context.types.is_pointer(func->params->params[i].type) && (escapes(name) || freed.find(name) != freed.end());
+			if (escaped && !params[i]) {
+				params[i] = true;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	size_t EscapeAnalysis::promote(FunctionDefinitionNode* func) {
+		analyze(func);
+
+		size_t limit = func->stack_limit != 0 ? func->stack_limit : s_DefaultStackLimit;
+		size_t promoted = 0;
+		for (auto& decl : m_Allocations) {
+			AnnotationNode* alloc = allocation_of(decl);
+			if (escapes(decl->var_name) || !m_Context.types.is_pointer(decl->type)) {
+				continue;
+			}
+
+			size_t element = m_Context.types.size_of(m_Context.types.pointee_of(decl->type));
+			if (element == 0) {
+				continue;
+			}
+
+			StaticIntegerNode* count = node_cast<StaticIntegerNode>(alloc->body());
+			bool fixed = count != nullptr && count->value() > 0 && (size_t)count->value() <= limit / element;
+			if (fixed) {
+				alloc->stack_capacity = (size_t)count->value();
+			}
+			else if (count == nullptr && func->stack_limit != 0 && limit / element != 0) {
+				alloc->stack_capacity = limit / element;
+			}
+			else {
+				continue;
+			}
+			alloc->stack_buffer = Name{ decl->var_name.str() + "__stack" };
+			promoted++;
+
+			for (auto& free : m_Frees) {
+				Name name;
+				if (!local_name(free.statement->params()[0], name) || name != decl->var_name) {
+					continue;
+				}
+
+				if (fixed) {
+					auto& statements = free.block->statements;
+					statements.erase(std::find(statements.begin(), statements.end(), free.statement));
+					delete free.statement;
+				}
+				else {
+					free.statement->stack_buffer = alloc->stack_buffer;
+					free.statement->stack_capacity = alloc->stack_capacity;
+				}
+			}
+		}
+		return promoted;
+	}
+
+	void EscapeAnalysis::visit_block(StatementBlockNode* node) {
+		StatementBlockNode* outer = m_Block;
+		m_Block = node;
+		for (auto& statement : node->statements) {
+			visit(statement);
+		}
+		m_Block = outer;
+	}
+
+	void EscapeAnalysis::visit_variable_decl(VariableDeclNode* node) {
+		m_Declared[node->var_name]++;
+		if (allocation_of(node) != nullptr) {
+			m_Allocations.push_back(node);
+		}
+		visit(node->default_value);
+	}
+
+	void EscapeAnalysis::visit_binary(BinaryOperator* node) {
+		Name name;
+		switch (node->m_Operator) {
+		case OperatorID::ArrayAccess:
+			if (!local_name(node->m_Lhs, name)) {
+				visit(node->m_Lhs);
+			}
+			visit(node->m_Rhs);
+			return;
+		case OperatorID::Equals:
+		case OperatorID::NotEquals:
+			if (!local_name(strip_not_null(node->m_Lhs), name)) {
+				visit(node->m_Lhs);
+			}
+			if (!local_name(strip_not_null(node->m_Rhs), name)) {
+				visit(node->m_Rhs);
+			}
+			return;
+		default:
+			// anything else, including p = .., reaches visit_variable
+			AstVisitor<EscapeAnalysis>::visit_binary(node);
+			return;
+		}
+	}
+
+	void EscapeAnalysis::visit_unary(UnaryOperator* node) {
+		Name name;
+		if (node->m_Operator == OperatorID::Dereference && local_name(node->m_Child, name)) {
+			return;
+		}
+		AstVisitor<EscapeAnalysis>::visit_unary(node);
+	}
+
+	void EscapeAnalysis::visit_call(FunctionCallNode* node) {
+		if (node->arguments == nullptr) {
+			return;
+		}
+
+		FunctionDefinitionNode* callee = nullptr;
+		if (node->function_name != nullptr && node->function_name->nodes.size() == 1) {
+			auto f = m_Functions.find(node->function_name->nodes[0].bit);
+			if (f != m_Functions.end()) {
+				callee = f->second;
+			}
+		}
+
+		auto& args = node->arguments->args;
+		for (size_t i = 0; i < args.size(); i++) {
+			Name name;
+			if (callee != nullptr && local_name(strip_not_null(args[i]), name) && i < summary(callee).size() && !summary(callee)[i]) {
+				continue;
+			}
+			visit(args[i]);
+		}
+	}
+
+	void EscapeAnalysis::visit_annotation(AnnotationNode* node) {
+		if (node->annotation_type() == "null_check") {
+			return;
+		}
+		if (node->annotation_type() == "free") {
+			m_Frees.push_back(Free{ m_Block, node });
+			return;
+		}
+		AstVisitor<EscapeAnalysis>::visit_annotation(node);
+	}
+
+	void EscapeAnalysis::visit_variable(VariableNode* node) {
+		Name name;
+		if (local_name(node, name)) {
+			m_Escaped.insert(name);
+		}
+	}
+
+	void EscapeAnalysis::visit_cblock(InlineCBlock* node) {
+		for (auto& tok : node->tokens) {
+			if (tok.type == TokenType::Identifier) {
+				m_Escaped.insert(Name{ tok.literal });
+			}
+		}
+	}
+
+	size_t PromoteAllocations(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		EscapeAnalysis escape(ctx);
+
+		std::vector<FunctionDefinitionNode*> functions;
+		for (auto& funcDef : module->body->functions) {
+			if (funcDef->templateParams == nullptr && funcDef->body != nullptr) {
+				escape.add_function(funcDef);
+				functions.push_back(funcDef);
+			}
+		}
+
+		// summaries only ever go from not escaping to escaping, so this settles
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto& funcDef : functions) {
+				changed |= escape.analyze(funcDef);
+			}
+		}
+
+		size_t promoted = 0;
+		for (auto& funcDef : functions) {
+			promoted += escape.promote(funcDef);
+		}
+		return promoted;
+	}
+}
@@ -0,0 +1,399 @@
+#include "core/inliner.h"
+
+namespace tau {
+
+	static inline bool is_builtin(const AllowedBinaryOperator* op) {
+		return op != nullptr && op->overload_function == nullptr;
+	}
+
+	static inline bool is_builtin(const AllowedUnaryOperator* op) {
+		return op != nullptr && op->overload_function == nullptr;
+	}
+
+	static bool is_mutation(OperatorID op) {
+		switch (op) {
+		case OperatorID::PreInc:
+		case OperatorID::PreDec:
+		case OperatorID::PostInc:
+		case OperatorID::PostDec:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// types whose C arithmetic is not promoted, so an expression of that type needs no conversion on return
+	static bool is_unpromoted(_type_id type) {
+		switch (type) {
+		case TYPE_I32:
+		case TYPE_U32:
+		case TYPE_I64:
+		case TYPE_U64:
+		case TYPE_F32:
+		case TYPE_F64:
+		case TYPE_BOOL:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool is_plain_path(PathNode* path) {
+		if (path == nullptr || path->nodes.empty()) {
+			return false;
+		}
+		for (auto& node : path->nodes) {
+			if (node.args != nullptr) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static _type_id type_of(AstNode* node) {
+		Typed* typed = as_typed(node);
+		return typed != nullptr ? typed->resolved_type : TYPE_UNDEFINED;
+	}
+
+	// index of the parameter a variable names, or the parameter count when it names something else
+	static size_t param_index(FunctionDefinitionNode* func, AstNode* node) {
+		size_t count = func->params != nullptr ? func->params->params.size() : 0;
+
+		VariableNode* var = node_cast<VariableNode>(node);
+		if (var == nullptr || var->path() == nullptr || var->path()->nodes.size() != 1 || var->path()->nodes[0].args != nullptr) {
+			return count;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			if (func->params->params[i].name == var->path()->nodes[0].bit) {
+				return i;
+			}
+		}
+		return count;
+	}
+
+	// evaluating node has no effect besides its value
+	static bool is_pure(AstNode* node) {
+		switch (node->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+			return true;
+		case NodeType::Variable:
+			return is_plain_path(static_cast<VariableNode*>(node)->path());
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			return !is_assignment(op->m_Operator) && is_builtin(op->resolved_operator) && is_pure(op->m_Lhs) && is_pure(op->m_Rhs);
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			return !is_mutation(op->m_Operator) && is_builtin(op->resolved_operator) && is_pure(op->m_Child);
+		}
+		default:
+			return false;
+		}
+	}
+
+	// pure expression over the parameters of func only, counting nodes and parameter uses
+	static bool is_leaf_expression(AstNode* node, FunctionDefinitionNode* func, std::vector<size_t>& uses, size_t& size) {
+		size++;
+
+		switch (node->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+			return true;
+		case NodeType::Variable: {
+			size_t index = param_index(func, node);
+			if (index == uses.size()) {
+				return false;
+			}
+			uses[index]++;
+			return true;
+		}
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			return !is_assignment(op->m_Operator) && is_builtin(op->resolved_operator) &&
+				is_leaf_expression(op->m_Lhs, func, uses, size) && is_leaf_expression(op->m_Rhs, func, uses, size);
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			// the address of a parameter has no counterpart once the argument is substituted
+			return !is_mutation(op->m_Operator) && op->m_Operator != OperatorID::Reference && is_builtin(op->resolved_operator) &&
+				is_leaf_expression(op->m_Child, func, uses, size);
+		}
+		default:
+			return false;
+		}
+	}
+
+	AstNode* copy_expression(AstNode* node, FunctionDefinitionNode* func, const std::vector<AstNode*>* args) {
+		switch (node->kind()) {
+		case NodeType::ImmediateInt: {
+			StaticIntegerNode* lit = static_cast<StaticIntegerNode*>(node);
+			StaticIntegerNode* copy = new StaticIntegerNode(lit->value(), lit->type_name());
+			copy->resolved_type = lit->resolved_type;
+			return copy;
+		}
+		case NodeType::ImmediateFloat: {
+			StaticFloatNode* lit = static_cast<StaticFloatNode*>(node);
+			StaticFloatNode* copy = new StaticFloatNode(lit->value(), lit->type_name());
+			copy->resolved_type = lit->resolved_type;
+			return copy;
+		}
+		case NodeType::ImmediateBool: {
+			StaticBoolNode* lit = static_cast<StaticBoolNode*>(node);
+			StaticBoolNode* copy = new StaticBoolNode(lit->value(), lit->type_name());
+			copy->resolved_type = lit->resolved_type;
+			return copy;
+		}
+		case NodeType::ImmediateChar: {
+			StaticCharNode* lit = static_cast<StaticCharNode*>(node);
+			StaticCharNode* copy = new StaticCharNode(lit->value(), lit->type_name());
+			copy->resolved_type = lit->resolved_type;
+			return copy;
+		}
+		case NodeType::Variable: {
+			if (func != nullptr) {
+				size_t index = param_index(func, node);
+				if (index < args->size()) {
+					return copy_expression((*args)[index]);
+				}
+			}
+
+			VariableNode* var = static_cast<VariableNode*>(node);
+			PathNode* path = new PathNode();
+			for (auto& bit : var->path()->nodes) {
+				path->nodes.push_back(PathArg{ bit.bit, nullptr });
+			}
+
+			VariableNode* copy = new VariableNode(path);
+			copy->resolved_type = var->resolved_type;
+			return copy;
+		}
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			BinaryOperator* copy = new BinaryOperator(op->m_Operator, copy_expression(op->m_Lhs, func, args), copy_expression(op->m_Rhs, func, args));
+			copy->parenthesized = op->parenthesized;
+			copy->resolved_operator = op->resolved_operator;
+			copy->resolved_type = op->resolved_type;
+			return copy;
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			UnaryOperator* copy = new UnaryOperator(op->m_Operator, copy_expression(op->m_Child, func, args));
+			copy->resolved_operator = op->resolved_operator;
+			copy->resolved_type = op->resolved_type;
+			return copy;
+		}
+		default:
+			return nullptr;
+		}
+	}
+
+	void Inliner::add_function(FunctionDefinitionNode* func) {
+		if (func->templateParams != nullptr || func->body == nullptr) {
+			return;
+		}
+		m_Functions[func->functionName] = func;
+	}
+
+	Inliner::Summary& Inliner::summarize(FunctionDefinitionNode* func) {
+		Summary& summary = m_Summaries[func];
+		if (summary.state != State::Pending) {
+			// a function being expanded is on the current call chain and never a leaf
+			return summary;
+		}
+
+		summary.state = State::Running;
+		visit(func->body);
+		summary.state = State::Done;
+
+		// a function the profile never saw called is not worth growing its callers for, an instrumented one keeps its calls counted
+		bool cold = func->heat == FunctionHeat::Cold && !func->is_inline;
+		if (cold || func->profile_counter != NO_PROFILE_COUNTER || func->const_eval || func->has_entry_checks() || func->body->statements.size() != 1 || !is_unpromoted(func->returnType)) {
+			return summary;
+		}
+
+		ReturnNode* ret = node_cast<ReturnNode>(func->body->statements[0]);
+		if (ret == nullptr || ret->returnValue == nullptr || type_of(ret->returnValue) != func->returnType) {
+			return summary;
+		}
+
+		std::vector<size_t> uses(func->params != nullptr ? func->params->params.size() : 0);
+		size_t size = 0;
+		if (!is_leaf_expression(ret->returnValue, func, uses, size) || size > (func->is_inline || func->heat == FunctionHeat::Hot ? s_MaxInlineSize : s_MaxSize)) {
+			return summary;
+		}
+
+		summary.expr = ret->returnValue;
+		summary.uses = std::move(uses);
+		return summary;
+	}
+
+	bool Inliner::try_inline(AstNode*& slot) {
+		FunctionCallNode* call = static_cast<FunctionCallNode*>(slot);
+		PathNode* path = call->function_name;
+		if (path == nullptr || path->nodes.size() != 1 || path->nodes[0].args != nullptr) {
+			return false;
+		}
+
+		auto f = m_Functions.find(path->nodes[0].bit);
+		if (f == m_Functions.end()) {
+			return false;
+		}
+
+		FunctionDefinitionNode* func = f->second;
+		Summary& summary = summarize(func);
+		if (summary.expr == nullptr) {
+			return false;
+		}
+
+		size_t count = summary.uses.size();
+		size_t argc = call->arguments != nullptr ? call->arguments->args.size() : 0;
+		if (argc != count) {
+			return false;
+		}
+
+		// constants are converted to the parameter type up front, the rest must already have it
+		std::vector<AstNode*> args(count, nullptr);
+		std::vector<AstNode*> converted;
+		bool ok = true;
+		for (size_t i = 0; i < count && ok; i++) {
+			AstNode* arg = call->arguments->args[i];
+			_type_id type = func->params->params[i].type;
+
+			Constant value, stored;
+			if (constant_of(arg, value)) {
+				ok = convert_constant(value, type, stored);
+				if (ok) {
+					args[i] = constant_node(stored);
+					converted.push_back(args[i]);
+				}
+				continue;
+			}
+
+			ok = is_pure(arg) && type_of(arg) == type && (summary.uses[i] <= 1 || arg->kind() == NodeType::Variable);
+			args[i] = arg;
+		}
+
+		AstNode* result = ok ? copy_expression(summary.expr, func, &args) : nullptr;
+
+		for (auto& node : converted) {
+			delete node;
+		}
+
+		if (result == nullptr) {
+			return false;
+		}
+
+		delete slot;
+		slot = result;
+		m_Inlined++;
+		return true;
+	}
+
+	void Inliner::expand(AstNode*& slot) {
+		if (slot == nullptr) {
+			return;
+		}
+
+		switch (slot->kind()) {
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(slot);
+			if (!is_assignment(op->m_Operator)) {
+				expand(op->m_Lhs);
+			}
+			expand(op->m_Rhs);
+			return;
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(slot);
+			if (!is_mutation(op->m_Operator) && op->m_Operator != OperatorID::Reference) {
+				expand(op->m_Child);
+			}
+			return;
+		}
+		case NodeType::FunctionCall:
+			visit_call(static_cast<FunctionCallNode*>(slot));
+			try_inline(slot);
+			return;
+		case NodeType::Variable:
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+		case NodeType::ImmediateString:
+			return;
+		default:
+			visit(slot);
+			return;
+		}
+	}
+
+	void Inliner::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr || node->body == nullptr) {
+			return;
+		}
+		summarize(node);
+	}
+
+	void Inliner::visit_block(StatementBlockNode* node) {
+		for (auto& statement : node->statements) {
+			// a call on its own is kept as a call, only its arguments are expanded
+			if (statement->kind() == NodeType::FunctionCall) {
+				visit_call(static_cast<FunctionCallNode*>(statement));
+				continue;
+			}
+			expand(statement);
+		}
+	}
+
+	void Inliner::visit_if(IfNode* node) {
+		expand(node->condition);
+		visit(node->body);
+		visit(node->elseBranch);
+	}
+
+	void Inliner::visit_for(ForNode* node) {
+		expand(node->init);
+		expand(node->condition);
+		expand(node->step);
+		visit(node->body);
+	}
+
+	void Inliner::visit_return(ReturnNode* node) {
+		expand(node->returnValue);
+	}
+
+	void Inliner::visit_variable_decl(VariableDeclNode* node) {
+		expand(node->default_value);
+	}
+
+	void Inliner::visit_call(FunctionCallNode* node) {
+		if (node->arguments == nullptr) {
+			return;
+		}
+		for (auto& arg : node->arguments->args) {
+			expand(arg);
+		}
+	}
+
+	size_t InlineFunctions(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		Inliner inliner(ctx);
+		for (auto& funcDef : module->body->functions) {
+			inliner.add_function(funcDef);
+		}
+		for (auto& funcDef : module->body->functions) {
+			inliner.visit(funcDef);
+		}
+
+		return inliner.inlined_count();
+	}
+}
@@ -0,0 +1,1097 @@
+#include "core/ir.h"
+
+#include <unordered_set>
+
+namespace tau {
+
+	// prefixes of the C locals and labels the IR is emitted with
+	static constexpr std::string_view s_ValuePrefix = "v__";
+	static constexpr std::string_view s_TempPrefix = "t__";
+	static constexpr std::string_view s_LabelPrefix = "bb__";
+
+	static inline bool is_scalar(_type_id type) {
+		switch (type) {
+		case TYPE_I32:
+		case TYPE_U32:
+		case TYPE_I64:
+		case TYPE_U64:
+		case TYPE_F32:
+		case TYPE_F64:
+		case TYPE_BOOL:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// bool takes part in arithmetic as an int
+	static inline _type_id promoted(_type_id type) {
+		return type == TYPE_BOOL ? TYPE_I32 : type;
+	}
+
+	// the usual arithmetic conversions over the scalar types
+	static _type_id arithmetic_type(_type_id lhs, _type_id rhs) {
+		lhs = promoted(lhs);
+		rhs = promoted(rhs);
+		if (lhs == TYPE_F64 || rhs == TYPE_F64) {
+			return TYPE_F64;
+		}
+		if (lhs == TYPE_F32 || rhs == TYPE_F32) {
+			return TYPE_F32;
+		}
+		if (lhs == rhs) {
+			return lhs;
+		}
+
+		bool lhs_wide = lhs == TYPE_I64 || lhs == TYPE_U64;
+		bool rhs_wide = rhs == TYPE_I64 || rhs == TYPE_U64;
+		if (lhs_wide != rhs_wide) {
+			return lhs_wide ? lhs : rhs;
+		}
+		// same width, one of them unsigned
+		return lhs_wide ? TYPE_U64 : TYPE_U32;
+	}
+
+	static const char* op_name(IrInstruction* inst) {
+		switch (inst->op) {
+		case IrOp::Const: return "const";
+		case IrOp::Param: return "param";
+		case IrOp::Alloca: return "alloca";
+		case IrOp::Load: return "load";
+		case IrOp::Store: return "store";
+		case IrOp::Binary: return "binary";
+		case IrOp::Unary: return "unary";
+		case IrOp::Convert: return "convert";
+		case IrOp::Call: return "call";
+		case IrOp::Phi: return "phi";
+		case IrOp::Jump: return "jump";
+		case IrOp::Branch: return "branch";
+		case IrOp::Return: return "return";
+		case IrOp::Unreachable: return "unreachable";
+		default: return "?";
+		}
+	}
+
+	std::vector<IrBlock*> IrBlock::successors() const {
+		IrInstruction* term = terminator();
+		if (term == nullptr) {
+			return {};
+		}
+		switch (term->op) {
+		case IrOp::Jump: return { term->targets[0] };
+		case IrOp::Branch: return { term->targets[0], term->targets[1] };
+		default: return {};
+		}
+	}
+
+	void IrBlock::insert(IrInstruction* inst) {
+		inst->block = this;
+		if (terminator() == nullptr) {
+			instructions.push_back(inst);
+			return;
+		}
+		instructions.insert(instructions.end() - 1, inst);
+	}
+
+	void IrBlock::replace_successor(IrBlock* from, IrBlock* to) {
+		IrInstruction* term = terminator();
+		if (term == nullptr) {
+			return;
+		}
+		for (auto& target : term->targets) {
+			if (target == from) {
+				target = to;
+			}
+		}
+	}
+
+	void IrBlock::remove_incoming(IrBlock* pred) {
+		for (auto& inst : instructions) {
+			if (inst->op != IrOp::Phi) {
+				break;
+			}
+			for (size_t i = 0; i < inst->incoming.size(); i++) {
+				if (inst->incoming[i] == pred) {
+					inst->incoming.erase(inst->incoming.begin() + i);
+					inst->operands.erase(inst->operands.begin() + i);
+					break;
+				}
+			}
+		}
+	}
+
+	IrInstruction* IrFunction::create(IrOp op, _type_id type) {
+		IrInstruction& inst = m_Values.emplace_back(op, type);
+		inst.id = (u32)(m_Values.size() - 1);
+		return &inst;
+	}
+
+	IrBlock* IrFunction::create_block() {
+		return &m_Blocks.emplace_back((u32)m_Blocks.size());
+	}
+
+	void IrFunction::compute_predecessors() {
+		for (auto& block : blocks) {
+			block->predecessors.clear();
+		}
+		for (auto& block : blocks) {
+			for (auto& succ : block->successors()) {
+				succ->predecessors.push_back(block);
+			}
+		}
+	}
+
+	size_t IrFunction::remove_unreachable_blocks() {
+		std::vector<bool> reached(block_ids(), false);
+		std::vector<IrBlock*> worklist{ entry() };
+		reached[entry()->id] = true;
+		while (!worklist.empty()) {
+			IrBlock* block = worklist.back();
+			worklist.pop_back();
+			for (auto& succ : block->successors()) {
+				if (!reached[succ->id]) {
+					reached[succ->id] = true;
+					worklist.push_back(succ);
+				}
+			}
+		}
+
+		size_t removed = 0;
+		for (auto& block : blocks) {
+			if (reached[block->id]) {
+				continue;
+			}
+			for (auto& succ : block->successors()) {
+				if (reached[succ->id]) {
+					succ->remove_incoming(block);
+				}
+			}
+			removed++;
+		}
+		if (removed != 0) {
+			std::erase_if(blocks, [&](IrBlock* block) { return !reached[block->id]; });
+		}
+		return removed;
+	}
+
+	IrInstruction* resolve_replacement(std::unordered_map<IrInstruction*, IrInstruction*>& replacements, IrInstruction* inst) {
+		auto r = replacements.find(inst);
+		if (r == replacements.end()) {
+			return inst;
+		}
+		IrInstruction* target = resolve_replacement(replacements, r->second);
+		r->second = target;
+		return target;
+	}
+
+	void IrFunction::replace_uses(std::unordered_map<IrInstruction*, IrInstruction*>& replacements) {
+		if (replacements.empty()) {
+			return;
+		}
+		for (auto& block : blocks) {
+			for (auto& inst : block->instructions) {
+				for (auto& operand : inst->operands) {
+					operand = resolve_replacement(replacements, operand);
+				}
+			}
+		}
+	}
+
+	static void print_value(std::ostream& output, IrInstruction* inst, ParserContext& ctx) {
+		if (inst->op == IrOp::Const) {
+			AstNode* literal = constant_node(inst->value);
+			literal->compile(output, ctx);
+			delete literal;
+			return;
+		}
+		output << "%" << inst->id;
+	}
+
+	void IrFunction::print(std::ostream& output, ParserContext& ctx) {
+		output << "fn " << definition->functionName << "\n";
+		for (auto& block : blocks) {
+			output << "bb" << block->id << ":";
+			for (auto& pred : block->predecessors) {
+				output << " bb" << pred->id;
+			}
+			output << "\n";
+
+			for (auto& inst : block->instructions) {
+				output << "\t";
+				if (inst->type != TYPE_VOID) {
+					output << "%" << inst->id << " = ";
+				}
+				output << op_name(inst);
+				if (inst->op == IrOp::Binary || inst->op == IrOp::Unary) {
+					output << " " << get_opstr(inst->oper);
+				}
+				if (inst->type != TYPE_VOID) {
+					output << " " << ctx.types.name_of(inst->type);
+				}
+				if (inst->op == IrOp::Param) {
+					output << " " << inst->index;
+				}
+				else if (inst->op == IrOp::Call) {
+					output << " " << inst->call->function_name->get_full_name(ctx);
+				}
+				else if (inst->op == IrOp::Const) {
+					output << " ";
+					print_value(output, inst, ctx);
+				}
+
+				for (size_t i = 0; i < inst->operands.size(); i++) {
+					output << (i == 0 ? " " : ", ");
+					if (inst->op == IrOp::Phi) {
+						output << "[bb" << inst->incoming[i]->id << " ";
+						print_value(output, inst->operands[i], ctx);
+						output << "]";
+					}
+					else {
+						print_value(output, inst->operands[i], ctx);
+					}
+				}
+				for (auto& target : inst->targets) {
+					if (target != nullptr) {
+						output << " bb" << target->id;
+					}
+				}
+				output << "\n";
+			}
+		}
+	}
+
+	/*
+	C emission. Constants are written in place and parameters by name, every other value
+	is a local declared at the top of the body, so gotos never jump over a declaration.
+	*/
+	class IrEmitter {
+	public:
+		inline IrEmitter(IrFunction& func, std::ostream& output, ParserContext& ctx) : m_Function{ func }, m_Output{ output }, m_Context{ ctx } {}
+
+		bool emit() {
+			m_Used.assign(m_Function.value_ids(), false);
+			m_Targeted.assign(m_Function.block_ids(), false);
+			for (auto& block : m_Function.blocks) {
+				for (auto& inst : block->instructions) {
+					for (auto& operand : inst->operands) {
+						m_Used[operand->id] = true;
+					}
+				}
+				for (auto& succ : block->successors()) {
+					m_Targeted[succ->id] = true;
+				}
+			}
+
+			m_Output << "{\n";
+			for (auto& block : m_Function.blocks) {
+				for (auto& inst : block->instructions) {
+					if (has_local(inst)) {
+						m_Output << m_Context.types.name_of(inst->type) << " " << s_ValuePrefix << inst->id << ";\n";
+					}
+				}
+			}
+
+			for (size_t i = 0; i < m_Function.blocks.size(); i++) {
+				IrBlock* block = m_Function.blocks[i];
+				m_Next = i + 1 < m_Function.blocks.size() ? m_Function.blocks[i + 1] : nullptr;
+
+				if (m_Targeted[block->id]) {
+					m_Output << s_LabelPrefix << block->id << ": ;\n";
+				}
+				for (auto& inst : block->instructions) {
+					instruction(inst);
+				}
+			}
+			m_Output << "}\n";
+			return true;
+		}
+
+	private:
+		bool has_local(IrInstruction* inst) {
+			switch (inst->op) {
+			case IrOp::Const:
+			case IrOp::Param:
+				return false;
+			case IrOp::Alloca:
+			case IrOp::Phi:
+				return true;
+			default:
+				return inst->type != TYPE_VOID && m_Used[inst->id];
+			}
+		}
+
+		void value(IrInstruction* inst) {
+			switch (inst->op) {
+			case IrOp::Const: {
+				AstNode* literal = constant_node(inst->value);
+				literal->compile(m_Output, m_Context);
+				delete literal;
+				break;
+			}
+			case IrOp::Param:
+				m_Output << m_Function.definition->params->params[inst->index].name;
+				break;
+			default:
+				m_Output << s_ValuePrefix << inst->id;
+				break;
+			}
+		}
+
+		void assign(IrInstruction* inst) {
+			m_Output << s_ValuePrefix << inst->id << " = ";
+		}
+
+		void instruction(IrInstruction* inst) {
+			switch (inst->op) {
+			case IrOp::Const:
+			case IrOp::Param:
+			case IrOp::Alloca:
+			case IrOp::Phi:
+				return;
+			case IrOp::Load:
+				if (m_Used[inst->id]) {
+					assign(inst);
+					value(inst->operands[0]);
+					m_Output << ";\n";
+				}
+				return;
+			case IrOp::Store:
+				value(inst->operands[0]);
+				m_Output << " = ";
+				value(inst->operands[1]);
+				m_Output << ";\n";
+				return;
+			case IrOp::Binary:
+				if (m_Used[inst->id]) {
+					assign(inst);
+					value(inst->operands[0]);
+					m_Output << " " << get_opstr(inst->oper) << " ";
+					value(inst->operands[1]);
+					m_Output << ";\n";
+				}
+				return;
+			case IrOp::Unary:
+				if (m_Used[inst->id]) {
+					assign(inst);
+					m_Output << get_opstr(inst->oper);
+					value(inst->operands[0]);
+					m_Output << ";\n";
+				}
+				return;
+			case IrOp::Convert:
+				if (m_Used[inst->id]) {
+					assign(inst);
+					m_Output << "(" << m_Context.types.name_of(inst->type) << ")";
+					value(inst->operands[0]);
+					m_Output << ";\n";
+				}
+				return;
+			case IrOp::Call:
+				if (has_local(inst)) {
+					assign(inst);
+				}
+				m_Output << inst->call->function_name->get_full_name(m_Context);
+				if (inst->call->unchecked) {
+					m_Output << "__unchecked";
+				}
+				m_Output << "(";
+				for (size_t i = 0; i < inst->operands.size(); i++) {
+					value(inst->operands[i]);
+					if (i + 1 < inst->operands.size()) {
+						m_Output << ", ";
+					}
+				}
+				m_Output << ");\n";
+				return;
+			case IrOp::Jump:
+				edge(inst->block, inst->targets[0], true);
+				return;
+			case IrOp::Branch:
+				m_Output << "if (";
+				if (inst->hint != BranchHint::None) {
+					m_Output << "__builtin_expect(";
+				}
+				if (inst->profile_counter != NO_PROFILE_COUNTER) {
+					m_Output << "__tau_profile_branch(";
+					value(inst->operands[0]);
+					m_Output << ", " << inst->profile_counter << ")";
+				}
+				else {
+					value(inst->operands[0]);
+				}
+				if (inst->hint != BranchHint::None) {
+					m_Output << ", " << (inst->hint == BranchHint::Likely ? 1 : 0) << ")";
+				}
+				m_Output << ") {\n";
+				edge(inst->block, inst->targets[0], false);
+				m_Output << "}\n";
+				edge(inst->block, inst->targets[1], true);
+				return;
+			case IrOp::Return:
+				m_Output << "return";
+				if (!inst->operands.empty()) {
+					m_Output << " ";
+					value(inst->operands[0]);
+				}
+				m_Output << ";\n";
+				return;
+			case IrOp::Unreachable:
+				if (inst->call != nullptr) {
+					m_Output << "__builtin_unreachable();\n";
+					return;
+				}
+				// control reaches the end of a non-void function, as it did in the source
+				m_Output << (m_Function.definition->returnType == TYPE_VOID ? "return;\n" : "return 0;\n");
+				return;
+			default:
+				return;
+			}
+		}
+
+		// assigns the phis of to for the edge from from, then goes there
+		void edge(IrBlock* from, IrBlock* to, bool may_fall_through) {
+			std::vector<std::pair<IrInstruction*, IrInstruction*>> copies;
+			for (auto& inst : to->instructions) {
+				if (inst->op != IrOp::Phi) {
+					break;
+				}
+				for (size_t i = 0; i < inst->incoming.size(); i++) {
+					if (inst->incoming[i] == from) {
+						copies.emplace_back(inst, inst->operands[i]);
+						break;
+					}
+				}
+			}
+
+			// a phi read by another phi of the same block has to be read before either is written
+			bool parallel = false;
+			for (auto& copy : copies) {
+				parallel |= copy.second->op == IrOp::Phi && copy.second->block == to && copy.second != copy.first;
+			}
+
+			// the temporaries get a scope of their own, another edge of the block may need them too
+			if (parallel) {
+				m_Output << "{\n";
+				for (size_t i = 0; i < copies.size(); i++) {
+					m_Output << m_Context.types.name_of(copies[i].first->type) << " " << s_TempPrefix << i << " = ";
+					value(copies[i].second);
+					m_Output << ";\n";
+				}
+				for (size_t i = 0; i < copies.size(); i++) {
+					assign(copies[i].first);
+					m_Output << s_TempPrefix << i << ";\n";
+				}
+				m_Output << "}\n";
+			}
+			else {
+				for (auto& copy : copies) {
+					if (copy.first == copy.second) {
+						continue;
+					}
+					assign(copy.first);
+					value(copy.second);
+					m_Output << ";\n";
+				}
+			}
+
+			if (!may_fall_through || to != m_Next) {
+				m_Output << "goto " << s_LabelPrefix << to->id << ";\n";
+			}
+		}
+
+	private:
+		IrFunction& m_Function;
+		std::ostream& m_Output;
+		ParserContext& m_Context;
+
+		std::vector<bool> m_Used;
+		std::vector<bool> m_Targeted;
+		IrBlock* m_Next = nullptr;
+	};
+
+	bool IrFunction::compile(std::ostream& output, ParserContext& ctx) {
+		IrEmitter emitter(*this, output, ctx);
+		return emitter.emit();
+	}
+
+	IrInstruction* IrBuilder::emit(IrOp op, _type_id type) {
+		IrInstruction* inst = m_Function->create(op, type);
+		inst->block = m_Block;
+		m_Block->instructions.push_back(inst);
+		return inst;
+	}
+
+	IrInstruction* IrBuilder::emit_const(const Constant& value) {
+		IrInstruction* inst = emit(IrOp::Const, value.is_bool ? TYPE_BOOL : value.type);
+		inst->value = value;
+		return inst;
+	}
+
+	IrInstruction* IrBuilder::emit_convert(IrInstruction* value, _type_id type) {
+		if (value == nullptr || value->type == type) {
+			return value;
+		}
+		IrInstruction* inst = emit(IrOp::Convert, type);
+		inst->operands.push_back(value);
+		return inst;
+	}
+
+	void IrBuilder::jump(IrBlock* target) {
+		IrInstruction* inst = emit(IrOp::Jump, TYPE_VOID);
+		inst->targets[0] = target;
+	}
+
+	void IrBuilder::branch(IrInstruction* condition, IrBlock* taken, IrBlock* not_taken, BranchHint hint) {
+		IrInstruction* inst = emit(IrOp::Branch, TYPE_VOID);
+		inst->operands.push_back(condition);
+		inst->targets[0] = taken;
+		inst->targets[1] = not_taken;
+		inst->hint = hint;
+	}
+
+	void IrBuilder::begin(IrBlock* block) {
+		m_Function->blocks.push_back(block);
+		m_Block = block;
+	}
+
+	IrInstruction* IrBuilder::lookup(AstNode* node) {
+		VariableNode* var = node_cast<VariableNode>(node);
+		if (var == nullptr || var->path() == nullptr || var->path()->nodes.size() != 1) {
+			return fail();
+		}
+
+		Name name = var->path()->nodes[0].bit;
+		for (auto b = m_Bindings.rbegin(); b != m_Bindings.rend(); ++b) {
+			if (b->name == name) {
+				return b->slot;
+			}
+		}
+		// not a local, such as a module constant
+		return fail();
+	}
+
+	IrInstruction* IrBuilder::declare(Name name, _type_id type) {
+		// slots all live in the entry block, where PromoteLocals expects them
+		IrInstruction* slot = m_Function->create(IrOp::Alloca, type);
+		slot->block = m_Function->entry();
+		m_Function->entry()->instructions.insert(m_Function->entry()->instructions.begin(), slot);
+		m_Bindings.push_back(Binding{ name, slot });
+		return slot;
+	}
+
+	void IrBuilder::statement(AstNode* node) {
+		if (m_Failed) {
+			return;
+		}
+
+		switch (node->kind()) {
+		case NodeType::StatementBlock:
+			block(static_cast<StatementBlockNode*>(node));
+			return;
+		case NodeType::If:
+			if_statement(static_cast<IfNode*>(node));
+			return;
+		case NodeType::For:
+			for_statement(static_cast<ForNode*>(node));
+			return;
+		case NodeType::VariableDeclaration:
+			variable_decl(static_cast<VariableDeclNode*>(node));
+			return;
+		case NodeType::Return: {
+			ReturnNode* ret = static_cast<ReturnNode*>(node);
+			_type_id type = m_Function->definition->returnType;
+			if ((ret->returnValue != nullptr) != (type != TYPE_VOID)) {
+				fail();
+				return;
+			}
+
+			IrInstruction* value = nullptr;
+			if (ret->returnValue != nullptr) {
+				value = emit_convert(expression(ret->returnValue), type);
+				if (value == nullptr) {
+					return;
+				}
+			}
+			IrInstruction* inst = emit(IrOp::Return, TYPE_VOID);
+			if (value != nullptr) {
+				inst->operands.push_back(value);
+			}
+
+			// whatever follows is unreachable, it still needs a block to go into
+			begin(m_Function->create_block());
+			return;
+		}
+		case NodeType::Annotation:
+		case NodeType::CBlock:
+			fail();
+			return;
+		default:
+			if (as_typed(node) == nullptr) {
+				fail();
+				return;
+			}
+			expression(node);
+			return;
+		}
+	}
+
+	void IrBuilder::block(StatementBlockNode* node) {
+		size_t frame = m_Bindings.size();
+		for (auto& child : node->statements) {
+			statement(child);
+		}
+		m_Bindings.resize(frame);
+	}
+
+	void IrBuilder::if_statement(IfNode* node) {
+		IrInstruction* condition = expression(node->condition);
+		if (condition == nullptr) {
+			return;
+		}
+
+		IrBlock* then_block = m_Function->create_block();
+		IrBlock* else_block = node->elseBranch != nullptr ? m_Function->create_block() : nullptr;
+		IrBlock* merge = m_Function->create_block();
+		branch(condition, then_block, else_block != nullptr ? else_block : merge, node->hint);
+		m_Block->terminator()->profile_counter = node->profile_counter;
+
+		begin(then_block);
+		if (node->body != nullptr) {
+			block(node->body);
+		}
+		jump(merge);
+
+		if (else_block != nullptr) {
+			begin(else_block);
+			if (node->elseBranch->ifBranch != nullptr) {
+				if_statement(node->elseBranch->ifBranch);
+			}
+			else if (node->elseBranch->body != nullptr) {
+				block(node->elseBranch->body);
+			}
+			if (m_Failed) {
+				return;
+			}
+			jump(merge);
+		}
+
+		begin(merge);
+	}
+
+	void IrBuilder::for_statement(ForNode* node) {
+		size_t frame = m_Bindings.size();
+		if (node->init != nullptr) {
+			statement(node->init);
+		}
+
+		IrBlock* header = m_Function->create_block();
+		IrBlock* body = m_Function->create_block();
+		IrBlock* step = m_Function->create_block();
+		IrBlock* exit = m_Function->create_block();
+
+		jump(header);
+		begin(header);
+		if (node->condition != nullptr) {
+			IrInstruction* condition = expression(node->condition);
+			if (condition == nullptr) {
+				return;
+			}
+			branch(condition, body, exit);
+		}
+		else {
+			jump(body);
+		}
+
+		begin(body);
+		block(node->body);
+		jump(step);
+
+		begin(step);
+		if (node->step != nullptr) {
+			expression(node->step);
+		}
+		jump(header);
+
+		begin(exit);
+		m_Bindings.resize(frame);
+	}
+
+	void IrBuilder::variable_decl(VariableDeclNode* node) {
+		if (!is_scalar(node->type)) {
+			fail();
+			return;
+		}
+
+		// the initializer still sees the names the declaration shadows
+		IrInstruction* value = nullptr;
+		if (node->default_value != nullptr) {
+			value = emit_convert(expression(node->default_value), node->type);
+			if (value == nullptr) {
+				return;
+			}
+		}
+
+		IrInstruction* slot = declare(node->var_name, node->type);
+		if (value != nullptr) {
+			IrInstruction* store = emit(IrOp::Store, TYPE_VOID);
+			store->operands = { slot, value };
+		}
+	}
+
+	IrInstruction* IrBuilder::expression(AstNode* node) {
+		if (m_Failed || node == nullptr) {
+			return fail();
+		}
+
+		switch (node->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar: {
+			Constant value;
+			if (!constant_of(node, value)) {
+				return fail();
+			}
+			return emit_const(value);
+		}
+		case NodeType::Variable: {
+			IrInstruction* slot = lookup(node);
+			if (slot == nullptr) {
+				return nullptr;
+			}
+			IrInstruction* load = emit(IrOp::Load, slot->type);
+			load->operands.push_back(slot);
+			return load;
+		}
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			if (op->resolved_operator == nullptr || op->resolved_operator->overload_function != nullptr) {
+				return fail();
+			}
+			if (op->m_Operator == OperatorID::LogicAnd || op->m_Operator == OperatorID::LogicOr) {
+				return logic(op);
+			}
+			if (is_assignment(op->m_Operator)) {
+				return assignment(op);
+			}
+			return binary(op);
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			if (op->resolved_operator == nullptr || op->resolved_operator->overload_function != nullptr) {
+				return fail();
+			}
+			return unary(op);
+		}
+		case NodeType::FunctionCall:
+			return call(static_cast<FunctionCallNode*>(node));
+		default:
+			return fail();
+		}
+	}
+
+	static bool is_comparison(OperatorID op) {
+		switch (op) {
+		case OperatorID::Equals:
+		case OperatorID::NotEquals:
+		case OperatorID::LessThan:
+		case OperatorID::GreaterThan:
+		case OperatorID::LessEquals:
+		case OperatorID::GreaterEquals:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// the operator a compound assignment applies, Undefined for the rest
+	static OperatorID compound_operator(OperatorID op) {
+		switch (op) {
+		case OperatorID::AddAssign: return OperatorID::Add;
+		case OperatorID::SubAssign: return OperatorID::Sub;
+		case OperatorID::MulAssign: return OperatorID::Mul;
+		case OperatorID::DivAssign: return OperatorID::Div;
+		case OperatorID::ModAssign: return OperatorID::Mod;
+		case OperatorID::AndAssign: return OperatorID::BinaryAnd;
+		case OperatorID::OrAssign: return OperatorID::BinaryOr;
+		case OperatorID::XorAssign: return OperatorID::BinaryXor;
+		case OperatorID::LeftShiftAssign: return OperatorID::LeftShift;
+		case OperatorID::RightShiftAssign: return OperatorID::RightShift;
+		default: return OperatorID::Undefined;
+		}
+	}
+
+	// type of lhs op rhs in C, 0 for operators the IR does not cover
+	static _type_id binary_type(OperatorID op, _type_id lhs, _type_id rhs) {
+		bool floating = promoted(lhs) == TYPE_F32 || promoted(lhs) == TYPE_F64 || promoted(rhs) == TYPE_F32 || promoted(rhs) == TYPE_F64;
+		switch (op) {
+		case OperatorID::Add:
+		case OperatorID::Sub:
+		case OperatorID::Mul:
+		case OperatorID::Div:
+			return arithmetic_type(lhs, rhs);
+		case OperatorID::Mod:
+		case OperatorID::BinaryAnd:
+		case OperatorID::BinaryOr:
+		case OperatorID::BinaryXor:
+			return floating ? 0 : arithmetic_type(lhs, rhs);
+		case OperatorID::LeftShift:
+		case OperatorID::RightShift:
+			return floating ? 0 : promoted(lhs);
+		default:
+			return is_comparison(op) ? TYPE_BOOL : 0;
+		}
+	}
+
+	IrInstruction* IrBuilder::binary(BinaryOperator* node) {
+		IrInstruction* lhs = expression(node->m_Lhs);
+		IrInstruction* rhs = expression(node->m_Rhs);
+		if (lhs == nullptr || rhs == nullptr) {
+			return fail();
+		}
+
+		_type_id type = binary_type(node->m_Operator, lhs->type, rhs->type);
+		if (type == 0) {
+			return fail();
+		}
+
+		IrInstruction* inst = emit(IrOp::Binary, type);
+		inst->oper = node->m_Operator;
+		inst->operands = { lhs, rhs };
+		return inst;
+	}
+
+	IrInstruction* IrBuilder::unary(UnaryOperator* node) {
+		switch (node->m_Operator) {
+		case OperatorID::Negative:
+		case OperatorID::Not:
+		case OperatorID::BinaryNot: {
+			IrInstruction* value = expression(node->m_Child);
+			if (value == nullptr) {
+				return nullptr;
+			}
+			bool floating = value->type == TYPE_F32 || value->type == TYPE_F64;
+			if (node->m_Operator == OperatorID::BinaryNot && floating) {
+				return fail();
+			}
+
+			IrInstruction* inst = emit(IrOp::Unary, node->m_Operator == OperatorID::Not ? TYPE_BOOL : promoted(value->type));
+			inst->oper = node->m_Operator;
+			inst->operands.push_back(value);
+			return inst;
+		}
+		case OperatorID::PreInc:
+		case OperatorID::PreDec:
+		case OperatorID::PostInc:
+		case OperatorID::PostDec: {
+			IrInstruction* slot = lookup(node->m_Child);
+			if (slot == nullptr) {
+				return nullptr;
+			}
+
+			IrInstruction* old = emit(IrOp::Load, slot->type);
+			old->operands.push_back(slot);
+
+			Constant one;
+			one.type = TYPE_I32;
+			one.bits = 1;
+
+			bool increment = node->m_Operator == OperatorID::PreInc || node->m_Operator == OperatorID::PostInc;
+			IrInstruction* step = emit(IrOp::Binary, arithmetic_type(slot->type, TYPE_I32));
+			step->oper = increment ? OperatorID::Add : OperatorID::Sub;
+			step->operands = { old, emit_const(one) };
+
+			IrInstruction* value = emit_convert(step, slot->type);
+			IrInstruction* store = emit(IrOp::Store, TYPE_VOID);
+			store->operands = { slot, value };
+
+			bool prefix = node->m_Operator == OperatorID::PreInc || node->m_Operator == OperatorID::PreDec;
+			return prefix ? value : old;
+		}
+		default:
+			return fail();
+		}
+	}
+
+	IrInstruction* IrBuilder::logic(BinaryOperator* node) {
+		bool is_and = node->m_Operator == OperatorID::LogicAnd;
+
+		IrInstruction* lhs = emit_convert(expression(node->m_Lhs), TYPE_BOOL);
+		if (lhs == nullptr) {
+			return nullptr;
+		}
+
+		// the value when the rhs is skipped
+		Constant shortcut;
+		shortcut.type = TYPE_I32;
+		shortcut.bits = is_and ? 0 : 1;
+		shortcut.is_bool = true;
+		IrInstruction* skipped = emit_const(shortcut);
+
+		IrBlock* from = m_Block;
+		IrBlock* rhs_block = m_Function->create_block();
+		IrBlock* merge = m_Function->create_block();
+		if (is_and) {
+			branch(lhs, rhs_block, merge);
+		}
+		else {
+			branch(lhs, merge, rhs_block);
+		}
+
+		begin(rhs_block);
+		IrInstruction* rhs = emit_convert(expression(node->m_Rhs), TYPE_BOOL);
+		if (rhs == nullptr) {
+			return nullptr;
+		}
+		IrBlock* rhs_end = m_Block;
+		jump(merge);
+
+		begin(merge);
+		IrInstruction* phi = emit(IrOp::Phi, TYPE_BOOL);
+		phi->operands = { skipped, rhs };
+		phi->incoming = { from, rhs_end };
+		return phi;
+	}
+
+	IrInstruction* IrBuilder::assignment(BinaryOperator* node) {
+		IrInstruction* slot = lookup(node->m_Lhs);
+		if (slot == nullptr) {
+			return nullptr;
+		}
+
+		IrInstruction* value;
+		if (node->m_Operator == OperatorID::Assign) {
+			value = expression(node->m_Rhs);
+		}
+		else {
+			OperatorID op = compound_operator(node->m_Operator);
+			IrInstruction* old = emit(IrOp::Load, slot->type);
+			old->operands.push_back(slot);
+
+			IrInstruction* rhs = expression(node->m_Rhs);
+			if (rhs == nullptr) {
+				return nullptr;
+			}
+
+			_type_id type = op != OperatorID::Undefined ? binary_type(op, old->type, rhs->type) : 0;
+			if (type == 0) {
+				return fail();
+			}
+			value = emit(IrOp::Binary, type);
+			value->oper = op;
+			value->operands = { old, rhs };
+		}
+
+		value = emit_convert(value, slot->type);
+		if (value == nullptr) {
+			return nullptr;
+		}
+		IrInstruction* store = emit(IrOp::Store, TYPE_VOID);
+		store->operands = { slot, value };
+		return value;
+	}
+
+	IrInstruction* IrBuilder::call(FunctionCallNode* node) {
+		for (auto moved : node->moves) {
+			if (moved) {
+				return fail();
+			}
+		}
+
+		_type_id type = node->resolved_type;
+		if (type != TYPE_VOID && !is_scalar(type)) {
+			return fail();
+		}
+
+		std::vector<IrInstruction*> args;
+		if (node->arguments != nullptr) {
+			for (auto& arg : node->arguments->args) {
+				IrInstruction* value = expression(arg);
+				if (value == nullptr) {
+					return nullptr;
+				}
+				args.push_back(value);
+			}
+		}
+
+		IrInstruction* inst = emit(IrOp::Call, type);
+		inst->operands = std::move(args);
+		inst->call = node;
+
+		auto callee = node->function_name != nullptr && node->function_name->nodes.size() == 1 ? m_Functions.find(node->function_name->nodes[0].bit) : m_Functions.end();
+		if (callee != m_Functions.end() && callee->second->noreturn) {
+			emit(IrOp::Unreachable, TYPE_VOID)->call = node;
+			begin(m_Function->create_block());
+		}
+		return inst;
+	}
+
+	void IrBuilder::add_function(FunctionDefinitionNode* func) {
+		m_Functions[func->functionName] = func;
+	}
+
+	IrFunction* IrBuilder::lower(FunctionDefinitionNode* func) {
+		if (func->templateParams != nullptr || func->body == nullptr || func->tail_loop) {
+			return nullptr;
+		}
+		if (func->returnType != TYPE_VOID && !is_scalar(func->returnType)) {
+			return nullptr;
+		}
+
+		size_t params = func->params != nullptr ? func->params->params.size() : 0;
+		for (size_t i = 0; i < params; i++) {
+			if (!is_scalar(func->params->params[i].type) || func->params->params[i].moves) {
+				return nullptr;
+			}
+		}
+
+		m_Function = new IrFunction(func);
+		m_Failed = false;
+		m_Bindings.clear();
+		begin(m_Function->create_block());
+
+		// parameters can be assigned like any other local
+		for (size_t i = 0; i < params; i++) {
+			auto& param = func->params->params[i];
+			IrInstruction* value = emit(IrOp::Param, param.type);
+			value->index = i;
+
+			IrInstruction* store = emit(IrOp::Store, TYPE_VOID);
+			store->operands = { declare(param.name, param.type), value };
+		}
+
+		block(func->body);
+
+		if (m_Failed) {
+			delete m_Function;
+			m_Function = nullptr;
+			return nullptr;
+		}
+
+		if (m_Block->terminator() == nullptr) {
+			emit(func->returnType == TYPE_VOID ? IrOp::Return : IrOp::Unreachable, TYPE_VOID);
+		}
+		m_Function->compute_predecessors();
+		return m_Function;
+	}
+
+	size_t LowerToIr(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		IrBuilder builder(ctx);
+		for (auto& funcDef : module->body->functions) {
+			builder.add_function(funcDef);
+		}
+
+		size_t lowered = 0;
+		for (auto& funcDef : module->body->functions) {
+			funcDef->ir = builder.lower(funcDef);
+			if (funcDef->ir != nullptr) {
+				lowered++;
+			}
+		}
+		return lowered;
+	}
+}
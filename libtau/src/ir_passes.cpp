@@ -0,0 +1,825 @@
+#include "core/ir_passes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace tau {
+
+	DominatorTree::DominatorTree(IrFunction& func) {
+		func.compute_predecessors();
+
+		size_t count = func.block_ids();
+		m_Order.assign(count, s_Unvisited);
+		m_Idom.assign(count, nullptr);
+		m_Children.assign(count, {});
+
+		// postorder without recursion, the second element is the next successor to visit
+		std::vector<IrBlock*> postorder;
+		std::vector<std::pair<IrBlock*, size_t>> stack{ { func.entry(), 0 } };
+		std::vector<bool> seen(count, false);
+		seen[func.entry()->id] = true;
+		while (!stack.empty()) {
+			auto& [block, next] = stack.back();
+			std::vector<IrBlock*> succs = block->successors();
+			if (next < succs.size()) {
+				IrBlock* succ = succs[next++];
+				if (!seen[succ->id]) {
+					seen[succ->id] = true;
+					stack.emplace_back(succ, 0);
+				}
+				continue;
+			}
+			postorder.push_back(block);
+			stack.pop_back();
+		}
+
+		m_Blocks.assign(postorder.rbegin(), postorder.rend());
+		for (size_t i = 0; i < m_Blocks.size(); i++) {
+			m_Order[m_Blocks[i]->id] = i;
+		}
+
+		IrBlock* entry = func.entry();
+		m_Idom[entry->id] = entry;
+
+		auto intersect = [&](IrBlock* a, IrBlock* b) {
+			while (a != b) {
+				while (m_Order[a->id] > m_Order[b->id]) {
+					a = m_Idom[a->id];
+				}
+				while (m_Order[b->id] > m_Order[a->id]) {
+					b = m_Idom[b->id];
+				}
+			}
+			return a;
+		};
+
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (size_t i = 1; i < m_Blocks.size(); i++) {
+				IrBlock* block = m_Blocks[i];
+				IrBlock* idom = nullptr;
+				for (auto& pred : block->predecessors) {
+					if (m_Idom[pred->id] == nullptr) {
+						continue;
+					}
+					idom = idom == nullptr ? pred : intersect(pred, idom);
+				}
+				if (m_Idom[block->id] != idom) {
+					m_Idom[block->id] = idom;
+					changed = true;
+				}
+			}
+		}
+
+		for (size_t i = 1; i < m_Blocks.size(); i++) {
+			m_Children[m_Idom[m_Blocks[i]->id]->id].push_back(m_Blocks[i]);
+		}
+	}
+
+	bool DominatorTree::dominates(IrBlock* a, IrBlock* b) const {
+		if (!is_reachable(b)) {
+			return false;
+		}
+		while (true) {
+			if (a == b) {
+				return true;
+			}
+			IrBlock* up = m_Idom[b->id];
+			if (up == b) {
+				return false;
+			}
+			b = up;
+		}
+	}
+
+	std::vector<std::vector<IrBlock*>> DominatorTree::frontiers() const {
+		std::vector<std::vector<IrBlock*>> frontier(m_Idom.size());
+		for (auto& block : m_Blocks) {
+			if (block->predecessors.size() < 2) {
+				continue;
+			}
+			for (auto& pred : block->predecessors) {
+				if (!is_reachable(pred)) {
+					continue;
+				}
+				for (IrBlock* runner = pred; runner != m_Idom[block->id]; runner = m_Idom[runner->id]) {
+					auto& list = frontier[runner->id];
+					if (std::find(list.begin(), list.end(), block) == list.end()) {
+						list.push_back(block);
+					}
+				}
+			}
+		}
+		return frontier;
+	}
+
+	static Constant zero_of(_type_id type) {
+		Constant value;
+		value.type = type == TYPE_BOOL ? TYPE_I32 : type;
+		value.is_bool = type == TYPE_BOOL;
+		return value;
+	}
+
+	static void erase_marked(IrBlock* block, std::unordered_set<IrInstruction*>& removed) {
+		std::erase_if(block->instructions, [&](IrInstruction* inst) { return removed.find(inst) != removed.end(); });
+	}
+
+	/*
+	Renames the loads and stores of the promoted slots along the dominator tree, carrying
+	the value each slot holds at the current point.
+	*/
+	class LocalPromoter {
+	public:
+		LocalPromoter(IrFunction& func, DominatorTree& dom, std::unordered_map<IrInstruction*, size_t>& slots, std::unordered_map<IrInstruction*, size_t>& phis)
+			: m_Function{ func }, m_Dominators{ dom }, m_Slots{ slots }, m_Phis{ phis }, m_Values(slots.size(), nullptr), m_Zeros(slots.size(), nullptr) {
+			m_Types.resize(slots.size());
+			for (auto& [slot, index] : slots) {
+				m_Types[index] = slot->type;
+			}
+		}
+
+		void rename(IrBlock* block) {
+			std::vector<IrInstruction*> saved = m_Values;
+
+			for (auto& inst : block->instructions) {
+				if (inst->op == IrOp::Phi) {
+					auto p = m_Phis.find(inst);
+					if (p != m_Phis.end()) {
+						m_Values[p->second] = inst;
+					}
+					continue;
+				}
+
+				size_t slot;
+				if (inst->op == IrOp::Load && slot_of(inst->operands[0], slot)) {
+					replacements[inst] = value_of(slot);
+					removed.insert(inst);
+				}
+				else if (inst->op == IrOp::Store && slot_of(inst->operands[0], slot)) {
+					m_Values[slot] = resolve_replacement(replacements, inst->operands[1]);
+					removed.insert(inst);
+				}
+			}
+
+			for (auto& succ : block->successors()) {
+				for (auto& inst : succ->instructions) {
+					if (inst->op != IrOp::Phi) {
+						break;
+					}
+					auto p = m_Phis.find(inst);
+					if (p != m_Phis.end()) {
+						inst->operands.push_back(value_of(p->second));
+						inst->incoming.push_back(block);
+					}
+				}
+			}
+
+			for (auto& child : m_Dominators.children(block)) {
+				rename(child);
+			}
+			m_Values = std::move(saved);
+		}
+
+		std::unordered_map<IrInstruction*, IrInstruction*> replacements;
+		std::unordered_set<IrInstruction*> removed;
+
+	private:
+		bool slot_of(IrInstruction* inst, size_t& slot) const {
+			auto s = m_Slots.find(inst);
+			if (s == m_Slots.end()) {
+				return false;
+			}
+			slot = s->second;
+			return true;
+		}
+
+		IrInstruction* value_of(size_t slot) {
+			if (m_Values[slot] != nullptr) {
+				return m_Values[slot];
+			}
+			if (m_Zeros[slot] == nullptr) {
+				IrInstruction* zero = m_Function.create(IrOp::Const, m_Types[slot]);
+				zero->value = zero_of(m_Types[slot]);
+				zero->block = m_Function.entry();
+				m_Function.entry()->instructions.insert(m_Function.entry()->instructions.begin(), zero);
+				m_Zeros[slot] = zero;
+			}
+			return m_Zeros[slot];
+		}
+
+	private:
+		IrFunction& m_Function;
+		DominatorTree& m_Dominators;
+		std::unordered_map<IrInstruction*, size_t>& m_Slots;
+		std::unordered_map<IrInstruction*, size_t>& m_Phis;
+
+		std::vector<IrInstruction*> m_Values;
+		std::vector<IrInstruction*> m_Zeros;
+		std::vector<_type_id> m_Types;
+	};
+
+	size_t PromoteLocals(IrFunction& func, ParserContext& ctx) {
+		func.remove_unreachable_blocks();
+
+		std::unordered_map<IrInstruction*, size_t> slots;
+		std::vector<IrInstruction*> allocas;
+		for (auto& inst : func.entry()->instructions) {
+			if (inst->op == IrOp::Alloca) {
+				slots[inst] = allocas.size();
+				allocas.push_back(inst);
+			}
+		}
+		if (allocas.empty()) {
+			return 0;
+		}
+
+		DominatorTree dom(func);
+		std::vector<std::vector<IrBlock*>> frontiers = dom.frontiers();
+
+		std::vector<std::vector<IrBlock*>> stores(allocas.size());
+		for (auto& block : func.blocks) {
+			for (auto& inst : block->instructions) {
+				auto s = inst->op == IrOp::Store ? slots.find(inst->operands[0]) : slots.end();
+				if (s != slots.end()) {
+					stores[s->second].push_back(block);
+				}
+			}
+		}
+
+		// a phi on the iterated dominance frontier of the blocks storing to the slot
+		std::unordered_map<IrInstruction*, size_t> phis;
+		for (size_t i = 0; i < allocas.size(); i++) {
+			std::vector<bool> has_phi(func.block_ids(), false);
+			std::vector<bool> queued(func.block_ids(), false);
+			std::vector<IrBlock*> worklist = stores[i];
+			for (auto& block : worklist) {
+				queued[block->id] = true;
+			}
+
+			while (!worklist.empty()) {
+				IrBlock* block = worklist.back();
+				worklist.pop_back();
+				for (auto& frontier : frontiers[block->id]) {
+					if (has_phi[frontier->id]) {
+						continue;
+					}
+					IrInstruction* phi = func.create(IrOp::Phi, allocas[i]->type);
+					phi->block = frontier;
+					frontier->instructions.insert(frontier->instructions.begin(), phi);
+					phis[phi] = i;
+					has_phi[frontier->id] = true;
+
+					if (!queued[frontier->id]) {
+						queued[frontier->id] = true;
+						worklist.push_back(frontier);
+					}
+				}
+			}
+		}
+
+		LocalPromoter promoter(func, dom, slots, phis);
+		promoter.rename(func.entry());
+
+		for (auto& slot : allocas) {
+			promoter.removed.insert(slot);
+		}
+		for (auto& block : func.blocks) {
+			erase_marked(block, promoter.removed);
+		}
+		func.replace_uses(promoter.replacements);
+		return allocas.size();
+	}
+
+	// removes the phis that merge a single value, returns how many
+	static size_t remove_trivial_phis(IrFunction& func, std::unordered_map<IrInstruction*, IrInstruction*>& replacements) {
+		size_t removed = 0;
+		bool progress = true;
+		while (progress) {
+			progress = false;
+			for (auto& block : func.blocks) {
+				std::unordered_set<IrInstruction*> trivial;
+				for (auto& inst : block->instructions) {
+					if (inst->op != IrOp::Phi) {
+						break;
+					}
+
+					IrInstruction* unique = nullptr;
+					bool merges = false;
+					for (auto& operand : inst->operands) {
+						operand = resolve_replacement(replacements, operand);
+						if (operand == inst || operand == unique) {
+							continue;
+						}
+						merges |= unique != nullptr;
+						unique = operand;
+					}
+
+					if (!merges && unique != nullptr) {
+						replacements[inst] = unique;
+						trivial.insert(inst);
+					}
+				}
+				if (!trivial.empty()) {
+					erase_marked(block, trivial);
+					removed += trivial.size();
+					progress = true;
+				}
+			}
+		}
+		return removed;
+	}
+
+	// appends blocks to their only predecessor when it has no other successor, returns how many
+	static size_t merge_blocks(IrFunction& func) {
+		size_t merged = 0;
+		for (size_t i = 1; i < func.blocks.size(); i++) {
+			IrBlock* block = func.blocks[i];
+			if (block->predecessors.size() != 1 || block == func.entry()) {
+				continue;
+			}
+			IrBlock* pred = block->predecessors[0];
+			IrInstruction* term = pred->terminator();
+			if (pred == block || term == nullptr || term->op != IrOp::Jump || block->instructions.front()->op == IrOp::Phi) {
+				continue;
+			}
+
+			pred->instructions.pop_back();
+			for (auto& inst : block->instructions) {
+				inst->block = pred;
+				pred->instructions.push_back(inst);
+			}
+			block->instructions.clear();
+
+			for (auto& succ : pred->successors()) {
+				for (auto& p : succ->predecessors) {
+					if (p == block) {
+						p = pred;
+					}
+				}
+				for (auto& inst : succ->instructions) {
+					if (inst->op != IrOp::Phi) {
+						break;
+					}
+					std::replace(inst->incoming.begin(), inst->incoming.end(), block, pred);
+				}
+			}
+
+			func.blocks.erase(func.blocks.begin() + i);
+			i--;
+			merged++;
+		}
+		return merged;
+	}
+
+	size_t EliminateDeadValues(IrFunction& func, ParserContext& ctx) {
+		size_t changed = 0;
+
+		for (auto& block : func.blocks) {
+			IrInstruction* term = block->terminator();
+			if (term == nullptr || term->op != IrOp::Branch) {
+				continue;
+			}
+
+			IrBlock* target;
+			if (term->targets[0] == term->targets[1]) {
+				target = term->targets[0];
+				target->remove_incoming(block);
+			}
+			else if (term->operands[0]->op == IrOp::Const) {
+				bool taken = constant_truthy(term->operands[0]->value);
+				target = term->targets[taken ? 0 : 1];
+				term->targets[taken ? 1 : 0]->remove_incoming(block);
+			}
+			else {
+				continue;
+			}
+
+			term->op = IrOp::Jump;
+			term->operands.clear();
+			term->targets[0] = target;
+			term->targets[1] = nullptr;
+			changed++;
+		}
+
+		changed += func.remove_unreachable_blocks();
+		func.compute_predecessors();
+
+		std::unordered_map<IrInstruction*, IrInstruction*> replacements;
+		while (true) {
+			size_t simplified = remove_trivial_phis(func, replacements) + merge_blocks(func);
+			if (simplified == 0) {
+				break;
+			}
+			changed += simplified;
+		}
+		func.replace_uses(replacements);
+
+		// everything an effect depends on is live
+		std::vector<bool> live(func.value_ids(), false);
+		std::vector<IrInstruction*> worklist;
+		for (auto& block : func.blocks) {
+			for (auto& inst : block->instructions) {
+				if (inst->is_terminator() || inst->op == IrOp::Store || inst->op == IrOp::Call) {
+					live[inst->id] = true;
+					worklist.push_back(inst);
+				}
+			}
+		}
+		while (!worklist.empty()) {
+			IrInstruction* inst = worklist.back();
+			worklist.pop_back();
+			for (auto& operand : inst->operands) {
+				if (!live[operand->id]) {
+					live[operand->id] = true;
+					worklist.push_back(operand);
+				}
+			}
+		}
+
+		for (auto& block : func.blocks) {
+			size_t before = block->instructions.size();
+			std::erase_if(block->instructions, [&](IrInstruction* inst) { return !live[inst->id]; });
+			changed += before - block->instructions.size();
+		}
+		return changed;
+	}
+
+	struct ValueKey {
+		IrOp op;
+		OperatorID oper;
+		_type_id type;
+		IrInstruction* lhs;
+		IrInstruction* rhs;
+		u64 bits;
+
+		inline bool operator==(const ValueKey& other) const {
+			return op == other.op && oper == other.oper && type == other.type && lhs == other.lhs && rhs == other.rhs && bits == other.bits;
+		}
+	};
+
+	struct ValueKeyHash {
+		inline size_t operator()(const ValueKey& key) const {
+			u64 h = (u64)key.op;
+			h = h * 0x9E3779B97F4A7C15ull ^ (u64)key.oper;
+			h = h * 0x9E3779B97F4A7C15ull ^ key.type;
+			h = h * 0x9E3779B97F4A7C15ull ^ (key.lhs != nullptr ? key.lhs->id : 0);
+			h = h * 0x9E3779B97F4A7C15ull ^ (key.rhs != nullptr ? key.rhs->id : 0);
+			h = h * 0x9E3779B97F4A7C15ull ^ key.bits;
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+
+	static bool is_commutative(OperatorID op) {
+		switch (op) {
+		case OperatorID::Add:
+		case OperatorID::Mul:
+		case OperatorID::Equals:
+		case OperatorID::NotEquals:
+		case OperatorID::BinaryAnd:
+		case OperatorID::BinaryOr:
+		case OperatorID::BinaryXor:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// turns inst into the constant its operands fold to, when C defines the result
+	static bool fold(IrInstruction* inst) {
+		for (auto& operand : inst->operands) {
+			if (operand->op != IrOp::Const) {
+				return false;
+			}
+		}
+
+		Constant out;
+		bool folded = false;
+		switch (inst->op) {
+		case IrOp::Binary:
+			folded = fold_binary(inst->oper, inst->operands[0]->value, inst->operands[1]->value, out);
+			break;
+		case IrOp::Unary:
+			folded = fold_unary(inst->oper, inst->operands[0]->value, out);
+			break;
+		case IrOp::Convert:
+			folded = convert_constant(inst->operands[0]->value, inst->type, out);
+			break;
+		default:
+			return false;
+		}
+
+		if (!folded || (out.is_bool ? TYPE_BOOL : out.type) != inst->type) {
+			return false;
+		}
+		inst->op = IrOp::Const;
+		inst->oper = OperatorID::Undefined;
+		inst->operands.clear();
+		inst->value = out;
+		return true;
+	}
+
+	static ValueKey key_of(IrInstruction* inst) {
+		ValueKey key{ inst->op, inst->oper, inst->type, nullptr, nullptr, 0 };
+		if (inst->op == IrOp::Const) {
+			if (inst->type == TYPE_F32 || inst->type == TYPE_F64) {
+				std::memcpy(&key.bits, &inst->value.real, sizeof(key.bits));
+			}
+			else {
+				key.bits = inst->value.bits;
+			}
+			return key;
+		}
+
+		key.lhs = inst->operands[0];
+		if (inst->operands.size() > 1) {
+			key.rhs = inst->operands[1];
+			if (is_commutative(inst->oper) && key.rhs->id < key.lhs->id) {
+				std::swap(key.lhs, key.rhs);
+			}
+		}
+		return key;
+	}
+
+	size_t NumberValues(IrFunction& func, ParserContext& ctx) {
+		DominatorTree dom(func);
+
+		std::unordered_map<ValueKey, IrInstruction*, ValueKeyHash> table;
+		std::unordered_map<IrInstruction*, IrInstruction*> replacements;
+		size_t changed = 0;
+
+		// the keys a block added are dropped again once its dominator subtree is done
+		std::vector<std::pair<IrBlock*, size_t>> stack{ { func.entry(), 0 } };
+		std::vector<ValueKey> scope;
+		std::vector<size_t> marks;
+		while (!stack.empty()) {
+			auto [block, state] = stack.back();
+			stack.pop_back();
+
+			if (state == 1) {
+				for (size_t i = marks.back(); i < scope.size(); i++) {
+					table.erase(scope[i]);
+				}
+				scope.resize(marks.back());
+				marks.pop_back();
+				continue;
+			}
+
+			marks.push_back(scope.size());
+			std::unordered_set<IrInstruction*> removed;
+			for (auto& inst : block->instructions) {
+				for (auto& operand : inst->operands) {
+					operand = resolve_replacement(replacements, operand);
+				}
+
+				if (inst->op != IrOp::Const && inst->op != IrOp::Binary && inst->op != IrOp::Unary && inst->op != IrOp::Convert) {
+					continue;
+				}
+				if (fold(inst)) {
+					changed++;
+				}
+
+				ValueKey key = key_of(inst);
+				auto found = table.find(key);
+				if (found != table.end()) {
+					replacements[inst] = found->second;
+					removed.insert(inst);
+					changed++;
+					continue;
+				}
+				table.emplace(key, inst);
+				scope.push_back(key);
+			}
+			erase_marked(block, removed);
+
+			stack.emplace_back(block, 1);
+			for (auto& child : dom.children(block)) {
+				stack.emplace_back(child, 0);
+			}
+		}
+
+		func.replace_uses(replacements);
+		return changed;
+	}
+
+	static bool is_signed_integer(_type_id type) {
+		return type == TYPE_I32 || type == TYPE_I64;
+	}
+
+	static bool is_float(_type_id type) {
+		return type == TYPE_F32 || type == TYPE_F64;
+	}
+
+	// whether computing inst is defined whatever its operands are
+	static bool is_speculatable(IrInstruction* inst) {
+		switch (inst->op) {
+		case IrOp::Const:
+			return true;
+		case IrOp::Convert:
+			return !is_float(inst->operands[0]->type) || is_float(inst->type) || inst->type == TYPE_BOOL;
+		case IrOp::Unary:
+			return inst->oper != OperatorID::Negative || !is_signed_integer(inst->type);
+		case IrOp::Binary:
+			switch (inst->oper) {
+			case OperatorID::Div:
+			case OperatorID::Mod:
+				return false;
+			case OperatorID::Add:
+			case OperatorID::Sub:
+			case OperatorID::Mul:
+				return !is_signed_integer(inst->type);
+			case OperatorID::LeftShift:
+			case OperatorID::RightShift: {
+				IrInstruction* amount = inst->operands[1];
+				u64 width = inst->type == TYPE_I64 || inst->type == TYPE_U64 ? 64 : 32;
+				bool in_range = amount->op == IrOp::Const && !is_float(amount->type) && amount->value.bits < width;
+				return in_range && (inst->oper == OperatorID::RightShift || !is_signed_integer(inst->type));
+			}
+			default:
+				return true;
+			}
+		default:
+			return false;
+		}
+	}
+
+	// a block of its own in front of the loop header, entered from everything outside the loop
+	static void insert_preheader(IrFunction& func, IrBlock* header, const std::vector<IrBlock*>& outside) {
+		IrBlock* preheader = func.create_block();
+		func.blocks.insert(std::find(func.blocks.begin(), func.blocks.end(), header), preheader);
+
+		for (auto& inst : header->instructions) {
+			if (inst->op != IrOp::Phi) {
+				break;
+			}
+
+			IrInstruction* merged = func.create(IrOp::Phi, inst->type);
+			merged->block = preheader;
+			for (size_t i = 0; i < inst->incoming.size(); i++) {
+				if (std::find(outside.begin(), outside.end(), inst->incoming[i]) == outside.end()) {
+					continue;
+				}
+				merged->operands.push_back(inst->operands[i]);
+				merged->incoming.push_back(inst->incoming[i]);
+				inst->operands.erase(inst->operands.begin() + i);
+				inst->incoming.erase(inst->incoming.begin() + i);
+				i--;
+			}
+
+			// a single incoming value needs no phi
+			IrInstruction* value = merged;
+			if (merged->operands.size() == 1) {
+				value = merged->operands[0];
+			}
+			else {
+				preheader->instructions.push_back(merged);
+			}
+			inst->operands.push_back(value);
+			inst->incoming.push_back(preheader);
+		}
+
+		IrInstruction* jump = func.create(IrOp::Jump, TYPE_VOID);
+		jump->targets[0] = header;
+		jump->block = preheader;
+		preheader->instructions.push_back(jump);
+
+		for (auto& pred : outside) {
+			pred->replace_successor(header, preheader);
+		}
+	}
+
+	struct Loop {
+		IrBlock* header = nullptr;
+		IrBlock* preheader = nullptr;
+		std::vector<bool> body;
+		size_t size = 0;
+	};
+
+	size_t HoistInvariants(IrFunction& func, ParserContext& ctx) {
+		func.remove_unreachable_blocks();
+
+		// loop headers are the blocks that dominate one of their predecessors
+		{
+			DominatorTree dom(func);
+			std::vector<std::pair<IrBlock*, std::vector<IrBlock*>>> headers;
+			for (auto& block : dom.blocks()) {
+				std::vector<IrBlock*> outside;
+				bool is_header = false;
+				for (auto& pred : block->predecessors) {
+					if (dom.dominates(block, pred)) {
+						is_header = true;
+					}
+					else if (std::find(outside.begin(), outside.end(), pred) == outside.end()) {
+						outside.push_back(pred);
+					}
+				}
+				if (!is_header) {
+					continue;
+				}
+
+				if (outside.size() != 1 || outside[0]->successors().size() != 1) {
+					headers.emplace_back(block, std::move(outside));
+				}
+			}
+			for (auto& [header, outside] : headers) {
+				insert_preheader(func, header, outside);
+			}
+		}
+
+		DominatorTree dom(func);
+
+		std::vector<Loop> loops;
+		for (auto& block : dom.blocks()) {
+			Loop loop;
+			loop.header = block;
+			loop.body.assign(func.block_ids(), false);
+			loop.body[block->id] = true;
+
+			std::vector<IrBlock*> worklist;
+			for (auto& pred : block->predecessors) {
+				if (dom.dominates(block, pred)) {
+					worklist.push_back(pred);
+				}
+				else {
+					loop.preheader = pred;
+				}
+			}
+			if (worklist.empty()) {
+				continue;
+			}
+
+			while (!worklist.empty()) {
+				IrBlock* member = worklist.back();
+				worklist.pop_back();
+				if (loop.body[member->id]) {
+					continue;
+				}
+				loop.body[member->id] = true;
+				for (auto& pred : member->predecessors) {
+					worklist.push_back(pred);
+				}
+			}
+			loop.size = std::count(loop.body.begin(), loop.body.end(), true);
+			loops.push_back(std::move(loop));
+		}
+
+		// inner loops first, what leaves them can then leave the outer loop too
+		std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.size < b.size; });
+
+		size_t hoisted = 0;
+		for (auto& loop : loops) {
+			std::vector<IrBlock*> blocks;
+			std::vector<IrBlock*> exiting;
+			bool has_call = false;
+			for (auto& block : dom.blocks()) {
+				if (!loop.body[block->id]) {
+					continue;
+				}
+				blocks.push_back(block);
+				for (auto& succ : block->successors()) {
+					if (!loop.body[succ->id]) {
+						exiting.push_back(block);
+						break;
+					}
+				}
+				for (auto& inst : block->instructions) {
+					has_call |= inst->op == IrOp::Call;
+				}
+			}
+
+			for (auto& block : blocks) {
+				// every trip through the loop that ends passes through block
+				bool always = !has_call && !exiting.empty();
+				for (auto& exit : exiting) {
+					always &= dom.dominates(block, exit);
+				}
+
+				std::vector<IrInstruction*> moved;
+				for (auto& inst : block->instructions) {
+					if (inst->op != IrOp::Const && inst->op != IrOp::Binary && inst->op != IrOp::Unary && inst->op != IrOp::Convert) {
+						continue;
+					}
+
+					bool invariant = true;
+					for (auto& operand : inst->operands) {
+						invariant &= !loop.body[operand->block->id];
+					}
+					if (!invariant || (!always && !is_speculatable(inst))) {
+						continue;
+					}
+
+					loop.preheader->insert(inst);
+					moved.push_back(inst);
+				}
+
+				if (!moved.empty()) {
+					std::unordered_set<IrInstruction*> removed(moved.begin(), moved.end());
+					erase_marked(block, removed);
+					hoisted += moved.size();
+				}
+			}
+		}
+		return hoisted;
+	}
+}
@@ -0,0 +1,261 @@
+#include "core/moves.h"
+
+namespace tau {
+
+	static Name root_of(VariableNode* var) {
+		return var->path()->nodes[0].bit;
+	}
+
+	void MoveChecker::error(const std::string& message) {
+		m_Context.errors.push_back(message);
+		m_ErrorCount++;
+	}
+
+	void MoveChecker::add_function(FunctionDefinitionNode* func) {
+		m_Functions[func->functionName] = func;
+	}
+
+	size_t MoveChecker::loop_of(Name name) const {
+		for (auto l = m_Locals.rbegin(); l != m_Locals.rend(); ++l) {
+			if (l->name == name) {
+				return l->loop;
+			}
+		}
+		return 0;
+	}
+
+	void MoveChecker::declare(Name name) {
+		m_Locals.push_back(Local{ name, m_Loop, m_Moved.find(name) != m_Moved.end() });
+		m_Moved.erase(name);
+	}
+
+	void MoveChecker::end_frame(size_t size) {
+		// names declared in the frame stop shadowing the outer ones
+		while (m_Locals.size() > size) {
+			Local& local = m_Locals.back();
+			if (local.shadowed_moved) {
+				m_Moved.insert(local.name);
+			}
+			else {
+				m_Moved.erase(local.name);
+			}
+			m_Locals.pop_back();
+		}
+	}
+
+	void MoveChecker::statement(AstNode* expr) {
+		if (expr == nullptr) {
+			return;
+		}
+
+		m_Uses.clear();
+		m_Moves.clear();
+		m_Assigned.clear();
+		visit(expr);
+
+		for (auto& [name, count] : m_Uses) {
+			if (m_Moved.find(name) != m_Moved.end()) {
+				error(name.str() + " is used after being moved in " + m_Function);
+				m_Moved.erase(name);
+			}
+		}
+
+		for (auto& move : m_Moves) {
+			if (m_Uses[move.name] > 1) {
+				error(move.name.str() + " is moved into " + move.callee + " and used again in the same statement in " + m_Function);
+			}
+			else if (loop_of(move.name) < m_Loop) {
+				error(move.name.str() + " is moved into " + move.callee + " inside a loop it was declared outside of in " + m_Function);
+			}
+			m_Moved.insert(move.name);
+		}
+
+		// assigning a moved-out local gives it a value again
+		for (auto& name : m_Assigned) {
+			m_Moved.erase(name);
+		}
+	}
+
+	void MoveChecker::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr || node->body == nullptr) {
+			return;
+		}
+
+		m_Function = node->functionName;
+		m_Moved.clear();
+		m_Locals.clear();
+		m_Loop = 0;
+		m_Reachable = true;
+
+		if (node->params != nullptr) {
+			for (auto& param : node->params->params) {
+				if (param.moves && !m_Context.types.is_struct(param.type)) {
+					error("@moves parameter " + param.name + " of " + node->functionName + " is not a struct value");
+				}
+				declare(param.name);
+			}
+		}
+
+		visit_block(node->body);
+	}
+
+	void MoveChecker::visit_block(StatementBlockNode* node) {
+		if (node == nullptr) {
+			return;
+		}
+
+		size_t frame = m_Locals.size();
+		for (auto& child : node->statements) {
+			switch (child->kind()) {
+			case NodeType::StatementBlock:
+			case NodeType::If:
+			case NodeType::For:
+			case NodeType::Return:
+			case NodeType::VariableDeclaration:
+				visit(child);
+				break;
+			default:
+				statement(child);
+				break;
+			}
+		}
+		end_frame(frame);
+	}
+
+	void MoveChecker::visit_if(IfNode* node) {
+		statement(node->condition);
+
+		std::unordered_set<Name> before = m_Moved;
+
+		visit_block(node->body);
+		std::unordered_set<Name> taken = std::move(m_Moved);
+		bool taken_reachable = m_Reachable;
+
+		m_Moved = std::move(before);
+		m_Reachable = true;
+		if (node->elseBranch != nullptr) {
+			if (node->elseBranch->ifBranch != nullptr) {
+				visit_if(node->elseBranch->ifBranch);
+			}
+			else {
+				visit_block(node->elseBranch->body);
+			}
+		}
+
+		// past the if a local is moved out if any branch that falls through moved it
+		if (!taken_reachable) {
+			return;
+		}
+		if (!m_Reachable) {
+			m_Moved = std::move(taken);
+			m_Reachable = true;
+			return;
+		}
+		m_Moved.insert(taken.begin(), taken.end());
+	}
+
+	void MoveChecker::visit_for(ForNode* node) {
+		size_t frame = m_Locals.size();
+		if (node->init != nullptr && node->init->kind() == NodeType::VariableDeclaration) {
+			visit_variable_decl(static_cast<VariableDeclNode*>(node->init));
+		}
+		else {
+			statement(node->init);
+		}
+
+		bool reachable = m_Reachable;
+		m_Loop++;
+		statement(node->condition);
+		visit_block(node->body);
+		statement(node->step);
+		m_Loop--;
+
+		m_Reachable = reachable;
+		end_frame(frame);
+	}
+
+	void MoveChecker::visit_return(ReturnNode* node) {
+		statement(node->returnValue);
+		m_Reachable = false;
+	}
+
+	void MoveChecker::visit_variable_decl(VariableDeclNode* node) {
+		statement(node->default_value);
+		declare(node->var_name);
+	}
+
+	void MoveChecker::visit_binary(BinaryOperator* node) {
+		VariableNode* var = node_cast<VariableNode>(node->m_Lhs);
+		if (node->m_Operator == OperatorID::Assign && var != nullptr && var->path()->nodes.size() == 1) {
+			visit(node->m_Rhs);
+			m_Assigned.push_back(root_of(var));
+			return;
+		}
+		AstVisitor<MoveChecker>::visit_binary(node);
+	}
+
+	void MoveChecker::visit_call(FunctionCallNode* node) {
+		if (node->arguments == nullptr) {
+			return;
+		}
+
+		FunctionDefinitionNode* callee = nullptr;
+		if (node->function_name != nullptr && node->function_name->nodes.size() == 1) {
+			auto f = m_Functions.find(node->function_name->nodes[0].bit);
+			if (f != m_Functions.end()) {
+				callee = f->second;
+			}
+		}
+
+		auto& args = node->arguments->args;
+		for (size_t i = 0; i < args.size(); i++) {
+			if (callee != nullptr && callee->params != nullptr && i < callee->params->params.size() && callee->params->params[i].moves) {
+				VariableNode* var = node_cast<VariableNode>(args[i]);
+				if (var != nullptr && var->path()->nodes.size() == 1) {
+					m_Moves.push_back(Move{ root_of(var), callee->functionName });
+				}
+				else if (args[i]->kind() != NodeType::FunctionCall) {
+					error("Argument " + std::to_string(i + 1) + " of " + callee->functionName + " is moved, pass a local or a temporary in " + m_Function);
+				}
+
+				node->moves.resize(args.size(), false);
+				node->moves[i] = true;
+			}
+			visit(args[i]);
+		}
+	}
+
+	void MoveChecker::visit_variable(VariableNode* node) {
+		if (node->path() != nullptr && !node->path()->nodes.empty()) {
+			m_Uses[root_of(node)]++;
+		}
+	}
+
+	void MoveChecker::visit_cblock(InlineCBlock* node) {
+		for (auto& tok : node->tokens) {
+			if (tok.type == TokenType::Identifier) {
+				m_Uses[Name{ tok.literal }]++;
+			}
+		}
+	}
+
+	bool CheckMoves(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return true;
+		}
+
+		MoveChecker checker(ctx);
+
+		for (auto& funcDef : module->body->functions) {
+			if (funcDef->templateParams == nullptr) {
+				checker.add_function(funcDef);
+			}
+		}
+
+		for (auto& funcDef : module->body->functions) {
+			checker.visit(funcDef);
+		}
+
+		return checker.error_count() == 0;
+	}
+}
@@ -0,0 +1,330 @@
+#include "core/null_check.h"
+
+#include <algorithm>
+
+namespace tau {
+
+	void NullCheckElider::add_function(FunctionDefinitionNode* func) {
+		m_Functions[func->functionName] = func;
+	}
+
+	bool NullCheckElider::is_known(AstNode* expr) const {
+		if (expr == nullptr) {
+			return false;
+		}
+
+		switch (expr->kind()) {
+		case NodeType::Annotation: {
+			// a literal count PromoteAllocations gave a local array always gets the array
+			AnnotationNode* annotation = static_cast<AnnotationNode*>(expr);
+			return annotation->annotation_type() == "not_null" ||
+				(annotation->stack_capacity != 0 && annotation->body()->kind() == NodeType::ImmediateInt);
+		}
+		case NodeType::UnaryOperator:
+			return static_cast<UnaryOperator*>(expr)->m_Operator == OperatorID::Reference;
+		case NodeType::Variable: {
+			Name name;
+			return local_name(expr, name) && m_Known.find(name) != m_Known.end();
+		}
+		default:
+			return false;
+		}
+	}
+
+	void NullCheckElider::expression(AstNode* expr) {
+		if (expr == nullptr) {
+			return;
+		}
+
+		WriteCollector writes;
+		writes.visit(expr);
+		for (auto& [name, count] : writes.written) {
+			m_Known.erase(name);
+		}
+
+		m_Gens.clear();
+		visit(expr);
+
+		// a name written twice, or written and checked, in one expression depends on C's evaluation order
+		for (auto& gen : m_Gens) {
+			if (writes.writes(gen.name) == (gen.assigned ? 1 : 0) && m_Escaped.find(gen.name) == m_Escaped.end()) {
+				m_Known.insert(gen.name);
+			}
+		}
+		m_Gens.clear();
+	}
+
+	bool NullCheckElider::null_check(AnnotationNode* node) {
+		auto& params = node->params();
+		for (size_t i = 0; i < params.size();) {
+			Name name;
+			if (!local_name(params[i], name)) {
+				i++;
+				continue;
+			}
+
+			if (m_Known.find(name) != m_Known.end()) {
+				delete params[i];
+				params.erase(params.begin() + i);
+				m_Elided++;
+				continue;
+			}
+
+			if (m_Escaped.find(name) == m_Escaped.end()) {
+				m_Known.insert(name);
+			}
+			i++;
+		}
+		return params.empty();
+	}
+
+	void NullCheckElider::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr || node->body == nullptr) {
+			return;
+		}
+
+		WriteCollector writes;
+		writes.visit(node->body);
+		m_Escaped = std::move(writes.escaped);
+
+		m_Known.clear();
+		m_Reachable = true;
+		for (auto& index : node->null_checks) {
+			Name name = node->params->params[index].name;
+			if (m_Escaped.find(name) == m_Escaped.end()) {
+				m_Known.insert(name);
+			}
+		}
+
+		visit_block(node->body);
+	}
+
+	void NullCheckElider::visit_block(StatementBlockNode* node) {
+		if (node == nullptr) {
+			return;
+		}
+
+		m_Frames.emplace_back();
+
+		auto& statements = node->statements;
+		for (size_t i = 0; i < statements.size();) {
+			AstNode* statement = statements[i];
+
+			switch (statement->kind()) {
+			case NodeType::Annotation:
+				if (static_cast<AnnotationNode*>(statement)->annotation_type() == "null_check" && null_check(static_cast<AnnotationNode*>(statement))) {
+					delete statement;
+					statements.erase(statements.begin() + i);
+					continue;
+				}
+				break;
+			case NodeType::StatementBlock:
+			case NodeType::If:
+			case NodeType::For:
+			case NodeType::Return:
+			case NodeType::VariableDeclaration:
+			case NodeType::CBlock:
+				visit(statement);
+				break;
+			default:
+				if (as_typed(statement) != nullptr) {
+					expression(statement);
+				}
+				else {
+					// nothing is known about statements this pass does not understand
+					m_Known.clear();
+				}
+				break;
+			}
+			i++;
+		}
+
+		end_frame();
+	}
+
+	void NullCheckElider::end_frame() {
+		// names declared in the frame stop shadowing the outer ones
+		std::vector<Shadowed> frame = std::move(m_Frames.back());
+		m_Frames.pop_back();
+		for (auto s = frame.rbegin(); s != frame.rend(); ++s) {
+			if (s->known) {
+				m_Known.insert(s->name);
+			}
+			else {
+				m_Known.erase(s->name);
+			}
+		}
+	}
+
+	void NullCheckElider::visit_if(IfNode* node) {
+		expression(node->condition);
+
+		std::unordered_set<Name> before = m_Known;
+
+		visit_block(node->body);
+		std::unordered_set<Name> taken = std::move(m_Known);
+		bool taken_reachable = m_Reachable;
+
+		m_Known = std::move(before);
+		m_Reachable = true;
+		if (node->elseBranch != nullptr) {
+			if (node->elseBranch->ifBranch != nullptr) {
+				visit_if(node->elseBranch->ifBranch);
+			}
+			else {
+				visit_block(node->elseBranch->body);
+			}
+		}
+
+		if (!taken_reachable) {
+			return;
+		}
+		if (!m_Reachable) {
+			m_Known = std::move(taken);
+			m_Reachable = true;
+			return;
+		}
+
+		for (auto it = m_Known.begin(); it != m_Known.end();) {
+			if (taken.find(*it) == taken.end()) {
+				it = m_Known.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	void NullCheckElider::visit_for(ForNode* node) {
+		m_Frames.emplace_back();
+		if (node->init != nullptr && node->init->kind() == NodeType::VariableDeclaration) {
+			visit_variable_decl(static_cast<VariableDeclNode*>(node->init));
+		}
+		else {
+			expression(node->init);
+		}
+
+		// what holds on every pass is what the loop never writes, the body may run any number of times
+		WriteCollector writes;
+		writes.visit(node->condition);
+		writes.visit(node->step);
+		writes.visit(node->body);
+		if (writes.inline_c) {
+			m_Known.clear();
+		}
+		for (auto& [name, count] : writes.written) {
+			m_Known.erase(name);
+		}
+
+		std::unordered_set<Name> invariant = m_Known;
+		bool reachable = m_Reachable;
+
+		visit(node->condition);
+		visit_block(node->body);
+		m_Known = invariant;
+		visit(node->step);
+
+		m_Known = std::move(invariant);
+		m_Reachable = reachable;
+		end_frame();
+	}
+
+	void NullCheckElider::visit_return(ReturnNode* node) {
+		expression(node->returnValue);
+		m_Reachable = false;
+	}
+
+	void NullCheckElider::visit_variable_decl(VariableDeclNode* node) {
+		expression(node->default_value);
+		bool known = is_known(node->default_value);
+
+		if (!m_Frames.empty()) {
+			m_Frames.back().push_back(Shadowed{ node->var_name, m_Known.find(node->var_name) != m_Known.end() });
+		}
+
+		m_Known.erase(node->var_name);
+		if (known && m_Escaped.find(node->var_name) == m_Escaped.end()) {
+			m_Known.insert(node->var_name);
+		}
+	}
+
+	void NullCheckElider::visit_binary(BinaryOperator* node) {
+		// the right side of && and || may not run, what it proves does not outlive it
+		if (node->m_Operator == OperatorID::LogicAnd || node->m_Operator == OperatorID::LogicOr) {
+			visit(node->m_Lhs);
+			m_Conditional++;
+			visit(node->m_Rhs);
+			m_Conditional--;
+			return;
+		}
+
+		AstVisitor<NullCheckElider>::visit_binary(node);
+
+		Name name;
+		if (node->m_Operator == OperatorID::Assign && m_Conditional == 0 && local_name(node->m_Lhs, name) && is_known(node->m_Rhs)) {
+			m_Gens.push_back(Gen{ name, true });
+		}
+	}
+
+	void NullCheckElider::visit_call(FunctionCallNode* node) {
+		AstVisitor<NullCheckElider>::visit_call(node);
+
+		if (node->function_name == nullptr || node->function_name->nodes.size() != 1) {
+			return;
+		}
+
+		auto f = m_Functions.find(node->function_name->nodes[0].bit);
+		if (f == m_Functions.end()) {
+			return;
+		}
+
+		FunctionDefinitionNode* callee = f->second;
+		std::vector<AstNode*> none;
+		std::vector<AstNode*>& args = node->arguments != nullptr ? node->arguments->args : none;
+
+		bool proven = true;
+		for (auto& index : callee->null_checks) {
+			proven &= index < args.size() && is_known(args[index]);
+		}
+
+		if (proven && !node->nonnull_proven) {
+			node->nonnull_proven = true;
+			node->unchecked = callee->passes_entry_checks(node);
+			m_Elided++;
+		}
+
+		// past the call the checked arguments are not null, or the callee aborted
+		if (m_Conditional == 0) {
+			for (auto& index : callee->null_checks) {
+				Name name;
+				if (index < args.size() && local_name(args[index], name)) {
+					m_Gens.push_back(Gen{ name, false });
+				}
+			}
+		}
+	}
+
+	void NullCheckElider::visit_cblock(InlineCBlock* node) {
+		m_Known.clear();
+	}
+
+	size_t ElideNullChecks(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		NullCheckElider elider(ctx);
+
+		for (auto& funcDef : module->body->functions) {
+			if (funcDef->templateParams == nullptr && !funcDef->null_checks.empty()) {
+				elider.add_function(funcDef);
+			}
+		}
+
+		for (auto& funcDef : module->body->functions) {
+			elider.visit(funcDef);
+		}
+
+		return elider.elided_count();
+	}
+}
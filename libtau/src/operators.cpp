@@ -0,0 +1,108 @@
+#include "core/operators.h"
+
+namespace tau {
+
+	// promotion preference for literals, widest signed type first
+	static constexpr _type_id s_IntPreference[] = { TYPE_I64, TYPE_U64, TYPE_I32, TYPE_U32, TYPE_I16, TYPE_U16, TYPE_I8, TYPE_U8 };
+	static constexpr _type_id s_FloatPreference[] = { TYPE_F64, TYPE_F32 };
+
+	OperatorTable::OperatorTable() {}
+
+	_type_id OperatorTable::literal_of(_type_id type, u32& rank) const {
+		for (u32 i = 0; i < sizeof(s_IntPreference) / sizeof(_type_id); i++) {
+			if (s_IntPreference[i] == type) {
+				rank = i;
+				return TYPE_STATIC_INT;
+			}
+		}
+		for (u32 i = 0; i < sizeof(s_FloatPreference) / sizeof(_type_id); i++) {
+			if (s_FloatPreference[i] == type) {
+				rank = i;
+				return TYPE_STATIC_FLOAT;
+			}
+		}
+		return 0;
+	}
+
+	void OperatorTable::promote(const OperatorKey& key, const void* entry, u32 rank, std::unordered_map<OperatorKey, Promoted, OperatorKeyHash>& index) {
+		auto f = index.find(key);
+		if (f == index.end() || rank < f->second.rank) {
+			index[key] = Promoted{ entry, rank };
+		}
+	}
+
+	void OperatorTable::add(const AllowedBinaryOperator& op) {
+		m_Binary.push_back(op);
+		const AllowedBinaryOperator* entry = &m_Binary.back();
+
+		OperatorKey key{ op.operator_, op.left_type, op.right_type };
+		if (m_BinaryIndex.find(key) == m_BinaryIndex.end()) {
+			m_BinaryIndex[key] = entry;
+		}
+
+		u32 left_rank = 0;
+		u32 right_rank = 0;
+		_type_id left_literal = literal_of(op.left_type, left_rank);
+		_type_id right_literal = literal_of(op.right_type, right_rank);
+
+		// a literal next to a typed operand only matches that exact type, the
+		// rank decides between the candidates when both operands are literals
+		if (left_literal != 0) {
+			promote({ op.operator_, left_literal, op.right_type }, entry, left_rank, m_BinaryPromoted);
+		}
+		if (right_literal != 0) {
+			promote({ op.operator_, op.left_type, right_literal }, entry, right_rank, m_BinaryPromoted);
+		}
+		if (left_literal != 0 && right_literal != 0) {
+			promote({ op.operator_, left_literal, right_literal }, entry, left_rank * 16 + right_rank, m_BinaryPromoted);
+		}
+	}
+
+	void OperatorTable::add(const AllowedUnaryOperator& op) {
+		m_Unary.push_back(op);
+		const AllowedUnaryOperator* entry = &m_Unary.back();
+
+		OperatorKey key{ op.operator_, op.value_type, 0 };
+		if (m_UnaryIndex.find(key) == m_UnaryIndex.end()) {
+			m_UnaryIndex[key] = entry;
+		}
+
+		u32 rank = 0;
+		_type_id literal = literal_of(op.value_type, rank);
+		if (literal != 0) {
+			promote({ op.operator_, literal, 0 }, entry, rank, m_UnaryPromoted);
+		}
+	}
+
+	const AllowedBinaryOperator* OperatorTable::find(OperatorID op, _type_id lhs, _type_id rhs) const {
+		OperatorKey key{ op, lhs, rhs };
+
+		auto f = m_BinaryIndex.find(key);
+		if (f != m_BinaryIndex.end()) {
+			return f->second;
+		}
+
+		auto p = m_BinaryPromoted.find(key);
+		if (p != m_BinaryPromoted.end()) {
+			return static_cast<const AllowedBinaryOperator*>(p->second.entry);
+		}
+
+		return nullptr;
+	}
+
+	const AllowedUnaryOperator* OperatorTable::find(OperatorID op, _type_id value) const {
+		OperatorKey key{ op, value, 0 };
+
+		auto f = m_UnaryIndex.find(key);
+		if (f != m_UnaryIndex.end()) {
+			return f->second;
+		}
+
+		auto p = m_UnaryPromoted.find(key);
+		if (p != m_UnaryPromoted.end()) {
+			return static_cast<const AllowedUnaryOperator*>(p->second.entry);
+		}
+
+		return nullptr;
+	}
+}
@@ -1,47 +1,108 @@
 #include "core/parser.h"
+#include "core/templates.h"
+
+#include <algorithm>
 
 namespace tau {
 
+	static inline size_t hash_symbol(Symbol name) {
+		return (size_t)(name * 0x9E3779B1u);
+	}
+
+	Scope::Scope() {
+		m_Slots.resize(64);
+	}
+
 	void Scope::begin() {
-		frames.push_back({});
+		m_Frames.push_back((u32)m_Entries.size());
 	}
+
 	void Scope::end() {
-		frames.pop_back();
+		if (m_Frames.empty()) {
+			return;
+		}
+
+		u32 frame_start = m_Frames.back();
+		m_Frames.pop_back();
+
+		while (m_Entries.size() > frame_start) {
+			Entry& entry = m_Entries.back();
+			m_Slots[probe(entry.name)].head = entry.shadowed;
+			m_Entries.pop_back();
+		}
 	}
 
-	bool Scope::exists(const std::string& name) {
-		for (auto f = frames.rbegin(); f != frames.rend(); ++f) {
-			auto r = (*f).find(name);
-			if (r != (*f).end()) {
-				return true;
-			}
+	size_t Scope::probe(Symbol name) const {
+		size_t mask = m_Slots.size() - 1;
+		size_t i = hash_symbol(name) & mask;
+		while (m_Slots[i].name != NULL_SYMBOL && m_Slots[i].name != name) {
+			i = (i + 1) & mask;
 		}
-		return false;
+		return i;
 	}
-	
-	ItemInfo Scope::get(const std::string& name) {
-		for (auto f = frames.rbegin(); f != frames.rend(); ++f) {
-			auto r = (*f).find(name);
-			if (r != (*f).end()) {
-				return r->second;
+
+	void Scope::grow() {
+		std::vector<Slot> old = std::move(m_Slots);
+		m_Slots.clear();
+		m_Slots.resize(old.size() * 2);
+
+		for (auto& slot : old) {
+			if (slot.name != NULL_SYMBOL) {
+				m_Slots[probe(slot.name)] = slot;
 			}
 		}
-		
-		return {};
 	}
 
-	void Scope::add(const std::string& name, const ItemInfo& info) {
-		if (frames.empty()) {
-			frames.push_back({});
+	bool Scope::exists(Symbol name) const {
+		return lookup(name) != nullptr;
+	}
+
+	bool Scope::exists(const Name& name) const {
+		return lookup(name.symbol()) != nullptr;
+	}
+
+	const ItemInfo* Scope::lookup(Symbol name) const {
+		if (name == NULL_SYMBOL) {
+			return nullptr;
+		}
+
+		const Slot& slot = m_Slots[probe(name)];
+		if (slot.head == NO_ENTRY) {
+			return nullptr;
+		}
+		return &m_Entries[slot.head].info;
+	}
+
+	const ItemInfo* Scope::lookup(const Name& name) const {
+		return lookup(name.symbol());
+	}
+
+	void Scope::add(Symbol name, const ItemInfo& info) {
+		// keep the load factor at or below one half
+		if ((m_SlotsUsed + 1) * 2 > m_Slots.size()) {
+			grow();
+		}
+
+		Slot& slot = m_Slots[probe(name)];
+		if (slot.name == NULL_SYMBOL) {
+			slot.name = name;
+			m_SlotsUsed++;
 		}
-		(*frames.rbegin())[name] = info;
+
+		m_Entries.push_back(Entry{ name, slot.head, info });
+		slot.head = (u32)(m_Entries.size() - 1);
+	}
+
+	void Scope::add(const Name& name, const ItemInfo& info) {
+		add(name.symbol(), info);
 	}
 
-	void Scope::add_variable(const std::string& name, _type_id type, bool is_pointer, bool is_optional) {
+	void Scope::add_variable(const Name& name, _type_id type, bool is_pointer, bool is_optional, bool is_indirect) {
 		ItemInfo info;
 		info.type_id = type;
 		info.is_pointer = is_pointer;
 		info.is_optional = is_optional;
+		info.is_indirect = is_indirect;
 
 		add(name, info);
 	}
@@ -50,46 +111,44 @@ namespace tau {
 		ItemInfo t;
 		t.is_primitive_type = true;
 
-		auto& types = TypeRegistry::instance();
-
-		t.type_id = types.get_id_from_name("void");
-		m_TypeScope.add("void", t);
+		t.type_id = TYPE_VOID;
+		m_TypeScope.add(Name{ "void" }, t);
 
-		t.type_id = types.get_id_from_name("i8");
-		m_TypeScope.add("i8", t);
+		t.type_id = TYPE_I8;
+		m_TypeScope.add(Name{ "i8" }, t);
 
-		t.type_id = types.get_id_from_name("i16");
-		m_TypeScope.add("i16", t);
+		t.type_id = TYPE_I16;
+		m_TypeScope.add(Name{ "i16" }, t);
 
-		t.type_id = types.get_id_from_name("i32");
-		m_TypeScope.add("i32", t);
+		t.type_id = TYPE_I32;
+		m_TypeScope.add(Name{ "i32" }, t);
 
-		t.type_id = types.get_id_from_name("i64");
-		m_TypeScope.add("i64", t);
+		t.type_id = TYPE_I64;
+		m_TypeScope.add(Name{ "i64" }, t);
 
-		t.type_id = types.get_id_from_name("u8");
-		m_TypeScope.add("u8", t);
+		t.type_id = TYPE_U8;
+		m_TypeScope.add(Name{ "u8" }, t);
 
-		t.type_id = types.get_id_from_name("u16");
-		m_TypeScope.add("u16", t);
+		t.type_id = TYPE_U16;
+		m_TypeScope.add(Name{ "u16" }, t);
 
-		t.type_id = types.get_id_from_name("u32");
-		m_TypeScope.add("u32", t);
+		t.type_id = TYPE_U32;
+		m_TypeScope.add(Name{ "u32" }, t);
 
-		t.type_id = types.get_id_from_name("u64");
-		m_TypeScope.add("u64", t);
+		t.type_id = TYPE_U64;
+		m_TypeScope.add(Name{ "u64" }, t);
 
-		t.type_id = types.get_id_from_name("f32");
-		m_TypeScope.add("f32", t);
+		t.type_id = TYPE_F32;
+		m_TypeScope.add(Name{ "f32" }, t);
 
-		t.type_id = types.get_id_from_name("f64");
-		m_TypeScope.add("f64", t);
+		t.type_id = TYPE_F64;
+		m_TypeScope.add(Name{ "f64" }, t);
 
-		t.type_id = types.get_id_from_name("char");
-		m_TypeScope.add("char", t);
+		t.type_id = TYPE_CHAR;
+		m_TypeScope.add(Name{ "char" }, t);
 
-		t.type_id = types.get_id_from_name("bool");
-		m_TypeScope.add("bool", t);
+		t.type_id = TYPE_BOOL;
+		m_TypeScope.add(Name{ "bool" }, t);
 
 	}
 	Parser::~Parser() {
@@ -101,12 +160,109 @@ namespace tau {
 	}
 	
 	ParserContext Parser::get_context() {
-		auto ctx = ParserContext{ TypeRegistry::instance(), GetAllowedOperators(), GetAllowedUnaryOperators() };
+		auto ctx = ParserContext{ TypeRegistry::instance(), GetOperatorTable() };
 		ctx.active_symbol_scope = &m_TypeScope;
+		ctx.template_params = &m_TemplateParams;
+		ctx.parsing_module = &m_ModuleName;
 
 		return ctx;
 	}
 
+	_type_id ParserContext::resolve_type(PathNode* path) {
+		_type_id type = resolve_named_type(path);
+
+		for (u32 i = 0; i < path->indirection && type != 0; i++) {
+			if (is_template_type(type)) {
+				errors.push_back("Pointers to template parameters are not supported yet: " + path->get_local_name());
+				return 0;
+			}
+			type = pointer_to(type);
+		}
+		return type;
+	}
+
+	_type_id ParserContext::pointer_to(_type_id pointee) {
+		_type_id pointer = types.pointer_to(pointee);
+
+		if (operators.find(OperatorID::Dereference, pointer) == nullptr) {
+			operators.add(AllowedUnaryOperator{ OperatorID::Reference, pointee, pointer });
+			operators.add(AllowedUnaryOperator{ OperatorID::Dereference, pointer, pointee });
+			operators.add(AllowedBinaryOperator{ OperatorID::Equals, pointer, pointer, TYPE_BOOL });
+			operators.add(AllowedBinaryOperator{ OperatorID::NotEquals, pointer, pointer, TYPE_BOOL });
+			operators.add(AllowedBinaryOperator{ OperatorID::Assign, pointer, pointer, pointer });
+
+			for (_type_id index : { TYPE_U8, TYPE_U16, TYPE_U32, TYPE_U64, TYPE_I8, TYPE_I16, TYPE_I32, TYPE_I64 }) {
+				operators.add(AllowedBinaryOperator{ OperatorID::ArrayAccess, pointer, index, pointee });
+			}
+		}
+		return pointer;
+	}
+
+	_type_id ParserContext::resolve_named_type(PathNode* path) {
+		if (path == nullptr || path->nodes.empty()) {
+			return 0;
+		}
+
+		PathArg& last = path->nodes.back();
+
+		if (template_params != nullptr && path->nodes.size() == 1 && last.args == nullptr) {
+			for (size_t i = 0; i < template_params->size(); i++) {
+				if ((*template_params)[i] == last.bit) {
+					return TEMPLATE_TYPE_BASE + i;
+				}
+			}
+		}
+
+		if (last.args != nullptr) {
+			std::vector<_type_id> args;
+			for (auto& arg : last.args->template_args) {
+				_type_id type = resolve_type(arg);
+				if (type == 0) {
+					return 0;
+				}
+				args.push_back(type);
+			}
+
+			// written with its module (mod.vector<T>), otherwise seen from the module being compiled
+			Name module = current_module != nullptr ? current_module->moduleName->get_full_name() : *parsing_module;
+			if (path->nodes.size() > 1) {
+				std::string written = path->nodes[0].bit.str();
+				for (size_t i = 1; i + 1 < path->nodes.size(); i++) {
+					written += "_" + path->nodes[i].bit;
+				}
+				module = Name{ written };
+			}
+
+			result<Name> key = TemplateCache::instance().qualify_struct(last.bit, module);
+			if (key.error_bit) {
+				errors.push_back(key.error);
+				return 0;
+			}
+
+			auto r = TemplateCache::instance().apply_struct(key.value, args, types);
+			if (r.error_bit) {
+				errors.push_back(r.error);
+				return 0;
+			}
+			return r.value;
+		}
+
+		// structs of the module being parsed are registered under their plain name, and the
+		// module is not known yet for get_full_name to qualify them
+		if (path->nodes.size() == 1 && last.args == nullptr) {
+			_type_id local = types.get_id_from_name(last.bit.str());
+			if (local != 0) {
+				return local;
+			}
+		}
+
+		// anything else needs the module to qualify it, which is only known after parsing
+		if (current_module == nullptr) {
+			return 0;
+		}
+		return types.get_id_from_name(path->get_full_name(*this).str());
+	}
+
 	AstNode* Parser::eval_ruleset(TokenStream& tokens, std::vector<Rule>& ruleset) {
 		ParserContext ctx = get_context();
 		TokenResultView view;
@@ -264,13 +420,105 @@ namespace tau {
 	}
 
 
+	// a condition the checked entry of a function can run: parameters, literals and operators that read nothing else
+	static bool is_entry_condition(AstNode* node, ParameterListNode* params) {
+		switch (node->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+			return true;
+		case NodeType::Variable: {
+			PathNode* path = static_cast<VariableNode*>(node)->path();
+			if (path->nodes.size() != 1) {
+				return false;
+			}
+			for (auto& param : params->params) {
+				if (param.name == path->nodes[0].bit) {
+					return true;
+				}
+			}
+			return false;
+		}
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			return !is_assignment(op->m_Operator) && op->m_Operator != OperatorID::ArrayAccess && op->m_Operator != OperatorID::Dot &&
+				is_entry_condition(op->m_Lhs, params) && is_entry_condition(op->m_Rhs, params);
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			return (op->m_Operator == OperatorID::Not || op->m_Operator == OperatorID::Negative || op->m_Operator == OperatorID::BinaryNot) &&
+				is_entry_condition(op->m_Child, params);
+		}
+		default:
+			return false;
+		}
+	}
+
 #define MOVE(ptr) ptr; ptr = nullptr
-#define MOVE_CAST(type, ptr) dynamic_cast<type*>(ptr); ptr = nullptr
+#define MOVE_CAST(type, ptr) node_cast<type>(ptr); ptr = nullptr
+
+	static StructDefNode* define_struct(ParserContext& ctx, OrphanTokens* token, StructMembersNode* members, const StructLayout& layout, TemplateParamsNode* templ, Visibility visibility) {
+		StructDefNode* _struct = nullptr;
+		try {
+			_struct = new StructDefNode(
+				Name{ token->tokens[0].literal },
+				members,
+				ctx.types,
+				layout,
+				templ
+			);
+
+			_struct->visibility = visibility;
+		}
+		catch (const std::string& err) {
+			std::cout << err << "\n\tAt struct definition in " << token->tokens[0].source_file << " on line " << token->tokens[0].row << ", " << token->tokens[0].col << "\n";
+		}
+
+		// generic structs become types only once applied to arguments, see TemplateCache
+		if (_struct != nullptr && templ != nullptr) {
+			StructTemplate generic;
+			generic.name = _struct->struct_name.bit;
+			generic.module = *ctx.parsing_module;
+			generic.param_count = templ->params.size();
+			generic.layout = layout;
+			for (auto& member : _struct->members->members) {
+				FieldDef field;
+				field.name = member->var_name;
+				field.type = member->type;
+				generic.fields.push_back(field);
+			}
+			TemplateCache::instance().add_struct(generic);
+		}
+
+		return _struct;
+	}
+
+	// cases are kept as members, the ones without a payload typed void
+	static StructMembersNode* add_enum_case(TokenResultView& view, _type_id type) {
+		OrphanTokens* nameToks = node_cast<OrphanTokens>(view.at("name"));
+
+		VariableDeclNode* var = new VariableDeclNode(Name{ nameToks->tokens[0].literal }, type);
+		var->visibility = Visibility::Public;
+
+		StructMembersNode* cases;
+		auto f = view.find("next_cases");
+		if (f != view.end()) {
+			cases = node_cast<StructMembersNode>(f->second);
+			view["next_cases"] = nullptr;
+		}
+		else {
+			cases = new StructMembersNode();
+		}
+		cases->members.insert(cases->members.begin(), var);
+
+		return cases;
+	}
 
 	void InitializeTauParser(Parser& parser) {
 		parser["INT"] = (begin()
 			* tok(TokenType::Integer, "value") / [](ParserContext& ctx, TokenResultView& view) {
-				OrphanTokens* tok = dynamic_cast<OrphanTokens*>(view.at("value"));
+				OrphanTokens* tok = node_cast<OrphanTokens>(view.at("value"));
 				StaticIntegerNode* node = new StaticIntegerNode((i64)atoll(std::string{ tok->tokens[0].literal.begin(), tok->tokens[0].literal.end() }.c_str()), "i64");
 				return node;
 			}
@@ -278,7 +526,7 @@ namespace tau {
 
 		parser["FLOAT"] = (begin()
 			* tok(TokenType::Float, "value") / [](ParserContext& ctx, TokenResultView& view) {
-				OrphanTokens* tok = dynamic_cast<OrphanTokens*>(view.at("value"));
+				OrphanTokens* tok = node_cast<OrphanTokens>(view.at("value"));
 				StaticFloatNode* node = new StaticFloatNode(atof(std::string{ tok->tokens[0].literal.begin(), tok->tokens[0].literal.end() }.c_str()), "f64");
 				return node;
 			}
@@ -286,7 +534,7 @@ namespace tau {
 
 		parser["STRING"] = (begin()
 			* tok(TokenType::String, "value") / [](ParserContext& ctx, TokenResultView& view) {
-				OrphanTokens* tok = dynamic_cast<OrphanTokens*>(view.at("value"));
+				OrphanTokens* tok = node_cast<OrphanTokens>(view.at("value"));
 				StaticStringNode* node = new StaticStringNode(tok->tokens[0].literal.substr(1, tok->tokens[0].literal.length() - 1).data(), "string");
 				return node;
 			}
@@ -294,7 +542,7 @@ namespace tau {
 
 		parser["CHAR"] = (begin()
 			* tok(TokenType::Char, "value") / [](ParserContext& ctx, TokenResultView& view) {
-				OrphanTokens* tok = dynamic_cast<OrphanTokens*>(view.at("value"));
+				OrphanTokens* tok = node_cast<OrphanTokens>(view.at("value"));
 
 				std::string_view literal = tok->tokens[0].literal;
 				char ch = 0;
@@ -331,7 +579,7 @@ namespace tau {
 		parser["TEMPLATE_PARAMS_EXT"] = (begin()
 			* lit(",") * tok(TokenType::Identifier, "param") * rule("TEMPLATE_PARAMS_EXT", "params", true)
 								/ [](auto& ctx, auto& view) {
-									OrphanTokens* param = dynamic_cast<OrphanTokens*>(view["param"]);
+									OrphanTokens* param = node_cast<OrphanTokens>(view["param"]);
 									AstNode* params = nullptr;
 
 									auto f = view.find("params");
@@ -341,14 +589,14 @@ namespace tau {
 									}
 
 									if (params != nullptr) {
-										TemplateParamsNode* as_params = dynamic_cast<TemplateParamsNode*>(params);
-										as_params->params.insert(as_params->params.begin(), std::string(param->tokens[0].literal.begin(), param->tokens[0].literal.end()));
+										TemplateParamsNode* as_params = node_cast<TemplateParamsNode>(params);
+										as_params->params.insert(as_params->params.begin(), Name{ param->tokens[0].literal });
 
 										return as_params;
 									}
 
 									TemplateParamsNode* tNode = new TemplateParamsNode();
-									tNode->params.push_back(std::string(param->tokens[0].literal.begin(), param->tokens[0].literal.end()));
+									tNode->params.push_back(Name{ param->tokens[0].literal });
 
 									return tNode;
 								}
@@ -357,36 +605,41 @@ namespace tau {
 		parser["TEMPLATE_PARAMS"] = (begin()
 			* lit("<") * tok(TokenType::Identifier, "param") * rule("TEMPLATE_PARAMS_EXT", "params", true) * lit(">")
 								/ [](auto& ctx, auto& view) {
-									OrphanTokens* param = dynamic_cast<OrphanTokens*>(view["param"]);
-									AstNode* params = nullptr;
+									OrphanTokens* param = node_cast<OrphanTokens>(view["param"]);
+									TemplateParamsNode* tNode = nullptr;
 
 									auto f = view.find("params");
 									if (f != view.end()) {
-										params = f->second;
-										view["args"] = nullptr;
+										tNode = node_cast<TemplateParamsNode>(f->second);
+										view["params"] = nullptr;
+										tNode->params.insert(tNode->params.begin(), Name{ param->tokens[0].literal });
 									}
-
-									if (params != nullptr) {
-										TemplateParamsNode* as_params = dynamic_cast<TemplateParamsNode*>(params);
-										as_params->params.insert(as_params->params.begin(), std::string(param->tokens[0].literal.begin(), param->tokens[0].literal.end()));
-
-										return as_params;
+									else {
+										tNode = new TemplateParamsNode();
+										tNode->params.push_back(Name{ param->tokens[0].literal });
 									}
 
-									TemplateParamsNode* tNode = new TemplateParamsNode();
-									tNode->params.push_back(std::string(param->tokens[0].literal.begin(), param->tokens[0].literal.end()));
+									// the rest of the definition resolves these names to TEMPLATE_TYPE_BASE + index,
+									// the definition's own action clears them again
+									if (tNode->params.size() > MAX_TEMPLATE_PARAMS) {
+										ctx.errors.push_back("Too many template parameters");
+									}
+									*ctx.template_params = tNode->params;
 
 									return tNode;
 								}
 		).end();
 
+		// TEMPLATE_ARGS: < TYPE {, TYPE} >
+		// arguments may be pointers to concrete types, option<i64*>, but not to a template
+		// parameter, option<T*> inside a generic is rejected when the type is resolved
 		parser["TEMPLATE_ARGS_EXT"] = (begin()
-			* lit(",") * rule("PATH", "t0") * rule("TEMPLATE_ARGS_EXT", "args", true)
+			* lit(",") * rule("TYPE", "t0") * rule("TEMPLATE_ARGS_EXT", "args", true)
 								/ [](auto& ctx, auto& view) {
 									AstNode* path = MOVE(view["t0"]);
 									AstNode* args = nullptr;
 
-									PathNode* as_path = dynamic_cast<PathNode*>(path);
+									PathNode* as_path = node_cast<PathNode>(path);
 
 									auto f = view.find("args");
 									if (f != view.end()) {
@@ -395,7 +648,7 @@ namespace tau {
 									}
 
 									if (args != nullptr) {
-										TemplateArgsNode* as_targs = dynamic_cast<TemplateArgsNode*>(args);
+										TemplateArgsNode* as_targs = node_cast<TemplateArgsNode>(args);
 
 										as_targs->template_args.insert(as_targs->template_args.begin(), as_path);
 
@@ -410,12 +663,12 @@ namespace tau {
 		).end();
 
 		parser["TEMPLATE_ARGS"] = (begin()
-			* lit("<") * rule("PATH", "t0") * rule("TEMPLATE_ARGS_EXT", "args", true) * lit(">")
+			* lit("<") * rule("TYPE", "t0") * rule("TEMPLATE_ARGS_EXT", "args", true) * lit(">")
 								/ [](auto& ctx, auto& view) {
 									AstNode* path = view["t0"]; view["t0"] = nullptr;
 									AstNode* args = nullptr;
 
-									PathNode* as_path = dynamic_cast<PathNode*>(path);
+									PathNode* as_path = node_cast<PathNode>(path);
 
 									auto f = view.find("args");
 									if (f != view.end()) {
@@ -424,7 +677,7 @@ namespace tau {
 									}
 
 									if (args != nullptr) {
-										TemplateArgsNode* as_targs = dynamic_cast<TemplateArgsNode*>(args);
+										TemplateArgsNode* as_targs = node_cast<TemplateArgsNode>(args);
 
 										as_targs->template_args.insert(as_targs->template_args.begin(), as_path);
 
@@ -445,7 +698,7 @@ namespace tau {
 									AstNode* bit_template = nullptr;
 									AstNode* ext = nullptr;
 
-									OrphanTokens* bit_tok = dynamic_cast<OrphanTokens*>(bit);
+									OrphanTokens* bit_tok = node_cast<OrphanTokens>(bit);
 
 									auto f = view.find("bit_template");
 									if (f != view.end()) {
@@ -460,11 +713,11 @@ namespace tau {
 									}
 
 									PathArg pbit;
-									pbit.bit = std::string{ bit_tok->tokens[0].literal.begin(), bit_tok->tokens[0].literal.end() };
-									pbit.args = (bit_template == nullptr) ? nullptr : dynamic_cast<TemplateArgsNode*>(bit_template);
+									pbit.bit = Name{ bit_tok->tokens[0].literal };
+									pbit.args = (bit_template == nullptr) ? nullptr : node_cast<TemplateArgsNode>(bit_template);
 
 									if (ext != nullptr) {
-										PathNode* _path = dynamic_cast<PathNode*>(ext);
+										PathNode* _path = node_cast<PathNode>(ext);
 										_path->nodes.insert(_path->nodes.begin(), pbit);
 
 										return _path;
@@ -483,7 +736,7 @@ namespace tau {
 									AstNode* bit_template = nullptr;
 									AstNode* ext = nullptr;
 
-									OrphanTokens* bit_tok = dynamic_cast<OrphanTokens*>(bit);
+									OrphanTokens* bit_tok = node_cast<OrphanTokens>(bit);
 
 									auto f = view.find("bit_template");
 									if (f != view.end()) {
@@ -498,11 +751,11 @@ namespace tau {
 									}
 
 									PathArg pbit;
-									pbit.bit = { bit_tok->tokens[0].literal.begin(), bit_tok->tokens[0].literal.end() };
-									pbit.args = (bit_template == nullptr) ? nullptr : dynamic_cast<TemplateArgsNode*>(bit_template);
+									pbit.bit = Name{ bit_tok->tokens[0].literal };
+									pbit.args = (bit_template == nullptr) ? nullptr : node_cast<TemplateArgsNode>(bit_template);
 
 									if (ext != nullptr) {
-										PathNode* _path = dynamic_cast<PathNode*>(ext);
+										PathNode* _path = node_cast<PathNode>(ext);
 										_path->nodes.insert(_path->nodes.begin(), pbit);
 
 										return _path;
@@ -514,6 +767,21 @@ namespace tau {
 									return path;
 								}
 		).end();
+
+		// TYPE: {PATH} [*] [*]
+		parser["TYPE"] = (begin()
+			* rule("PATH", "path") * lit("*", true, "pointer") * lit("*", true, "pointer_pointer")
+								/ [](auto& ctx, auto& view) {
+									PathNode* path = MOVE_CAST(PathNode, view["path"]);
+									if (ctx.flags.find("pointer") != ctx.flags.end()) {
+										path->indirection++;
+									}
+									if (ctx.flags.find("pointer_pointer") != ctx.flags.end()) {
+										path->indirection++;
+									}
+									return path;
+								}
+		).end();
 		
 		parser["PATH_SPEC_EXT"] = (begin()
 			* lit(".") * rule("PATH_SPEC", "ext") / [](auto& ctx, auto& view) { AstNode* ext = MOVE(view["ext"]); return ext; }
@@ -522,7 +790,7 @@ namespace tau {
 		parser["PATH_SPEC"] = (begin()
 			* tok(TokenType::Identifier, "bit") * rule("TEMPLATE_PARAMS", "template_bit", true) * rule("PATH_SPEC_EXT", "ext", true)
 								/ [](auto& ctx, auto& view) {
-									OrphanTokens* bit = dynamic_cast<OrphanTokens*>(view["bit"]);
+									OrphanTokens* bit = node_cast<OrphanTokens>(view["bit"]);
 									TemplateParamsNode* params = nullptr;
 									PathSpecNode* path = nullptr;
 
@@ -532,7 +800,7 @@ namespace tau {
 									}
 
 									PathSpecBit pbit = {
-										std::string{ bit->tokens[0].literal.begin(), bit->tokens[0].literal.end() },
+										Name{ bit->tokens[0].literal },
 										params
 									};
 
@@ -552,7 +820,7 @@ namespace tau {
 		).end();
 
 		parser["VAR"] = (begin() * rule("PATH", "varname") / [](ParserContext& ctx, TokenResultView& view) {
-			PathNode* tok = dynamic_cast<PathNode*>(view.at("varname")); view["varname"] = nullptr;
+			PathNode* tok = node_cast<PathNode>(view.at("varname")); view["varname"] = nullptr;
 			VariableNode* node = new VariableNode(tok);
 			return node;
 			}
@@ -569,51 +837,64 @@ namespace tau {
 		).end();
 
 		parser["VAR_DECL"] = (begin()
-			* rule("PATH", "type") * tok(TokenType::Identifier, "name") * lit("=") * rule("Term", "expr") * lit(";")
+			* rule("TYPE", "type") * tok(TokenType::Identifier, "name") * lit("=") * rule("Term", "expr") * lit(";")
 								/ [](auto& ctx, auto& view) {
-									PathNode* tyname = dynamic_cast<PathNode*>(view["type"]);
-									OrphanTokens* vname = dynamic_cast<OrphanTokens*>(view["name"]);
+									PathNode* tyname = node_cast<PathNode>(view["type"]);
+									OrphanTokens* vname = node_cast<OrphanTokens>(view["name"]);
 									AstNode* expr = MOVE(view["expr"]);
 
-									std::string full_type_name = tyname->get_full_name(ctx);
-									_type_id _id = ctx.types.get_id_from_name(full_type_name);
+									_type_id _id = ctx.resolve_type(tyname);
 
 									if (_id == 0) {
-										ctx.errors.push_back("Unkown type: " + full_type_name);
+										ctx.errors.push_back("Unkown type: " + tyname->get_full_name(ctx));
+									}
+
+									// @alloc(count) allocates count elements of what the declared pointer points to
+									AnnotationNode* alloc = node_cast<AnnotationNode>(expr);
+									if (alloc != nullptr && alloc->annotation_type() == "alloc") {
+										if (_id != 0 && !ctx.types.is_pointer(_id)) {
+											ctx.errors.push_back("@alloc initializes " + std::string{ vname->tokens[0].literal } + ", which is not a pointer");
+										}
+										alloc->value_type = _id;
 									}
 
-									VariableDeclNode* varNode = new VariableDeclNode(std::string(vname->tokens[0].literal.begin(), vname->tokens[0].literal.end()), _id);
+									VariableDeclNode* varNode = new VariableDeclNode(Name{ vname->tokens[0].literal }, _id);
 									varNode->default_value = expr;
 
 									return varNode;
 								}
-			% rule("PATH", "type") * tok(TokenType::Identifier, "name") * lit(";")
+			% rule("TYPE", "type") * tok(TokenType::Identifier, "name") * lit(";")
 								/ [](auto& ctx, auto& view) {
-									PathNode* tyname = dynamic_cast<PathNode*>(view["type"]);
-									OrphanTokens* vname = dynamic_cast<OrphanTokens*>(view["name"]);
+									PathNode* tyname = node_cast<PathNode>(view["type"]);
+									OrphanTokens* vname = node_cast<OrphanTokens>(view["name"]);
 
-									std::string full_type_name = tyname->get_full_name(ctx);
-									_type_id _id = ctx.types.get_id_from_name(full_type_name);
+									_type_id _id = ctx.resolve_type(tyname);
 
 									if (_id == 0) {
-										ctx.errors.push_back("Unknown type: " + full_type_name);
+										ctx.errors.push_back("Unknown type: " + tyname->get_full_name(ctx));
 									}
-									VariableDeclNode* varNode = new VariableDeclNode(std::string(vname->tokens[0].literal.begin(), vname->tokens[0].literal.end()), _id);
+									VariableDeclNode* varNode = new VariableDeclNode(Name{ vname->tokens[0].literal }, _id);
 
 									return varNode;	
 								}
 		).end();
 
+		parser["ARGS_EXT"] = (begin()
+			* lit(",") * rule("ARGS", "ext") / [](auto& ctx, auto& view) { AstNode* ext = MOVE(view["ext"]); return ext; }
+		).end();
+
+		// ARGS: {Term} [, {ARGS}], the last argument used to be parsed once more after {Term} , failed,
+		// which doubled the work at every level of f(g(h(x)))
 		parser["ARGS"] = (begin()
-			* rule("Term", "arg") * lit(",") * rule("ARGS", "ext")
+			* rule("Term", "arg") * rule("ARGS_EXT", "ext", true)
 								/ [](auto& ctx, auto& view) {
 									AstNode* arg = MOVE(view["arg"]);
 
 									ArgumentsNode* argsE;
 
 									auto f = view.find("ext");
-									if (f != view.end()) {
-										argsE = dynamic_cast<ArgumentsNode*>(f->second);
+									if (f != view.end() && f->second != nullptr) {
+										argsE = node_cast<ArgumentsNode>(f->second);
 										view["ext"] = nullptr;
 
 										argsE->args.insert(argsE->args.begin(), arg);
@@ -627,25 +908,17 @@ namespace tau {
 
 									return argsE;
 								}
-			% rule("Term", "arg")
-								/ [](auto& ctx, auto& view) {
-									AstNode* arg = MOVE(view["arg"]);
-									ArgumentsNode* argsE = new ArgumentsNode();
-									argsE->args.push_back(arg);
-									return argsE;
-								}
-
 		).end();
 
 		parser["FunctionCall"] = (begin()
 			* rule("PATH", "functionName") * lit("(") * rule("ARGS", "args", true) * lit(")") 
 								/ [](auto& ctx, auto& view) {
-									AstNode* nameRaw = MOVE(view["functionName"]); PathNode* name = dynamic_cast<PathNode*>(nameRaw);
+									AstNode* nameRaw = MOVE(view["functionName"]); PathNode* name = node_cast<PathNode>(nameRaw);
 									ArgumentsNode* args = nullptr;
 
 									auto f = view.find("args");
 									if (f != view.end()) {
-										args = dynamic_cast<ArgumentsNode*>(f->second);
+										args = node_cast<ArgumentsNode>(f->second);
 										view["args"] = nullptr;
 									}
 
@@ -656,61 +929,112 @@ namespace tau {
 		).end();
 
 		// Factor: ( {Term} )
+		//		 | @{annotation} ( {Term} )
 		//		 | {op} {Factor}  // << maybe this needs to be a term? 
-		//		 | {Value}
+		//		 | {Var} [ {Term} ]
+		//		 | {Var} ++ | {Var} --
+		//		 | {Value} [?]  // one alternative, a failed {Value} ? parsed every nested call twice
 		parser["Factor"] = (begin()
 			* lit("(") * rule("Term", "value") * lit(")")
 								/ [](auto& ctx, auto& view) {
 									AstNode* value = view["value"]; view["value"] = nullptr;
+									BinaryOperator* op = node_cast<BinaryOperator>(value);
+									if (op != nullptr) {
+										op->parenthesized = true;
+									}
 									return value;
 								}
+			% lit("@") * tok(TokenType::Identifier, "name") * lit("(") * rule("Term", "value") * lit(")")
+								/ [](auto& ctx, auto& view) {
+									OrphanTokens* name = node_cast<OrphanTokens>(view["name"]);
+									AstNode* value = MOVE(view["value"]);
+									std::string kind{ name->tokens[0].literal.begin(), name->tokens[0].literal.end() };
+
+									if (kind != "not_null" && kind != "alloc") {
+										ctx.errors.push_back("Unknown expression annotation @" + kind);
+									}
+									return new AnnotationNode(kind, {}, value);
+								}
 			% tok(TokenType::Operator, "op") * rule("Factor", "value") 
 								/ [](auto& ctx, auto& view) {
-									OrphanTokens* tok = dynamic_cast<OrphanTokens*>(view.at("op"));
+									OrphanTokens* tok = node_cast<OrphanTokens>(view.at("op"));
 									AstNode* value = view["value"]; view["value"] = nullptr;
 									OperatorID opID = get_unary_operator(tok->tokens[0].literal);
 									return new UnaryOperator(opID, value);
 								}
-			% rule("VALUE", "value") 
+			% rule("VAR", "array") * lit("[") * rule("Term", "index") * lit("]")
 								/ [](auto& ctx, auto& view) {
-									AstNode* value = view["value"]; view["value"] = nullptr;
+									AstNode* array = MOVE(view["array"]);
+									AstNode* index = MOVE(view["index"]);
+									return new BinaryOperator(OperatorID::ArrayAccess, array, index);
+								}
+			% rule("VAR", "value") * lit("++")
+								/ [](auto& ctx, auto& view) {
+									AstNode* value = MOVE(view["value"]);
+									return new UnaryOperator(OperatorID::PostInc, value);
+								}
+			% rule("VAR", "value") * lit("--")
+								/ [](auto& ctx, auto& view) {
+									AstNode* value = MOVE(view["value"]);
+									return new UnaryOperator(OperatorID::PostDec, value);
+								}
+			% rule("VALUE", "value") * lit("?", true, "propagate")
+								/ [](auto& ctx, auto& view) {
+									AstNode* value = MOVE(view["value"]);
+									if (ctx.flags.find("propagate") != ctx.flags.end()) {
+										value = new PropagateNode(value);
+									}
 									return value;
 								}
 		).end();
 
 
-		// Term : {Factor} {op} {Term}
-		//		| {Factor}
-		parser["Term"] = (begin()
-			* rule("Factor", "a") * tok(TokenType::Operator, "op") * rule("Term", "b")
+		// TermTail: {op} {Term}, the operator comes out with its left operand still missing
+		parser["TermTail"] = (begin()
+			* tok(TokenType::Operator, "op") * rule("Term", "b")
 								/ [](auto& ctx, auto& view) {
-									AstNode* a = view["a"]; view["a"] = nullptr;
-									AstNode* b = view["b"]; view["b"] = nullptr;
-									OrphanTokens* op = dynamic_cast<OrphanTokens*>(view.at("op"));
-									OperatorID opID = get_binary_operator(op->tokens[0].literal);
-
-									BinaryOperator* b_as_op = dynamic_cast<BinaryOperator*>(b);
-
-									BinaryOperator* thisOp = new BinaryOperator(opID, a, b);
+									AstNode* b = MOVE(view["b"]);
+									OrphanTokens* op = node_cast<OrphanTokens>(view.at("op"));
+									return new BinaryOperator(get_binary_operator(op->tokens[0].literal), nullptr, b);
+								}
+		).end();
 
-									if (b_as_op == nullptr) {
-										return thisOp;
+		// Term : {Factor} {TermTail}?
+		// the Factor is parsed once whether an operator follows or not, trying {Factor} {op} {Term}
+		// before {Factor} parsed it twice per level and nested parentheses took exponential time
+		parser["Term"] = (begin()
+			* rule("Factor", "a") * rule("TermTail", "tail", true)
+								/ [](auto& ctx, auto& view) {
+									AstNode* a = MOVE(view["a"]);
+									BinaryOperator* tail = node_cast<BinaryOperator>(view["tail"]);
+									if (tail == nullptr) {
+										return a;
 									}
-
-									int prec_b = get_operator_prec(b_as_op->m_Operator);
+									OperatorID opID = tail->m_Operator;
+									AstNode* b = tail->m_Rhs; tail->m_Rhs = nullptr;
+
+									/*
+									b is already grouped, a belongs to its leftmost operand. Walk down the left
+									edge of b past every operator that binds looser than op (or as loose, when op
+									groups left to right) and hang a op x where the walk stops.
+									*/
 									int prec = get_operator_prec(opID);
-
-									if (prec_b < prec) {
-										thisOp->m_Rhs = b_as_op->m_Lhs;
-										b_as_op->m_Lhs = thisOp;
-										return b_as_op;
+									AstNode** slot = &b;
+									while (true) {
+										BinaryOperator* b_as_op = node_cast<BinaryOperator>(*slot);
+										if (b_as_op == nullptr || b_as_op->parenthesized) {
+											break;
+										}
+
+										int prec_b = get_operator_prec(b_as_op->m_Operator);
+										if (prec_b < prec || (prec_b == prec && is_right_associative(opID))) {
+											break;
+										}
+										slot = &b_as_op->m_Lhs;
 									}
-									return thisOp;
-								}
-			% rule("Factor", "value") 
-								/ [](auto& ctx, auto& view) {
-									AstNode* value = view["value"]; view["value"] = nullptr;
-									return value;
+
+									*slot = new BinaryOperator(opID, a, *slot);
+									return b;
 								}
 		).end();
 
@@ -718,7 +1042,7 @@ namespace tau {
 		parser["Else"] = (begin()
 			* lit("else") * rule("If", "if")
 								/ [](auto& ctx, auto& view) {
-									IfNode* ifNode = dynamic_cast<IfNode*>(view["if"]); view["if"] = nullptr;
+									IfNode* ifNode = node_cast<IfNode>(view["if"]); view["if"] = nullptr;
 									ElseNode* elseNode = new ElseNode();
 									elseNode->ifBranch = ifNode;
 									elseNode->body = nullptr;
@@ -729,7 +1053,7 @@ namespace tau {
 									AstNode* body = MOVE(view["body"]);
 									ElseNode* elseNode = new ElseNode();
 									elseNode->ifBranch = nullptr;
-									elseNode->body = dynamic_cast<StatementBlockNode*>(body);
+									elseNode->body = node_cast<StatementBlockNode>(body);
 									return elseNode;
 								}
 		).end();
@@ -738,12 +1062,12 @@ namespace tau {
 			* lit("if") * lit("(") * rule("Term", "expr") * lit(")") * rule("STATEMENT_BODY", "body") * rule("Else", "else", true)
 								/ [](auto& ctx, auto& view) {
 									AstNode* expr = MOVE(view["expr"]);
-									StatementBlockNode* body = dynamic_cast<StatementBlockNode*>(view["body"]); view["body"] = nullptr;
+									StatementBlockNode* body = node_cast<StatementBlockNode>(view["body"]); view["body"] = nullptr;
 									ElseNode* elseN = nullptr;
 
 									auto f = view.find("else");
 									if (f != view.end()) {
-										elseN = dynamic_cast<ElseNode*>(f->second);
+										elseN = node_cast<ElseNode>(f->second);
 										view["else"] = nullptr;
 									}
 
@@ -756,11 +1080,71 @@ namespace tau {
 								}
 		).end();
 
+		parser["For"] = (begin()
+			* lit("for") * lit("(") * rule("VAR_DECL", "init") * rule("Term", "cond", true) * lit(";") * rule("Term", "step", true) * lit(")") * rule("STATEMENT_BODY", "body")
+								/ [](auto& ctx, auto& view) {
+									ForNode* loop = new ForNode();
+									loop->init = MOVE(view["init"]);
+									loop->body = MOVE_CAST(StatementBlockNode, view["body"]);
+
+									if (view.find("cond") != view.end()) {
+										loop->condition = MOVE(view["cond"]);
+									}
+									if (view.find("step") != view.end()) {
+										loop->step = MOVE(view["step"]);
+									}
+									return loop;
+								}
+			% lit("for") * lit("(") * rule("Term", "init", true) * lit(";") * rule("Term", "cond", true) * lit(";") * rule("Term", "step", true) * lit(")") * rule("STATEMENT_BODY", "body")
+								/ [](auto& ctx, auto& view) {
+									ForNode* loop = new ForNode();
+									loop->body = MOVE_CAST(StatementBlockNode, view["body"]);
+
+									if (view.find("init") != view.end()) {
+										loop->init = MOVE(view["init"]);
+									}
+									if (view.find("cond") != view.end()) {
+										loop->condition = MOVE(view["cond"]);
+									}
+									if (view.find("step") != view.end()) {
+										loop->step = MOVE(view["step"]);
+									}
+									return loop;
+								}
+		).end();
+
 		parser["STATEMENT"] = (begin()
 			* rule("If", "if") / [](auto& ctx, auto& view) { AstNode* ifNode = MOVE(view["if"]); return ifNode; }
+			% rule("For", "for") / [](auto& ctx, auto& view) { AstNode* loop = MOVE(view["for"]); return loop; }
 			% rule("InlineC", "cblock") / [](auto& ctx, auto& view) { AstNode* block = MOVE(view["cblock"]); return block; }
 			% rule("RETURN", "ret") / [](auto& ctx, auto& view) { AstNode* block = MOVE(view["ret"]); return block; }
 			% rule("VAR_DECL", "var") / [](auto& ctx, auto& view) { AstNode* vNode = MOVE(view["var"]); return vNode; }
+			% rule("ANNOTATION", "annotation") * lit(";")
+								/ [](auto& ctx, auto& view) {
+									AnnotationNode* annotation = MOVE_CAST(AnnotationNode, view["annotation"]);
+
+									if (annotation->annotation_type() == "pre_assert") {
+										if (annotation->params().size() != 1) {
+											ctx.errors.push_back("@pre_assert expects a single condition");
+										}
+										return annotation;
+									}
+
+									const std::string& kind = annotation->annotation_type();
+									if (kind == "free" && annotation->params().size() != 1) {
+										ctx.errors.push_back("@free expects a single variable");
+									}
+									else if ((kind != "null_check" && kind != "free") || annotation->params().empty()) {
+										ctx.errors.push_back("Unknown statement annotation @" + kind);
+									}
+									for (auto& param : annotation->params()) {
+										VariableNode* var = node_cast<VariableNode>(param);
+										if (var == nullptr || var->path()->nodes.size() != 1) {
+											ctx.errors.push_back("@" + kind + " expects variable names");
+										}
+									}
+									return annotation;
+								}
 			% rule("Term", "expr") * lit(";") / [](auto& ctx, auto& view) { AstNode* expr = MOVE(view["expr"]); return expr; }
 		).end();
 
@@ -771,7 +1155,7 @@ namespace tau {
 				
 									auto f = view.find("statements");
 									if (f != view.end()) {
-										StatementBlockNode* statements = dynamic_cast<StatementBlockNode*>(f->second);
+										StatementBlockNode* statements = node_cast<StatementBlockNode>(f->second);
 										view["statements"] = nullptr;
 
 										statements->statements.insert(statements->statements.begin(), statement);
@@ -790,21 +1174,18 @@ namespace tau {
 		).end();
 
 		parser["STRUCT_MEMBERS"] = (begin()
-			* lit("pub", true, "pub") * rule("PATH", "type") * tok(TokenType::Identifier, "name") * lit("=") * rule("Term", "expr") * lit(";") * rule("STRUCT_MEMBERS", "next_members", true)
+			* lit("pub", true, "pub") * rule("TYPE", "type") * tok(TokenType::Identifier, "name") * lit("=") * rule("Term", "expr") * lit(";") * rule("STRUCT_MEMBERS", "next_members", true)
 								/ [](ParserContext& ctx, TokenResultView& view) {
-									AstNode* type = MOVE(view["type"]); PathNode* ttype = dynamic_cast<PathNode*>(type);
+									AstNode* type = MOVE(view["type"]); PathNode* ttype = node_cast<PathNode>(type);
 									AstNode* expr = MOVE(view["expr"]);
-									OrphanTokens* nameToks = dynamic_cast<OrphanTokens*>(view.at("name"));
+									OrphanTokens* nameToks = node_cast<OrphanTokens>(view.at("name"));
 									Visibility visi = Visibility::Private;
 									if (ctx.flags.find("pub") != ctx.flags.end()) {
 										visi = Visibility::Public;
 									}
 
-									std::string varname = std::string{
-										nameToks->tokens[0].literal.begin(), nameToks->tokens[0].literal.end(),
-									};
-									std::string _typename = ttype->get_full_name(ctx);
-									_type_id type_id = ctx.types.get_id_from_name(_typename.c_str());
+									Name varname{ nameToks->tokens[0].literal };
+									_type_id type_id = ctx.resolve_type(ttype);
 
 									VariableDeclNode* var = new VariableDeclNode(varname, type_id);
 									var->visibility = visi;
@@ -813,7 +1194,7 @@ namespace tau {
 									auto f = view.find("next_members");
 									StructMembersNode* struct_members;
 									if (f != view.end()) {
-										struct_members = dynamic_cast<StructMembersNode*>(f->second);
+										struct_members = node_cast<StructMembersNode>(f->second);
 										view["next_members"] = nullptr;
 									}
 									else {
@@ -823,19 +1204,18 @@ namespace tau {
 
 									return struct_members;
 								}
-			% lit("pub", true, "pub") * rule("PATH", "type") * tok(TokenType::Identifier, "name") * lit(";") * rule("STRUCT_MEMBERS", "next_members", true)
+			% lit("pub", true, "pub") * rule("TYPE", "type") * tok(TokenType::Identifier, "name") * lit(";") * rule("STRUCT_MEMBERS", "next_members", true)
 								/ [](ParserContext& ctx, TokenResultView& view) {
-								AstNode* t = MOVE(view["type"]); PathNode* type = dynamic_cast<PathNode*>(t);
-								OrphanTokens* nameToks = dynamic_cast<OrphanTokens*>(view.at("name"));
+								AstNode* t = MOVE(view["type"]); PathNode* type = node_cast<PathNode>(t);
+								OrphanTokens* nameToks = node_cast<OrphanTokens>(view.at("name"));
 
 								Visibility visi = Visibility::Private;
 								if (ctx.flags.find("pub") != ctx.flags.end()) {
 									visi = Visibility::Public;
 								}
 
-								std::string varname = std::string{ nameToks->tokens[0].literal.begin(), nameToks->tokens[0].literal.end() };
-								std::string _typename = type->get_full_name(ctx);
-								_type_id type_id = ctx.types.get_id_from_name(_typename.c_str());
+								Name varname{ nameToks->tokens[0].literal };
+								_type_id type_id = ctx.resolve_type(type);
 
 								VariableDeclNode* var = new VariableDeclNode(varname, type_id);
 								var->visibility = visi;
@@ -843,7 +1223,7 @@ namespace tau {
 								auto f = view.find("next_members");
 								StructMembersNode* struct_members;
 								if (f != view.end()) {
-									struct_members = dynamic_cast<StructMembersNode*>(f->second);
+									struct_members = node_cast<StructMembersNode>(f->second);
 									view["next_members"] = nullptr;
 
 									struct_members->members.insert(struct_members->members.begin(), var);
@@ -859,8 +1239,63 @@ namespace tau {
 								}
 		).end();
 
+		parser["ANNOTATION"] = (begin()
+			* lit("@") * tok(TokenType::Identifier, "name") * lit("(") * rule("ARGS", "args") * lit(")")
+								/ [](auto& ctx, auto& view) {
+									OrphanTokens* name = node_cast<OrphanTokens>(view["name"]);
+									ArgumentsNode* args = MOVE_CAST(ArgumentsNode, view["args"]);
+
+									std::vector<AstNode*> params = std::move(args->args);
+									args->args.clear();
+									delete args;
+
+									return new AnnotationNode(std::string{ name->tokens[0].literal.begin(), name->tokens[0].literal.end() }, params, nullptr);
+								}
+			% lit("@") * tok(TokenType::Identifier, "name")
+								/ [](auto& ctx, auto& view) {
+									OrphanTokens* name = node_cast<OrphanTokens>(view["name"]);
+									return new AnnotationNode(std::string{ name->tokens[0].literal.begin(), name->tokens[0].literal.end() }, {}, nullptr);
+								}
+		).end();
+
+		parser["ANNOTATIONS"] = (begin()
+			* rule("ANNOTATION", "annotation") * rule("ANNOTATIONS", "next", true)
+								/ [](auto& ctx, auto& view) {
+									AstNode* annotation = MOVE(view["annotation"]);
+
+									ListNode* list;
+									auto f = view.find("next");
+									if (f != view.end()) {
+										list = node_cast<ListNode>(f->second);
+										view["next"] = nullptr;
+									}
+									else {
+										list = new ListNode();
+									}
+									list->entries.insert(list->entries.begin(), annotation);
+
+									return list;
+								}
+		).end();
+
+		// Name(payload type) or just Name, commas between cases and optionally after the last
+		parser["ENUM_CASES"] = (begin()
+			* tok(TokenType::Identifier, "name") * lit("(") * rule("TYPE", "type") * lit(")") * lit(",", true) * rule("ENUM_CASES", "next_cases", true)
+								/ [](ParserContext& ctx, TokenResultView& view) {
+									AstNode* type = MOVE(view["type"]);
+									_type_id type_id = ctx.resolve_type(node_cast<PathNode>(type));
+									delete type;
+
+									return add_enum_case(view, type_id);
+								}
+			% tok(TokenType::Identifier, "name") * lit(",", true) * rule("ENUM_CASES", "next_cases", true)
+								/ [](ParserContext& ctx, TokenResultView& view) {
+									return add_enum_case(view, TYPE_VOID);
+								}
+		).end();
+
 		parser["STRUCT_DEF"] = (begin()
-			* lit("pub", true, "pub") * lit("struct") * tok(TokenType::Identifier, "name") * lit("{") * rule("STRUCT_MEMBERS", "members") * lit("}")
+			* rule("ANNOTATIONS", "annotations", true) * lit("pub", true, "pub") * lit("struct") * tok(TokenType::Identifier, "name") * rule("TEMPLATE_PARAMS", "template", true) * lit("{") * rule("STRUCT_MEMBERS", "members") * lit("}")
 								/ [](auto& ctx, auto& view) {
 									AstNode* name = view["name"];
 									AstNode* members = MOVE(view["members"]);
@@ -870,30 +1305,72 @@ namespace tau {
 										visibility = Visibility::Public;
 									}
 
-									OrphanTokens* token = dynamic_cast<OrphanTokens*>(name);
+									OrphanTokens* token = node_cast<OrphanTokens>(name);
+
+									StructLayout layout;
+									auto a = view.find("annotations");
+									if (a != view.end() && a->second != nullptr) {
+										ListNode* annotations = node_cast<ListNode>(a->second);
+										for (auto& entry : annotations->entries) {
+											AnnotationNode* annotation = node_cast<AnnotationNode>(entry);
+											const std::string& kind = annotation->annotation_type();
+
+											if (kind == "reorder" && annotation->params().empty()) {
+												layout.reorder = true;
+											}
+											else if (kind == "packed" && annotation->params().empty()) {
+												layout.packed = true;
+											}
+											else if (kind == "align" && annotation->params().size() == 1) {
+												StaticIntegerNode* value = node_cast<StaticIntegerNode>(annotation->params()[0]);
+												if (value == nullptr || value->value() <= 0 || (value->value() & (value->value() - 1)) != 0) {
+													ctx.errors.push_back("@align expects a power of two at struct definition in " + std::string{ token->tokens[0].source_file } + " on line " + std::to_string(token->tokens[0].row));
+													continue;
+												}
+												layout.align = (size_t)value->value();
+											}
+											else {
+												ctx.errors.push_back("Unknown struct annotation @" + kind + " at struct definition in " + std::string{ token->tokens[0].source_file } + " on line " + std::to_string(token->tokens[0].row));
+											}
+										}
+									}
+
+									TemplateParamsNode* templ = nullptr;
+									auto t = view.find("template");
+									if (t != view.end()) {
+										templ = MOVE_CAST(TemplateParamsNode, view["template"]);
+									}
+									ctx.template_params->clear();
 
-									StructDefNode* _struct = nullptr;
-									try {
-										_struct = new StructDefNode(
-											std::string{ token->tokens[0].literal.begin(), token->tokens[0].literal.end() },
-											dynamic_cast<StructMembersNode*>(members),
-											ctx.types
-										);
+									return define_struct(ctx, token, node_cast<StructMembersNode>(members), layout, templ, visibility);
+								}
+			% lit("pub", true, "pub") * lit("enum") * tok(TokenType::Identifier, "name") * rule("TEMPLATE_PARAMS", "template", true) * lit("{") * rule("ENUM_CASES", "cases") * lit("}")
+								/ [](auto& ctx, auto& view) {
+									OrphanTokens* token = node_cast<OrphanTokens>(view["name"]);
+									AstNode* cases = MOVE(view["cases"]);
 
-										_struct->visibility = visibility;
+									Visibility visibility = Visibility::Private;
+									if (ctx.flags.find("pub") != ctx.flags.end()) {
+										visibility = Visibility::Public;
 									}
-									catch (const std::string& err) {
-										std::cout << err << "\n\tAt struct definition in " << token->tokens[0].source_file << " on line " << token->tokens[0].row << ", " << token->tokens[0].col << "\n";
+
+									TemplateParamsNode* templ = nullptr;
+									auto t = view.find("template");
+									if (t != view.end()) {
+										templ = MOVE_CAST(TemplateParamsNode, view["template"]);
 									}
+									ctx.template_params->clear();
 
-									return _struct;
+									StructLayout layout;
+									layout.variant = true;
+									return define_struct(ctx, token, node_cast<StructMembersNode>(cases), layout, templ, visibility);
 								}
 		).end();
 
 		parser["INCLUDE"] = (begin()
 			* lit("include") * lit("_C") * tok(TokenType::String, "include")
 								/ [](auto& ctx, auto& view) {
-									OrphanTokens* toks = dynamic_cast<OrphanTokens*>(view["include"]);
+									OrphanTokens* toks = node_cast<OrphanTokens>(view["include"]);
 
 									IncludeNode* include = new IncludeNode();
 									include->is_c_include = true;
@@ -914,44 +1391,51 @@ namespace tau {
 								}
 		).end();
 
-		parser["Params"] = (begin()
-			* rule("PATH", "type") * tok(TokenType::Identifier, "name") * rule("ParamsExt", "params", true)
-								/ [](auto& ctx, auto& view) {
-									PathNode* type = dynamic_cast<PathNode*>(view["type"]);
-									OrphanTokens* name = dynamic_cast<OrphanTokens*>(view["name"]);
+		// TYPE name, or TYPE @moves(name) for a parameter that takes over the caller's value
+		auto param = [](auto& ctx, auto& view) {
+			PathNode* type = node_cast<PathNode>(view["type"]);
+			OrphanTokens* name = node_cast<OrphanTokens>(view["name"]);
 
-									std::string _typename = type->get_full_name(ctx);
-									_type_id type_id = ctx.types.get_id_from_name(_typename.c_str());
+			_type_id type_id = ctx.resolve_type(type);
 
-									if (type_id == 0) {
-										ctx.errors.push_back("Unknown type: " + _typename);
-									}
+			if (type_id == 0) {
+				ctx.errors.push_back("Unknown type: " + type->get_full_name(ctx));
+			}
 
-									std::string varname = std::string(name->tokens[0].literal.begin(), name->tokens[0].literal.end());
+			Name varname{ name->tokens[0].literal };
 
-									Param p = { type_id, varname };
+			auto m = view.find("moved");
+			if (m != view.end() && node_cast<OrphanTokens>(m->second)->tokens[0].literal != "moves") {
+				ctx.errors.push_back("Unknown parameter annotation @" + std::string{ node_cast<OrphanTokens>(m->second)->tokens[0].literal } + " on " + varname.str());
+			}
 
-									auto f = view.find("params");
-									if (f != view.end()) {
-										ParameterListNode* params = dynamic_cast<ParameterListNode*>(f->second);
-										view["params"] = nullptr;
+			Param p = { type_id, varname, m != view.end() };
 
-										params->params.insert(params->params.begin(), p);
+			auto f = view.find("params");
+			if (f != view.end()) {
+				ParameterListNode* params = node_cast<ParameterListNode>(f->second);
+				view["params"] = nullptr;
 
-										return params;
-									}
+				params->params.insert(params->params.begin(), p);
+
+				return params;
+			}
 				
-									ParameterListNode* par = new ParameterListNode();
-									par->params.push_back(p);
+			ParameterListNode* par = new ParameterListNode();
+			par->params.push_back(p);
 
-									return par;
-								}
+			return par;
+		};
+
+		parser["Params"] = (begin()
+			* rule("TYPE", "type") * lit("@") * tok(TokenType::Identifier, "moved") * lit("(") * tok(TokenType::Identifier, "name") * lit(")") * rule("ParamsExt", "params", true) / param
+			% rule("TYPE", "type") * tok(TokenType::Identifier, "name") * rule("ParamsExt", "params", true) / param
 		).end();
 
 		parser["InlineC"] = (begin()
 			* lit("inline") * lit("_C") * grab_nested("{", "}", "tokens")
 								/ [](auto& ctx, auto& view) {
-									OrphanTokens* toks = dynamic_cast<OrphanTokens*>(view["tokens"]);
+									OrphanTokens* toks = node_cast<OrphanTokens>(view["tokens"]);
 
 									InlineCBlock* block = new InlineCBlock();
 									for (auto& tok : toks->tokens) {
@@ -963,15 +1447,31 @@ namespace tau {
 			
 		).end();
 
+		// generic structs are keyed by module, so the name has to be known before the declarations
+		parser["MODULE_DECL"] = (begin()
+			* lit("mod") * rule("PATH_SPEC", "moduleName") * lit(";")
+								/ [](auto& ctx, auto& view) {
+									PathSpecNode* name = MOVE_CAST(PathSpecNode, view["moduleName"]);
+									*ctx.parsing_module = name->get_full_name();
+									return name;
+								}
+		).end();
+
 		parser["Module"] = (begin()
-			* lit("mod") * rule("PATH_SPEC", "moduleName") * lit(";") * rule("ModuleLevelDeclarations", "content")
+			* rule("MODULE_DECL", "moduleName") * rule("ModuleLevelDeclarations", "content")
 								/[](auto& ctx, auto& view) {
-									PathSpecNode* name = dynamic_cast<PathSpecNode*>(view["moduleName"]); view["moduleName"] = nullptr;
-									ModuleBodyNode* body = dynamic_cast<ModuleBodyNode*>(view["content"]); view["content"] = nullptr;
+									PathSpecNode* name = node_cast<PathSpecNode>(view["moduleName"]); view["moduleName"] = nullptr;
+									ModuleBodyNode* body = node_cast<ModuleBodyNode>(view["content"]); view["content"] = nullptr;
 
 									if (body == nullptr) {
 										ctx.errors.push_back("A module cannot be empty");
 									}
+									else {
+										// ModuleLevelDeclarations adds each declaration after the ones following it
+										std::reverse(body->structs.begin(), body->structs.end());
+										std::reverse(body->functions.begin(), body->functions.end());
+										std::reverse(body->includes.begin(), body->includes.end());
+									}
 									ModuleNode* moduleN = new ModuleNode(name);
 									moduleN->body = body;
 
@@ -987,7 +1487,7 @@ namespace tau {
 				
 									auto f = view.find("body");
 									if (f != view.end()) {
-										body = dynamic_cast<ModuleBodyNode*>(f->second);
+										body = node_cast<ModuleBodyNode>(f->second);
 										view["body"] = nullptr;
 				
 										body->functions.push_back(func);
@@ -1036,56 +1536,130 @@ namespace tau {
 		).end();
 
 		parser["FuncDef"] = (begin()
-			* lit("pub", true, "pub") * lit("inline", true, "inline") * lit("fn") * tok(TokenType::Identifier, "name") * rule("TEMPLATE_PARAMS", "template", true)
-				* lit("(") * rule("Params", "params", true) * lit(")") * rule("PATH", "returnty", true) * rule("STATEMENT_BODY", "body")
+			* rule("ANNOTATIONS", "annotations", true) * lit("pub", true, "pub") * lit("inline", true, "inline") * lit("fn") * tok(TokenType::Identifier, "name") * rule("TEMPLATE_PARAMS", "template", true)
+				* lit("(") * rule("Params", "params", true) * lit(")") * rule("TYPE", "returnty", true) * rule("STATEMENT_BODY", "body")
 			/ [](auto& ctx, auto& view) {
 				Visibility visibility = ctx.flags.find("pub") != ctx.flags.end() ? Visibility::Public : Visibility::Private;
 				bool is_inline = ctx.flags.find("inline") != ctx.flags.end();
 
-				OrphanTokens* nameTok = dynamic_cast<OrphanTokens*>(view["name"]);
+				OrphanTokens* nameTok = node_cast<OrphanTokens>(view["name"]);
 				TemplateParamsNode* templ = nullptr;
 				ParameterListNode* params = nullptr;
 				PathNode* returnType = nullptr;
 
-				StatementBlockNode* body = dynamic_cast<StatementBlockNode*>(view["body"]);
+				StatementBlockNode* body = node_cast<StatementBlockNode>(view["body"]);
 				view["body"] = nullptr;
 					
 				auto f = view.find("template");
 				if (f != view.end()) {
-					templ = dynamic_cast<TemplateParamsNode*>(f->second);
+					templ = node_cast<TemplateParamsNode>(f->second);
 					view["template"] = nullptr;
 				}
 
 				f = view.find("params");
 				if (f != view.end()) {
-					params = dynamic_cast<ParameterListNode*>(f->second);
+					params = node_cast<ParameterListNode>(f->second);
 					view["params"] = nullptr;
 				}
 
 				f = view.find("returnty");
 				if (f != view.end()) {
-					returnType = dynamic_cast<PathNode*>(f->second);
+					returnType = node_cast<PathNode>(f->second);
 					view["returnty"] = nullptr;
 				}
 				
-				std::string _ret_ty = "void";
+				_type_id _ty = TYPE_VOID;
 				if (returnType != nullptr) {
-					_ret_ty = returnType->get_full_name(ctx);
+					_ty = ctx.resolve_type(returnType);
 				}
 
-				_type_id _ty = ctx.types.get_id_from_name(_ret_ty);
-
 				if (_ty == 0) {
-					ctx.errors.push_back("Unknown type: " + _ret_ty);
+					ctx.errors.push_back("Unknown type: " + returnType->get_full_name(ctx));
+				}
+				ctx.template_params->clear();
+
+				// @null_check(params..), either before the function or as its leading statements
+				std::vector<size_t> null_checks;
+				auto add_null_checks = [&](AnnotationNode* annotation) {
+					for (auto& param : annotation->params()) {
+						VariableNode* var = node_cast<VariableNode>(param);
+						size_t index = 0;
+						while (var != nullptr && params != nullptr && index < params->params.size() && params->params[index].name != var->path()->nodes[0].bit) {
+							index++;
+						}
+
+						if (var == nullptr || params == nullptr || index == params->params.size()) {
+							ctx.errors.push_back("@null_check on entry of " + std::string{ nameTok->tokens[0].literal } + " expects parameter names");
+						}
+						else if (std::find(null_checks.begin(), null_checks.end(), index) == null_checks.end()) {
+							null_checks.push_back(index);
+						}
+					}
+				};
+
+				// @pre_assert(cond) over the parameters alone, the rest stay in the body
+				std::vector<AstNode*> preconditions;
+				while (body != nullptr && !body->statements.empty() && body->statements.front()->kind() == NodeType::Annotation) {
+					AnnotationNode* annotation = static_cast<AnnotationNode*>(body->statements.front());
+					if (annotation->annotation_type() == "pre_assert") {
+						if (params == nullptr || annotation->params().size() != 1 || !is_entry_condition(annotation->params()[0], params)) {
+							break;
+						}
+						preconditions.push_back(annotation->params()[0]);
+						annotation->params().clear();
+					}
+					else if (annotation->annotation_type() == "null_check") {
+						add_null_checks(annotation);
+					}
+					else {
+						break;
+					}
+					body->statements.erase(body->statements.begin());
+					delete annotation;
+				}
+
+				bool const_eval = false;
+				size_t stack_limit = 0;
+				f = view.find("annotations");
+				if (f != view.end() && f->second != nullptr) {
+					ListNode* annotations = node_cast<ListNode>(f->second);
+					for (auto& entry : annotations->entries) {
+						AnnotationNode* annotation = node_cast<AnnotationNode>(entry);
+						const std::string& kind = annotation->annotation_type();
+
+						if (kind == "const_eval" && annotation->params().empty()) {
+							const_eval = true;
+						}
+						else if (kind == "null_check" && !annotation->params().empty()) {
+							add_null_checks(annotation);
+						}
+						else if (kind == "stack_limit" && annotation->params().size() == 1) {
+							StaticIntegerNode* value = node_cast<StaticIntegerNode>(annotation->params()[0]);
+							if (value == nullptr || value->value() <= 0) {
+								ctx.errors.push_back("@stack_limit expects a positive byte count at function definition in " + std::string{ nameTok->tokens[0].source_file } + " on line " + std::to_string(nameTok->tokens[0].row));
+							}
+							else {
+								stack_limit = (size_t)value->value();
+							}
+						}
+						else {
+							ctx.errors.push_back("Unknown function annotation @" + kind + " at function definition in " + std::string{ nameTok->tokens[0].source_file } + " on line " + std::to_string(nameTok->tokens[0].row));
+						}
+					}
 				}
 
 				FunctionDefinitionNode* funcDef = new FunctionDefinitionNode();
-				funcDef->functionName = std::string(nameTok->tokens[0].literal.begin(), nameTok->tokens[0].literal.end());
+				funcDef->functionName = Name{ nameTok->tokens[0].literal };
 				funcDef->params = params;
 				funcDef->templateParams = templ;
 				funcDef->returnType = _ty;
 				funcDef->body = body;
 				funcDef->visibility = visibility;
+				funcDef->const_eval = const_eval;
+				funcDef->is_inline = is_inline;
+				funcDef->stack_limit = stack_limit;
+				funcDef->null_checks = std::move(null_checks);
+				funcDef->preconditions = std::move(preconditions);
 
 				return funcDef;
 			}
@@ -1111,20 +1685,17 @@ namespace tau {
 		static std::vector<AllowedBinaryOperator> operators;
 
 		if (operators.empty()) {
-			TypeRegistry& registry = TypeRegistry::instance();
-			
-			_type_id _u8 = registry.get_id_from_name("u8");
-			_type_id _u16 = registry.get_id_from_name("u16");
-			_type_id _u32 = registry.get_id_from_name("u32");
-			_type_id _u64 = registry.get_id_from_name("u64");
-			_type_id _i8 = registry.get_id_from_name("i8");
-			_type_id _i16 = registry.get_id_from_name("i16");
-			_type_id _i32 = registry.get_id_from_name("i32");
-			_type_id _i64 = registry.get_id_from_name("i64");
-			_type_id _f32 = registry.get_id_from_name("f32");
-			_type_id _f64 = registry.get_id_from_name("f64");
-			_type_id _char = registry.get_id_from_name("char");
-			_type_id _bool = registry.get_id_from_name("bool");
+			_type_id _u8 = TYPE_U8;
+			_type_id _u16 = TYPE_U16;
+			_type_id _u32 = TYPE_U32;
+			_type_id _u64 = TYPE_U64;
+			_type_id _i8 = TYPE_I8;
+			_type_id _i16 = TYPE_I16;
+			_type_id _i32 = TYPE_I32;
+			_type_id _i64 = TYPE_I64;
+			_type_id _f32 = TYPE_F32;
+			_type_id _f64 = TYPE_F64;
+			_type_id _bool = TYPE_BOOL;
 
 
 			operators.push_back({ OperatorID::Add,  _u8,  _u8,  _u8, nullptr });
@@ -1267,20 +1838,18 @@ namespace tau {
 		static std::vector<AllowedUnaryOperator> operators;
 
 		if (operators.empty()) {
-			TypeRegistry& registry = TypeRegistry::instance();
-
-			_type_id _u8 = registry.get_id_from_name("u8");
-			_type_id _u16 = registry.get_id_from_name("u16");
-			_type_id _u32 = registry.get_id_from_name("u32");
-			_type_id _u64 = registry.get_id_from_name("u64");
-			_type_id _i8 = registry.get_id_from_name("i8");
-			_type_id _i16 = registry.get_id_from_name("i16");
-			_type_id _i32 = registry.get_id_from_name("i32");
-			_type_id _i64 = registry.get_id_from_name("i64");
-			_type_id _f32 = registry.get_id_from_name("f32");
-			_type_id _f64 = registry.get_id_from_name("f64");
-			_type_id _char = registry.get_id_from_name("char");
-			_type_id _bool = registry.get_id_from_name("bool");
+			_type_id _u8 = TYPE_U8;
+			_type_id _u16 = TYPE_U16;
+			_type_id _u32 = TYPE_U32;
+			_type_id _u64 = TYPE_U64;
+			_type_id _i8 = TYPE_I8;
+			_type_id _i16 = TYPE_I16;
+			_type_id _i32 = TYPE_I32;
+			_type_id _i64 = TYPE_I64;
+			_type_id _f32 = TYPE_F32;
+			_type_id _f64 = TYPE_F64;
+			_type_id _char = TYPE_CHAR;
+			_type_id _bool = TYPE_BOOL;
 
 			operators.push_back({ OperatorID::Negative, _i8, _i8 });
 			operators.push_back({ OperatorID::Negative, _i16, _i16 });
@@ -1485,4 +2054,21 @@ namespace tau {
 
 		return operators;
 	}
+
+	OperatorTable& GetOperatorTable() {
+		static OperatorTable table;
+		static bool initialized = false;
+
+		if (!initialized) {
+			for (auto& op : GetAllowedOperators()) {
+				table.add(op);
+			}
+			for (auto& op : GetAllowedUnaryOperators()) {
+				table.add(op);
+			}
+			initialized = true;
+		}
+
+		return table;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "core/pass_manager.h"
+#include "core/attributes.h"
+#include "core/bounds_check.h"
+#include "core/dead_code.h"
+#include "core/escape.h"
+#include "core/inliner.h"
+#include "core/ir_passes.h"
+#include "core/null_check.h"
+#include "core/tail_calls.h"
+
+#include <chrono>
+#include <iomanip>
+
+namespace tau {
+
+	size_t PassManager::timing_of(const std::string& name) {
+		for (size_t i = 0; i < m_Timings.size(); i++) {
+			if (m_Timings[i].name == name) {
+				return i;
+			}
+		}
+		m_Timings.push_back(PassTiming{ name });
+		return m_Timings.size() - 1;
+	}
+
+	void PassManager::add_module_pass(const std::string& name, ModulePass pass) {
+		m_Passes.push_back(Pass{ timing_of(name), std::move(pass), nullptr });
+	}
+
+	void PassManager::add_function_pass(const std::string& name, FunctionPass pass) {
+		m_Passes.push_back(Pass{ timing_of(name), nullptr, std::move(pass) });
+	}
+
+	bool PassManager::run(ModuleNode* module) {
+		if (module == nullptr || module->body == nullptr) {
+			return true;
+		}
+
+		for (auto& pass : m_Passes) {
+			PassTiming& timing = m_Timings[pass.timing];
+			auto start = std::chrono::steady_clock::now();
+
+			if (pass.module_pass) {
+				timing.changes += pass.module_pass(module, m_Context);
+			}
+			else {
+				for (auto& funcDef : module->body->functions) {
+					if (funcDef->ir != nullptr) {
+						timing.changes += pass.function_pass(*funcDef->ir, m_Context);
+					}
+				}
+			}
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			timing.milliseconds += elapsed.count();
+			timing.runs++;
+
+			if (!m_Context.errors.empty()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void PassManager::print_timings(std::ostream& output) const {
+		double total = 0.0;
+		for (auto& timing : m_Timings) {
+			total += timing.milliseconds;
+		}
+
+		output << std::fixed << std::setprecision(3);
+		for (auto& timing : m_Timings) {
+			output << std::setw(10) << timing.milliseconds << " ms  " << std::setw(8) << timing.changes << "  " << timing.name;
+			if (timing.runs > 1) {
+				output << " (x" << timing.runs << ")";
+			}
+			output << "\n";
+		}
+		output << std::setw(10) << total << " ms  total\n";
+		output << std::defaultfloat;
+	}
+
+	void AddDefaultPasses(PassManager& passes) {
+		passes.add_module_pass("inline", InlineFunctions);
+		passes.add_module_pass("fold", FoldConstants);
+		passes.add_module_pass("promote-allocations", PromoteAllocations);
+		passes.add_module_pass("null-checks", ElideNullChecks);
+		passes.add_module_pass("bounds-checks", EliminateBoundsChecks);
+		passes.add_module_pass("tail-calls", EliminateTailCalls);
+		passes.add_module_pass("dead-code", EliminateDeadCode);
+		passes.add_module_pass("attributes", InferAttributes);
+
+		passes.add_module_pass("lower", LowerToIr);
+		passes.add_function_pass("mem2reg", PromoteLocals);
+		passes.add_function_pass("dce", EliminateDeadValues);
+		passes.add_function_pass("gvn", NumberValues);
+		passes.add_function_pass("licm", HoistInvariants);
+		passes.add_function_pass("gvn", NumberValues);
+		passes.add_function_pass("dce", EliminateDeadValues);
+	}
+}
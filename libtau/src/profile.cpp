@@ -0,0 +1,174 @@
+#include "core/profile.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace tau {
+
+	// fewer samples than this say too little about an if to hint it
+	static constexpr u64 s_MinBranchSamples = 32;
+	// one side of a hinted if takes at most a tenth of the samples
+	static constexpr u64 s_UnlikelyDivisor = 10;
+	// hot functions are called at least a hundredth as often as the most called one
+	static constexpr u64 s_HotDivisor = 100;
+
+	static std::string branch_key(const std::string& function, size_t ordinal) {
+		return function + "#" + std::to_string(ordinal);
+	}
+
+	result<bool> Profile::load(std::istream& input) {
+		std::string line;
+		size_t row = 0;
+		while (std::getline(input, line)) {
+			row++;
+
+			std::istringstream fields(line);
+			std::string kind, function;
+			if (!(fields >> kind)) {
+				continue;
+			}
+
+			if (kind == "fn") {
+				u64 calls = 0;
+				if (!(fields >> function >> calls)) {
+					return result<bool>::Err("Malformed profile line " + std::to_string(row) + ": " + line);
+				}
+				u64& total = m_Calls[function];
+				total += calls;
+				m_MaxCalls = std::max(m_MaxCalls, total);
+			}
+			else if (kind == "br") {
+				size_t ordinal = 0;
+				Branch counts;
+				if (!(fields >> function >> ordinal >> counts.taken >> counts.not_taken)) {
+					return result<bool>::Err("Malformed profile line " + std::to_string(row) + ": " + line);
+				}
+				Branch& total = m_Branches[branch_key(function, ordinal)];
+				total.taken += counts.taken;
+				total.not_taken += counts.not_taken;
+			}
+			else {
+				return result<bool>::Err("Unknown profile record " + kind + " on line " + std::to_string(row));
+			}
+		}
+		return result<bool>::Ok(true);
+	}
+
+	const u64* Profile::calls(const std::string& function) const {
+		auto c = m_Calls.find(function);
+		return c != m_Calls.end() ? &c->second : nullptr;
+	}
+
+	const Profile::Branch* Profile::branch(const std::string& function, size_t ordinal) const {
+		auto b = m_Branches.find(branch_key(function, ordinal));
+		return b != m_Branches.end() ? &b->second : nullptr;
+	}
+
+	void BranchSites::visit_if(IfNode* node) {
+		sites.push_back(node);
+		AstVisitor<BranchSites>::visit_if(node);
+	}
+
+	std::string profile_key(ModuleNode* module, FunctionDefinitionNode* func) {
+		return module->moduleName->get_full_name().str() + "." + func->functionName.str();
+	}
+
+	static bool is_profiled(FunctionDefinitionNode* func) {
+		return func->templateParams == nullptr && func->body != nullptr && !(func->is_inline && func->visibility == Visibility::Public);
+	}
+
+	size_t InstrumentModule(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		size_t counter = 0;
+		module->profile_sites.clear();
+		for (auto& funcDef : module->body->functions) {
+			if (!is_profiled(funcDef)) {
+				continue;
+			}
+
+			std::string key = profile_key(module, funcDef);
+			funcDef->profile_counter = counter;
+			module->profile_sites.push_back(ProfileSite{ key, NO_PROFILE_COUNTER, counter });
+			counter++;
+
+			BranchSites branches;
+			branches.visit(funcDef->body);
+			for (size_t i = 0; i < branches.sites.size(); i++) {
+				branches.sites[i]->profile_counter = counter;
+				module->profile_sites.push_back(ProfileSite{ key, i, counter });
+				counter += 2;
+			}
+		}
+		return counter;
+	}
+
+	size_t ApplyProfile(ModuleNode* module, ParserContext& ctx, const Profile& profile) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		std::unordered_map<FunctionDefinitionNode*, u64> calls;
+		for (auto& funcDef : module->body->functions) {
+			const u64* count = is_profiled(funcDef) ? profile.calls(profile_key(module, funcDef)) : nullptr;
+			if (count != nullptr) {
+				calls[funcDef] = *count;
+			}
+		}
+		if (calls.empty()) {
+			return 0;
+		}
+
+		size_t changed = 0;
+		for (auto& funcDef : module->body->functions) {
+			auto c = calls.find(funcDef);
+			if (c == calls.end()) {
+				continue;
+			}
+
+			if (c->second == 0) {
+				funcDef->heat = FunctionHeat::Cold;
+			}
+			else if (c->second * s_HotDivisor >= profile.max_calls()) {
+				funcDef->heat = FunctionHeat::Hot;
+			}
+			changed += funcDef->heat != FunctionHeat::Unknown;
+
+			BranchSites branches;
+			branches.visit(funcDef->body);
+			std::string key = profile_key(module, funcDef);
+			for (size_t i = 0; i < branches.sites.size(); i++) {
+				const Profile::Branch* counts = profile.branch(key, i);
+				if (counts == nullptr || counts->taken + counts->not_taken < s_MinBranchSamples) {
+					continue;
+				}
+
+				u64 samples = counts->taken + counts->not_taken;
+				if (counts->not_taken * s_UnlikelyDivisor <= samples) {
+					branches.sites[i]->hint = BranchHint::Likely;
+				}
+				else if (counts->taken * s_UnlikelyDivisor <= samples) {
+					branches.sites[i]->hint = BranchHint::Unlikely;
+				}
+				else {
+					continue;
+				}
+				changed++;
+			}
+		}
+
+		// functions the profile does not know keep their place behind the rest
+		auto& functions = module->body->functions;
+		std::stable_sort(functions.begin(), functions.end(), [&](FunctionDefinitionNode* a, FunctionDefinitionNode* b) {
+			auto ca = calls.find(a);
+			auto cb = calls.find(b);
+			if (cb == calls.end()) {
+				return ca != calls.end();
+			}
+			return ca != calls.end() && ca->second > cb->second;
+		});
+		return changed;
+	}
+}
@@ -0,0 +1,74 @@
+#include "core/symbols.h"
+
+#include <mutex>
+
+namespace tau {
+
+	SymbolInterner& SymbolInterner::instance() {
+		static SymbolInterner interner;
+		return interner;
+	}
+
+	SymbolInterner::SymbolInterner() {
+		// slot 0 is NULL_SYMBOL
+		m_Chunks[0] = std::make_unique<std::string[]>(CHUNK_SIZE);
+		m_Count.store(1, std::memory_order_release);
+	}
+
+	Symbol SymbolInterner::intern(std::string_view name) {
+		{
+			std::shared_lock<std::shared_mutex> lock(m_Lock);
+			auto f = m_Index.find(name);
+			if (f != m_Index.end()) {
+				return f->second;
+			}
+		}
+
+		std::unique_lock<std::shared_mutex> lock(m_Lock);
+
+		// another thread may have added it between the two locks
+		auto f = m_Index.find(name);
+		if (f != m_Index.end()) {
+			return f->second;
+		}
+
+		Symbol symbol = m_Count.load(std::memory_order_relaxed);
+		if (symbol >= CHUNK_SIZE * CHUNK_COUNT) {
+			throw "Too many symbols";
+		}
+
+		auto& chunk = m_Chunks[symbol / CHUNK_SIZE];
+		if (chunk == nullptr) {
+			chunk = std::make_unique<std::string[]>(CHUNK_SIZE);
+		}
+
+		std::string& stored = chunk[symbol % CHUNK_SIZE];
+		stored = name;
+		m_Index[stored] = symbol;
+
+		// publishes the string to name_of
+		m_Count.store(symbol + 1, std::memory_order_release);
+
+		return symbol;
+	}
+
+	Symbol SymbolInterner::find(std::string_view name) const {
+		std::shared_lock<std::shared_mutex> lock(m_Lock);
+		auto f = m_Index.find(name);
+		if (f == m_Index.end()) {
+			return NULL_SYMBOL;
+		}
+		return f->second;
+	}
+
+	const std::string& SymbolInterner::name_of(Symbol symbol) const {
+		if (symbol >= m_Count.load(std::memory_order_acquire)) {
+			symbol = NULL_SYMBOL;
+		}
+		return m_Chunks[symbol / CHUNK_SIZE][symbol % CHUNK_SIZE];
+	}
+
+	size_t SymbolInterner::size() const {
+		return m_Count.load(std::memory_order_acquire);
+	}
+}
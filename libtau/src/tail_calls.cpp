@@ -0,0 +1,186 @@
+#include "core/tail_calls.h"
+
+namespace tau {
+
+	static inline bool is_integer(_type_id type) {
+		return type >= TYPE_U8 && type <= TYPE_I64;
+	}
+
+	// reads locals and literals only, so it can be evaluated ahead of the call it sits next to
+	static bool is_pure_operand(AstNode* node) {
+		switch (node->kind()) {
+		case NodeType::ImmediateInt:
+		case NodeType::ImmediateFloat:
+		case NodeType::ImmediateBool:
+		case NodeType::ImmediateChar:
+		case NodeType::Variable:
+			return true;
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			return !is_assignment(op->m_Operator) && is_pure_operand(op->m_Lhs) && is_pure_operand(op->m_Rhs);
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			switch (op->m_Operator) {
+			case OperatorID::PreInc:
+			case OperatorID::PreDec:
+			case OperatorID::PostInc:
+			case OperatorID::PostDec:
+				return false;
+			default:
+				return is_pure_operand(op->m_Child);
+			}
+		}
+		default:
+			return false;
+		}
+	}
+
+	bool TailCallEliminator::is_self_call(AstNode* node) const {
+		FunctionCallNode* call = node_cast<FunctionCallNode>(node);
+		return call != nullptr && call->function_name != nullptr && call->function_name->nodes.size() == 1 &&
+			call->function_name->nodes[0].bit == m_Function->functionName;
+	}
+
+	FunctionCallNode* TailCallEliminator::tail_call(ReturnNode* node, AstNode*& accumulated, OperatorID& op) const {
+		accumulated = nullptr;
+		op = OperatorID::Undefined;
+
+		if (node->returnValue == nullptr) {
+			return nullptr;
+		}
+		if (is_self_call(node->returnValue)) {
+			return static_cast<FunctionCallNode*>(node->returnValue);
+		}
+
+		BinaryOperator* binary = node_cast<BinaryOperator>(node->returnValue);
+		if (binary == nullptr || (binary->m_Operator != OperatorID::Add && binary->m_Operator != OperatorID::Mul) || binary->resolved_type != m_Function->returnType) {
+			return nullptr;
+		}
+
+		op = binary->m_Operator;
+		if (is_self_call(binary->m_Rhs) && is_pure_operand(binary->m_Lhs)) {
+			accumulated = binary->m_Lhs;
+			return static_cast<FunctionCallNode*>(binary->m_Rhs);
+		}
+		if (is_self_call(binary->m_Lhs) && is_pure_operand(binary->m_Rhs)) {
+			accumulated = binary->m_Rhs;
+			return static_cast<FunctionCallNode*>(binary->m_Lhs);
+		}
+		return nullptr;
+	}
+
+	void TailCallEliminator::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr || node->body == nullptr) {
+			return;
+		}
+
+		size_t params = node->params != nullptr ? node->params->params.size() : 0;
+		for (size_t i = 0; i < params; i++) {
+			if (node->params->params[i].moves) {
+				return;
+			}
+		}
+
+		m_Function = node;
+		m_Returns.clear();
+		m_SelfCalls = 0;
+		m_Unsafe = false;
+		visit(node->body);
+
+		if (m_Unsafe || m_SelfCalls == 0) {
+			return;
+		}
+
+		// every self call has to be in tail position, and all accumulate the same way
+		std::vector<ReturnNode*> tails;
+		OperatorID accumulator = OperatorID::Undefined;
+		for (auto& ret : m_Returns) {
+			AstNode* accumulated;
+			OperatorID op;
+			FunctionCallNode* call = tail_call(ret, accumulated, op);
+			if (call == nullptr) {
+				continue;
+			}
+
+			size_t args = call->arguments != nullptr ? call->arguments->args.size() : 0;
+			if (args != params || (node->has_entry_checks() && !call->unchecked)) {
+				return;
+			}
+			if (accumulated != nullptr) {
+				if (accumulator != OperatorID::Undefined && accumulator != op) {
+					return;
+				}
+				accumulator = op;
+			}
+			tails.push_back(ret);
+		}
+
+		if (tails.size() != m_SelfCalls) {
+			return;
+		}
+		if (accumulator != OperatorID::Undefined) {
+			if (!is_integer(node->returnType)) {
+				return;
+			}
+			for (auto& ret : m_Returns) {
+				if (ret->returnValue == nullptr) {
+					return;
+				}
+			}
+		}
+
+		for (auto& ret : tails) {
+			AstNode* accumulated;
+			OperatorID op;
+			ret->tail_call = tail_call(ret, accumulated, op);
+			ret->accumulated = accumulated;
+			m_Eliminated++;
+		}
+		node->tail_loop = true;
+		node->accumulator = accumulator;
+	}
+
+	void TailCallEliminator::visit_return(ReturnNode* node) {
+		m_Returns.push_back(node);
+		visit(node->returnValue);
+	}
+
+	void TailCallEliminator::visit_variable_decl(VariableDeclNode* node) {
+		AnnotationNode* alloc = node_cast<AnnotationNode>(node->default_value);
+		if (alloc != nullptr && alloc->stack_capacity != 0) {
+			m_Unsafe = true;
+		}
+		visit(node->default_value);
+	}
+
+	void TailCallEliminator::visit_unary(UnaryOperator* node) {
+		if (node->m_Operator == OperatorID::Reference) {
+			m_Unsafe = true;
+		}
+		visit(node->m_Child);
+	}
+
+	void TailCallEliminator::visit_call(FunctionCallNode* node) {
+		if (is_self_call(node)) {
+			m_SelfCalls++;
+		}
+		AstVisitor<TailCallEliminator>::visit_call(node);
+	}
+
+	void TailCallEliminator::visit_cblock(InlineCBlock* node) {
+		m_Unsafe = true;
+	}
+
+	size_t EliminateTailCalls(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		TailCallEliminator eliminator(ctx);
+		for (auto& funcDef : module->body->functions) {
+			eliminator.visit(funcDef);
+		}
+		return eliminator.eliminated_count();
+	}
+}
@@ -1,98 +1,215 @@
 #include "core/tau_types.h"
 
-namespace tau {
+#include <algorithm>
 
-	static _type_id s_ID_COUNTER = 0;
+namespace tau {
 
 	TypeRegistry& TypeRegistry::instance() {
 		static TypeRegistry registry;
 		return registry;
 	}
 
+	static inline size_t align_up(size_t value, size_t align) {
+		return (value + align - 1) / align * align;
+	}
+
+	// C layout: every field starts at a multiple of its alignment, the struct is aligned
+	// to its strictest field and padded to a multiple of that alignment
 	void TypeID::calculate_size_and_offsets(TypeRegistry& registry) {
+		if (layout.variant) {
+			calculate_variant_layout(registry);
+			return;
+		}
+
+		if (layout.reorder) {
+			std::stable_sort(fields.begin(), fields.end(), [&registry](const FieldDef& a, const FieldDef& b) {
+				return registry.align_of(a.type) > registry.align_of(b.type);
+			});
+		}
 
-		size_t size = 0;
 		size_t offset = 0;
+		size_t struct_align = 1;
 
-		for (size_t i = 0; i < fields.size(); i++) {
-			auto& field = fields[i];
-			size_t size = registry.size_of(field.type);
+		for (auto& field : fields) {
+			size_t field_size = registry.size_of(field.type);
+			size_t field_align = layout.packed ? 1 : registry.align_of(field.type);
 
+			offset = align_up(offset, field_align);
 			field.offset = offset;
-			
-			offset += size;
-			size += size;
+			offset += field_size;
+
+			struct_align = std::max(struct_align, field_align);
+
+			// an enum holding the struct can use the roomiest niche of any field, but not a null
+			// pointer, the struct holding one is a value of its own
+			Niche field_niche = registry.is_pointer(field.type) ? Niche{} : registry.niche_of(field.type);
+			if (field_niche.count > niche.count) {
+				niche = field_niche;
+				niche.offset += field.offset;
+			}
 		}
 
-		this->size = size;
-		//TODO: take padding into consideration
+		struct_align = std::max(struct_align, layout.align);
+
+		this->align = struct_align;
+		this->size = align_up(offset, struct_align);
 	}
 
-#define PRIMITIVE(name, size_b) \
-		TypeID name ## _ty; \
-		name ## _ty.true_name = #name; \
-		name ## _ty.size = size_b; \
-		name ## _ty.is_user_defined = false; \
-		name ## _ty.id = ++s_ID_COUNTER; \
-		m_Types[name ## _ty.id] = name ## _ty;
+	void TypeID::calculate_variant_layout(TypeRegistry& registry) {
+		std::vector<FieldDef> cases = std::move(fields);
+		fields.clear();
+
+		size_t payload_case = 0;
+		for (size_t i = 0; i < cases.size(); i++) {
+			variant.cases.push_back(cases[i].name);
+			if (cases[i].type != TYPE_VOID) {
+				fields.push_back(cases[i]);
+				fields.back().offset = 0;
+				payload_case = i;
+			}
+		}
 
-	TypeRegistry::TypeRegistry(){
+		// option<i64*> and the like are as large as their payload, null being the other case
+		size_t others = variant.cases.size() - 1;
+		if (fields.size() == 1 && registry.niche_of(fields[0].type).count >= others) {
+			variant.niche_case = payload_case;
+			variant.niche = registry.niche_of(fields[0].type);
+			variant.niche.count = others;
+
+			niche = registry.niche_of(fields[0].type);
+			niche.first += others;
+			niche.count -= others;
+
+			size = registry.size_of(fields[0].type);
+			align = registry.align_of(fields[0].type);
+			return;
+		}
+
+		size_t count = variant.cases.size();
+		variant.tag = count <= 0x100 ? TYPE_U8 : count <= 0x10000 ? TYPE_U16 : TYPE_U32;
+		size_t tag_size = registry.size_of(variant.tag);
+
+		// the payloads overlap in a union at offset 0, sized the way C sizes it, and the tag
+		// goes after it so no payload is pushed off its alignment by the tag
+		size_t payload_size = 0;
+		size_t payload_align = 1;
+		for (auto& field : fields) {
+			payload_size = std::max(payload_size, registry.size_of(field.type));
+			payload_align = std::max(payload_align, registry.align_of(field.type));
+		}
+		payload_size = align_up(payload_size, payload_align);
+
+		variant.tag_offset = align_up(payload_size, registry.align_of(variant.tag));
+		align = std::max({ payload_align, registry.align_of(variant.tag), layout.align });
+		size = align_up(variant.tag_offset + tag_size, align);
+
+		niche = Niche{ variant.tag_offset, tag_size, count, (1ull << (8 * tag_size)) - count };
+	}
+
+	struct Primitive {
+		const char* name;
+		size_t size;
+		_type_id id;
+	};
+
+	// registered in this order right after TYPE_UNDEFINED, literals use long long and double
+	static constexpr Primitive s_Primitives[] = {
+		{ "void", 0, TYPE_VOID },
+		{ "u8", 1, TYPE_U8 },
+		{ "u16", 2, TYPE_U16 },
+		{ "u32", 4, TYPE_U32 },
+		{ "u64", 8, TYPE_U64 },
+		{ "i8", 1, TYPE_I8 },
+		{ "i16", 2, TYPE_I16 },
+		{ "i32", 4, TYPE_I32 },
+		{ "i64", 8, TYPE_I64 },
+		{ "f32", 4, TYPE_F32 },
+		{ "f64", 8, TYPE_F64 },
+		{ "char", 1, TYPE_CHAR },
+		{ "bool", sizeof(bool), TYPE_BOOL },
+		{ "long long", sizeof(long long), TYPE_STATIC_INT },
+		{ "double", sizeof(double), TYPE_STATIC_FLOAT },
+	};
+
+	static constexpr bool primitives_in_order() {
+		_type_id expected = TYPE_UNDEFINED + 1;
+		for (auto& primitive : s_Primitives) {
+			if (primitive.id != expected++) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static_assert(primitives_in_order(), "the TYPE_* constants must follow the order the primitives are registered in");
 
-		PRIMITIVE(void, 0);
-		PRIMITIVE(u8, 1);
-		PRIMITIVE(u16, 2);
-		PRIMITIVE(u32, 4);
-		PRIMITIVE(u64, 8);
-		PRIMITIVE(i8, 1);
-		PRIMITIVE(i16, 2);
-		PRIMITIVE(i32, 4);
-		PRIMITIVE(i64, 8);
-		PRIMITIVE(f32, 4);
-		PRIMITIVE(f64, 8);
-		PRIMITIVE(char, 1);
-		PRIMITIVE(bool, sizeof(bool));
-
-		TypeID STATIC_INT_TY;
-		STATIC_INT_TY.true_name = "long long";
-		STATIC_INT_TY.size = sizeof(long long);
-		STATIC_INT_TY.is_user_defined = false;
-		STATIC_INT_TY.id = ++s_ID_COUNTER;
-		m_Types[STATIC_INT_TY.id] = STATIC_INT_TY;
-
-		TypeID STATIC_FLOAT_TY;
-		STATIC_FLOAT_TY.true_name = "double";
-		STATIC_FLOAT_TY.size = sizeof(double);
-		STATIC_FLOAT_TY.is_user_defined = false;
-		STATIC_FLOAT_TY.id = ++s_ID_COUNTER;
-		m_Types[STATIC_FLOAT_TY.id] = STATIC_FLOAT_TY;
+	_type_id TypeRegistry::define_primitive(const std::string& name, size_t size) {
+		TypeID type;
+		type.true_name = name;
+		type.size = size;
+		type.align = size == 0 ? 1 : size;
+		type.is_user_defined = false;
+		type.id = m_Types.size();
+
+		m_NameIndex[name] = type.id;
+		m_Types.push_back(type);
+
+		return type.id;
+	}
+
+	TypeRegistry::TypeRegistry(){
+		TypeID undefined;
+		undefined.id = TYPE_UNDEFINED;
+		undefined.is_user_defined = false;
+		undefined.true_name = "Undefined";
+		undefined.size = 0;
+		m_Types.push_back(undefined);
+
+		for (auto& primitive : s_Primitives) {
+			define_primitive(primitive.name, primitive.size);
+		}
 		// TODO: string?
 	}
 
+	TypeID* TypeRegistry::lookup(_type_id id) {
+		if (id == TYPE_UNDEFINED || id >= m_Types.size()) {
+			return nullptr;
+		}
+		return &m_Types[id];
+	}
+
 	_type_id TypeRegistry::get_id_from_name(std::string_view name) {
-		for (auto& kv : m_Types) {
-			if (kv.second.true_name == name) {
-				return kv.first;
-			}
+		auto f = m_NameIndex.find(std::string{ name.begin(), name.end() });
+		if (f == m_NameIndex.end()) {
+			return 0;
 		}
 
-		return 0;
+		return f->second;
 	}
 
 	size_t TypeRegistry::size_of(_type_id id) {
-		if (m_Types.find(id) == m_Types.end()) return 0;
-		return m_Types.at(id).size;
+		TypeID* type = lookup(id);
+		if (type == nullptr) return 0;
+		return type->size;
+	}
+
+	size_t TypeRegistry::align_of(_type_id id) {
+		TypeID* type = lookup(id);
+		if (type == nullptr) return 1;
+		return type->align;
 	}
 
 	std::string TypeRegistry::name_of(_type_id id) {
-		if (m_Types.find(id) == m_Types.end()) return "Undefined";
-		return (m_Types.at(id).is_user_defined ? "struct " : "") + m_Types.at(id).true_name;
+		TypeID* type = lookup(id);
+		if (type == nullptr) return "Undefined";
+		return (type->is_user_defined ? "struct " : "") + type->true_name;
 	}
 
 	std::vector<FieldDef>& TypeRegistry::fields_of(_type_id id) {
 		return m_Types.at(id).fields;
 	}
 
-	size_t TypeRegistry::offset_of(_type_id id, const std::string& field_name) {
+	size_t TypeRegistry::offset_of(_type_id id, Name field_name) {
 		auto& type = m_Types.at(id);
 
 		for (size_t i = 0; i < type.fields.size(); i++) {
@@ -104,11 +221,11 @@ namespace tau {
 		return 0;
 	}
 
-	_type_id TypeRegistry::get_struct_field_type(_type_id struct_type, const std::string& field_name) {
-		if (m_Types.find(struct_type) == m_Types.end()) return 0;
+	_type_id TypeRegistry::get_struct_field_type(_type_id struct_type, Name field_name) {
+		TypeID* type = lookup(struct_type);
+		if (type == nullptr) return 0;
 
-		auto& type = m_Types.at(struct_type);
-		for (auto& field : type.fields) {
+		for (auto& field : type->fields) {
 			if (field.name == field_name) {
 				return field.type;
 			}
@@ -117,12 +234,76 @@ namespace tau {
 	}
 
 	bool TypeRegistry::is_struct(_type_id id) {
-		if (m_Types.find(id) == m_Types.end()) return false;
-		return m_Types.at(id).is_user_defined;
+		TypeID* type = lookup(id);
+		if (type == nullptr) return false;
+		return type->is_user_defined;
+	}
+
+	bool TypeRegistry::is_variant(_type_id id) {
+		TypeID* type = lookup(id);
+		return type != nullptr && type->layout.variant;
+	}
+
+	const VariantLayout& TypeRegistry::variant_of(_type_id id) {
+		return m_Types.at(id).variant;
+	}
+
+	_type_id TypeRegistry::case_type(_type_id variant, size_t index) {
+		TypeID& type = m_Types.at(variant);
+		for (auto& field : type.fields) {
+			if (field.name == type.variant.cases.at(index)) {
+				return field.type;
+			}
+		}
+		return TYPE_VOID;
+	}
+
+	Niche TypeRegistry::niche_of(_type_id id) {
+		if (id == TYPE_BOOL) {
+			return Niche{ 0, size_of(TYPE_BOOL), 2, (1ull << (8 * size_of(TYPE_BOOL))) - 2 };
+		}
+		if (is_pointer(id)) {
+			return Niche{ 0, sizeof(void*), 0, 1 };
+		}
+
+		TypeID* type = lookup(id);
+		return type != nullptr ? type->niche : Niche{};
+	}
+
+	_type_id TypeRegistry::pointer_to(_type_id pointee) {
+		std::string name = name_of(pointee) + "*";
+
+		_type_id existing = get_id_from_name(name);
+		if (existing != 0) {
+			return existing;
+		}
+
+		TypeID type;
+		type.id = m_Types.size();
+		type.is_user_defined = false;
+		type.true_name = name;
+		type.size = sizeof(void*);
+		type.align = alignof(void*);
+		type.pointee = pointee;
+
+		m_NameIndex[name] = type.id;
+		m_Types.push_back(type);
+
+		return type.id;
+	}
+
+	bool TypeRegistry::is_pointer(_type_id id) {
+		TypeID* type = lookup(id);
+		return type != nullptr && type->pointee != 0;
+	}
+
+	_type_id TypeRegistry::pointee_of(_type_id id) {
+		TypeID* type = lookup(id);
+		return type != nullptr ? type->pointee : 0;
 	}
 
 	result<_type_id> TypeRegistry::define_type(const std::string& type_name, size_t size) {
-		if (get_id_from_name(type_name.c_str()) != 0) {
+		if (get_id_from_name(type_name) != 0) {
 			return result<_type_id>::Err("Type " + type_name + " is already defined");
 		}
 
@@ -130,27 +311,36 @@ namespace tau {
 		type.true_name = type_name;
 		type.size = size;
 		type.is_user_defined = true;
-		type.id = ++s_ID_COUNTER;
+		type.id = m_Types.size();
+
+		// opaque types get the strictest alignment their size allows, capped at 8
+		type.align = 1;
+		while (type.align < 8 && size % (type.align * 2) == 0 && size != 0) {
+			type.align *= 2;
+		}
 
-		m_Types[type.id] = type;
+		m_NameIndex[type_name] = type.id;
+		m_Types.push_back(type);
 
 		return result<_type_id>::Ok(type.id);
 	}
 
-	result<_type_id> TypeRegistry::define_type(const std::string& type_name, std::vector<FieldDef>& fields) {
-		if (get_id_from_name(type_name.c_str()) != 0) {
+	result<_type_id> TypeRegistry::define_type(const std::string& type_name, std::vector<FieldDef>& fields, const StructLayout& layout) {
+		if (get_id_from_name(type_name) != 0) {
 			return result<_type_id>::Err("Type " + type_name + " is already defined");
 		}
 
 		TypeID type;
-		type.id = ++s_ID_COUNTER;
+		type.id = m_Types.size();
 		type.is_user_defined = true;
 		type.true_name = type_name;
 		type.fields = fields;
+		type.layout = layout;
 
 		type.calculate_size_and_offsets(*this);
 
-		m_Types[type.id] = type;
+		m_NameIndex[type_name] = type.id;
+		m_Types.push_back(type);
 
 		return result<_type_id>::Ok(type.id);
 	}
@@ -0,0 +1,563 @@
+#include "core/templates.h"
+#include "core/visitor.h"
+
+namespace tau {
+
+	static constexpr size_t s_MaxInstantiationDepth = 64;
+	static constexpr size_t s_MaxFunctionInstances = 4096;
+
+	TemplateCache& TemplateCache::instance() {
+		static TemplateCache cache;
+		return cache;
+	}
+
+	static Name struct_key(Name name, Name module) {
+		return Name{ module + "." + name };
+	}
+
+	void TemplateCache::add_struct(const StructTemplate& generic) {
+		Name key = struct_key(generic.name, generic.module);
+		if (m_Structs.find(key) == m_Structs.end()) {
+			m_Modules[generic.name].push_back(generic.module);
+		}
+		m_Structs[key] = generic;
+	}
+
+	bool TemplateCache::has_struct(Name key) const {
+		return m_Structs.find(key) != m_Structs.end();
+	}
+
+	result<Name> TemplateCache::qualify_struct(Name name, Name module) const {
+		Name own = struct_key(name, module);
+		if (has_struct(own)) {
+			return result<Name>::Ok(own);
+		}
+
+		auto f = m_Modules.find(name);
+		if (f == m_Modules.end()) {
+			return result<Name>::Err("Unknown generic struct " + name);
+		}
+		if (f->second.size() > 1) {
+			return result<Name>::Err("Generic struct " + name + " is declared by more than one module, write it with the module it comes from");
+		}
+		return result<Name>::Ok(struct_key(name, f->second.front()));
+	}
+
+	std::string TemplateCache::mangle(Name name, const std::vector<_type_id>& args, TypeRegistry& types) {
+		std::string mangled = name.str();
+		mangled += "_";
+
+		for (auto& arg : args) {
+			std::string arg_name = types.name_of(arg);
+			if (arg_name.rfind("struct ", 0) == 0) {
+				arg_name.erase(0, 7);
+			}
+
+			mangled += "_";
+			for (char c : arg_name) {
+				bool ident = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+				mangled += ident ? c : '_';
+			}
+		}
+		return mangled;
+	}
+
+	result<_type_id> TemplateCache::apply_struct(Name key, const std::vector<_type_id>& args, TypeRegistry& types) {
+		auto f = m_Structs.find(key);
+		if (f == m_Structs.end()) {
+			return result<_type_id>::Err("Unknown generic struct " + key);
+		}
+
+		const StructTemplate& generic = f->second;
+		if (args.size() != generic.param_count) {
+			return result<_type_id>::Err("Generic struct " + generic.name + " expects " + std::to_string(generic.param_count) +
+				" template arguments, got " + std::to_string(args.size()));
+		}
+
+		bool dependent = false;
+		for (auto& arg : args) {
+			dependent |= is_template_type(arg);
+		}
+
+		if (!dependent) {
+			return instantiate_struct(generic, args, types);
+		}
+
+		for (size_t i = 0; i < m_Dependent.size(); i++) {
+			if (m_Dependent[i].key == key && m_Dependent[i].args == args) {
+				return result<_type_id>::Ok(TEMPLATE_DEPENDENT_BASE + i);
+			}
+		}
+		m_Dependent.push_back(Dependent{ key, args });
+		return result<_type_id>::Ok(TEMPLATE_DEPENDENT_BASE + m_Dependent.size() - 1);
+	}
+
+	result<_type_id> TemplateCache::instantiate_struct(const StructTemplate& generic, const std::vector<_type_id>& args, TypeRegistry& types) {
+		// module qualified like get_fully_qualified_name, so the C names of two modules' templates differ
+		std::string mangled = mangle(Name{ generic.module + "_" + generic.name }, args, types);
+
+		_type_id existing = types.get_id_from_name(mangled);
+		if (existing != 0) {
+			return result<_type_id>::Ok(existing);
+		}
+
+		// a generic struct holding itself by value never bottoms out
+		if (m_Depth >= s_MaxInstantiationDepth) {
+			return result<_type_id>::Err("Instantiation of " + mangled + " nests too deeply, does " + generic.name + " contain itself?");
+		}
+
+		std::vector<FieldDef> fields = generic.fields;
+
+		m_Depth++;
+		for (auto& field : fields) {
+			auto r = substitute(field.type, args, types);
+			if (r.error_bit) {
+				m_Depth--;
+				return r;
+			}
+			field.type = r.value;
+		}
+		m_Depth--;
+
+		auto r = types.define_type(mangled, fields, generic.layout);
+		if (!r.error_bit) {
+			m_Instances[r.value] = generic.layout;
+		}
+		return r;
+	}
+
+	result<_type_id> TemplateCache::substitute(_type_id type, const std::vector<_type_id>& args, TypeRegistry& types) {
+		if (!is_template_type(type)) {
+			return result<_type_id>::Ok(type);
+		}
+
+		if (type < TEMPLATE_DEPENDENT_BASE) {
+			size_t index = type - TEMPLATE_TYPE_BASE;
+			if (index >= args.size()) {
+				return result<_type_id>::Err("Template parameter " + std::to_string(index) + " has no argument");
+			}
+			return result<_type_id>::Ok(args[index]);
+		}
+
+		size_t index = type - TEMPLATE_DEPENDENT_BASE;
+		if (index >= m_Dependent.size()) {
+			return result<_type_id>::Err("Unknown dependent type");
+		}
+
+		// copied, substituting may add dependent types and move the vector
+		Dependent dependent = m_Dependent[index];
+		for (auto& arg : dependent.args) {
+			auto r = substitute(arg, args, types);
+			if (r.error_bit) {
+				return r;
+			}
+			arg = r.value;
+		}
+		return apply_struct(dependent.key, dependent.args, types);
+	}
+
+	bool TemplateCache::is_instance(_type_id id) const {
+		return m_Instances.find(id) != m_Instances.end();
+	}
+
+	const StructLayout& TemplateCache::layout_of(_type_id instance) const {
+		static const StructLayout s_Default;
+
+		auto f = m_Instances.find(instance);
+		if (f == m_Instances.end()) {
+			return s_Default;
+		}
+		return f->second;
+	}
+
+	// deep copy of a generic function body with the declared types of its locals substituted
+	class TemplateCloner {
+	public:
+		inline TemplateCloner(ParserContext& ctx, const std::vector<_type_id>& args) : m_Context{ ctx }, m_Args{ args } {}
+
+		AstNode* clone(AstNode* node);
+		PathNode* clone_path(PathNode* path);
+		StatementBlockNode* clone_block(StatementBlockNode* block);
+
+		_type_id substitute(_type_id type);
+
+		bool failed = false;
+
+	private:
+		ParserContext& m_Context;
+		const std::vector<_type_id>& m_Args;
+	};
+
+	_type_id TemplateCloner::substitute(_type_id type) {
+		auto r = TemplateCache::instance().substitute(type, m_Args, m_Context.types);
+		if (r.error_bit) {
+			m_Context.errors.push_back(r.error);
+			failed = true;
+			return 0;
+		}
+		return r.value;
+	}
+
+	PathNode* TemplateCloner::clone_path(PathNode* path) {
+		if (path == nullptr) {
+			return nullptr;
+		}
+
+		PathNode* copy = new PathNode();
+		for (auto& node : path->nodes) {
+			PathArg arg{ node.bit, nullptr };
+			if (node.args != nullptr) {
+				arg.args = new TemplateArgsNode();
+				for (auto& targ : node.args->template_args) {
+					arg.args->template_args.push_back(clone_path(targ));
+				}
+			}
+			copy->nodes.push_back(arg);
+		}
+		copy->indirection = path->indirection;
+		return copy;
+	}
+
+	StatementBlockNode* TemplateCloner::clone_block(StatementBlockNode* block) {
+		if (block == nullptr) {
+			return nullptr;
+		}
+
+		StatementBlockNode* copy = new StatementBlockNode();
+		for (auto& statement : block->statements) {
+			copy->statements.push_back(clone(statement));
+		}
+		return copy;
+	}
+
+	AstNode* TemplateCloner::clone(AstNode* node) {
+		if (node == nullptr) {
+			return nullptr;
+		}
+
+		switch (node->kind()) {
+		case NodeType::ImmediateInt: {
+			StaticIntegerNode* lit = static_cast<StaticIntegerNode*>(node);
+			return new StaticIntegerNode(lit->value(), lit->type_name());
+		}
+		case NodeType::ImmediateFloat: {
+			StaticFloatNode* lit = static_cast<StaticFloatNode*>(node);
+			return new StaticFloatNode(lit->value(), lit->type_name());
+		}
+		case NodeType::ImmediateBool: {
+			StaticBoolNode* lit = static_cast<StaticBoolNode*>(node);
+			return new StaticBoolNode(lit->value(), lit->type_name());
+		}
+		case NodeType::ImmediateChar: {
+			StaticCharNode* lit = static_cast<StaticCharNode*>(node);
+			return new StaticCharNode(lit->value(), lit->type_name());
+		}
+		case NodeType::ImmediateString: {
+			StaticStringNode* lit = static_cast<StaticStringNode*>(node);
+			return new StaticStringNode(lit->value(), lit->type_name());
+		}
+		case NodeType::Variable:
+			return new VariableNode(clone_path(static_cast<VariableNode*>(node)->path()));
+		case NodeType::BinaryOperator: {
+			BinaryOperator* op = static_cast<BinaryOperator*>(node);
+			BinaryOperator* copy = new BinaryOperator(op->m_Operator, clone(op->m_Lhs), clone(op->m_Rhs));
+			copy->parenthesized = op->parenthesized;
+			return copy;
+		}
+		case NodeType::UnaryOperator: {
+			UnaryOperator* op = static_cast<UnaryOperator*>(node);
+			return new UnaryOperator(op->m_Operator, clone(op->m_Child));
+		}
+		case NodeType::FunctionCall: {
+			FunctionCallNode* call = static_cast<FunctionCallNode*>(node);
+			ArgumentsNode* args = nullptr;
+			if (call->arguments != nullptr) {
+				args = new ArgumentsNode();
+				for (auto& arg : call->arguments->args) {
+					args->args.push_back(clone(arg));
+				}
+			}
+			return new FunctionCallNode(clone_path(call->function_name), args);
+		}
+		case NodeType::Propagate:
+			return new PropagateNode(clone(static_cast<PropagateNode*>(node)->value));
+		case NodeType::Return: {
+			ReturnNode* copy = new ReturnNode();
+			copy->returnValue = clone(static_cast<ReturnNode*>(node)->returnValue);
+			return copy;
+		}
+		case NodeType::VariableDeclaration: {
+			VariableDeclNode* decl = static_cast<VariableDeclNode*>(node);
+			VariableDeclNode* copy = new VariableDeclNode(decl->var_name, substitute(decl->type));
+			copy->visibility = decl->visibility;
+			copy->default_value = clone(decl->default_value);
+			return copy;
+		}
+		case NodeType::StatementBlock:
+			return clone_block(static_cast<StatementBlockNode*>(node));
+		case NodeType::If: {
+			IfNode* branch = static_cast<IfNode*>(node);
+			IfNode* copy = new IfNode();
+			copy->condition = clone(branch->condition);
+			copy->body = clone_block(branch->body);
+			copy->elseBranch = static_cast<ElseNode*>(clone(branch->elseBranch));
+			return copy;
+		}
+		case NodeType::Else: {
+			ElseNode* branch = static_cast<ElseNode*>(node);
+			ElseNode* copy = new ElseNode();
+			copy->ifBranch = static_cast<IfNode*>(clone(branch->ifBranch));
+			copy->body = clone_block(branch->body);
+			return copy;
+		}
+		case NodeType::For: {
+			ForNode* loop = static_cast<ForNode*>(node);
+			ForNode* copy = new ForNode();
+			copy->init = clone(loop->init);
+			copy->condition = clone(loop->condition);
+			copy->step = clone(loop->step);
+			copy->body = clone_block(loop->body);
+			return copy;
+		}
+		case NodeType::CBlock: {
+			InlineCBlock* copy = new InlineCBlock();
+			copy->tokens = static_cast<InlineCBlock*>(node)->tokens;
+			return copy;
+		}
+		case NodeType::Annotation: {
+			AnnotationNode* annotation = static_cast<AnnotationNode*>(node);
+			std::vector<AstNode*> params;
+			for (auto& param : annotation->params()) {
+				params.push_back(clone(param));
+			}
+			AnnotationNode* copy = new AnnotationNode(annotation->annotation_type(), params, clone(annotation->body()));
+			copy->value_type = annotation->value_type;
+			return copy;
+		}
+		default:
+			m_Context.errors.push_back("Cannot instantiate a template containing this kind of statement");
+			failed = true;
+			return nullptr;
+		}
+	}
+
+	class TemplateInstantiator : public AstVisitor<TemplateInstantiator> {
+	public:
+		inline TemplateInstantiator(ModuleNode* module, ParserContext& ctx) : m_Module{ module }, m_Context{ ctx } {}
+
+		size_t run();
+
+		void visit_call(FunctionCallNode* node);
+
+	private:
+		void resolve_variant_case(FunctionCallNode* node);
+
+		struct Pending {
+			FunctionDefinitionNode* function;
+			// template the function was specialised from and its arguments, empty for plain functions
+			FunctionDefinitionNode* generic;
+			std::vector<_type_id> args;
+			// length of the chain of instantiations that led here
+			size_t depth;
+		};
+
+		Name instantiate(FunctionDefinitionNode* generic, const std::vector<_type_id>& args);
+		_type_id resolve_argument(PathNode* path);
+
+	private:
+		ModuleNode* m_Module;
+		ParserContext& m_Context;
+
+		std::unordered_map<Name, FunctionDefinitionNode*> m_Templates;
+		std::unordered_map<std::string, Name> m_Instances;
+		std::vector<Pending> m_Pending;
+
+		const Pending* m_Current = nullptr;
+	};
+
+	_type_id TemplateInstantiator::resolve_argument(PathNode* path) {
+		// arguments inside a specialised body may still name the template's own parameters
+		std::vector<Name>* saved = m_Context.template_params;
+		std::vector<Name> params;
+		if (m_Current->generic != nullptr) {
+			params = m_Current->generic->templateParams->params;
+		}
+		m_Context.template_params = &params;
+		_type_id type = m_Context.resolve_type(path);
+		m_Context.template_params = saved;
+
+		if (type == 0) {
+			return 0;
+		}
+
+		auto r = TemplateCache::instance().substitute(type, m_Current->args, m_Context.types);
+		if (r.error_bit) {
+			m_Context.errors.push_back(r.error);
+			return 0;
+		}
+		return r.value;
+	}
+
+	Name TemplateInstantiator::instantiate(FunctionDefinitionNode* generic, const std::vector<_type_id>& args) {
+		std::string mangled = TemplateCache::mangle(generic->functionName, args, m_Context.types);
+
+		auto f = m_Instances.find(mangled);
+		if (f != m_Instances.end()) {
+			return f->second;
+		}
+
+		if (m_Instances.size() >= s_MaxFunctionInstances) {
+			m_Context.errors.push_back("Too many instances of generic functions, stopped at " + mangled);
+			return Name{};
+		}
+
+		// f<T> calling f<box<T>> never runs out of new argument types
+		size_t depth = m_Current->depth + 1;
+		if (depth > s_MaxInstantiationDepth) {
+			m_Context.errors.push_back("Instantiation of " + generic->functionName + " nests too deeply, does it call itself with growing template arguments?");
+			return Name{};
+		}
+
+		TemplateCloner cloner(m_Context, args);
+
+		FunctionDefinitionNode* instance = new FunctionDefinitionNode();
+		instance->functionName = Name{ mangled };
+		instance->returnType = cloner.substitute(generic->returnType);
+		instance->visibility = generic->visibility;
+		instance->const_eval = generic->const_eval;
+		instance->is_inline = generic->is_inline;
+		instance->stack_limit = generic->stack_limit;
+		instance->null_checks = generic->null_checks;
+		for (auto& condition : generic->preconditions) {
+			instance->preconditions.push_back(cloner.clone(condition));
+		}
+
+		if (generic->params != nullptr) {
+			instance->params = new ParameterListNode();
+			for (auto& param : generic->params->params) {
+				instance->params->params.push_back(Param{ cloner.substitute(param.type), param.name, param.moves });
+			}
+		}
+		instance->body = cloner.clone_block(generic->body);
+
+		if (cloner.failed) {
+			delete instance;
+			return Name{};
+		}
+
+		m_Module->body->functions.push_back(instance);
+		m_Instances[mangled] = instance->functionName;
+		m_Pending.push_back(Pending{ instance, generic, args, depth });
+
+		return instance->functionName;
+	}
+
+	void TemplateInstantiator::visit_call(FunctionCallNode* node) {
+		AstVisitor<TemplateInstantiator>::visit_call(node);
+
+		PathNode* path = node->function_name;
+		if (path != nullptr && path->nodes.size() == 2) {
+			resolve_variant_case(node);
+			return;
+		}
+		if (path == nullptr || path->nodes.size() != 1 || path->nodes[0].args == nullptr) {
+			return;
+		}
+
+		auto f = m_Templates.find(path->nodes[0].bit);
+		if (f == m_Templates.end()) {
+			return;
+		}
+
+		FunctionDefinitionNode* generic = f->second;
+		auto& targs = path->nodes[0].args->template_args;
+		if (targs.size() != generic->templateParams->params.size()) {
+			m_Context.errors.push_back("Generic function " + generic->functionName + " expects " + std::to_string(generic->templateParams->params.size()) +
+				" template arguments, got " + std::to_string(targs.size()));
+			return;
+		}
+
+		std::vector<_type_id> args;
+		for (auto& targ : targs) {
+			_type_id type = resolve_argument(targ);
+			if (type == 0) {
+				m_Context.errors.push_back("Unknown template argument " + targ->get_local_name() + " in call to " + generic->functionName);
+				return;
+			}
+			args.push_back(type);
+		}
+
+		Name name = instantiate(generic, args);
+		if (name.empty()) {
+			return;
+		}
+
+		PathNode* target = new PathNode();
+		target->nodes.push_back(PathArg{ name, nullptr });
+		delete node->function_name;
+		node->function_name = target;
+	}
+
+	// Enum.Case or Enum<args>.Case, only enums of the module and generic instances are looked up
+	void TemplateInstantiator::resolve_variant_case(FunctionCallNode* node) {
+		std::vector<PathArg>& nodes = node->function_name->nodes;
+		if (nodes[0].args == nullptr && !m_Context.types.is_variant(m_Context.types.get_id_from_name(nodes[0].bit.str()))) {
+			return;
+		}
+
+		// the enum alone, borrowing the call's template arguments for the lookup
+		PathNode enum_path;
+		enum_path.nodes.push_back(nodes[0]);
+		_type_id type = resolve_argument(&enum_path);
+		enum_path.nodes.clear();
+
+		if (!m_Context.types.is_variant(type)) {
+			return;
+		}
+
+		const std::vector<Name>& cases = m_Context.types.variant_of(type).cases;
+		for (size_t i = 0; i < cases.size(); i++) {
+			if (cases[i] == nodes[1].bit) {
+				node->variant = type;
+				node->variant_case = i;
+				return;
+			}
+		}
+	}
+
+	size_t TemplateInstantiator::run() {
+		for (auto& funcDef : m_Module->body->functions) {
+			if (funcDef->templateParams != nullptr) {
+				m_Templates[funcDef->functionName] = funcDef;
+			}
+			else {
+				m_Pending.push_back(Pending{ funcDef, nullptr, {}, 0 });
+			}
+		}
+
+		// instances are appended while the worklist is drained, so index rather than iterate
+		for (size_t i = 0; i < m_Pending.size(); i++) {
+			Pending current = m_Pending[i];
+			m_Current = &current;
+			visit(current.function->body);
+		}
+		m_Current = nullptr;
+
+		return m_Instances.size();
+	}
+
+	size_t InstantiateTemplates(ModuleNode* module, ParserContext& ctx) {
+		if (module == nullptr || module->body == nullptr) {
+			return 0;
+		}
+
+		ModuleNode* saved = ctx.current_module;
+		ctx.current_module = module;
+
+		TemplateInstantiator instantiator(module, ctx);
+		size_t count = instantiator.run();
+
+		ctx.current_module = saved;
+		return count;
+	}
+}
@@ -0,0 +1,326 @@
+#include "core/type_checker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace tau {
+
+	TypeChecker::TypeChecker(ParserContext& ctx) : m_Context{ ctx } {}
+
+	void TypeChecker::error(const std::string& message) {
+		m_Context.errors.push_back(message);
+		m_ErrorCount++;
+	}
+
+	void TypeChecker::declare_module(ModuleNode* node) {
+		Scope* scope = m_Context.active_symbol_scope;
+		m_Context.current_module = node;
+
+		ItemInfo self;
+		self.is_module = true;
+		scope->begin();
+		scope->add(node->moduleName->get_full_name(), self);
+
+		if (node->body == nullptr) {
+			return;
+		}
+
+		for (auto& structDef : node->body->structs) {
+			if (structDef->templateParams != nullptr) {
+				continue;
+			}
+
+			std::string fullName = node->moduleName->get_full_name().str();
+			fullName += ".";
+			fullName += structDef->struct_name.bit.str();
+
+			if (m_Context.types.get_id_from_name(fullName) != 0) {
+				continue;
+			}
+
+			std::vector<FieldDef> fields;
+			for (auto& member : structDef->members->members) {
+				FieldDef field;
+				field.name = member->var_name;
+				field.type = member->type;
+
+				fields.push_back(field);
+			}
+
+			m_Context.types.define_type(fullName, fields, structDef->layout);
+		}
+
+		// functions may be called before their definition, so declare them all up front
+		for (auto& funcDef : node->body->functions) {
+			ItemInfo func;
+			func.is_function = true;
+			func.type_id = funcDef->returnType;
+			scope->add(funcDef->functionName, func);
+		}
+	}
+
+	void TypeChecker::end_module() {
+		m_Context.active_symbol_scope->end();
+		m_Context.current_module = nullptr;
+	}
+
+	void TypeChecker::visit_module(ModuleNode* node) {
+		declare_module(node);
+		visit(node->body);
+		end_module();
+	}
+
+	void TypeChecker::visit_function(FunctionDefinitionNode* node) {
+		if (node->templateParams != nullptr) {
+			return;
+		}
+
+		Scope* scope = m_Context.active_symbol_scope;
+		scope->begin();
+
+		if (node->params != nullptr) {
+			for (auto& param : node->params->params) {
+				scope->add_variable(param.name, param.type);
+			}
+		}
+
+		for (auto& index : node->null_checks) {
+			const Param& param = node->params->params[index];
+			if (!m_Context.types.is_pointer(param.type)) {
+				error("@null_check on " + param.name + " in " + node->functionName + ", which is not a pointer");
+			}
+		}
+
+		for (auto& condition : node->preconditions) {
+			assertion(condition, "@pre_assert on entry of " + node->functionName);
+		}
+
+		m_Function = node;
+		visit(node->body);
+		m_Function = nullptr;
+
+		scope->end();
+	}
+
+	void TypeChecker::visit_block(StatementBlockNode* node) {
+		m_Context.active_symbol_scope->begin();
+		for (auto& statement : node->statements) {
+			visit(statement);
+		}
+		m_Context.active_symbol_scope->end();
+	}
+
+	void TypeChecker::visit_for(ForNode* node) {
+		// a variable declared by the loop is scoped to it
+		m_Context.active_symbol_scope->begin();
+		visit(node->init);
+		visit(node->condition);
+		visit(node->step);
+		visit(node->body);
+		m_Context.active_symbol_scope->end();
+	}
+
+	void TypeChecker::assertion(AstNode* condition, const std::string& what) {
+		visit(condition);
+
+		_type_id type = as_typed(condition)->get_type(m_Context);
+		if (type != 0 && type != TYPE_BOOL) {
+			error(what + " expects a bool, got " + m_Context.types.name_of(type));
+		}
+	}
+
+	void TypeChecker::visit_variable_decl(VariableDeclNode* node) {
+		visit(node->default_value);
+		m_Context.active_symbol_scope->add_variable(node->var_name, node->type);
+	}
+
+	void TypeChecker::visit_binary(BinaryOperator* node) {
+		visit(node->m_Lhs);
+		visit(node->m_Rhs);
+
+		if (node->get_type(m_Context) == 0) {
+			error("Could not find operator implementation for binary operator: " + get_opstr(node->m_Operator) + " using (" +
+				m_Context.types.name_of(as_typed(node->m_Lhs)->get_type(m_Context)) + ", " +
+				m_Context.types.name_of(as_typed(node->m_Rhs)->get_type(m_Context)) + ")");
+		}
+	}
+
+	void TypeChecker::visit_unary(UnaryOperator* node) {
+		visit(node->m_Child);
+
+		if (node->get_type(m_Context) == 0) {
+			error("Could not find operator implementation for unary operator: " + get_opstr(node->m_Operator) + " using (" +
+				m_Context.types.name_of(as_typed(node->m_Child)->get_type(m_Context)) + ")");
+		}
+	}
+
+	void TypeChecker::visit_call(FunctionCallNode* node) {
+		AstVisitor<TypeChecker>::visit_call(node);
+
+		if (node->get_type(m_Context) == 0) {
+			error("Unknown function: " + node->function_name->get_local_name());
+		}
+		else if (node->variant != 0) {
+			construction(node);
+		}
+	}
+
+	void TypeChecker::construction(FunctionCallNode* node) {
+		std::string name = node->function_name->nodes[0].bit + "." + node->function_name->nodes[1].bit.str();
+		_type_id payload = m_Context.types.case_type(node->variant, node->variant_case);
+		size_t count = node->arguments != nullptr ? node->arguments->args.size() : 0;
+		if (count != (payload != TYPE_VOID ? 1 : 0)) {
+			error(name + " takes " + (payload != TYPE_VOID ? "one argument" : "no arguments") + ", got " + std::to_string(count));
+			return;
+		}
+		if (payload == TYPE_VOID) {
+			return;
+		}
+
+		// literals fit any payload of their kind, like they do on assignment
+		_type_id type = as_typed(node->arguments->args[0])->get_type(m_Context);
+		bool literal = (type == TYPE_STATIC_INT && payload >= TYPE_U8 && payload <= TYPE_I64) ||
+			(type == TYPE_STATIC_FLOAT && (payload == TYPE_F32 || payload == TYPE_F64));
+		if (type != 0 && type != payload && !literal) {
+			error(name + " expects a " + m_Context.types.name_of(payload) + ", got " + m_Context.types.name_of(type));
+		}
+	}
+
+	void TypeChecker::visit_propagate(PropagateNode* node) {
+		visit(node->value);
+
+		_type_id type = as_typed(node->value)->get_type(m_Context);
+		if (type == 0) {
+			return;
+		}
+		if (node->get_type(m_Context) == 0) {
+			error("? expects an enum with a success and a failure case, got " + m_Context.types.name_of(type));
+			return;
+		}
+
+		_type_id returned = m_Function->returnType;
+		if (!m_Context.types.is_variant(returned)) {
+			error(std::string("? in ") + m_Function->functionName + ", which does not return an enum");
+			return;
+		}
+		if (returned == type) {
+			return;
+		}
+
+		// every failure is handed on as the case of the same name
+		const VariantLayout& variant = m_Context.types.variant_of(type);
+		const std::vector<Name>& cases = m_Context.types.variant_of(returned).cases;
+		for (size_t i = 1; i < variant.cases.size(); i++) {
+			auto c = std::find(cases.begin(), cases.end(), variant.cases[i]);
+			if (c == cases.end() || m_Context.types.case_type(returned, c - cases.begin()) != m_Context.types.case_type(type, i)) {
+				error("? cannot return the " + variant.cases[i].str() + " case of " + m_Context.types.name_of(type) + " as " + m_Context.types.name_of(returned));
+			}
+		}
+	}
+
+	void TypeChecker::visit_annotation(AnnotationNode* node) {
+		if (node->annotation_type() == "pre_assert") {
+			assertion(node->params()[0], "@pre_assert");
+			return;
+		}
+
+		AstVisitor<TypeChecker>::visit_annotation(node);
+
+		if (node->annotation_type() == "null_check") {
+			for (auto& param : node->params()) {
+				_type_id type = as_typed(param)->get_type(m_Context);
+				if (type != 0 && !m_Context.types.is_pointer(type)) {
+					error("@null_check on " + static_cast<VariableNode*>(param)->path()->get_local_name() + ", which is not a pointer");
+				}
+			}
+		}
+		else if (node->annotation_type() == "free") {
+			_type_id type = as_typed(node->params()[0])->get_type(m_Context);
+			if (type != 0 && !m_Context.types.is_pointer(type)) {
+				error("@free on " + static_cast<VariableNode*>(node->params()[0])->path()->get_local_name() + ", which is not a pointer");
+			}
+		}
+		else if (node->annotation_type() == "alloc") {
+			if (node->value_type == 0) {
+				error("@alloc can only initialize a pointer declaration");
+			}
+			_type_id count = as_typed(node->body())->get_type(m_Context);
+			if (count != 0 && count != TYPE_STATIC_INT && (count < TYPE_U8 || count > TYPE_I64)) {
+				error("@alloc expects an integer count, got " + m_Context.types.name_of(count));
+			}
+		}
+		else if (node->annotation_type() == "not_null") {
+			_type_id type = node->get_type(m_Context);
+			if (type != 0 && !m_Context.types.is_pointer(type)) {
+				error("@not_null on a value of type " + m_Context.types.name_of(type) + ", which is not a pointer");
+			}
+		}
+	}
+
+	void TypeChecker::visit_variable(VariableNode* node) {
+		if (node->get_type(m_Context) == 0) {
+			error("Unknown variable: " + node->path()->get_local_name());
+		}
+	}
+
+	bool TypeCheckModule(ModuleNode* module, ParserContext& ctx, size_t threads) {
+		if (threads == 0) {
+			threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+		}
+
+		if (threads == 1 || module->body == nullptr || module->body->functions.size() < 2) {
+			TypeChecker checker(ctx);
+			checker.visit(module);
+			return checker.error_count() == 0;
+		}
+
+		TypeChecker declarations(ctx);
+		declarations.declare_module(module);
+		for (auto& structDef : module->body->structs) {
+			declarations.visit(structDef);
+		}
+
+		std::vector<FunctionDefinitionNode*>& functions = module->body->functions;
+		std::vector<std::vector<std::string>> errors(functions.size());
+		std::atomic<size_t> next{ 0 };
+
+		auto worker = [&]() {
+			Scope scope = *ctx.active_symbol_scope;
+			ParserContext local = ctx;
+			local.errors.clear();
+			local.active_symbol_scope = &scope;
+
+			size_t i;
+			while ((i = next.fetch_add(1)) < functions.size()) {
+				TypeChecker checker(local);
+				checker.visit(functions[i]);
+
+				errors[i] = std::move(local.errors);
+				local.errors.clear();
+			}
+		};
+
+		threads = std::min(threads, functions.size());
+
+		std::vector<std::thread> pool;
+		for (size_t t = 1; t < threads; t++) {
+			pool.emplace_back(worker);
+		}
+		worker();
+
+		for (auto& thread : pool) {
+			thread.join();
+		}
+
+		declarations.end_module();
+
+		size_t error_count = declarations.error_count();
+		for (auto& list : errors) {
+			error_count += list.size();
+			ctx.errors.insert(ctx.errors.end(), list.begin(), list.end());
+		}
+
+		return error_count == 0;
+	}
+}
@@ -1,9 +1,11 @@
 #include "tau.h"
 
 
+#include <cstdlib>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 #include <string>
 
 /*
@@ -142,6 +144,10 @@ pub fn main() void {
 }
 */
 
+/*
+Tagged-struct AST the library may move to, built by hand for the program above. Kept as
+a sketch, the driver below is what the tau binary runs.
+
 enum class OperatorID {
 	Undefined = 0,
 	Negative,
@@ -677,19 +683,9 @@ int main(int argc, char** argv) {
 
 	return 0;
 }
+*/
 
 
-
-
-
-
-
-
-
-
-
-
-/*
 #include "toml.h"
 
 std::vector<std::string> get_args(int argc, char** argv) {
@@ -730,7 +726,33 @@ void generate_main_tau(const std::string& name) {
 	f.close();
 }
 
-void build_project();
+// the fixed width types every generated C file includes
+void generate_tautypes_h() {
+	std::ofstream f("./tmp/tautypes.h");
+
+	f << "#pragma once\n\n";
+	f << "#include <stdint.h>\n\n";
+	for (const char* width : { "8", "16", "32", "64" }) {
+		f << "typedef uint" << width << "_t u" << width << ";\n";
+		f << "typedef int" << width << "_t i" << width << ";\n";
+	}
+	f << "typedef float f32;\n";
+	f << "typedef double f64;\n";
+
+	f.close();
+}
+
+struct BuildOptions {
+	bool time_passes = false;
+	// type checking workers per module, 0 for one per core
+	size_t jobs = 0;
+	// counts calls and branches, the program appends them to $TAU_PROFILE or ./tau.profile at exit
+	bool instrument = false;
+	// a profile an instrumented build wrote, empty for none
+	std::string profile_use;
+};
+
+void build_project(const BuildOptions& options);
 
 
 void copyFolder(const std::filesystem::path& source, const std::filesystem::path& destination) {
@@ -757,7 +779,7 @@ void copyFolder(const std::filesystem::path& source, const std::filesystem::path
 	}
 }
 
-void build_file(std::filesystem::path filename);
+void build_file(std::filesystem::path filename, const BuildOptions& options = {}, const tau::Profile* profile = nullptr);
 
 int main(int argc, char** argv) {
 	using namespace tau;
@@ -768,14 +790,15 @@ int main(int argc, char** argv) {
 		if (args[0] == "create") {
 			std::string name = args[1];
 
-			std::filesystem::create_directory(".\\" + name);
-			std::filesystem::create_directory(".\\" + name + "\\src\\");
-			std::filesystem::create_directory(".\\" + name + "\\tmp\\");
-			std::filesystem::create_directory(".\\" + name + "\\bin\\");
-			std::filesystem::create_directory(".\\" + name + "\\libs\\");
+			std::filesystem::path project = name;
+			std::filesystem::create_directory(project);
+			std::filesystem::create_directory(project / "src");
+			std::filesystem::create_directory(project / "tmp");
+			std::filesystem::create_directory(project / "bin");
+			std::filesystem::create_directory(project / "libs");
 
-			copyFolder(".\\data\\bin\\cc\\", ".\\" + name + "\\bin\\cc\\");
-			//copyFolder(".\\data\\stdlib\\", ".\\" + name + "\\libs\\stdlib\\");
+			copyFolder(std::filesystem::path("data") / "bin" / "cc", project / "bin" / "cc");
+			//copyFolder(std::filesystem::path("data") / "stdlib", project / "libs" / "stdlib");
 
 			generate_project_toml(name);
 			generate_main_tau(name);
@@ -785,12 +808,43 @@ int main(int argc, char** argv) {
 	}
 	if (args.size() == 0) {
 		std::cout << "tau [create] [name]\n";
-		std::cout << "tau [build]\n";
+		std::cout << "tau [build] [--time-passes] [--jobs=<n>] [--instrument | --profile-use=<file>]\n";
 		return 0;
 	}
 
 	if (args[0] == "build") {
-		build_project();
+		BuildOptions options;
+		const std::string profile_use = "--profile-use=";
+		const std::string jobs = "--jobs=";
+		for (size_t i = 1; i < args.size(); i++) {
+			if (args[i] == "--time-passes") {
+				options.time_passes = true;
+			}
+			else if (args[i].compare(0, jobs.size(), jobs) == 0) {
+				std::string count = args[i].substr(jobs.size());
+				if (count.empty() || count.find_first_not_of("0123456789") != std::string::npos) {
+					std::cout << "--jobs needs a number of threads, got " << count << "\n";
+					return 1;
+				}
+				options.jobs = std::stoul(count);
+			}
+			else if (args[i] == "--instrument") {
+				options.instrument = true;
+			}
+			else if (args[i].compare(0, profile_use.size(), profile_use) == 0) {
+				options.profile_use = args[i].substr(profile_use.size());
+			}
+			else {
+				std::cout << "Unknown option " << args[i] << "\n";
+				return 1;
+			}
+		}
+		// an instrumented build only counts, a profile it was given would go unused
+		if (options.instrument && !options.profile_use.empty()) {
+			std::cout << "--instrument and --profile-use cannot be combined\n";
+			return 1;
+		}
+		build_project(options);
 	}
 	else if (args[0] == "debug") {
 		build_file("./hello/src/main.tau");
@@ -799,7 +853,7 @@ int main(int argc, char** argv) {
 	return 0;
 }
 
-void build_file(std::filesystem::path filename) {
+void build_file(std::filesystem::path filename, const BuildOptions& options, const tau::Profile* profile) {
 	std::string input_file = filename.string();
 	std::stringstream text;
 	std::ifstream in(input_file);
@@ -832,9 +886,53 @@ void build_file(std::filesystem::path filename) {
 		return;
 	}
 
-	tau::ModuleNode* modul = dynamic_cast<tau::ModuleNode*>(node);
+	tau::ModuleNode* modul = tau::node_cast<tau::ModuleNode>(node);
+	if (modul == nullptr) {
+		std::cout << "Error compiling file\n";
+		delete node;
+		return;
+	}
+
+	tau::InstantiateTemplates(modul, ctx);
+	if (!ctx.errors.empty()) {
+		for (auto& err : ctx.errors) {
+			std::cout << "Error: " << err << "\n";
+		}
+		std::cout << "Error compiling file\n";
+		return;
+	}
 
-	std::string module_name = modul->moduleName->get_full_name();
+	if (!tau::TypeCheckModule(modul, ctx, options.jobs) || !tau::CheckMoves(modul, ctx)) {
+		for (auto& err : ctx.errors) {
+			std::cout << "Error: " << err << "\n";
+		}
+		std::cout << "Error compiling file\n";
+		return;
+	}
+
+	tau::PassManager passes(ctx);
+	if (options.instrument) {
+		passes.add_module_pass("instrument", tau::InstrumentModule);
+	}
+	else if (profile != nullptr) {
+		passes.add_module_pass("profile", [profile](tau::ModuleNode* module, tau::ParserContext& ctx) {
+			return tau::ApplyProfile(module, ctx, *profile);
+		});
+	}
+	tau::AddDefaultPasses(passes);
+	if (!passes.run(modul)) {
+		for (auto& err : ctx.errors) {
+			std::cout << "Error: " << err << "\n";
+		}
+		std::cout << "Error compiling file\n";
+		return;
+	}
+
+	if (options.time_passes) {
+		passes.print_timings(std::cout);
+	}
+
+	std::string module_name = modul->moduleName->get_full_name().str();
 
 	std::string outname = "./tmp/";
 	outname += module_name;
@@ -855,12 +953,30 @@ void build_file(std::filesystem::path filename) {
 
 void compile_project();
 
-void build_project() {
+void build_project(const BuildOptions& options) {
 	if (!std::filesystem::exists("project.toml")) {
 		std::cout << "Could not find project config file.\n";
 		return;
 	}
 
+	tau::Profile profile;
+	if (!options.profile_use.empty()) {
+		std::ifstream in(options.profile_use);
+		if (!in.good()) {
+			std::cout << "Could not open profile " << options.profile_use << "\n";
+			return;
+		}
+
+		tau::result<bool> loaded = profile.load(in);
+		if (loaded.error_bit) {
+			std::cout << loaded.error << "\n";
+			return;
+		}
+	}
+
+	std::filesystem::create_directory("./tmp/");
+	generate_tautypes_h();
+
 	std::filesystem::path src = "./src/";
 	for (const auto& file_ : std::filesystem::directory_iterator(src)) {
 		if (!std::filesystem::is_regular_file(file_.path())) {
@@ -871,7 +987,7 @@ void build_project() {
 			continue;
 		}
 		std::cout << "Compiling " << file_.path().string() << "...";
-		build_file(file_.path());
+		build_file(file_.path(), options, options.profile_use.empty() ? nullptr : &profile);
 		std::cout << "Done.\n";
 	}
 
@@ -879,20 +995,43 @@ void build_project() {
 }
 
 void compile_project() {
+	namespace fs = std::filesystem;
 	std::cout << "Compiling...\n";
 
 	auto project = toml::parse_file("project.toml");
 
-	std::string_view compiler = project["config"]["compiler"].value_or(std::string_view(""));
-	if (compiler == "default") {
-		compiler = ".\\bin\\cc\\tcc.exe";
+	std::string compiler{ project["config"]["compiler"].value_or(std::string_view("")) };
+	if (compiler.empty() || compiler == "default") {
+#ifdef _WIN32
+		compiler = (fs::path("bin") / "cc" / "tcc.exe").string();
+#else
+		compiler = "cc";
+#endif
 	}
-	std::string_view name = project["config"]["name"].value_or(std::string_view(""));
-
+	std::string name{ project["config"]["name"].value_or(std::string_view("")) };
+
+	fs::create_directory("bin");
+	fs::path output = fs::path("bin") / name;
+#ifdef _WIN32
+	output += ".exe";
+#endif
+
+	/*
+	No -fprofile-* flags: a profile-use build emits different C than the instrumented one
+	(no counters, functions reordered), so the C compiler's own profile would not match
+	it. The Tau profile already steers ordering, hot/cold, branch hints and inlining.
+	*/
 	std::stringstream command;
-	command << compiler << " -o .\\bin\\" << name << ".exe " << ".\\tmp\\*.c";
+	command << compiler << " -o \"" << output.string() << "\"";
+	for (const auto& file : fs::directory_iterator("tmp")) {
+		if (file.path().extension() == ".c") {
+			command << " \"" << file.path().string() << "\"";
+		}
+	}
 	std::cout << command.str() << "\n";
-	std::system(command.str().c_str());
+	if (std::system(command.str().c_str()) != 0) {
+		std::cout << "C compiler failed\n";
+	}
 }
 
 /*
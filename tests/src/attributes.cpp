@@ -0,0 +1,157 @@
+#include "tau_test.h"
+
+/*
+Attribute inference regression test.
+
+Functions get const, pure, noreturn and restrict parameters where they hold and ifs
+leading to a call that never returns expect the other side. The annotated module computes
+what it computed without them. Tail loops that never reach a return are endless:
+noreturn and never const or pure, so the C compiler cannot drop or merge calls to them.
+
+usage: attributes
+*/
+
+using namespace tau_test;
+
+static bool attributes_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::PassManager passes(ctx);
+	passes.add_module_pass("attributes", tau::InferAttributes);
+	return passes.run(module);
+}
+
+static bool tail_attributes(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::PassManager passes(ctx);
+	passes.add_module_pass("tail-calls", tau::EliminateTailCalls);
+	passes.add_module_pass("attributes", tau::InferAttributes);
+	return passes.run(module);
+}
+
+// the line of the header declaring function name
+static std::string prototype(const Compiled& compiled, const std::string& name) {
+	size_t at = compiled.header.find(" " + name + "(");
+	if (at == std::string::npos) {
+		return "";
+	}
+	size_t start = compiled.header.rfind('\n', at) + 1;
+	return compiled.header.substr(start, compiled.header.find('\n', at) - start);
+}
+
+static const char* s_Source = R"(mod attr_a;
+
+pub fn spin() void {
+	for (;;) {
+	}
+}
+
+pub fn down(i64 x) i64 {
+	if (x <= 0) {
+		return 0;
+	}
+	return down(x - 1);
+}
+
+pub fn halt(i64 x) void {
+	spin();
+}
+
+pub fn add(i64 a, i64 b) i64 {
+	return a + b;
+}
+
+pub fn load(i64* p) i64 {
+	return p[0];
+}
+
+pub fn store(i64* p) i64 {
+	p[0] = 1;
+	return 0;
+}
+
+pub fn guard(i64 x) i64 {
+	if (x < 0) {
+		spin();
+	}
+	return x;
+}
+
+fn fill(i64* a, i64* b, u64 n) void {
+	for (u64 i = 0; i < n; i++) {
+		a[i] = b[i];
+	}
+}
+
+pub fn copy() i64 {
+	i64* a = @alloc(4);
+	i64* b = @alloc(4);
+	b[0] = 5;
+	fill(a, b, 1);
+	i64 r = a[0];
+	@free(a);
+	@free(b);
+	return r;
+}
+)";
+
+static const char* s_Main = "#include <stdio.h>\n#include <stdlib.h>\n#include \"tautypes.h\"\n#include \"attr_a.h\"\n"
+	"int main() { i64 v = 4; i64 w = 0; i64 s = store(&w); printf(\"%lld %lld %lld %lld %lld %lld %lld\\n\", (long long)down(1000), (long long)add(2, 3), (long long)load(&v),"
+	" (long long)s, (long long)w, (long long)guard(6), (long long)copy()); return 0; }\n";
+
+int main() {
+	Compiled inferred = compile(s_Source, attributes_only);
+	check(inferred.ok, "attr_a compiles");
+
+	check(contains(prototype(inferred, "spin"), "noreturn"), "an endless loop is noreturn");
+	check(!contains(prototype(inferred, "spin"), "const") && !contains(prototype(inferred, "spin"), "pure"), "an endless loop is neither const nor pure");
+	check(contains(prototype(inferred, "halt"), "noreturn"), "ending in a noreturn call is noreturn");
+	check(contains(prototype(inferred, "down"), "const"), "recursion on arguments is const");
+	check(contains(prototype(inferred, "add"), "const"), "arithmetic on arguments is const");
+	check(contains(prototype(inferred, "load"), "pure"), "reading through a pointer is pure");
+	check(!contains(prototype(inferred, "store"), "__attribute__"), "writing through a pointer is impure");
+
+	check(contains(function_body(inferred, "i64 guard(i64 x)"), "__builtin_expect"), "the side calling a noreturn function is cold");
+	check(contains(function_body(inferred, "void fill(i64* restrict a, i64* restrict b, u64 n)"), "b[i]"), "distinct non-escaping allocations are restrict");
+
+	Compiled looped = compile(R"(mod attr_b;
+
+pub fn endless(i64 x) i64 {
+	return endless(x + 1);
+}
+
+pub fn bouncing(i64 x) i64 {
+	if (x > 0) {
+		return bouncing(x - 1);
+	}
+	return bouncing(x + 2);
+}
+
+pub fn down(i64 x) i64 {
+	if (x <= 0) {
+		return 0;
+	}
+	return down(x - 1);
+}
+
+pub fn calls_endless(i64 x) i64 {
+	return endless(x) + down(x);
+}
+)", tail_attributes);
+
+	check(looped.ok, "attr_b compiles");
+	check(contains(prototype(looped, "endless"), "noreturn"), "a tail loop without a return is noreturn");
+	check(contains(prototype(looped, "bouncing"), "noreturn"), "a tail loop whose every path loops is noreturn");
+	check(!contains(prototype(looped, "endless"), "const") && !contains(prototype(looped, "bouncing"), "const"), "endless tail loops are not const");
+	check(!contains(prototype(looped, "calls_endless"), "const") && !contains(prototype(looped, "calls_endless"), "pure"), "calling an endless function is not const");
+	check(contains(prototype(looped, "down"), "const"), "a tail loop that returns stays const");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "attr_a compiles without the pass");
+
+		std::string expected;
+		std::string output;
+		check(run_c("attributes_plain", { plain }, s_Main, expected) == 0 && expected == "0 5 4 0 1 6 5\n", "the module computes the expected values, got " + expected);
+		check(run_c("attributes", { inferred }, s_Main, output) == 0 && output == expected, "annotated functions compute the same, got " + output);
+	}
+
+	return finish();
+}
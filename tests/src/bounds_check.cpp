@@ -0,0 +1,113 @@
+#include "tau_test.h"
+
+/*
+Bounds check elimination regression test.
+
+@pre_assert checks proven by a loop condition, an if or an earlier check disappear and
+calls whose preconditions hold skip them, and checks that do not depend on the loop are
+hoisted out of it behind its entry condition. Proven code computes the same, while every
+index that can fail still aborts: unproven calls, indices written in the loop and hoisted
+checks of loops that run.
+
+usage: bounds_check
+*/
+
+using namespace tau_test;
+
+static bool checks_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::ElideNullChecks(module, ctx);
+	tau::EliminateBoundsChecks(module, ctx);
+	return true;
+}
+
+// runs main_body with i64 a[4] = { 1, 2, 3, 4 }, returns whether it exited normally
+static bool exits(const Compiled& module, const std::string& name, const std::string& main_body, std::string& output) {
+	return run_c(name, { module }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"" + module.module + ".h\"\n"
+		"int main() { i64 a[4] = { 1, 2, 3, 4 }; " + main_body + " return 0; }\n", output) == 0;
+}
+
+int main() {
+	Compiled eliminated = compile(R"(mod bnd_a;
+
+pub fn get(i64* p, u64 len, u64 i) i64 {
+	@pre_assert(i < len);
+	return p[i];
+}
+
+pub fn sum(i64* p, u64 len) i64 {
+	i64 total = 0;
+	for (u64 i = 0; i < len; i++) {
+		total = total + get(p, len, i);
+	}
+	return total;
+}
+
+pub fn prefix(i64* p, u64 len, u64 n) i64 {
+	@pre_assert(n <= len);
+	i64 total = 0;
+	for (u64 i = 0; i < n; i++) {
+		@pre_assert(i < len);
+		total = total + p[i];
+	}
+	return total;
+}
+
+pub fn hoisted(i64* p, u64 len, u64 n, u64 k) i64 {
+	i64 total = 0;
+	for (u64 i = 0; i < n; i++) {
+		@pre_assert(k < len);
+		total = total + p[k];
+	}
+	return total;
+}
+
+pub fn guarded(i64* p, u64 len, u64 i) i64 {
+	if (i < len) {
+		return get(p, len, i);
+	}
+	return 0;
+}
+
+pub fn unproven(i64* p, u64 len, u64 n) i64 {
+	i64 total = 0;
+	for (u64 i = 0; i < n; i++) {
+		total = total + get(p, len, i);
+	}
+	return total;
+}
+
+pub fn written(i64* p, u64 len) i64 {
+	i64 total = 0;
+	for (u64 i = 0; i < len; i++) {
+		i = i + 1;
+		total = total + get(p, len, i);
+	}
+	return total;
+}
+)", checks_only);
+
+	check(eliminated.ok, "bnd_a compiles");
+	check(contains(function_body(eliminated, "i64 sum(i64* p, u64 len)"), "get__unchecked("), "the loop condition proves the callee's precondition");
+	check(contains(function_body(eliminated, "i64 guarded(i64* p, u64 len, u64 i)"), "get__unchecked("), "an if proves the check in its branch");
+
+	std::string prefix = function_body(eliminated, "i64 prefix__unchecked(i64* p, u64 len, u64 n)");
+	check(!prefix.empty() && !contains(prefix, "abort"), "i < n and n <= len prove i < len");
+
+	std::string hoisted = function_body(eliminated, "i64 hoisted(i64* p, u64 len, u64 n, u64 k)");
+	check(contains(hoisted, "k < len") && hoisted.find("k < len") < hoisted.find("for"), "a check independent of the loop is hoisted in front of it");
+
+	if (has_c_compiler()) {
+		std::string output;
+		check(exits(eliminated, "bounds_check", "printf(\"%lld %lld %lld %lld %lld %lld %lld\\n\", (long long)sum(a, 4), (long long)prefix(a, 4, 3), (long long)hoisted(a, 4, 3, 1),"
+			" (long long)hoisted(a, 4, 0, 7), (long long)guarded(a, 4, 2), (long long)guarded(a, 4, 9), (long long)unproven(a, 4, 3));", output) && output == "10 6 6 0 3 0 6\n",
+			"proven code computes the same, got " + output);
+
+		check(!exits(eliminated, "bounds_check_get", "get(a, 4, 4);", output), "a failing @pre_assert aborts");
+		check(!exits(eliminated, "bounds_check_prefix", "prefix(a, 4, 5);", output), "a failing precondition aborts");
+		check(!exits(eliminated, "bounds_check_hoisted", "hoisted(a, 4, 2, 7);", output), "a hoisted check still aborts when the loop runs");
+		check(!exits(eliminated, "bounds_check_unproven", "unproven(a, 4, 5);", output), "an unproven call keeps the check");
+		check(!exits(eliminated, "bounds_check_written", "written(a, 3);", output), "an index written in the loop keeps the check");
+	}
+
+	return finish();
+}
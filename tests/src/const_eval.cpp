@@ -0,0 +1,109 @@
+#include "tau_test.h"
+
+/*
+Compile-time evaluation regression test.
+
+Calls to pure module functions with constant arguments are replaced by their result,
+recursion included, and the program prints what it printed when the calls ran. Calls with
+runtime arguments and calls that never return are left to run, and a @const_eval function
+that cannot be evaluated is an error.
+
+usage: const_eval
+*/
+
+using namespace tau_test;
+
+static const char* s_Source = R"(mod eval_a;
+
+fn fact(i64 n) i64 {
+	if (n < 2) {
+		return 1;
+	}
+	return n * fact(n - 1);
+}
+
+fn fib(i64 n) i64 {
+	if (n < 2) {
+		return n;
+	}
+	return fib(n - 1) + fib(n - 2);
+}
+
+fn half(f64 x) f64 {
+	return x / 2.0;
+}
+
+fn spin(i64 n) i64 {
+	return spin(n + 1);
+}
+
+pub fn facts() i64 {
+	return fact(10);
+}
+
+pub fn small_fib() i64 {
+	return fib(20);
+}
+
+pub fn fibs() i64 {
+	return fib(80);
+}
+
+pub fn halves() f64 {
+	return half(5.0) + half(1.0);
+}
+
+pub fn runtime(i64 x) i64 {
+	return fact(x);
+}
+
+pub fn endless() i64 {
+	return spin(0);
+}
+)";
+
+static const std::string s_Main = "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"eval_a.h\"\n"
+	"int main() { printf(\"%lld %lld %.2f %lld\\n\", (long long)facts(), (long long)small_fib(), halves(), (long long)runtime(6));";
+
+int main() {
+	Compiled evaluated = compile(s_Source);
+	check(evaluated.ok, "eval_a compiles");
+
+	check(!contains(function_body(evaluated, "i64 facts()"), "fact("), "fact(10) is evaluated");
+	check(!contains(function_body(evaluated, "i64 fibs()"), "fib("), "fib(80) is evaluated");
+	check(!contains(function_body(evaluated, "f64 halves()"), "half("), "float arithmetic is evaluated");
+	check(contains(function_body(evaluated, "i64 runtime(i64 x)"), "fact("), "a call with a runtime argument is kept");
+	check(contains(function_body(evaluated, "i64 endless()"), "spin("), "a call that never returns is left to run");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "eval_a compiles without the passes");
+
+		// fib(80) only finishes when it was evaluated
+		std::string expected;
+		std::string output;
+		check(run_c("const_eval_plain", { plain }, s_Main + " return 0; }\n", expected) == 0 && expected == "3628800 6765 3.00 720\n", "the calls compute the expected values, got " + expected);
+		check(run_c("const_eval", { evaluated }, s_Main + " printf(\"%lld\\n\", (long long)fibs()); return 0; }\n", output) == 0 && output == expected + "23416728348467685\n",
+			"evaluated calls print what the calls did, got " + output);
+	}
+
+	Compiled rejected = compile(R"(mod eval_b;
+
+@const_eval
+fn table(i64 n) i64 {
+	return n * 2;
+}
+
+pub fn use(i64 x) i64 {
+	return table(x);
+}
+)");
+
+	bool reported = false;
+	for (auto& error : rejected.errors) {
+		reported |= contains(error, "@const_eval function table");
+	}
+	check(!rejected.ok && reported, "a @const_eval call with a runtime argument is an error");
+
+	return finish();
+}
@@ -0,0 +1,96 @@
+#include "tau_test.h"
+
+/*
+Constant folding regression test.
+
+Builds the same module with and without FoldConstants and runs both: folding has to give
+what the C compiler computes from the unfolded source, precedence, promotion, wraparound
+and truncating division included. Checks that the constant functions really fold and
+that overflow and division by zero are left to C.
+
+usage: const_fold
+*/
+
+using namespace tau_test;
+
+static const char* s_Source = R"(mod fold_a;
+
+pub fn arith() i64 {
+	return 2 * 3 + 1;
+}
+
+pub fn grouped() i64 {
+	i64 a = 7;
+	i64 b = 3;
+	i64 c = 5;
+	return a - b - c + a * b % c - (a - b) * c / 2 + 100 / a / b;
+}
+
+pub fn signs() i64 {
+	return -7 / 2 * 10 + -7 % 3;
+}
+
+pub fn ratio() f64 {
+	return 2.0 / 3.0 + 1.5;
+}
+
+pub fn wraps() u8 {
+	u8 a = 250;
+	return a + 10;
+}
+
+pub fn wraps_wide() u32 {
+	u32 a = 4294967295;
+	return a + 1;
+}
+
+pub fn propagated(i64 x) i64 {
+	i64 k = 4;
+	return x * k;
+}
+
+pub fn reassigned(i64 x) i64 {
+	i64 k = 4;
+	i64 old = k = x;
+	return k + old;
+}
+
+pub fn overflow() i64 {
+	return 9223372036854775807 + 1;
+}
+
+pub fn by_zero(i64 x) i64 {
+	return 10 / 0;
+}
+)";
+
+static const char* s_Main = "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"fold_a.h\"\n"
+	"int main() { printf(\"%lld %lld %lld %.4f %u %u %lld %lld\\n\", (long long)arith(), (long long)grouped(), (long long)signs(), ratio(),"
+	" (unsigned)wraps(), (unsigned)wraps_wide(), (long long)propagated(6), (long long)reassigned(9)); return 0; }\n";
+
+int main() {
+	Compiled folded = compile(s_Source);
+	check(folded.ok, "fold_a compiles folded");
+
+	std::string arith = function_body(folded, "i64 arith()");
+	check(!arith.empty() && !contains(arith, "*"), "2 * 3 + 1 folds");
+	std::string grouped = function_body(folded, "i64 grouped()");
+	check(!grouped.empty() && !contains(grouped, "/") && !contains(grouped, "%"), "constant locals propagate and fold");
+	std::string propagated = function_body(folded, "i64 propagated(i64 x)");
+	check(!propagated.empty() && !contains(propagated, "* k"), "a constant local is propagated into its use");
+	check(contains(function_body(folded, "i64 overflow()"), "+"), "signed overflow is left to C");
+	check(contains(function_body(folded, "i64 by_zero(i64 x)"), "/"), "division by zero is left to C");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "fold_a compiles unfolded");
+
+		std::string expected;
+		std::string output;
+		check(run_c("const_fold_plain", { plain }, s_Main, expected) == 0, "the unfolded module runs");
+		check(run_c("const_fold", { folded }, s_Main, output) == 0 && output == expected, "folding computes what C does, expected " + expected + " got " + output);
+		check(expected == "7 -6 -31 2.1667 4 0 24 18\n", "C computes the expected values, got " + expected);
+	}
+
+	return finish();
+}
@@ -0,0 +1,86 @@
+#include "tau_test.h"
+
+/*
+Dead code elimination regression test.
+
+Private functions and structs nothing public reaches are dropped, while everything
+reached through calls, types, struct fields or the identifiers of inline C is kept: the
+pruned module still builds and computes the same.
+
+usage: dead_code
+*/
+
+using namespace tau_test;
+
+static bool dead_code_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::EliminateDeadCode(module, ctx);
+	return true;
+}
+
+int main() {
+	Compiled types = compile(R"(mod dead_a;
+
+struct dead_unused {
+	i64 a;
+}
+
+struct dead_inner {
+	i64 b;
+}
+
+struct dead_outer {
+	dead_inner inner;
+}
+
+pub fn holder(i64 x) i64 {
+	dead_outer o;
+	o.inner.b = x;
+	return o.inner.b;
+}
+)", dead_code_only);
+
+	check(types.ok, "dead_a compiles");
+	check(!contains(types.header + types.source, "dead_unused"), "unreachable private structs are dropped");
+	check(contains(types.source, "struct dead_outer {"), "structs used by public functions are kept");
+	check(contains(types.source, "struct dead_inner {"), "field types of reachable structs are kept");
+
+	Compiled calls = compile(R"(mod dead_b;
+
+fn unused(i64 x) i64 {
+	return x;
+}
+
+fn only_unused(i64 x) i64 {
+	return unused(x);
+}
+
+fn called(i64 x) i64 {
+	return x + 1;
+}
+
+fn from_c(i64 x) i64 {
+	return x * 2;
+}
+
+pub fn entry(i64 x) i64 {
+	i64 y = called(x);
+	inline _C {
+		return from_c(y);
+	}
+}
+)", dead_code_only);
+
+	check(calls.ok, "dead_b compiles");
+	check(!contains(calls.source, "unused("), "unreachable private functions are dropped");
+	check(!contains(calls.source, "only_unused("), "functions only dead code calls are dropped");
+
+	// called, from_c and both kept structs have to survive for the C to build
+	if (has_c_compiler()) {
+		std::string output;
+		int status = run_c("dead_code", { types, calls }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"dead_a.h\"\n#include \"dead_b.h\"\n"
+			"int main() { printf(\"%lld %lld\\n\", (long long)holder(3), (long long)entry(4)); return 0; }\n", output);
+		check(status == 0 && output == "3 10\n", "what is reachable is kept, got " + output);
+	}
+
+	return finish();
+}
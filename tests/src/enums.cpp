@@ -0,0 +1,99 @@
+#include "tau_test.h"
+
+/*
+Enum layout regression test.
+
+Enums get the smallest tag that counts their cases, after their payloads, or no tag at all
+when a payload has a niche with room for the other cases: option<bool> and
+option<option<bool>> are one byte and an option of a pointer, written as a template
+argument or not, is the pointer with null for None. The header asserts every size and
+offset, so building it checks the layout against what C gives the emitted structs.
+Pointers to template parameters are rejected.
+
+usage: enums
+*/
+
+using namespace tau_test;
+
+int main() {
+	Compiled laid_out = compile(R"(mod enm_a;
+
+pub enum enm_opt<T> {
+	Some(T),
+	None,
+}
+
+pub enum enm_shape {
+	Empty,
+	Small(u8),
+	Big(i64),
+}
+
+pub enum enm_ref {
+	Some(i64*),
+	None,
+}
+
+pub fn some_ptr(i64* p) enm_opt<i64*> {
+	return enm_opt<i64*>.Some(p);
+}
+
+pub fn no_ptr() enm_opt<i64*> {
+	return enm_opt<i64*>.None();
+}
+
+pub fn deeper(enm_opt<u8**> p) i64 {
+	return 1;
+}
+
+pub fn flags(enm_opt<bool> flag, enm_opt<enm_opt<bool> > nested) i64 {
+	return 1;
+}
+
+pub fn wide(enm_opt<i64> v) i64 {
+	return v.Some;
+}
+
+pub fn big(enm_shape s) i64 {
+	return s.Big;
+}
+)", nullptr);
+
+	check(laid_out.ok, "enm_a compiles");
+	check(contains(laid_out.header, "struct enm_a_enm_opt__bool {"), "enm_opt<bool> is laid out in the header");
+
+	// parse errors are printed, not collected, and the module stops where the parser gave up
+	std::stringstream printed;
+	std::streambuf* out = std::cout.rdbuf(printed.rdbuf());
+	Compiled rejected = compile(R"(mod enm_b;
+
+pub enum enm_maybe<T> {
+	Some(T),
+	None,
+}
+
+pub struct enm_box<T> {
+	enm_maybe<T*> p;
+}
+
+pub fn use(enm_box<i64> b) i64 {
+	return 1;
+}
+)", nullptr);
+	std::cout.rdbuf(out);
+
+	check(!contains(rejected.header, "enm_box") && contains(printed.str(), "Pointers to template parameters are not supported yet: T"), "a pointer to a template parameter is reported");
+
+	if (has_c_compiler()) {
+		std::string output;
+		int status = run_c("enums", { laid_out }, "#include <stdbool.h>\n#include <stdio.h>\n#include \"tautypes.h\"\n#include \"enm_a.h\"\n"
+			"int main() { struct enm_a_enm_opt__i64 w; w.Some = 5; struct enm_shape s; s.Big = 9;\n"
+			" printf(\"%zu %zu %zu %zu %zu %zu %zu %zu %lld %lld\\n\", sizeof(struct enm_a_enm_opt__bool), sizeof(struct enm_a_enm_opt__enm_a_enm_opt__bool), sizeof(struct enm_ref),"
+			" sizeof(struct enm_a_enm_opt__i64_), sizeof(struct enm_a_enm_opt__u8__), sizeof(struct enm_a_enm_opt__i64), sizeof(struct enm_shape), offsetof(struct enm_shape, tag__), (long long)wide(w), (long long)big(s));\n"
+			" i64 v = 1; struct enm_a_enm_opt__i64_ some = some_ptr(&v), none = no_ptr();\n"
+			" printf(\"%u %u %d %d\\n\", enm_a_enm_opt__i64___case(&some), enm_a_enm_opt__i64___case(&none), some.Some == &v, none.Some == NULL); return 0; }\n", output);
+		check(status == 0 && output == "1 1 8 8 8 16 16 8 5 9\n0 1 1 1\n", "the enums have the expected sizes, their asserts hold and None of a pointer is null, got " + output);
+	}
+
+	return finish();
+}
@@ -0,0 +1,110 @@
+#include "tau_test.h"
+
+/*
+Escape analysis regression test.
+
+@alloc of a pointer that does not escape becomes a local array when its count fits the
+stack limit, and a bounded prefix of one under @stack_limit with a heap fallback, while
+escaping pointers, counts past the limit and unbounded counts stay on the heap. The
+promoted module prints what the module without the pass printed, fallback included.
+
+usage: escape
+*/
+
+using namespace tau_test;
+
+static bool promote_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::PromoteAllocations(module, ctx);
+	return true;
+}
+
+static const char* s_Source = R"(mod esc_a;
+
+fn keep(i64* p) i64* {
+	return p;
+}
+
+fn fill(i64* p, u64 n, i64 v) void {
+	for (u64 i = 0; i < n; i++) {
+		p[i] = v;
+		v = v + 1;
+	}
+}
+
+fn total(i64* p, u64 n) i64 {
+	i64 t = 0;
+	for (u64 i = 0; i < n; i++) {
+		t = t + p[i];
+	}
+	return t;
+}
+
+fn rsum(i64* p, u64 n) i64 {
+	if (n == 0) {
+		return 0;
+	}
+	return p[n - 1] + rsum(p, n - 1);
+}
+
+pub fn fixed() i64 {
+	i64* buf = @alloc(8);
+	fill(buf, 8, 1);
+	i64 r = total(buf, 8) + rsum(buf, 8);
+	@free(buf);
+	return r;
+}
+
+@stack_limit(64)
+pub fn bounded(u64 n) i64 {
+	i64* buf = @alloc(n);
+	fill(buf, n, 2);
+	i64 r = total(buf, n);
+	@free(buf);
+	return r;
+}
+
+pub fn large() i64 {
+	i64* buf = @alloc(100);
+	fill(buf, 100, 0);
+	i64 r = total(buf, 100);
+	@free(buf);
+	return r;
+}
+
+pub fn escaping() i64 {
+	i64* buf = @alloc(4);
+	fill(buf, 4, 3);
+	i64* k = keep(buf);
+	i64 r = k[3];
+	@free(buf);
+	return r;
+}
+)";
+
+int main() {
+	Compiled promoted = compile(s_Source, promote_only);
+	check(promoted.ok, "esc_a compiles");
+
+	std::string fixed = function_body(promoted, "i64 fixed()");
+	check(!fixed.empty() && !contains(fixed, "malloc") && !contains(fixed, "free"), "a small fixed allocation moves to the stack, recursion included");
+	std::string bounded = function_body(promoted, "i64 bounded(u64 n)");
+	check(contains(bounded, "__stack") && contains(bounded, "malloc"), "@stack_limit gives a stack prefix with a heap fallback");
+	check(contains(function_body(promoted, "i64 large()"), "malloc"), "an allocation past the stack limit stays on the heap");
+	check(contains(function_body(promoted, "i64 escaping()"), "malloc"), "an escaping pointer stays on the heap");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "esc_a compiles without the pass");
+
+		// bounded(20) does not fit the 8 slots of its prefix and takes the fallback
+		const char* main_c = "#include <stdio.h>\n#include <stdlib.h>\n#include \"tautypes.h\"\n#include \"esc_a.h\"\n"
+			"int main() { printf(\"%lld %lld %lld %lld %lld\\n\", (long long)fixed(), (long long)bounded(4), (long long)bounded(20), (long long)large(), (long long)escaping()); return 0; }\n";
+
+		std::string expected;
+		std::string output;
+		check(run_c("escape_plain", { plain }, main_c, expected) == 0 && expected == "72 14 230 4950 6\n", "the allocations compute the expected values, got " + expected);
+		check(run_c("escape", { promoted }, main_c, output) == 0 && output == expected, "promoted allocations compute the same, got " + output);
+	}
+
+	return finish();
+}
@@ -0,0 +1,89 @@
+#include "tau_test.h"
+
+/*
+Inliner regression test.
+
+Calls to small pure leaf functions are replaced by the callee's expression and leaves are
+expanded before their callers, while arguments used more than once are not computed twice.
+The inlined module prints what the module without the pass printed, and pub inline
+functions are static inline in the header, so C including it can call them.
+
+usage: inliner
+*/
+
+using namespace tau_test;
+
+static bool inline_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::InlineFunctions(module, ctx);
+	return true;
+}
+
+static const char* s_Source = R"(mod inl_a;
+
+fn sq(i64 x) i64 {
+	return x * x;
+}
+
+fn inc(i64 x) i64 {
+	return x + 1;
+}
+
+fn inc2(i64 x) i64 {
+	return inc(inc(x));
+}
+
+fn sub(i64 a, i64 b) i64 {
+	return a - b;
+}
+
+pub inline fn dbl(i64 x) i64 {
+	return x + x;
+}
+
+pub fn square(i64 a) i64 {
+	return sq(a);
+}
+
+pub fn nested(i64 a) i64 {
+	return inc2(a);
+}
+
+pub fn computed(i64 a) i64 {
+	return sq(a + 1);
+}
+
+pub fn ordered(i64 a, i64 b) i64 {
+	return sub(b, a) * sub(a - b, 2);
+}
+
+pub fn doubled(i64 a) i64 {
+	return dbl(a) + 1;
+}
+)";
+
+static const char* s_Main = "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"inl_a.h\"\n"
+	"int main() { printf(\"%lld %lld %lld %lld %lld %lld\\n\", (long long)square(7), (long long)nested(7), (long long)computed(7), (long long)ordered(3, 10), (long long)doubled(4), (long long)dbl(5)); return 0; }\n";
+
+int main() {
+	Compiled inlined = compile(s_Source, inline_only);
+	check(inlined.ok, "inl_a compiles");
+
+	std::string square = function_body(inlined, "i64 square(i64 a)");
+	check(!square.empty() && !contains(square, "sq("), "a leaf call is inlined");
+	std::string nested = function_body(inlined, "i64 nested(i64 a)");
+	check(!nested.empty() && !contains(nested, "inc"), "a function calling only leaves is a leaf itself");
+	check(contains(function_body(inlined, "i64 computed(i64 a)"), "sq("), "an argument used twice is not computed twice");
+	check(contains(inlined.header, "static inline i64 dbl(i64 x)"), "pub inline functions are static inline in the header");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "inl_a compiles without the pass");
+
+		std::string expected;
+		std::string output;
+		check(run_c("inliner_plain", { plain }, s_Main, expected) == 0 && expected == "49 9 64 -63 9 10\n", "the calls compute the expected values, got " + expected);
+		check(run_c("inliner", { inlined }, s_Main, output) == 0 && output == expected, "inlined calls compute the same, got " + output);
+	}
+
+	return finish();
+}
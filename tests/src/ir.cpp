@@ -0,0 +1,127 @@
+#include "tau_test.h"
+
+/*
+SSA IR regression test.
+
+Scalar functions lowered to the IR go through PromoteLocals, EliminateDeadValues,
+NumberValues and HoistInvariants and the emitted C computes what the AST codegen of the
+same module computes. Checks that repeated computations are shared, constant branches
+fold, locals become SSA values and only products that cannot overflow leave the loop.
+
+usage: ir
+*/
+
+using namespace tau_test;
+
+static bool ir_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::PassManager passes(ctx);
+	passes.add_module_pass("lower", tau::LowerToIr);
+	passes.add_function_pass("mem2reg", tau::PromoteLocals);
+	passes.add_function_pass("dce", tau::EliminateDeadValues);
+	passes.add_function_pass("gvn", tau::NumberValues);
+	passes.add_function_pass("licm", tau::HoistInvariants);
+	passes.add_function_pass("gvn", tau::NumberValues);
+	passes.add_function_pass("dce", tau::EliminateDeadValues);
+	return passes.run(module);
+}
+
+// how often part occurs in text
+static size_t count(const std::string& text, const std::string& part) {
+	size_t n = 0;
+	for (size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + part.size())) {
+		n++;
+	}
+	return n;
+}
+
+static const char* s_Source = R"(mod ir_a;
+
+pub fn shared(i64 a, i64 b) i64 {
+	i64 x = a * b + 1;
+	i64 y = a * b + 2;
+	return x + y;
+}
+
+pub fn folded(i64 a) i64 {
+	i64 k = 3;
+	i64 m = k * 4;
+	if (m > 10) {
+		return a + m;
+	}
+	return a;
+}
+
+pub fn hoisted(u64 n, u64 x, u64 y) u64 {
+	u64 t = 0;
+	for (u64 i = 0; i < n; i++) {
+		t = t + x * y;
+	}
+	return t;
+}
+
+pub fn signed_loop(i64 n, i64 x, i64 y) i64 {
+	i64 t = 0;
+	for (i64 i = 0; i < n; i++) {
+		t = t + x * y;
+	}
+	return t;
+}
+
+pub fn merged(i64 a, i64 c) i64 {
+	i64 r = 0;
+	if (c > 0) {
+		r = a;
+	}
+	else {
+		r = 2;
+	}
+	return r;
+}
+
+pub fn nested(i64 n) i64 {
+	i64 t = 0;
+	for (i64 i = 0; i < n; i++) {
+		for (i64 j = 0; j < i; j++) {
+			if (j % 2 == 0) {
+				t = t + j;
+			}
+			else {
+				t = t - 1;
+			}
+		}
+	}
+	return t;
+}
+)";
+
+static const char* s_Main = "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"ir_a.h\"\n"
+	"int main() { printf(\"%lld %lld %lld %llu %llu %lld %lld %lld %lld %lld\\n\", (long long)shared(3, 4), (long long)folded(1), (long long)folded(-20),"
+	" (unsigned long long)hoisted(5, 2, 3), (unsigned long long)hoisted(0, 2, 3), (long long)signed_loop(4, -2, 3), (long long)merged(7, 1), (long long)merged(7, 0),"
+	" (long long)nested(0), (long long)nested(9)); return 0; }\n";
+
+int main() {
+	Compiled lowered = compile(s_Source, ir_only);
+	check(lowered.ok, "ir_a compiles");
+
+	check(count(function_body(lowered, "i64 shared(i64 a, i64 b)"), "a * b") == 1, "a * b is computed once");
+	check(!contains(function_body(lowered, "i64 folded(i64 a)"), "if"), "constants fold through locals and the branch on them goes away");
+	check(!contains(function_body(lowered, "i64 merged(i64 a, i64 c)"), "i64 r"), "locals become SSA values");
+
+	// the loop header is the first block label after the entry
+	std::string hoisted = function_body(lowered, "u64 hoisted(u64 n, u64 x, u64 y)");
+	check(contains(hoisted, "x * y") && hoisted.find("x * y") < hoisted.find("bb__"), "an invariant unsigned product is hoisted in front of the loop");
+	std::string signed_loop = function_body(lowered, "i64 signed_loop(i64 n, i64 x, i64 y)");
+	check(contains(signed_loop, "x * y") && signed_loop.find("x * y") > signed_loop.find("bb__"), "a product that may overflow stays in the loop");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "ir_a compiles through the AST");
+
+		std::string expected;
+		std::string output;
+		check(run_c("ir_plain", { plain }, s_Main, expected) == 0 && expected == "27 13 -8 30 0 -24 7 2 0 24\n", "the AST codegen computes the expected values, got " + expected);
+		check(run_c("ir", { lowered }, s_Main, output) == 0 && output == expected, "the optimized IR computes the same, got " + output);
+	}
+
+	return finish();
+}
@@ -0,0 +1,142 @@
+#include "tau_test.h"
+
+/*
+Struct layout regression test.
+
+The offsets and sizes the TypeRegistry computes for plain, @packed, @align and @reorder
+structs are the ones a C compiler gives structs written out by hand with the same fields
+and attributes, and a bad @align or an unknown annotation is reported.
+
+usage: layout
+*/
+
+using namespace tau_test;
+
+// "size field=offset ..." of a struct the way the TypeRegistry laid it out
+static std::string registry_layout(const std::string& type, const std::vector<std::string>& fields) {
+	tau::TypeRegistry& types = tau::TypeRegistry::instance();
+	tau::_type_id id = types.get_id_from_name(type);
+
+	std::string layout = std::to_string(types.size_of(id));
+	for (auto& field : fields) {
+		layout += " " + field + "=" + std::to_string(types.offset_of(id, tau::Name{ field }));
+	}
+	return layout;
+}
+
+// the same for a struct C laid out
+static std::string c_layout(const std::string& type, const std::vector<std::string>& fields) {
+	std::string code = "printf(\"%zu";
+	for (auto& field : fields) {
+		code += " " + field + "=%zu";
+	}
+	code += "\\n\", sizeof(struct " + type + ")";
+	for (auto& field : fields) {
+		code += ", offsetof(struct " + type + ", " + field + ")";
+	}
+	return code + ");\n";
+}
+
+int main() {
+	Compiled structs = compile(R"(mod lay_a;
+
+pub struct lay_plain {
+	pub u8 a;
+	pub i64 b;
+	pub u16 c;
+}
+
+@packed
+pub struct lay_packed {
+	pub u8 a;
+	pub i64 b;
+	pub u16 c;
+}
+
+@align(16)
+pub struct lay_aligned {
+	pub u8 a;
+	pub i32 b;
+}
+
+@reorder
+pub struct lay_reordered {
+	pub u8 a;
+	pub i64 b;
+	pub u16 c;
+	pub u8 d;
+}
+
+pub struct lay_nested {
+	pub u8 a;
+	pub lay_aligned inner;
+	pub lay_packed packed;
+}
+
+pub fn first(lay_nested n) u8 {
+	return n.a;
+}
+)", nullptr);
+
+	check(structs.ok, "lay_a compiles");
+
+	std::vector<std::pair<std::string, std::vector<std::string>>> checked = {
+		{ "lay_plain", { "a", "b", "c" } },
+		{ "lay_packed", { "a", "b", "c" } },
+		{ "lay_aligned", { "a", "b" } },
+		{ "lay_reordered", { "a", "b", "c", "d" } },
+		{ "lay_nested", { "a", "inner", "packed" } },
+	};
+
+	std::string expected;
+	for (auto& [type, fields] : checked) {
+		expected += registry_layout("lay_a." + type, fields) + "\n";
+	}
+
+	check(contains(expected, "24 a=0 b=8 c=16\n"), "plain fields are aligned to their size, got " + expected);
+	check(contains(expected, "11 a=0 b=1 c=9\n"), "packed fields follow each other, got " + expected);
+	check(contains(expected, "16 a=10 b=0 c=8 d=11\n"), "reordered fields are sorted by alignment, got " + expected);
+
+	if (has_c_compiler()) {
+		// written out by hand, the reordered one in the order @reorder should pick
+		std::string main = "#include <stdio.h>\n#include <stddef.h>\n#include \"tautypes.h\"\n"
+			"struct ref_plain { u8 a; i64 b; u16 c; };\n"
+			"struct ref_packed { u8 a; i64 b; u16 c; } __attribute__((packed));\n"
+			"struct ref_aligned { u8 a; i32 b; } __attribute__((aligned(16)));\n"
+			"struct ref_reordered { i64 b; u16 c; u8 a; u8 d; };\n"
+			"struct ref_nested { u8 a; struct ref_aligned inner; struct ref_packed packed; };\n"
+			"int main() {\n";
+		for (auto& [type, fields] : checked) {
+			main += c_layout("ref" + type.substr(3), fields);
+		}
+		main += "return 0; }\n";
+
+		std::string output;
+		int status = run_c("layout", { structs }, main, output);
+		check(status == 0 && output == expected, "the registry lays structs out like C, expected " + expected + "got " + output);
+	}
+
+	// parse errors are printed, not collected
+	std::stringstream printed;
+	std::streambuf* out = std::cout.rdbuf(printed.rdbuf());
+	Compiled odd = compile(R"(mod lay_b;
+
+@align(3)
+pub struct lay_odd {
+	pub i64 a;
+}
+)", nullptr);
+	Compiled unknown = compile(R"(mod lay_c;
+
+@padded
+pub struct lay_unknown {
+	pub i64 a;
+}
+)", nullptr);
+	std::cout.rdbuf(out);
+
+	check(!odd.ok && contains(printed.str(), "@align expects a power of two"), "@align of a number that is not a power of two is reported");
+	check(!unknown.ok && contains(printed.str(), "Unknown struct annotation @padded"), "an unknown struct annotation is reported");
+
+	return finish();
+}
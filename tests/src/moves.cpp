@@ -0,0 +1,116 @@
+#include "tau_test.h"
+
+/*
+@moves regression test.
+
+A @moves parameter takes the caller's struct by address instead of copying it, so C code
+sees what the callee wrote into it, and locals and temporaries moved from tau arrive
+intact. CheckMoves rejects using a moved local again, moving it twice in one statement
+or from inside a loop it was declared outside of.
+
+usage: moves
+*/
+
+using namespace tau_test;
+
+// a struct of its own and @moves functions taking it, every module needs a new struct name
+static std::string prelude(const std::string& module) {
+	return "mod " + module + ";\n\npub struct " + module + "_one {\n\ti64 a;\n}\n\n"
+		"fn take(" + module + "_one @moves(v)) i64 {\n\treturn v.a;\n}\n\n"
+		"fn two(" + module + "_one @moves(v), " + module + "_one @moves(w)) i64 {\n\treturn v.a + w.a;\n}\n";
+}
+
+// whether compiling the module after its prelude fails with an error mentioning part
+static bool reports(const std::string& module, const std::string& body, const std::string& part) {
+	Compiled compiled = compile(prelude(module) + body, nullptr);
+	for (auto& error : compiled.errors) {
+		if (contains(error, part)) {
+			return !compiled.ok;
+		}
+	}
+	return false;
+}
+
+int main() {
+	Compiled moved = compile(R"(mod mov_a;
+
+pub struct mov_big {
+	i64 a;
+	i64 b;
+	i64 c;
+	i64 d;
+}
+
+fn make(i64 x) mov_big {
+	mov_big v;
+	v.a = x;
+	v.b = x + 1;
+	v.c = x + 2;
+	v.d = x + 3;
+	return v;
+}
+
+pub fn sum(mov_big @moves(v)) i64 {
+	v.a = v.a * 2;
+	return v.a + v.b + v.c + v.d;
+}
+
+fn forward(mov_big @moves(v), i64 k) i64 {
+	return sum(v) + k;
+}
+
+pub fn run(i64 x) i64 {
+	mov_big v = make(x);
+	i64 r = 0;
+	if (x > 0) {
+		r = forward(v, 1);
+	}
+	else {
+		r = sum(v);
+	}
+	mov_big w = make(x);
+	return r + sum(w) + sum(make(2));
+}
+)", nullptr);
+
+	check(moved.ok, "mov_a compiles");
+
+	check(reports("mov_b", R"(
+pub fn twice() i64 {
+	mov_b_one v;
+	v.a = 1;
+	i64 r = take(v);
+	return r + v.a;
+}
+)", "v is used after being moved in twice"), "a use after a move is an error");
+
+	check(reports("mov_c", R"(
+pub fn same() i64 {
+	mov_c_one v;
+	v.a = 1;
+	return two(v, v);
+}
+)", "used again in the same statement"), "moving a local twice in one statement is an error");
+
+	check(reports("mov_d", R"(
+pub fn looped() i64 {
+	mov_d_one v;
+	v.a = 1;
+	i64 r = 0;
+	for (i64 i = 0; i < 2; i++) {
+		r = r + take(v);
+	}
+	return r;
+}
+)", "inside a loop it was declared outside of"), "moving from inside a loop is an error");
+
+	if (has_c_compiler()) {
+		std::string output;
+		// sum doubles the a it was given, which the caller sees when it is passed by address
+		int status = run_c("moves", { moved }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"mov_a.h\"\n"
+			"int main() { struct mov_big b = { 1, 2, 3, 4 }; long long s = sum(&b); printf(\"%lld %lld %lld\\n\", s, (long long)b.a, (long long)run(1)); return 0; }\n", output);
+		check(status == 0 && output == "11 2 39\n", "moved values are passed by address and intact, got " + output);
+	}
+
+	return finish();
+}
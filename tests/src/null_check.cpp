@@ -0,0 +1,90 @@
+#include "tau_test.h"
+
+/*
+Null check elision regression test.
+
+@null_check aborts on a null argument. Checks of pointers already known not to be null
+(addresses, @not_null, earlier checks and calls that checked them) are removed and calls
+whose checks all hold go to the callee's __unchecked entry, while a reassigned or shadowed
+pointer is checked again: null still aborts wherever it can arrive.
+
+usage: null_check
+*/
+
+using namespace tau_test;
+
+static bool null_checks_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::ElideNullChecks(module, ctx);
+	return true;
+}
+
+// runs main_body in a program linked with module, returns whether it exited normally
+static bool exits(const Compiled& module, const std::string& name, const std::string& main_body, std::string& output) {
+	return run_c(name, { module }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"" + module.module + ".h\"\n"
+		"int main() { i32 v = 3; i32 w = -3; (void)v; (void)w; " + main_body + " return 0; }\n", output) == 0;
+}
+
+int main() {
+	Compiled elided = compile(R"(mod nul_a;
+
+pub fn load(i32* p) i32 {
+	@null_check(p);
+	return *p;
+}
+
+pub fn twice(i32* p) i32 {
+	@null_check(p);
+	@null_check(p);
+	return load(p);
+}
+
+pub fn address() i32 {
+	i32 x = 1;
+	return load(&x);
+}
+
+pub fn promised(i32* p) i32 {
+	return load(@not_null(p));
+}
+
+pub fn unknown(i32* p) i32 {
+	return load(p);
+}
+
+pub fn reassigned(i32* p, i32* q) i32 {
+	@null_check(p);
+	p = q;
+	return load(p);
+}
+
+pub fn shadowed(i32* p, i32* q) i32 {
+	@null_check(p);
+	if (load(p) > 0) {
+		i32* p = q;
+		return load(p);
+	}
+	return load(p);
+}
+)", null_checks_only);
+
+	check(elided.ok, "nul_a compiles");
+
+	// entry checks run in the wrapper, the body behind it is the __unchecked entry
+	std::string twice = function_body(elided, "i32 twice__unchecked(i32* p)");
+	check(!twice.empty() && !contains(twice, "NULL"), "a repeated check is removed");
+	check(contains(twice, "load__unchecked("), "a call after a check skips the callee's check");
+	check(contains(function_body(elided, "i32 address()"), "load__unchecked("), "an address is never null");
+	check(contains(function_body(elided, "i32 promised(i32* p)"), "load__unchecked("), "@not_null is trusted");
+
+	if (has_c_compiler()) {
+		std::string output;
+		check(exits(elided, "null_check", "printf(\"%d %d %d %d %d %d\\n\", twice(&v), address(), promised(&v), reassigned(&w, &v), shadowed(&v, &w), shadowed(&w, NULL));", output) && output == "3 1 3 3 -3 -3\n",
+			"checked pointers compute the same, got " + output);
+		check(!exits(elided, "null_check_argument", "load(NULL);", output), "a null argument aborts");
+		check(!exits(elided, "null_check_unknown", "unknown(NULL);", output), "a pointer nothing checked keeps the callee's check");
+		check(!exits(elided, "null_check_reassigned", "reassigned(&v, NULL);", output), "a reassigned pointer is checked again");
+		check(!exits(elided, "null_check_shadowed", "shadowed(&v, NULL);", output), "a shadowing pointer is checked again");
+	}
+
+	return finish();
+}
@@ -0,0 +1,137 @@
+#include "tau_test.h"
+
+#include <algorithm>
+
+/*
+Operator table regression test.
+
+Every (operator, lhs, rhs) pair resolves to what a scan of the allowed operator list
+finds, so mixed pairs like i64 + u8 or f32 * f64 resolve to nothing while a pointer
+indexed by any integer type does. A literal next to a typed operand takes that type,
+two literals take i64 or f64, overloads added later resolve for their own operand order
+only, and tau code mixing types is rejected where the table has no entry.
+
+usage: operators
+*/
+
+using namespace tau_test;
+
+// the first allowed operator matching the exact types, what the table replaced
+static const tau::AllowedBinaryOperator* scan(tau::OperatorID op, tau::_type_id lhs, tau::_type_id rhs) {
+	for (auto& allowed : tau::GetAllowedOperators()) {
+		if (allowed.operator_ == op && allowed.left_type == lhs && allowed.right_type == rhs) {
+			return &allowed;
+		}
+	}
+	return nullptr;
+}
+
+static tau::_type_id result_of(const tau::OperatorTable& table, tau::OperatorID op, tau::_type_id lhs, tau::_type_id rhs) {
+	const tau::AllowedBinaryOperator* found = table.find(op, lhs, rhs);
+	return found == nullptr ? tau::TYPE_UNDEFINED : found->resulting_type;
+}
+
+int main() {
+	using namespace tau;
+
+	OperatorTable& table = GetOperatorTable();
+
+	// registers the pointer operators the way the parser does on first use of f64*
+	ParserContext ctx{ TypeRegistry::instance(), table };
+	_type_id pointer = ctx.pointer_to(TYPE_F64);
+
+	std::vector<_type_id> types;
+	for (_type_id type = TYPE_VOID; type <= TYPE_BOOL; type++) {
+		types.push_back(type);
+	}
+	types.push_back(pointer);
+
+	std::vector<OperatorID> ops;
+	for (auto& allowed : GetAllowedOperators()) {
+		if (std::find(ops.begin(), ops.end(), allowed.operator_) == ops.end()) {
+			ops.push_back(allowed.operator_);
+		}
+	}
+	ops.push_back(OperatorID::ArrayAccess);
+
+	size_t mismatches = 0;
+	for (OperatorID op : ops) {
+		for (_type_id lhs : types) {
+			for (_type_id rhs : types) {
+				// the pointer entries are only in the table, not the list
+				if (lhs == pointer || rhs == pointer) {
+					continue;
+				}
+				const AllowedBinaryOperator* expected = scan(op, lhs, rhs);
+				const AllowedBinaryOperator* found = table.find(op, lhs, rhs);
+				if ((expected == nullptr) != (found == nullptr) || (found != nullptr && found->resulting_type != expected->resulting_type)) {
+					mismatches++;
+				}
+			}
+		}
+	}
+	check(mismatches == 0, "every typed pair resolves like a scan of the allowed operators, " + std::to_string(mismatches) + " differ");
+
+	check(table.find(OperatorID::Add, TYPE_I64, TYPE_U8) == nullptr, "i64 + u8 has no operator");
+	check(table.find(OperatorID::Mul, TYPE_F32, TYPE_F64) == nullptr, "f32 * f64 has no operator");
+	check(table.find(OperatorID::LessThan, TYPE_I32, TYPE_I64) == nullptr, "i32 < i64 has no operator");
+	check(table.find(OperatorID::Assign, TYPE_U64, TYPE_I64) == nullptr, "u64 = i64 has no operator");
+	check(table.find(OperatorID::Add, TYPE_I64, TYPE_F64) == nullptr, "i64 + f64 has no operator");
+
+	bool indexed = true;
+	for (_type_id index : { TYPE_U8, TYPE_U16, TYPE_U32, TYPE_U64, TYPE_I8, TYPE_I16, TYPE_I32, TYPE_I64 }) {
+		indexed &= result_of(table, OperatorID::ArrayAccess, pointer, index) == TYPE_F64;
+	}
+	check(indexed, "f64* indexed by every integer type is an f64");
+	check(table.find(OperatorID::ArrayAccess, pointer, TYPE_F64) == nullptr, "f64* indexed by an f64 has no operator");
+	check(table.find(OperatorID::ArrayAccess, TYPE_U64, pointer) == nullptr, "the operands of an index are not swapped");
+
+	check(result_of(table, OperatorID::Add, TYPE_U8, TYPE_STATIC_INT) == TYPE_U8, "u8 + literal is u8");
+	check(result_of(table, OperatorID::Sub, TYPE_STATIC_INT, TYPE_I16) == TYPE_I16, "literal - i16 is i16");
+	check(result_of(table, OperatorID::LessThan, TYPE_U64, TYPE_STATIC_INT) == TYPE_BOOL, "u64 < literal is bool");
+	check(result_of(table, OperatorID::Mul, TYPE_F32, TYPE_STATIC_FLOAT) == TYPE_F32, "f32 * float literal is f32");
+	check(table.find(OperatorID::Add, TYPE_I64, TYPE_STATIC_FLOAT) == nullptr, "i64 + float literal has no operator");
+	check(table.find(OperatorID::Add, TYPE_F64, TYPE_STATIC_INT) == nullptr, "f64 + integer literal has no operator");
+	check(result_of(table, OperatorID::Add, TYPE_STATIC_INT, TYPE_STATIC_INT) == TYPE_I64, "two integer literals are i64");
+	check(result_of(table, OperatorID::Div, TYPE_STATIC_FLOAT, TYPE_STATIC_FLOAT) == TYPE_F64, "two float literals are f64");
+	check(result_of(table, OperatorID::ArrayAccess, pointer, TYPE_STATIC_INT) == TYPE_F64, "f64* indexed by a literal is an f64");
+
+	// a table of its own so the overloads stay out of the one the compiler uses
+	OperatorTable overloads;
+	_type_id vec = TypeRegistry::instance().define_type("opr_vec", 16).value;
+	overloads.add(AllowedBinaryOperator{ OperatorID::Mul, vec, TYPE_F64, vec });
+	const AllowedBinaryOperator* scale = overloads.find(OperatorID::Mul, vec, TYPE_F64);
+	for (_type_id type = TYPE_VOID; type <= TYPE_BOOL; type++) {
+		overloads.add(AllowedBinaryOperator{ OperatorID::Add, type, type, type });
+	}
+	check(scale != nullptr && overloads.find(OperatorID::Mul, vec, TYPE_F64) == scale, "entries stay where they are when more are added");
+	check(overloads.find(OperatorID::Mul, vec, TYPE_STATIC_FLOAT) == scale, "an overload takes a literal for its typed operand");
+	check(overloads.find(OperatorID::Mul, TYPE_F64, vec) == nullptr, "an overload resolves for its own operand order only");
+	check(overloads.find(OperatorID::Mul, vec, TYPE_F32) == nullptr, "an overload resolves for its own operand types only");
+
+	Compiled mixed = compile(R"(mod opr_a;
+
+pub fn widened(i64 a, u8 b) i64 {
+	return a + 2 + b;
+}
+)", nullptr);
+
+	bool missing = false;
+	for (auto& error : mixed.errors) {
+		missing |= contains(error, "Could not find operator implementation for binary operator");
+	}
+	check(!mixed.ok && missing, "i64 + u8 in tau is rejected");
+
+	Compiled literals = compile(R"(mod opr_b;
+
+pub fn scaled(u8 a, f32 b, f64* p, u16 i) f64 {
+	u8 c = a * 3 + 1;
+	f32 d = b * 0.5;
+	return p[i] + p[2];
+}
+)", nullptr);
+
+	check(literals.ok, "literals and pointer indices next to typed operands compile");
+
+	return finish();
+}
@@ -0,0 +1,102 @@
+#include "tau_test.h"
+
+/*
+Profile guided build regression test.
+
+The round trip of tau build --instrument and --profile-use: the instrumented program
+counts calls and branches into tau.profile, the profile loads and a rebuild with it marks
+the never called function cold and the busy one hot, orders functions by calls and hints
+a lopsided branch, while the program prints the same. Needs cc to run the program.
+
+usage: profile
+*/
+
+using namespace tau_test;
+
+// the line of the source declaring name, a private function taking an i64
+static std::string declaration(const Compiled& compiled, const std::string& name) {
+	size_t at = compiled.source.find(" " + name + "(i64)");
+	if (at == std::string::npos) {
+		return "";
+	}
+	size_t start = compiled.source.rfind('\n', at) + 1;
+	return compiled.source.substr(start, compiled.source.find('\n', at) - start);
+}
+
+static const char* s_Source = R"(mod prof_a;
+
+include _C "stdio.h"
+
+fn work(i64 n) i64 {
+	if (n % 16 == 0) {
+		return n / 16;
+	}
+	return n * 3 + 1;
+}
+
+fn never(i64 n) i64 {
+	return n - 1;
+}
+
+pub fn main() i32 {
+	i64 total = 0;
+	for (i64 i = 0; i < 100000; i++) {
+		total = total + work(i);
+	}
+	if (total < 0) {
+		total = never(total);
+	}
+	inline _C {
+		printf("%lld\n", (long long)total);
+	}
+}
+)";
+
+int main() {
+	if (!has_c_compiler()) {
+		std::cout << "no cc, skipped\n";
+		return 0;
+	}
+
+	Compiled instrumented = compile(s_Source, [](tau::ModuleNode* module, tau::ParserContext& ctx) {
+		tau::PassManager passes(ctx);
+		passes.add_module_pass("instrument", tau::InstrumentModule);
+		tau::AddDefaultPasses(passes);
+		return passes.run(module);
+	});
+	check(instrumented.ok, "prof_a compiles instrumented");
+
+	std::string expected;
+	check(run_c("profile_instrument", { instrumented }, "", expected) == 0 && !expected.empty(), "the instrumented program runs");
+
+	std::ifstream counts(scratch_dir("profile_instrument") / "tau.profile");
+	std::stringstream text;
+	text << counts.rdbuf();
+	check(contains(text.str(), "fn prof_a.work 100000\n"), "calls are counted");
+	check(contains(text.str(), "fn prof_a.never 0\n"), "functions never called are listed");
+	check(contains(text.str(), "br prof_a.work 0 6250 93750\n"), "branches are counted");
+
+	tau::Profile profile;
+	tau::result<bool> loaded = profile.load(text);
+	check(!loaded.error_bit && profile.max_calls() == 100000, "the profile loads");
+
+	Compiled optimized = compile(s_Source, [&profile](tau::ModuleNode* module, tau::ParserContext& ctx) {
+		tau::PassManager passes(ctx);
+		passes.add_module_pass("profile", [&profile](tau::ModuleNode* module, tau::ParserContext& ctx) {
+			return tau::ApplyProfile(module, ctx, profile);
+		});
+		tau::AddDefaultPasses(passes);
+		return passes.run(module);
+	});
+	check(optimized.ok, "prof_a compiles with the profile");
+	check(contains(declaration(optimized, "never"), "cold"), "a function never called is cold");
+	check(contains(declaration(optimized, "work"), "hot"), "the busy function is hot");
+	check(optimized.source.find("main() {") < optimized.source.find("never(i64 n) {"), "the cold function is emitted last");
+	check(!contains(function_body(instrumented, "static i64 work(i64 n)"), "__builtin_expect("), "without a profile the branch has no hint");
+	check(contains(function_body(optimized, "static i64 work(i64 n)"), "__builtin_expect("), "the lopsided branch is hinted");
+
+	std::string output;
+	check(run_c("profile_use", { optimized }, "", output) == 0 && output == expected, "the profile-use build prints the same, got " + output);
+
+	return finish();
+}
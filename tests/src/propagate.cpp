@@ -0,0 +1,123 @@
+#include "tau_test.h"
+
+/*
+? propagation regression test.
+
+value? unwraps the first case of an enum and returns any other case from the calling
+function on a cold path, rebuilt through the constructors of the enum the function
+returns. Generic code can construct cases of its own enum instances, and ? is rejected
+in functions that do not return an enum or cannot hold the failure.
+
+usage: propagate
+*/
+
+using namespace tau_test;
+
+int main() {
+	Compiled propagated = compile(R"(mod prop_a;
+
+pub enum prop_result<_ok_t, _err_t> {
+	Ok(_ok_t),
+	Err(_err_t),
+}
+
+pub enum prop_opt<_t> {
+	Some(_t),
+	None,
+}
+
+pub enum prop_status {
+	Done(i64),
+	Failed(u8),
+}
+
+pub enum prop_code {
+	Done(i64),
+	Failed(u8),
+}
+
+pub fn checked(i64 x, u8 code) prop_result<i64, u8> {
+	if (x < 0) {
+		return prop_result<i64, u8>.Err(code);
+	}
+	return prop_result<i64, u8>.Ok(x);
+}
+
+pub fn twice(i64 x, u8 code) prop_result<i64, u8> {
+	i64 v = checked(x, code)?;
+	return prop_result<i64, u8>.Ok(v * 2);
+}
+
+fn status(i64 x) prop_status {
+	if (x > 100) {
+		return prop_status.Failed(9);
+	}
+	return prop_status.Done(x);
+}
+
+pub fn converted(i64 x) prop_code {
+	i64 v = status(x)?;
+	return prop_code.Done(v + 1);
+}
+
+pub fn wrap<_t>(_t v) prop_opt<_t> {
+	return prop_opt<_t>.Some(v);
+}
+
+pub fn next(i64 x) prop_opt<i64> {
+	i64 v = wrap<i64>(x)?;
+	return prop_opt<i64>.Some(v + 1);
+}
+)");
+
+	check(propagated.ok, "prop_a compiles");
+	check(contains(function_body(propagated, "struct prop_a_prop_result__i64_u8 twice(i64 x, u8 code)"), "__builtin_expect"), "? returns the failure early on a cold path");
+
+	Compiled rejected = compile(R"(mod prop_b;
+
+pub enum prop_res<_ok_t, _err_t> {
+	Ok(_ok_t),
+	Err(_err_t),
+}
+
+pub enum prop_other {
+	Ok(i64),
+	Fail(u8),
+}
+
+pub fn make(i64 x) prop_res<i64, u8> {
+	return prop_res<i64, u8>.Ok(x);
+}
+
+pub fn plain(i64 x) i64 {
+	i64 v = make(x)?;
+	return v;
+}
+
+pub fn mismatched(i64 x) prop_other {
+	i64 v = make(x)?;
+	return prop_other.Ok(v);
+}
+)");
+
+	check(!rejected.ok, "prop_b is rejected");
+	bool plain = false;
+	bool mismatched = false;
+	for (auto& error : rejected.errors) {
+		plain |= contains(error, "? in plain, which does not return an enum");
+		mismatched |= contains(error, "? cannot return the Err case of struct prop_b_prop_res__i64_u8 as struct prop_other");
+	}
+	check(plain, "? in a function returning i64 is reported");
+	check(mismatched, "? in a function returning a different enum is reported");
+
+	if (has_c_compiler()) {
+		std::string output;
+		int status = run_c("propagate", { propagated }, "#include <stdbool.h>\n#include <stdio.h>\n#include \"tautypes.h\"\n#include \"prop_a.h\"\n"
+			"int main() { struct prop_a_prop_result__i64_u8 good = twice(21, 3), bad = twice(-1, 7); struct prop_code c = converted(4), f = converted(200); struct prop_a_prop_opt__i64 n = next(4);\n"
+			" printf(\"%u %lld %u %u %u %lld %u %u\\n\", prop_a_prop_result__i64_u8__case(&good), (long long)good.Ok, prop_a_prop_result__i64_u8__case(&bad), (unsigned)bad.Err,"
+			" prop_code__case(&c), (long long)c.Done, prop_code__case(&f), (unsigned)f.Failed); printf(\"%u %lld\\n\", prop_a_prop_opt__i64__case(&n), (long long)n.Some); return 0; }\n", output);
+		check(status == 0 && output == "0 42 1 7 0 5 1 9\n0 5\n", "? passes values through and failures out, got " + output);
+	}
+
+	return finish();
+}
@@ -0,0 +1,106 @@
+#include "tau_test.h"
+
+/*
+Scope regression test.
+
+A binding shadows the outer binding of its name until its frame ends, and then the outer
+one is back, however deep the nesting and however often the table grew in between. Tau
+source shadowing a variable in nested blocks computes with the innermost binding and a
+variable is gone once its block is left.
+
+usage: scope
+*/
+
+using namespace tau_test;
+
+// type of the innermost binding, TYPE_UNDEFINED when name is not bound
+static tau::_type_id bound(const tau::Scope& scope, const tau::Name& name) {
+	const tau::ItemInfo* info = scope.lookup(name);
+	return info == nullptr ? tau::TYPE_UNDEFINED : info->type_id;
+}
+
+int main() {
+	tau::Name x{ "scope_x" };
+	tau::Name y{ "scope_y" };
+
+	tau::Scope scope;
+	scope.begin();
+	scope.add_variable(x, tau::TYPE_I64);
+
+	scope.begin();
+	scope.add_variable(x, tau::TYPE_F64);
+	scope.add_variable(y, tau::TYPE_U8);
+	check(bound(scope, x) == tau::TYPE_F64, "an inner binding shadows the outer one");
+
+	scope.begin();
+	scope.add_variable(x, tau::TYPE_BOOL);
+	scope.add_variable(x, tau::TYPE_CHAR);
+	check(bound(scope, x) == tau::TYPE_CHAR, "a name bound twice in one frame is its last binding");
+
+	// many names force the table to grow while x is shadowed three deep
+	std::vector<tau::Name> many;
+	for (int i = 0; i < 500; i++) {
+		many.emplace_back("scope_many_" + std::to_string(i));
+		scope.add_variable(many.back(), tau::TYPE_I32);
+	}
+	check(bound(scope, many[0]) == tau::TYPE_I32 && bound(scope, many[499]) == tau::TYPE_I32, "every name added is bound");
+	check(bound(scope, x) == tau::TYPE_CHAR, "growing keeps the innermost binding");
+
+	scope.end();
+	check(bound(scope, x) == tau::TYPE_F64, "ending a frame brings back the binding it shadowed");
+	check(!scope.exists(many[0]) && !scope.exists(many[499]), "ending a frame unbinds the names it added");
+
+	scope.end();
+	check(bound(scope, x) == tau::TYPE_I64, "the outermost binding is back");
+	check(!scope.exists(y), "a name only bound inside is gone");
+
+	scope.begin();
+	scope.add_variable(y, tau::TYPE_U16);
+	check(bound(scope, y) == tau::TYPE_U16, "a name is bound again after it went out of scope");
+	scope.end();
+
+	scope.end();
+	check(!scope.exists(x) && !scope.exists(y), "nothing is bound once every frame ended");
+
+	Compiled shadowed = compile(R"(mod scp_a;
+
+pub fn shadow(i64 x, f64* out) i64 {
+	if (x > 0) {
+		f64 x = 2.5;
+		if (x > 1.0) {
+			f64 x = 7.5;
+			out[1] = x;
+		}
+		out[0] = x;
+	}
+	return x + 1;
+}
+)", nullptr);
+
+	check(shadowed.ok, "scp_a compiles");
+
+	if (has_c_compiler()) {
+		std::string output;
+		int status = run_c("scope", { shadowed }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"scp_a.h\"\n"
+			"int main() { f64 out[2] = { 0, 0 }; i64 r = shadow(3, out); printf(\"%lld %g %g\\n\", (long long)r, out[0], out[1]); return 0; }\n", output);
+		check(status == 0 && output == "4 2.5 7.5\n", "each block uses its own x, got " + output);
+	}
+
+	Compiled leaked = compile(R"(mod scp_b;
+
+pub fn leak(i64 a) i64 {
+	if (a > 0) {
+		i64 inner = a;
+	}
+	return inner;
+}
+)", nullptr);
+
+	bool unknown = false;
+	for (auto& error : leaked.errors) {
+		unknown |= contains(error, "Unknown variable: inner");
+	}
+	check(!leaked.ok && unknown, "a variable is unknown after its block");
+
+	return finish();
+}
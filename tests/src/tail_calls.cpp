@@ -0,0 +1,89 @@
+#include "tau_test.h"
+
+/*
+Tail call elimination regression test.
+
+Self tail calls and accumulating recursion (n * f(n - 1)) become loops that run deep
+enough to overflow the stack of the recursive version, and compute what the recursion
+did. Functions taking an address or mixing + and * in their recursive returns keep
+recursing and still compute the same.
+
+usage: tail_calls
+*/
+
+using namespace tau_test;
+
+static bool tail_calls_only(tau::ModuleNode* module, tau::ParserContext& ctx) {
+	tau::EliminateTailCalls(module, ctx);
+	return true;
+}
+
+static const char* s_Source = R"(mod tail_a;
+
+pub fn fact(i64 n) i64 {
+	if (n < 2) {
+		return 1;
+	}
+	return n * fact(n - 1);
+}
+
+pub fn count(i64 n, i64 acc) i64 {
+	if (n == 0) {
+		return acc;
+	}
+	return count(n - 1, acc + 1);
+}
+
+pub fn sum(i64 n) i64 {
+	if (n == 0) {
+		return 0;
+	}
+	return n + sum(n - 1);
+}
+
+pub fn addr(i64 n) i64 {
+	i64* p = &n;
+	if (n == 0) {
+		return 0;
+	}
+	return addr(n - 1);
+}
+
+pub fn mixed(i64 n) i64 {
+	if (n == 0) {
+		return 0;
+	}
+	if (n == 1) {
+		return 2 * mixed(n - 1);
+	}
+	return 1 + mixed(n - 1);
+}
+)";
+
+static const std::string s_Main = "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"tail_a.h\"\n"
+	"int main() { printf(\"%lld %lld %lld %lld %lld\\n\", (long long)fact(20), (long long)count(1000, 0), (long long)sum(1000), (long long)addr(1000), (long long)mixed(1000));";
+
+int main() {
+	Compiled looped = compile(s_Source, tail_calls_only);
+	check(looped.ok, "tail_a compiles");
+
+	check(!contains(function_body(looped, "i64 count(i64 n, i64 acc)"), "return count("), "a tail call becomes a jump");
+	check(!contains(function_body(looped, "i64 fact(i64 n)"), "fact(n - 1)"), "n * f(n - 1) multiplies into an accumulator");
+	check(contains(function_body(looped, "i64 addr(i64 n)"), "return addr("), "a function taking an address keeps recursing");
+	check(contains(function_body(looped, "i64 mixed(i64 n)"), "mixed(n - 1)"), "mixing + and * keeps recursing");
+
+	if (has_c_compiler()) {
+		Compiled plain = compile(s_Source, nullptr);
+		check(plain.ok, "tail_a compiles without the pass");
+
+		// a hundred million frames only finish as a loop
+		std::string expected;
+		std::string output;
+		check(run_c("tail_calls_plain", { plain }, s_Main + " return 0; }\n", expected) == 0 && expected == "2432902008176640000 1000 500500 0 999\n",
+			"the recursion computes the expected values, got " + expected);
+		check(run_c("tail_calls", { looped }, s_Main + " printf(\"%lld %lld\\n\", (long long)count(100000000, 0), (long long)sum(100000000)); return 0; }\n", output) == 0
+			&& output == expected + "100000000 5000000050000000\n", "loops compute what the recursion did, got " + output);
+	}
+
+	return finish();
+}
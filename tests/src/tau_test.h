@@ -0,0 +1,188 @@
+#pragma once
+
+#include "tau.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+Shared by the regression tests in tests/src. Every test is a standalone program like the
+benchmarks: it runs tau source through the same steps as the tau driver (tokenize, parse,
+instantiate templates, type check, check moves, the passes, emit C), builds the C with cc
+and runs it where a C compiler is around, and returns 1 when any check failed.
+
+Structs register in the global TypeRegistry, so every source a test program compiles
+needs struct names of its own. Generic structs in the TemplateCache are kept per module
+and only need a module name of their own.
+*/
+
+namespace tau_test {
+
+	struct Compiled {
+		bool ok = false;
+		std::string module;
+		std::string header;
+		std::string source;
+		std::vector<std::string> errors;
+	};
+
+	// the passes to run on a module that type checked, false stops the compile
+	typedef std::function<bool(tau::ModuleNode*, tau::ParserContext&)> Passes;
+
+	// what the tau driver runs after type checking
+	inline bool default_passes(tau::ModuleNode* module, tau::ParserContext& ctx) {
+		tau::PassManager passes(ctx);
+		tau::AddDefaultPasses(passes);
+		return passes.run(module);
+	}
+
+	inline int s_Failures = 0;
+
+	inline bool contains(const std::string& text, const std::string& part) {
+		return text.find(part) != std::string::npos;
+	}
+
+	inline void check(bool condition, const std::string& what) {
+		if (!condition) {
+			std::cout << "FAIL " << what << "\n";
+			s_Failures++;
+		}
+	}
+
+	// the C of one function, from its signature up to the brace closing its body
+	inline std::string function_body(const Compiled& compiled, const std::string& signature) {
+		const std::string& source = compiled.source;
+		size_t start = source.find(signature + " {");
+		if (start == std::string::npos) {
+			return "";
+		}
+
+		size_t depth = 0;
+		for (size_t i = start + signature.size() + 1; i < source.size(); i++) {
+			if (source[i] == '{') {
+				depth++;
+			}
+			else if (source[i] == '}' && --depth == 0) {
+				return source.substr(start, i + 1 - start);
+			}
+		}
+		return source.substr(start);
+	}
+
+	// passes may be empty to emit the C of the module as it was parsed, threads go to TypeCheckModule
+	inline Compiled compile(const std::string& text, const Passes& passes = default_passes, size_t threads = 0) {
+		Compiled compiled;
+
+		tau::TokenStream tokens;
+		tau::result<bool> tokenized = tau::Tokenize(text, "test.tau", tokens);
+		if (tokenized.error_bit) {
+			compiled.errors.push_back(tokenized.error);
+			return compiled;
+		}
+
+		tau::Parser parser;
+		tau::InitializeTauParser(parser);
+
+		tau::AstNode* node = parser.parse_eval(tokens, "Module");
+		tau::ParserContext ctx = parser.get_context();
+
+		tau::ModuleNode* module = tau::node_cast<tau::ModuleNode>(node);
+		if (module == nullptr) {
+			compiled.errors = ctx.errors;
+			compiled.errors.push_back("not a module");
+			delete node;
+			return compiled;
+		}
+		compiled.module = module->moduleName->get_full_name().str();
+
+		tau::InstantiateTemplates(module, ctx);
+
+		bool checked = ctx.errors.empty() && tau::TypeCheckModule(module, ctx, threads) && tau::CheckMoves(module, ctx);
+
+		if (checked && (!passes || passes(module, ctx))) {
+			std::stringstream header;
+			std::stringstream source;
+			module->compile_header(header, ctx);
+			compiled.ok = node->compile(source, ctx);
+			compiled.header = header.str();
+			compiled.source = source.str();
+		}
+
+		compiled.errors = ctx.errors;
+		delete node;
+		return compiled;
+	}
+
+	inline bool has_c_compiler() {
+		return std::system("cc --version > /dev/null 2>&1") == 0;
+	}
+
+	// where run_c builds and runs the test called name, files the program writes end up here
+	inline std::filesystem::path scratch_dir(const std::string& name) {
+		return std::filesystem::temp_directory_path() / ("tau_test_" + name);
+	}
+
+	/*
+	Builds the modules and main_c (may be empty when a module defines main) with cc in
+	the scratch directory of the test and runs the program there. Returns what
+	std::system did for the run, 0 when it exited with 0, with its standard output in
+	output, or -1 when it did not build.
+	*/
+	inline int run_c(const std::string& name, const std::vector<Compiled>& modules, const std::string& main_c, std::string& output) {
+		namespace fs = std::filesystem;
+		fs::path dir = scratch_dir(name);
+		fs::remove_all(dir);
+		fs::create_directories(dir);
+
+		std::ofstream types(dir / "tautypes.h");
+		types << "#pragma once\n\n#include <stdint.h>\n\n";
+		for (const char* width : { "8", "16", "32", "64" }) {
+			types << "typedef uint" << width << "_t u" << width << ";\n";
+			types << "typedef int" << width << "_t i" << width << ";\n";
+		}
+		types << "typedef float f32;\ntypedef double f64;\n";
+		types.close();
+
+		std::string files;
+		for (auto& module : modules) {
+			std::ofstream(dir / (module.module + ".h")) << module.header;
+			std::ofstream(dir / (module.module + ".c")) << module.source;
+			files += " " + module.module + ".c";
+		}
+		if (!main_c.empty()) {
+			std::ofstream(dir / "main.c") << main_c;
+			files += " main.c";
+		}
+
+		std::string cd = "cd \"" + dir.string() + "\" && ";
+		if (std::system((cd + "cc -w -o program" + files + " > build.txt 2>&1").c_str()) != 0) {
+			std::ifstream log(dir / "build.txt");
+			std::cout << log.rdbuf();
+			return -1;
+		}
+
+		int status = std::system((cd + "./program > output.txt").c_str());
+
+		std::ifstream in(dir / "output.txt");
+		std::stringstream text;
+		text << in.rdbuf();
+		output = text.str();
+
+		return status;
+	}
+
+	inline int finish() {
+		if (s_Failures != 0) {
+			std::cout << s_Failures << " check(s) failed\n";
+			return 1;
+		}
+		std::cout << "ok\n";
+		return 0;
+	}
+}
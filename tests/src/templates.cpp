@@ -0,0 +1,162 @@
+#include "tau_test.h"
+
+/*
+Monomorphization regression test.
+
+Generic functions and structs get one specialised copy per argument list and generic
+code calling generic code is expanded until no template call is left: the C builds,
+links and computes what the templates say. Two modules declaring a generic struct of the
+same name each get their own, and a third module names the one it means by its module.
+Instantiations that would never end or do not match the template are reported.
+
+usage: templates
+*/
+
+using namespace tau_test;
+
+int main() {
+	Compiled generic = compile(R"(mod tmpl_a;
+
+pub struct tmpl_pair<T> {
+	pub T first;
+	pub T second;
+}
+
+fn max<T>(T a, T b) T {
+	if (a > b) {
+		return a;
+	}
+	return b;
+}
+
+fn max3<T>(T a, T b, T c) T {
+	return max<T>(max<T>(a, b), c);
+}
+
+pub fn ints(i64 a, i64 b, i64 c) i64 {
+	return max3<i64>(a, b, c) + max<i64>(a, b);
+}
+
+pub fn floats(f64 a) f64 {
+	return max<f64>(a, 1.5);
+}
+
+pub fn larger(tmpl_pair<i64> p) i64 {
+	return max<i64>(p.first, p.second);
+}
+
+pub struct tmpl_holder {
+	pub tmpl_pair<f64> range;
+	pub i64 count;
+}
+
+pub fn width(tmpl_holder h) f64 {
+	return h.range.second - h.range.first;
+}
+)", nullptr);
+
+	check(generic.ok, "tmpl_a compiles");
+	check(contains(generic.header, "struct tmpl_a_tmpl_pair__i64 {"), "tmpl_pair<i64> is laid out in the header");
+
+	if (has_c_compiler()) {
+		std::string output;
+		int status = run_c("templates", { generic }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"tmpl_a.h\"\n"
+			"int main() { struct tmpl_a_tmpl_pair__i64 p = { 11, 7 }; struct tmpl_holder h = { { 1.5, 4.0 }, 2 };\n"
+			" printf(\"%lld %g %g %lld %g\\n\", (long long)ints(3, 9, 4), floats(0.5), floats(2.5), (long long)larger(p), width(h)); return 0; }\n", output);
+		check(status == 0 && output == "18 1.5 2.5 11 2.5\n", "instances compute what the templates say, got " + output);
+	}
+
+	Compiled first = compile(R"(mod tmpl_d;
+
+pub struct box<T> {
+	pub T v;
+	pub T w;
+}
+
+pub fn spread(box<i64> b) i64 {
+	return b.w - b.v;
+}
+)", nullptr);
+
+	Compiled second = compile(R"(mod tmpl_e;
+
+pub struct box<T> {
+	pub T z;
+}
+
+pub fn unwrap(box<i64> b) i64 {
+	return b.z;
+}
+)", nullptr);
+
+	Compiled third = compile(R"(mod tmpl_f;
+
+pub fn total(tmpl_d.box<i64> b) i64 {
+	return b.v + b.w;
+}
+)", nullptr);
+
+	check(first.ok && second.ok, "two modules declare box<T> of their own");
+	check(third.ok, "a module names the box<T> of another module by its module");
+
+	// parse errors are printed, not collected
+	std::stringstream printed;
+	std::streambuf* out = std::cout.rdbuf(printed.rdbuf());
+	Compiled ambiguous = compile(R"(mod tmpl_g;
+
+pub fn either(box<i64> b) i64 {
+	return 0;
+}
+)", nullptr);
+	std::cout.rdbuf(out);
+
+	check(!contains(ambiguous.header, "either") && contains(printed.str(), "Generic struct box is declared by more than one module"), "box<i64> declared by two other modules is ambiguous");
+
+	if (has_c_compiler()) {
+		std::string output;
+		int status = run_c("templates_modules", { first, second, third }, "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"tmpl_d.h\"\n#include \"tmpl_e.h\"\n#include \"tmpl_f.h\"\n"
+			"int main() { struct tmpl_d_box__i64 d = { 3, 10 }; struct tmpl_e_box__i64 e = { 5 }; printf(\"%lld %lld %lld\\n\", (long long)spread(d), (long long)unwrap(e), (long long)total(d)); return 0; }\n", output);
+		check(status == 0 && output == "7 5 13\n", "each module uses its own box<i64>, got " + output);
+	}
+
+	Compiled growing = compile(R"(mod tmpl_b;
+
+pub struct tmpl_box<T> {
+	T v;
+}
+
+fn grow<T>(T a) i64 {
+	tmpl_box<T> b;
+	return grow<tmpl_box<T> >(b);
+}
+
+pub fn start(i64 a) i64 {
+	return grow<i64>(a);
+}
+)", nullptr);
+
+	bool too_deep = false;
+	for (auto& error : growing.errors) {
+		too_deep |= contains(error, "nests too deeply");
+	}
+	check(!growing.ok && too_deep, "a template instantiating itself with growing arguments is reported");
+
+	Compiled mismatched = compile(R"(mod tmpl_c;
+
+fn id<T>(T a) T {
+	return a;
+}
+
+pub fn wrong(i64 a) i64 {
+	return id<i64, i32>(a);
+}
+)", nullptr);
+
+	bool arity = false;
+	for (auto& error : mismatched.errors) {
+		arity |= contains(error, "expects 1 template arguments, got 2");
+	}
+	check(!mismatched.ok && arity, "the template argument count is checked");
+
+	return finish();
+}
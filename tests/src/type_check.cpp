@@ -0,0 +1,53 @@
+#include "tau_test.h"
+
+/*
+Parallel type check regression test.
+
+TypeCheckModule checks function bodies on several workers. A module checked on eight
+threads has to give the errors of a single threaded check in the same order and, when it
+is clean, the same C, which builds and runs.
+
+usage: type_check
+*/
+
+using namespace tau_test;
+
+// count functions, every one calling the one before it, broken ones use an unknown variable
+static std::string module(const std::string& name, size_t count, bool broken) {
+	std::string text = "mod " + name + ";\n\nfn step0(i64 x) i64 {\n\treturn x + 1;\n}\n";
+	for (size_t i = 1; i < count; i++) {
+		std::string n = std::to_string(i);
+		std::string value = broken && i % 7 == 0 ? "missing" + n : "x";
+		text += "\nfn step" + n + "(i64 x) i64 {\n\ti64 y = step" + std::to_string(i - 1) + "(" + value + ");\n\treturn y * 3 % 1000;\n}\n";
+	}
+	text += "\npub fn run(i64 x) i64 {\n\treturn step" + std::to_string(count - 1) + "(x);\n}\n";
+	return text;
+}
+
+int main() {
+	std::string clean = module("chk_a", 64, false);
+	Compiled single = compile(clean, nullptr, 1);
+	Compiled parallel = compile(clean, nullptr, 8);
+
+	check(single.ok && parallel.ok, "chk_a checks on one and on eight threads");
+	check(parallel.header == single.header && parallel.source == single.source, "the C does not depend on the thread count");
+
+	std::string broken = module("chk_b", 64, true);
+	Compiled single_errors = compile(broken, nullptr, 1);
+	Compiled parallel_errors = compile(broken, nullptr, 8);
+
+	check(!single_errors.ok && single_errors.errors.size() >= 9, "every broken function is reported");
+	check(parallel_errors.errors == single_errors.errors, "errors come in function order on eight threads");
+
+	if (has_c_compiler()) {
+		const char* main_c = "#include <stdio.h>\n#include \"tautypes.h\"\n#include \"chk_a.h\"\n"
+			"int main() { printf(\"%lld\\n\", (long long)run(5)); return 0; }\n";
+
+		std::string expected;
+		std::string output;
+		check(run_c("type_check_single", { single }, main_c, expected) == 0 && !expected.empty(), "the single threaded build runs");
+		check(run_c("type_check", { parallel }, main_c, output) == 0 && output == expected, "the parallel build prints the same, got " + output);
+	}
+
+	return finish();
+}